@@ -1,8 +1,27 @@
 import flags
 import numpy
+from typing import Callable, ClassVar
+
+class Mesh:
+    def __init__(self, vertices: numpy.ndarray[numpy.float32[m, 3]], faces: numpy.ndarray[numpy.int32[m, 3]], colors: numpy.ndarray[numpy.float32[m, 3]] = ...) -> None:
+        """__init__(self: pytoph.Mesh, vertices: numpy.ndarray[numpy.float32[m, 3]], faces: numpy.ndarray[numpy.int32[m, 3]], colors: numpy.ndarray[numpy.float32[m, 3]] = array([], shape=(0, 3), dtype=float32)) -> None"""
+    @staticmethod
+    def cube(size: numpy.ndarray[numpy.float32[3, 1]], color: numpy.ndarray[numpy.float32[3, 1]] = ...) -> Mesh:
+        """cube(size: numpy.ndarray[numpy.float32[3, 1]], color: numpy.ndarray[numpy.float32[3, 1]] = array([1., 1., 1.], dtype=float32)) -> pytoph.Mesh"""
+    @staticmethod
+    def load(path: str, weld: bool = ..., weld_epsilon: float = ..., scale: float = ..., color: numpy.ndarray[numpy.float32[3, 1]] = ..., cache_directory: str = ...) -> Mesh:
+        """load(path: str, weld: bool = True, weld_epsilon: float = 0.0, scale: float = 1.0, color: numpy.ndarray[numpy.float32[3, 1]] = array([1., 1., 1.], dtype=float32), cache_directory: str = '') -> pytoph.Mesh"""
+    @property
+    def triangle_count(self) -> int:
+        """(arg0: pytoph.Mesh) -> int"""
+    @property
+    def vertex_count(self) -> int:
+        """(arg0: pytoph.Mesh) -> int"""
 
 class Frame:
+    color: numpy.ndarray[numpy.float32[3, 1]]
     matrix: numpy.ndarray[numpy.float32[4, 4]]
+    mesh: Mesh
     name: str
     quaternion: numpy.ndarray[numpy.float32[4, 1]]
     rotation: numpy.ndarray[numpy.float32[3, 3], flags.f_contiguous]
@@ -11,10 +30,13 @@ class Frame:
         """__init__(self: pytoph.Frame, name: str) -> None"""
     def add_child(self, child: Frame) -> None:
         """add_child(self: pytoph.Frame, child: pytoph.Frame) -> None"""
+    @staticmethod
+    def cube(name: str, size: numpy.ndarray[numpy.float32[3, 1]], color: numpy.ndarray[numpy.float32[3, 1]] = ...) -> Frame:
+        """cube(name: str, size: numpy.ndarray[numpy.float32[3, 1]], color: numpy.ndarray[numpy.float32[3, 1]] = array([1., 1., 1.], dtype=float32)) -> pytoph.Frame"""
     def rotate(self, arg0) -> None:
         """rotate(self: pytoph.Frame, arg0: Eigen::AngleAxis<float>) -> None"""
-    def show(self) -> None:
-        """show(self: pytoph.Frame) -> None"""
+    def show(self, block: bool = ...) -> Viewer | None:
+        """show(self: pytoph.Frame, block: bool = True) -> pytoph.Viewer"""
     def translate(self, arg0: numpy.ndarray[numpy.float32[3, 1]]) -> None:
         """translate(self: pytoph.Frame, arg0: numpy.ndarray[numpy.float32[3, 1]]) -> None"""
     @property
@@ -35,3 +57,314 @@ class Frame:
     @property
     def world_translation(self) -> numpy.ndarray[numpy.float32[3, 1], flags.writeable]:
         """(arg0: pytoph.Frame) -> numpy.ndarray[numpy.float32[3, 1], flags.writeable]"""
+
+class PoseBuffer:
+    def __init__(self, frames: list[Frame]) -> None:
+        """__init__(self: pytoph.PoseBuffer, frames: list[pytoph.Frame]) -> None"""
+    def publish(self) -> None:
+        """publish(self: pytoph.PoseBuffer) -> None"""
+    def set(self, index: int, matrix: numpy.ndarray[numpy.float32[4, 4]]) -> None:
+        """set(self: pytoph.PoseBuffer, index: int, matrix: numpy.ndarray[numpy.float32[4, 4]]) -> None"""
+    @property
+    def frames(self) -> list[Frame]:
+        """(arg0: pytoph.PoseBuffer) -> list[pytoph.Frame]"""
+
+class RayHit:
+    def __init__(self, *args, **kwargs) -> None:
+        """Initialize self.  See help(type(self)) for accurate signature."""
+    def __bool__(self) -> bool:
+        """__bool__(self: pytoph.RayHit) -> bool"""
+    @property
+    def distance(self) -> float:
+        """(arg0: pytoph.RayHit) -> float"""
+    @property
+    def frame(self) -> Frame:
+        """(arg0: pytoph.RayHit) -> pytoph.Frame"""
+    @property
+    def triangle(self) -> int:
+        """(arg0: pytoph.RayHit) -> int"""
+
+class Scene:
+    def __init__(self) -> None:
+        """__init__(self: pytoph.Scene) -> None"""
+    def add_frame(self, frame: Frame) -> None:
+        """add_frame(self: pytoph.Scene, frame: pytoph.Frame) -> None"""
+    def raycast(self, origin: numpy.ndarray[numpy.float32[3, 1]], direction: numpy.ndarray[numpy.float32[3, 1]], max_distance: float = ...) -> RayHit:
+        """raycast(self: pytoph.Scene, origin: numpy.ndarray[numpy.float32[3, 1]], direction: numpy.ndarray[numpy.float32[3, 1]], max_distance: float = inf) -> pytoph.RayHit"""
+    def raycast_many(self, origins: numpy.ndarray[numpy.float32[m, 3]], directions: numpy.ndarray[numpy.float32[m, 3]], max_distance: float = ...) -> tuple:
+        """raycast_many(self: pytoph.Scene, origins: numpy.ndarray[numpy.float32[m, 3]], directions: numpy.ndarray[numpy.float32[m, 3]], max_distance: float = inf) -> tuple"""
+    @property
+    def frames(self) -> list[Frame]:
+        """(arg0: pytoph.Scene) -> list[pytoph.Frame]"""
+
+class BeamPattern:
+    def __init__(self, directions: numpy.ndarray[numpy.float32[m, 3]]) -> None:
+        """__init__(self: pytoph.BeamPattern, directions: numpy.ndarray[numpy.float32[m, 3]]) -> None"""
+    @staticmethod
+    def pinhole(width: int, height: int, fx: float, fy: float, cx: float, cy: float) -> BeamPattern:
+        """pinhole(width: int, height: int, fx: float, fy: float, cx: float, cy: float) -> pytoph.BeamPattern"""
+    @staticmethod
+    def spinning(channels: int, steps: int, min_elevation: float, max_elevation: float) -> BeamPattern:
+        """spinning(channels: int, steps: int, min_elevation: float, max_elevation: float) -> pytoph.BeamPattern"""
+    @property
+    def size(self) -> int:
+        """(arg0: pytoph.BeamPattern) -> int"""
+
+class RangeSensor:
+    def __init__(self, frame: Frame, pattern: BeamPattern, min_range: float = ..., max_range: float = ...) -> None:
+        """__init__(self: pytoph.RangeSensor, frame: pytoph.Frame, pattern: pytoph.BeamPattern, min_range: float = 0.0, max_range: float = 100.0) -> None"""
+    def point_cloud(self, ranges: list[float]) -> numpy.ndarray[numpy.float32]:
+        """point_cloud(self: pytoph.RangeSensor, ranges: list[float]) -> numpy.ndarray[numpy.float32]"""
+    def scan(self, scene: Scene) -> numpy.ndarray[numpy.float32]:
+        """scan(self: pytoph.RangeSensor, scene: pytoph.Scene) -> numpy.ndarray[numpy.float32]"""
+    @property
+    def frame(self) -> Frame:
+        """(arg0: pytoph.RangeSensor) -> pytoph.Frame"""
+    @property
+    def max_range(self) -> float:
+        """(arg0: pytoph.RangeSensor) -> float"""
+    @property
+    def min_range(self) -> float:
+        """(arg0: pytoph.RangeSensor) -> float"""
+
+class Contact:
+    def __init__(self, *args, **kwargs) -> None:
+        """Initialize self.  See help(type(self)) for accurate signature."""
+    @property
+    def a(self) -> Frame:
+        """(arg0: pytoph.Contact) -> pytoph.Frame"""
+    @property
+    def b(self) -> Frame:
+        """(arg0: pytoph.Contact) -> pytoph.Frame"""
+    @property
+    def distance(self) -> float:
+        """(arg0: pytoph.Contact) -> float"""
+    @property
+    def point_a(self) -> numpy.ndarray[numpy.float32[3, 1]]:
+        """(arg0: pytoph.Contact) -> numpy.ndarray[numpy.float32[3, 1]]"""
+    @property
+    def point_b(self) -> numpy.ndarray[numpy.float32[3, 1]]:
+        """(arg0: pytoph.Contact) -> numpy.ndarray[numpy.float32[3, 1]]"""
+    @property
+    def triangle_a(self) -> int:
+        """(arg0: pytoph.Contact) -> int"""
+    @property
+    def triangle_b(self) -> int:
+        """(arg0: pytoph.Contact) -> int"""
+
+class CollisionWorld:
+    def __init__(self, margin: float = ...) -> None:
+        """__init__(self: pytoph.CollisionWorld, margin: float = 0.0) -> None"""
+    def add_frame(self, frame: Frame) -> None:
+        """add_frame(self: pytoph.CollisionWorld, frame: pytoph.Frame) -> None"""
+    def candidate_pairs(self) -> list[tuple[int, int]]:
+        """candidate_pairs(self: pytoph.CollisionWorld) -> list[tuple[int, int]]"""
+    def contacts(self) -> list[Contact]:
+        """contacts(self: pytoph.CollisionWorld) -> list[pytoph.Contact]"""
+    def ignore(self, a: Frame, b: Frame) -> None:
+        """ignore(self: pytoph.CollisionWorld, a: pytoph.Frame, b: pytoph.Frame) -> None"""
+    @property
+    def frames(self) -> list[Frame]:
+        """(arg0: pytoph.CollisionWorld) -> list[pytoph.Frame]"""
+    @property
+    def margin(self) -> float:
+        """(arg0: pytoph.CollisionWorld) -> float"""
+    @property
+    def moved_frames(self) -> int:
+        """(arg0: pytoph.CollisionWorld) -> int"""
+
+class UrdfJoint:
+    class Type:
+        __members__: ClassVar[dict] = ...  # read-only
+        CONTINUOUS: ClassVar[UrdfJoint.Type] = ...
+        FIXED: ClassVar[UrdfJoint.Type] = ...
+        FLOATING: ClassVar[UrdfJoint.Type] = ...
+        PLANAR: ClassVar[UrdfJoint.Type] = ...
+        PRISMATIC: ClassVar[UrdfJoint.Type] = ...
+        REVOLUTE: ClassVar[UrdfJoint.Type] = ...
+        __entries: ClassVar[dict] = ...
+        def __init__(self, value: int) -> None:
+            """__init__(self: pytoph.UrdfJoint.Type, value: int) -> None"""
+        def __eq__(self, other: object) -> bool:
+            """__eq__(self: object, other: object) -> bool"""
+        def __hash__(self) -> int:
+            """__hash__(self: object) -> int"""
+        def __index__(self) -> int:
+            """__index__(self: pytoph.UrdfJoint.Type) -> int"""
+        def __int__(self) -> int:
+            """__int__(self: pytoph.UrdfJoint.Type) -> int"""
+        def __ne__(self, other: object) -> bool:
+            """__ne__(self: object, other: object) -> bool"""
+        @property
+        def name(self) -> str:
+            """name(self: handle) -> str"""
+        @property
+        def value(self) -> int:
+            """(arg0: pytoph.UrdfJoint.Type) -> int"""
+    def __init__(self, *args, **kwargs) -> None:
+        """Initialize self.  See help(type(self)) for accurate signature."""
+    @property
+    def axis(self) -> numpy.ndarray[numpy.float32[3, 1]]:
+        """(arg0: pytoph.UrdfJoint) -> numpy.ndarray[numpy.float32[3, 1]]"""
+    @property
+    def child(self) -> Frame:
+        """(arg0: pytoph.UrdfJoint) -> pytoph.Frame"""
+    @property
+    def lower(self) -> float:
+        """(arg0: pytoph.UrdfJoint) -> float"""
+    @property
+    def name(self) -> str:
+        """(arg0: pytoph.UrdfJoint) -> str"""
+    @property
+    def origin(self) -> numpy.ndarray[numpy.float32[4, 4]]:
+        """(arg0: pytoph.UrdfJoint) -> numpy.ndarray[numpy.float32[4, 4]]"""
+    @property
+    def parent(self) -> Frame:
+        """(arg0: pytoph.UrdfJoint) -> pytoph.Frame"""
+    @property
+    def type(self) -> UrdfJoint.Type:
+        """(arg0: pytoph.UrdfJoint) -> pytoph.UrdfJoint.Type"""
+    @property
+    def upper(self) -> float:
+        """(arg0: pytoph.UrdfJoint) -> float"""
+
+class UrdfRobot:
+    def __init__(self, *args, **kwargs) -> None:
+        """Initialize self.  See help(type(self)) for accurate signature."""
+    def link(self, name: str) -> Frame:
+        """link(self: pytoph.UrdfRobot, name: str) -> pytoph.Frame"""
+    def set_joint_position(self, name: str, position: float) -> None:
+        """set_joint_position(self: pytoph.UrdfRobot, name: str, position: float) -> None"""
+    @property
+    def joints(self) -> list[UrdfJoint]:
+        """(arg0: pytoph.UrdfRobot) -> list[pytoph.UrdfJoint]"""
+    @property
+    def links(self) -> list[Frame]:
+        """(arg0: pytoph.UrdfRobot) -> list[pytoph.Frame]"""
+    @property
+    def name(self) -> str:
+        """(arg0: pytoph.UrdfRobot) -> str"""
+    @property
+    def root(self) -> Frame:
+        """(arg0: pytoph.UrdfRobot) -> pytoph.Frame"""
+
+class ImageFormat:
+    __members__: ClassVar[dict] = ...  # read-only
+    PNG: ClassVar[ImageFormat] = ...
+    PPM: ClassVar[ImageFormat] = ...
+    RAW: ClassVar[ImageFormat] = ...
+    __entries: ClassVar[dict] = ...
+    def __init__(self, value: int) -> None:
+        """__init__(self: pytoph.ImageFormat, value: int) -> None"""
+    def __eq__(self, other: object) -> bool:
+        """__eq__(self: object, other: object) -> bool"""
+    def __hash__(self) -> int:
+        """__hash__(self: object) -> int"""
+    def __index__(self) -> int:
+        """__index__(self: pytoph.ImageFormat) -> int"""
+    def __int__(self) -> int:
+        """__int__(self: pytoph.ImageFormat) -> int"""
+    def __ne__(self, other: object) -> bool:
+        """__ne__(self: object, other: object) -> bool"""
+    @property
+    def name(self) -> str:
+        """name(self: handle) -> str"""
+    @property
+    def value(self) -> int:
+        """(arg0: pytoph.ImageFormat) -> int"""
+
+class Viewer:
+    def __init__(self, width: int = ..., height: int = ..., title: str = ...) -> None:
+        """__init__(self: pytoph.Viewer, width: int = 800, height: int = 600, title: str = 'Toph Viewer') -> None"""
+    def add_frame(self, frame: Frame) -> None:
+        """add_frame(self: pytoph.Viewer, frame: pytoph.Frame) -> None"""
+    def add_pose_buffer(self, poses: PoseBuffer) -> None:
+        """add_pose_buffer(self: pytoph.Viewer, poses: pytoph.PoseBuffer) -> None"""
+    def pick(self, x: float, y: float, callback: Callable) -> None:
+        """pick(self: pytoph.Viewer, x: float, y: float, callback: Callable) -> None"""
+    def poll_events(self, timeout: float = ...) -> None:
+        """poll_events(self: pytoph.Viewer, timeout: float = 0.0) -> None"""
+    def post_mesh(self, frame: Frame, mesh: Mesh) -> None:
+        """post_mesh(self: pytoph.Viewer, frame: pytoph.Frame, mesh: pytoph.Mesh) -> None"""
+    def post_transform(self, frame: Frame, matrix: numpy.ndarray[numpy.float32[4, 4]]) -> None:
+        """post_transform(self: pytoph.Viewer, frame: pytoph.Frame, matrix: numpy.ndarray[numpy.float32[4, 4]]) -> None"""
+    def request_redraw(self) -> None:
+        """request_redraw(self: pytoph.Viewer) -> None"""
+    def run(self) -> None:
+        """run(self: pytoph.Viewer) -> None"""
+    def set_click_callback(self, callback: Callable) -> None:
+        """set_click_callback(self: pytoph.Viewer, callback: Callable) -> None"""
+    def set_id_buffer(self, enabled: bool) -> None:
+        """set_id_buffer(self: pytoph.Viewer, enabled: bool) -> None"""
+    def start(self) -> None:
+        """start(self: pytoph.Viewer) -> None"""
+    def start_recording(self, path_pattern: str, format: ImageFormat = ...) -> None:
+        """start_recording(self: pytoph.Viewer, path_pattern: str, format: pytoph.ImageFormat = <ImageFormat.PNG: 2>) -> None"""
+    def stop(self) -> None:
+        """stop(self: pytoph.Viewer) -> None"""
+    def stop_recording(self) -> None:
+        """stop_recording(self: pytoph.Viewer) -> None"""
+    @property
+    def running(self) -> bool:
+        """(arg0: pytoph.Viewer) -> bool"""
+
+class HeadlessRenderer:
+    def __init__(self, width: int = ..., height: int = ...) -> None:
+        """__init__(self: pytoph.HeadlessRenderer, width: int = 800, height: int = 600) -> None"""
+    def add_frame(self, frame: Frame) -> None:
+        """add_frame(self: pytoph.HeadlessRenderer, frame: pytoph.Frame) -> None"""
+    def render(self) -> tuple:
+        """render(self: pytoph.HeadlessRenderer) -> tuple"""
+    def set_camera(self, eye: numpy.ndarray[numpy.float32[3, 1]], target: numpy.ndarray[numpy.float32[3, 1]], up: numpy.ndarray[numpy.float32[3, 1]] = ..., fov_y: float = ..., near: float = ..., far: float = ...) -> None:
+        """set_camera(self: pytoph.HeadlessRenderer, eye: numpy.ndarray[numpy.float32[3, 1]], target: numpy.ndarray[numpy.float32[3, 1]], up: numpy.ndarray[numpy.float32[3, 1]] = array([0., 0., 1.], dtype=float32), fov_y: float = 0.785398, near: float = 0.1, far: float = 100.0) -> None"""
+    @property
+    def height(self) -> int:
+        """(arg0: pytoph.HeadlessRenderer) -> int"""
+    @property
+    def width(self) -> int:
+        """(arg0: pytoph.HeadlessRenderer) -> int"""
+
+class CameraIntrinsics:
+    cx: float
+    cy: float
+    far: float
+    fx: float
+    fy: float
+    height: int
+    near: float
+    width: int
+    def __init__(self) -> None:
+        """__init__(self: pytoph.CameraIntrinsics) -> None"""
+
+class CameraView:
+    intrinsics: CameraIntrinsics
+    pose: numpy.ndarray[numpy.float32[4, 4]]
+    def __init__(self, pose: numpy.ndarray[numpy.float32[4, 4]], intrinsics: CameraIntrinsics) -> None:
+        """__init__(self: pytoph.CameraView, pose: numpy.ndarray[numpy.float32[4, 4]], intrinsics: pytoph.CameraIntrinsics) -> None"""
+
+class BatchRenderer:
+    def __init__(self, contexts: int = ...) -> None:
+        """__init__(self: pytoph.BatchRenderer, contexts: int = 0) -> None"""
+    def add_frame(self, frame: Frame) -> None:
+        """add_frame(self: pytoph.BatchRenderer, frame: pytoph.Frame) -> None"""
+    def render(self, views: list[CameraView], callback: Callable) -> None:
+        """render(self: pytoph.BatchRenderer, views: list[pytoph.CameraView], callback: Callable) -> None"""
+    def render_to_disk(self, views: list[CameraView], directory: str, format: ImageFormat = ...) -> None:
+        """render_to_disk(self: pytoph.BatchRenderer, views: list[pytoph.CameraView], directory: str, format: pytoph.ImageFormat = <ImageFormat.PNG: 2>) -> None"""
+    @property
+    def context_count(self) -> int:
+        """(arg0: pytoph.BatchRenderer) -> int"""
+    @property
+    def frames(self) -> list[Frame]:
+        """(arg0: pytoph.BatchRenderer) -> list[pytoph.Frame]"""
+
+def load_glb(path: str) -> list[Frame]:
+    """load_glb(path: str) -> list[pytoph.Frame]"""
+def load_scene(path: str) -> list[Frame]:
+    """load_scene(path: str) -> list[pytoph.Frame]"""
+def load_urdf(path: str, packages: dict[str, str] = ..., visuals: bool = ..., cache_directory: str = ...) -> UrdfRobot:
+    """load_urdf(path: str, packages: dict[str, str] = {}, visuals: bool = True, cache_directory: str = '') -> pytoph.UrdfRobot"""
+def save_glb(path: str, roots: list[Frame]) -> None:
+    """save_glb(path: str, roots: list[pytoph.Frame]) -> None"""
+def save_scene(path: str, roots: list[Frame]) -> None:
+    """save_scene(path: str, roots: list[pytoph.Frame]) -> None"""
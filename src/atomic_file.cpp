@@ -0,0 +1,43 @@
+#include "atomic_file.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <filesystem>
+#include <system_error>
+
+namespace toph {
+
+AtomicFile::AtomicFile(const std::string &path) : path_(path) {
+    // The pid and a counter keep concurrent writers of the same path, in this process or another, apart.
+    static std::atomic<unsigned> counter{0};
+    temporary_ = path + ".tmp" + std::to_string(::getpid()) + "_" + std::to_string(counter.fetch_add(1));
+    out_ = std::fopen(temporary_.c_str(), "wb");
+}
+
+AtomicFile::~AtomicFile() {
+    if (out_) {
+        std::fclose(out_);
+        std::remove(temporary_.c_str());
+    }
+}
+
+bool AtomicFile::write(const void *data, std::size_t size) {
+    return size == 0 || (out_ && std::fwrite(data, size, 1, out_) == 1);
+}
+
+bool AtomicFile::commit() {
+    if (!out_) return false;
+    const bool written = !std::ferror(out_);
+    const int closed = std::fclose(out_);
+    out_ = nullptr;
+    std::error_code error;
+    if (written && closed == 0) std::filesystem::rename(temporary_, path_, error);
+    if (!written || closed != 0 || error) {
+        std::remove(temporary_.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace toph
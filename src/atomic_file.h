@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+namespace toph {
+
+// A file written under a temporary name next to `path` that replaces `path` only once commit() succeeds, so readers
+// never see it half written. Destroying it without a successful commit removes the temporary.
+class AtomicFile {
+  public:
+    explicit AtomicFile(const std::string &path);
+    ~AtomicFile();
+
+    AtomicFile(const AtomicFile &) = delete;
+    AtomicFile &operator=(const AtomicFile &) = delete;
+
+    // False if the temporary couldn't be created; nothing else works then.
+    bool isOpen() const noexcept { return out_ != nullptr; }
+    std::FILE *stream() const noexcept { return out_; }
+
+    bool write(const void *data, std::size_t size);
+
+    // Closes the temporary and renames it over `path`. False, with the temporary removed, if any write failed.
+    bool commit();
+
+  private:
+    std::string path_;
+    std::string temporary_;
+    std::FILE *out_ = nullptr;
+};
+
+} // namespace toph
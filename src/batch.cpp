@@ -0,0 +1,197 @@
+#include "batch.h"
+#include "egl_context.h"
+#include "framebuffer.h"
+#include "renderer.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+
+namespace toph {
+
+Eigen::Matrix4f CameraIntrinsics::projection() const {
+    // Pixel edges sit half a pixel outside the centers; image rows grow downwards while NDC y grows upwards.
+    Eigen::Matrix4f m = Eigen::Matrix4f::Zero();
+    m(0, 0) = 2.0f * fx / width;
+    m(0, 2) = 1.0f - 2.0f * (cx + 0.5f) / width;
+    m(1, 1) = 2.0f * fy / height;
+    m(1, 2) = 2.0f * (cy + 0.5f) / height - 1.0f;
+    m(2, 2) = (zFar + zNear) / (zNear - zFar);
+    m(2, 3) = 2.0f * zFar * zNear / (zNear - zFar);
+    m(3, 2) = -1.0f;
+    return m;
+}
+
+namespace {
+
+// One render thread's context with its renderer and target.
+struct Worker {
+    EglContext context;
+    std::unique_ptr<Renderer> renderer;
+    std::unique_ptr<Framebuffer> framebuffer;
+
+    explicit Worker(const Worker *first)
+        : context(first ? &first->context : nullptr),
+          renderer(std::make_unique<Renderer>(first ? first->renderer.get() : nullptr)) {}
+
+    ~Worker() {
+        context.makeCurrent();
+        framebuffer.reset();
+        renderer.reset();
+    }
+
+    void render(const CameraView &view, std::size_t camera, unsigned outputs, BatchRenderer::Image &image) {
+        const CameraIntrinsics &k = view.intrinsics;
+        if (!framebuffer || framebuffer->width() != k.width || framebuffer->height() != k.height) {
+            framebuffer.reset();
+            framebuffer = std::make_unique<Framebuffer>(k.width, k.height);
+        }
+        framebuffer->bind();
+        // From the camera's +z forward, +y down axes to OpenGL's -z forward, +y up.
+        const Eigen::Matrix4f viewMatrix =
+            Eigen::Vector4f(1.0f, -1.0f, -1.0f, 1.0f).asDiagonal() * view.pose.inverse(Eigen::Isometry).matrix();
+        renderer->render(viewMatrix, k.projection());
+
+        image.camera = camera;
+        image.width = k.width;
+        image.height = k.height;
+        image.color.clear();
+        image.depth.clear();
+        image.ids.clear();
+        if (outputs & BatchRenderer::Color) framebuffer->readColor(image.color);
+        if (outputs & BatchRenderer::Ids) framebuffer->readIds(image.ids);
+        if (outputs & BatchRenderer::Depth) {
+            framebuffer->readDepth(image.depth);
+            const float n = k.zNear, f = k.zFar;
+            for (float &d : image.depth) {
+                d = d >= 1.0f ? 0.0f : 2.0f * n * f / (f + n - (2.0f * d - 1.0f) * (f - n));
+            }
+        }
+    }
+};
+
+void writeRaw(const std::string &path, const void *data, std::size_t bytes) {
+    std::unique_ptr<std::FILE, int (*)(std::FILE *)> file(std::fopen(path.c_str(), "wb"), &std::fclose);
+    if (!file || std::fwrite(data, 1, bytes, file.get()) != bytes) {
+        throw std::runtime_error("BatchRenderer: cannot write " + path);
+    }
+}
+
+} // namespace
+
+struct BatchRenderer::Impl {
+    // The first worker's renderer uploads the meshes; the others draw from its buffers.
+    std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+BatchRenderer::BatchRenderer(std::size_t contexts) : pimpl_(std::make_unique<Impl>()) {
+    if (contexts == 0) contexts = std::max(1u, std::thread::hardware_concurrency());
+    auto &workers = pimpl_->workers_;
+    for (std::size_t i = 0; i < contexts; ++i) {
+        workers.push_back(std::make_unique<Worker>(workers.empty() ? nullptr : workers.front().get()));
+    }
+    EglContext::releaseCurrent();
+}
+
+BatchRenderer::~BatchRenderer() {
+    // The first context goes last: it releases the shared meshes.
+    auto &workers = pimpl_->workers_;
+    while (!workers.empty()) {
+        workers.pop_back();
+    }
+    EglContext::releaseCurrent();
+}
+
+std::size_t BatchRenderer::contextCount() const noexcept { return pimpl_->workers_.size(); }
+
+void BatchRenderer::addFrame(const Frame::Ptr &frame) {
+    for (const auto &worker : pimpl_->workers_) {
+        worker->context.makeCurrent();
+        worker->renderer->addFrame(frame);
+    }
+    EglContext::releaseCurrent();
+}
+
+const std::vector<Frame::Ptr> &BatchRenderer::frames() const noexcept {
+    return pimpl_->workers_.front()->renderer->frames();
+}
+
+void BatchRenderer::render(const std::vector<CameraView> &views, const Sink &sink, unsigned outputs) {
+    auto &workers = pimpl_->workers_;
+    // Frames may have been given new meshes since they were added. Upload them all from the first context before the
+    // threads start, so that the render threads only look meshes up in the shared geometry and never write to it; the
+    // other contexts may only read the shared buffers once the uploads have completed.
+    workers.front()->context.makeCurrent();
+    workers.front()->renderer->uploadMeshes();
+    glFinish();
+    EglContext::releaseCurrent();
+    // World transforms are computed lazily; do it once here so that the render threads only read them.
+    std::unordered_set<TransformTree *> trees;
+    for (const auto &frame : frames()) {
+        if (trees.insert(frame->tree().get()).second) frame->tree()->updateWorldTransforms();
+    }
+
+    std::atomic<std::size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    const auto run = [&](Worker &worker) {
+        try {
+            worker.context.makeCurrent();
+            Image image;
+            for (std::size_t i; !failed && (i = next++) < views.size();) {
+                worker.render(views[i], i, outputs, image);
+                sink(image);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = std::current_exception();
+            failed = true;
+        }
+        EglContext::releaseCurrent();
+    };
+
+    const std::size_t threadCount = std::min(workers.size(), views.size());
+    std::vector<std::thread> threads;
+    for (std::size_t t = 1; t < threadCount; ++t) {
+        threads.emplace_back(run, std::ref(*workers[t]));
+    }
+    if (threadCount > 0) run(*workers[0]);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void BatchRenderer::renderToDisk(const std::vector<CameraView> &views, const std::string &directory,
+                                 ImageFormat format, unsigned outputs) {
+    static const char *const extensions[] = {"rgba", "ppm", "png"};
+    render(
+        views,
+        [&](Image &image) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "/%06zu", image.camera);
+            const std::string prefix = directory + name;
+            if (!image.color.empty()) {
+                writeImage(prefix + "_color." + extensions[static_cast<int>(format)], format, image.width,
+                           image.height, image.color.data());
+            }
+            if (!image.depth.empty()) {
+                writeRaw(prefix + "_depth.f32", image.depth.data(), image.depth.size() * sizeof(float));
+            }
+            if (!image.ids.empty()) {
+                writeRaw(prefix + "_ids.u32", image.ids.data(), image.ids.size() * sizeof(std::uint32_t));
+            }
+        },
+        outputs);
+}
+
+} // namespace toph
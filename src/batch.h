@@ -0,0 +1,83 @@
+#pragma once
+
+#include "frame.h"
+#include "image.h"
+#include <Eigen/Geometry>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace toph {
+
+// Pinhole intrinsics in pixels with the OpenCV conventions: pixel centers at integer coordinates, (0, 0) the center of
+// the top left pixel.
+struct CameraIntrinsics {
+    int width = 640;
+    int height = 480;
+    float fx = 500.0f;
+    float fy = 500.0f;
+    float cx = 319.5f;
+    float cy = 239.5f;
+    float zNear = 0.05f;
+    float zFar = 100.0f;
+
+    // The OpenGL projection matrix for a camera looking down -z, as Renderer expects.
+    Eigen::Matrix4f projection() const;
+};
+
+struct CameraView {
+    // Camera to world. The camera looks along its +z axis with +x to the right and +y down the image.
+    Eigen::Isometry3f pose = Eigen::Isometry3f::Identity();
+    CameraIntrinsics intrinsics;
+};
+
+// Renders many camera views of one scene for synthetic datasets. The views are split across several surfaceless EGL
+// contexts, each driven by its own thread. The contexts share one upload of the meshes, so memory and upload time
+// don't grow with the number of contexts. Every context's Renderer also culls and uploads instances on its own thread.
+class BatchRenderer {
+  public:
+    enum Output : unsigned { Color = 1, Depth = 2, Ids = 4, All = Color | Depth | Ids };
+
+    // One rendered view; rows run top to bottom. Only the requested outputs are filled in.
+    struct Image {
+        std::size_t camera = 0; // index into the views passed to render()
+        int width = 0;
+        int height = 0;
+        std::vector<std::uint8_t> color; // RGBA8
+        std::vector<float> depth;        // distance along the camera's z axis, 0 where nothing was drawn
+        std::vector<std::uint32_t> ids;  // index into frames() plus one, 0 where nothing was drawn
+    };
+    // Called on the render threads, concurrently and in no particular order of cameras. May keep the image by moving
+    // from it.
+    using Sink = std::function<void(Image &)>;
+
+    // contexts = 0 uses one per hardware thread. Throws std::runtime_error if no EGL context can be created.
+    explicit BatchRenderer(std::size_t contexts = 0);
+    ~BatchRenderer();
+
+    BatchRenderer(const BatchRenderer &) = delete;
+    BatchRenderer &operator=(const BatchRenderer &) = delete;
+
+    std::size_t contextCount() const noexcept;
+
+    // Adds the frame and its subtree. Don't change the scene while render() runs.
+    void addFrame(const Frame::Ptr &frame);
+    const std::vector<Frame::Ptr> &frames() const noexcept;
+
+    // Renders every view and blocks until all were passed to the sink. The first exception thrown by the sink or a
+    // render thread stops the batch and is rethrown.
+    void render(const std::vector<CameraView> &views, const Sink &sink, unsigned outputs = All);
+    // Writes <directory>/<camera>_color.<ext> through writeImage, and the depth and ids as raw little-endian float32
+    // and uint32 arrays to <camera>_depth.f32 and <camera>_ids.u32. Camera numbers are zero-padded to six digits.
+    void renderToDisk(const std::vector<CameraView> &views, const std::string &directory,
+                      ImageFormat format = ImageFormat::Png, unsigned outputs = All);
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+} // namespace toph
@@ -0,0 +1,69 @@
+// Batch rendering benchmark: a table of boxes seen by cameras on a ring around it, rendered with color, depth and frame
+// ids at 640x480. Reports views per second for a growing number of contexts, up to one per hardware thread.
+#include "batch.h"
+#include "frame.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+toph::Frame::Ptr buildScene(int side) {
+    auto root = std::make_shared<toph::Frame>("table");
+    const auto mesh = toph::Mesh::Cube({0.3f, 0.3f, 0.3f});
+    for (int x = 0; x < side; ++x) {
+        for (int y = 0; y < side; ++y) {
+            auto frame = std::make_shared<toph::Frame>(
+                "box", Eigen::Isometry3f(Eigen::Translation3f(0.5f * (x - side / 2), 0.5f * (y - side / 2), 0.0f)));
+            frame->setMesh(mesh);
+            root->addChild(frame);
+        }
+    }
+    return root;
+}
+
+std::vector<toph::CameraView> ring(std::size_t count) {
+    std::vector<toph::CameraView> views(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const float a = 2.0f * static_cast<float>(M_PI) * i / count;
+        const Eigen::Vector3f eye(8.0f * std::cos(a), 8.0f * std::sin(a), 4.0f);
+        // Camera axes: z towards the origin, y down the image.
+        const Eigen::Vector3f z = -eye.normalized();
+        const Eigen::Vector3f x = z.cross(Eigen::Vector3f::UnitZ()).normalized();
+        views[i].pose.linear() << x, z.cross(x), z;
+        views[i].pose.translation() = eye;
+    }
+    return views;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const std::size_t viewCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256;
+    const auto root = buildScene(20);
+    const auto views = ring(viewCount);
+    const std::size_t maxContexts = std::max(1u, std::thread::hardware_concurrency());
+
+    std::printf("%zu frames, %zu views of 640x480\n", root->children().size() + 1, viewCount);
+    for (std::size_t contexts = 1; contexts <= maxContexts; contexts *= 2) {
+        toph::BatchRenderer batch(contexts);
+        batch.addFrame(root);
+        std::atomic<std::size_t> covered{0};
+        const auto t0 = std::chrono::steady_clock::now();
+        batch.render(views, [&](toph::BatchRenderer::Image &image) {
+            covered += std::count_if(image.ids.begin(), image.ids.end(), [](std::uint32_t id) { return id != 0; });
+        });
+        const double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::printf("%2zu contexts: %8.1f views/s (%.1f%% of pixels covered)\n", contexts, viewCount / s,
+                    100.0 * covered / (viewCount * 640.0 * 480.0));
+        if (contexts < maxContexts && contexts * 2 > maxContexts) contexts = maxContexts / 2;
+    }
+    return 0;
+}
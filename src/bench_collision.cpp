@@ -0,0 +1,81 @@
+// Collision benchmark: randomly placed and rotated boxes in a cube sized for a few contacts per box. Each step jitters
+// a fraction of them; reports the broadphase update and the narrowphase separately, with and without a distance margin.
+#include "collision.h"
+#include "frame.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+double milliseconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+Eigen::Isometry3f randomPose(std::mt19937 &rng, float extent) {
+    std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+    Eigen::Isometry3f X = Eigen::Isometry3f::Identity();
+    X.linear() = Eigen::Quaternionf(u(rng), u(rng), u(rng), u(rng)).normalized().toRotationMatrix();
+    X.translation() = extent * Eigen::Vector3f(u(rng), u(rng), u(rng));
+    return X;
+}
+
+void run(std::size_t count, float movingFraction, float margin) {
+    std::mt19937 rng(7);
+    const float extent = 0.5f * std::cbrt(static_cast<float>(count));
+    const auto box = toph::Mesh::Cube({0.6f, 0.6f, 0.6f});
+    auto root = std::make_shared<toph::Frame>("root");
+    std::vector<toph::Frame::Ptr> boxes;
+    for (std::size_t i = 0; i < count; ++i) {
+        auto frame = std::make_shared<toph::Frame>("box", randomPose(rng, extent));
+        frame->setMesh(box);
+        root->addChild(frame);
+        boxes.push_back(frame);
+    }
+
+    toph::CollisionWorld world(margin);
+    world.addFrame(root);
+    auto t0 = std::chrono::steady_clock::now();
+    world.candidatePairs();
+    const double initial = milliseconds(t0);
+
+    const int steps = 20;
+    const std::size_t moving = static_cast<std::size_t>(movingFraction * count);
+    std::uniform_int_distribution<std::size_t> pick(0, count - 1);
+    double broadphase = 0.0, narrowphase = 0.0;
+    std::size_t pairs = 0, contacts = 0;
+    for (int step = 0; step < steps; ++step) {
+        for (std::size_t k = 0; k < moving; ++k) {
+            auto &frame = boxes[pick(rng)];
+            const Eigen::Isometry3f jitter = randomPose(rng, 0.05f);
+            frame->setX(Eigen::Isometry3f(Eigen::Translation3f(jitter.translation())) * frame->X());
+        }
+        t0 = std::chrono::steady_clock::now();
+        pairs += world.candidatePairs().size();
+        broadphase += milliseconds(t0);
+        t0 = std::chrono::steady_clock::now();
+        contacts += world.contacts().size();
+        narrowphase += milliseconds(t0);
+    }
+    std::printf("%6zu frames, %3.0f%% moving, margin %.2f: initial %7.2f ms, broadphase %6.2f ms, narrowphase %6.2f ms "
+                "(%zu pairs, %zu contacts)\n",
+                count, 100.0f * movingFraction, margin, initial, broadphase / steps, narrowphase / steps,
+                pairs / steps, contacts / steps);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    for (const float fraction : {0.01f, 0.1f, 1.0f}) {
+        run(count, fraction, 0.0f);
+    }
+    run(count, 0.1f, 0.1f);
+    run(4 * count, 0.1f, 0.0f);
+    return 0;
+}
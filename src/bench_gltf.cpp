@@ -0,0 +1,104 @@
+// GLB benchmark: builds a hierarchy whose frames share a set of grid meshes, saves it as GLB and loads it back. The
+// loaded meshes view the mapped BIN chunk, so the load itself only parses the JSON and checks the indices; the pass
+// over all vertices afterwards is what pages the data in.
+#include "gltf.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+double milliseconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+// A cells x cells grid of 2 * cells^2 triangles; `seed` offsets it so every mesh differs.
+toph::Mesh::Ptr grid(int cells, int seed) {
+    std::vector<toph::Mesh::Vertex> vertices;
+    vertices.reserve(static_cast<std::size_t>(cells + 1) * (cells + 1));
+    for (int i = 0; i <= cells; ++i) {
+        for (int j = 0; j <= cells; ++j) {
+            vertices.push_back({Eigen::Vector3f(static_cast<float>(i) / cells, static_cast<float>(j) / cells,
+                                                0.01f * seed),
+                                Eigen::Vector3f::Ones(), Eigen::Vector3f::UnitZ()});
+        }
+    }
+    std::vector<std::uint32_t> indices;
+    indices.reserve(6 * static_cast<std::size_t>(cells) * cells);
+    for (int i = 0; i < cells; ++i) {
+        for (int j = 0; j < cells; ++j) {
+            const std::uint32_t a = i * (cells + 1) + j, b = a + cells + 1;
+            for (const std::uint32_t index : {a, b, a + 1, a + 1, b, b + 1}) {
+                indices.push_back(index);
+            }
+        }
+    }
+    return std::make_shared<const toph::Mesh>(std::move(vertices), std::move(indices));
+}
+
+void collect(const toph::Frame::Ptr &frame, std::unordered_set<const toph::Mesh *> &meshes) {
+    if (frame->mesh()) meshes.insert(frame->mesh().get());
+    for (const auto &child : frame->children()) {
+        collect(child, meshes);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const int frames = argc > 1 ? std::atoi(argv[1]) : 10000;
+    const int meshes = argc > 2 ? std::atoi(argv[2]) : 32;
+    const int cells = argc > 3 ? std::atoi(argv[3]) : 512;
+    const int fanout = 8;
+
+    std::vector<toph::Mesh::Ptr> shapes;
+    for (int m = 0; m < meshes; ++m) {
+        shapes.push_back(grid(cells, m));
+    }
+    std::vector<toph::Frame::Ptr> all;
+    all.reserve(frames);
+    all.push_back(std::make_shared<toph::Frame>("root"));
+    for (int i = 1; i < frames; ++i) {
+        Eigen::Isometry3f X = Eigen::Isometry3f::Identity();
+        X.translate(Eigen::Vector3f(0.1f * (i % fanout), 0.0f, 0.1f));
+        all.push_back(toph::Frame::CreateChild(all[(i - 1) / fanout], "frame" + std::to_string(i), X));
+        if (meshes > 0) all.back()->setMesh(shapes[i % meshes]);
+        if (i % 3 == 0) all.back()->frameColor = Eigen::Vector3f(1.0f, 0.5f, 0.25f);
+    }
+    const std::vector<toph::Frame::Ptr> roots = {all.front()};
+    all.clear();
+    shapes.clear();
+
+    namespace fs = std::filesystem;
+    const std::string path = (fs::temp_directory_path() / "toph_bench_gltf.glb").string();
+    auto t0 = std::chrono::steady_clock::now();
+    toph::saveGlb(path, roots);
+    const double save = milliseconds(t0);
+    const std::uintmax_t bytes = fs::file_size(path);
+    std::printf("%d frames, %d meshes of %d triangles, %.0f MB\n", frames, meshes, 2 * cells * cells, bytes / 1e6);
+    std::printf("save:  %8.1f ms (%.0f MB/s)\n", save, bytes / 1e3 / save);
+
+    t0 = std::chrono::steady_clock::now();
+    const std::vector<toph::Frame::Ptr> loaded = toph::loadGlb(path);
+    const double load = milliseconds(t0);
+    std::printf("load:  %8.1f ms (%.0f MB/s)\n", load, bytes / 1e3 / load);
+
+    t0 = std::chrono::steady_clock::now();
+    std::unordered_set<const toph::Mesh *> distinct;
+    collect(loaded.front(), distinct);
+    float sum = 0.0f;
+    for (const toph::Mesh *mesh : distinct) {
+        for (std::size_t i = 0; i < mesh->vertexCount(); ++i) {
+            sum += mesh->position(i).z();
+        }
+    }
+    std::printf("touch: %8.1f ms, %zu distinct meshes (%g)\n", milliseconds(t0), distinct.size(), sum);
+    fs::remove(path);
+    return 0;
+}
@@ -0,0 +1,151 @@
+// Mesh import benchmark: writes a finely tessellated sphere as binary STL, ASCII OBJ, and ASCII and binary PLY to the
+// temporary directory, then imports each with a growing number of threads and reports MB/s, with and without welding,
+// and once more through a mesh cache directory: the first import fills it, the second maps the stored mesh.
+#include "mesh_import.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Soup {
+    std::vector<float> positions;
+    std::vector<std::uint32_t> triangles;
+};
+
+// A UV sphere of unit radius. par_shapes can't make one this fine, its indices are 16 bits.
+Soup sphere(int slices) {
+    Soup soup;
+    for (int i = 0; i <= slices; ++i) {
+        const float theta = static_cast<float>(M_PI) * i / slices;
+        for (int j = 0; j <= slices; ++j) {
+            const float phi = 2.0f * static_cast<float>(M_PI) * j / slices;
+            soup.positions.insert(soup.positions.end(), {std::sin(theta) * std::cos(phi),
+                                                         std::sin(theta) * std::sin(phi), std::cos(theta)});
+        }
+    }
+    for (int i = 0; i < slices; ++i) {
+        for (int j = 0; j < slices; ++j) {
+            const std::uint32_t a = i * (slices + 1) + j, b = a + slices + 1;
+            soup.triangles.insert(soup.triangles.end(), {a, b, a + 1, a + 1, b, b + 1});
+        }
+    }
+    return soup;
+}
+
+void writeStl(const std::string &path, const Soup &soup) {
+    std::ofstream out(path, std::ios::binary);
+    const char header[80] = "toph bench_import";
+    out.write(header, sizeof(header));
+    const std::uint32_t count = static_cast<std::uint32_t>(soup.triangles.size() / 3);
+    out.write(reinterpret_cast<const char *>(&count), 4);
+    for (std::size_t t = 0; t < count; ++t) {
+        float record[12] = {};
+        for (int k = 0; k < 3; ++k) {
+            for (int c = 0; c < 3; ++c) {
+                record[3 + 3 * k + c] = soup.positions[3 * soup.triangles[3 * t + k] + c];
+            }
+        }
+        const std::uint16_t attributes = 0;
+        out.write(reinterpret_cast<const char *>(record), sizeof(record));
+        out.write(reinterpret_cast<const char *>(&attributes), 2);
+    }
+}
+
+void writeObj(const std::string &path, const Soup &soup) {
+    std::FILE *out = std::fopen(path.c_str(), "w");
+    for (std::size_t i = 0; i < soup.positions.size(); i += 3) {
+        std::fprintf(out, "v %.7g %.7g %.7g\n", soup.positions[i], soup.positions[i + 1], soup.positions[i + 2]);
+    }
+    for (std::size_t i = 0; i < soup.triangles.size(); i += 3) {
+        std::fprintf(out, "f %u %u %u\n", soup.triangles[i] + 1, soup.triangles[i + 1] + 1, soup.triangles[i + 2] + 1);
+    }
+    std::fclose(out);
+}
+
+void writePly(const std::string &path, const Soup &soup, bool binary) {
+    std::FILE *out = std::fopen(path.c_str(), binary ? "wb" : "w");
+    std::fprintf(out,
+                 "ply\nformat %s 1.0\nelement vertex %zu\nproperty float x\nproperty float y\nproperty float z\n"
+                 "element face %zu\nproperty list uchar uint vertex_indices\nend_header\n",
+                 binary ? "binary_little_endian" : "ascii", soup.positions.size() / 3, soup.triangles.size() / 3);
+    if (binary) {
+        std::fwrite(soup.positions.data(), sizeof(float), soup.positions.size(), out);
+        for (std::size_t i = 0; i < soup.triangles.size(); i += 3) {
+            const std::uint8_t three = 3;
+            std::fwrite(&three, 1, 1, out);
+            std::fwrite(&soup.triangles[i], sizeof(std::uint32_t), 3, out);
+        }
+    } else {
+        for (std::size_t i = 0; i < soup.positions.size(); i += 3) {
+            std::fprintf(out, "%.7g %.7g %.7g\n", soup.positions[i], soup.positions[i + 1], soup.positions[i + 2]);
+        }
+        for (std::size_t i = 0; i < soup.triangles.size(); i += 3) {
+            std::fprintf(out, "3 %u %u %u\n", soup.triangles[i], soup.triangles[i + 1], soup.triangles[i + 2]);
+        }
+    }
+    std::fclose(out);
+}
+
+void run(const std::string &path, bool weld) {
+    const std::size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        toph::MeshImportOptions options;
+        options.weld = weld;
+        options.threadCount = threads;
+        toph::MeshImportStats stats;
+        toph::importMesh(path, options, &stats);
+        std::printf("%-28s %-9s %2zu threads: %8.1f MB/s (%.0f MB in %.3f s, %zu vertices, %zu triangles)\n",
+                    std::filesystem::path(path).filename().c_str(), weld ? "welded" : "unwelded", threads,
+                    stats.megabytesPerSecond(), stats.bytes / 1e6, stats.seconds, stats.vertices, stats.triangles);
+        if (threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2;
+    }
+}
+
+void runCached(const std::string &path, const std::string &cacheDirectory) {
+    for (const char *pass : {"store", "hit"}) {
+        toph::MeshImportOptions options;
+        options.cacheDirectory = cacheDirectory;
+        toph::MeshImportStats stats;
+        toph::importMesh(path, options, &stats);
+        std::printf("%-28s cache %-5s  all threads: %8.1f MB/s (%.0f MB in %.3f s, %s)\n",
+                    std::filesystem::path(path).filename().c_str(), pass, stats.megabytesPerSecond(), stats.bytes / 1e6,
+                    stats.seconds, stats.cached ? "mapped" : "parsed");
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const int slices = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const Soup soup = sphere(slices);
+    std::printf("sphere: %zu vertices, %zu triangles\n", soup.positions.size() / 3, soup.triangles.size() / 3);
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::string stl = (directory / "toph_bench_import.stl").string();
+    const std::string obj = (directory / "toph_bench_import.obj").string();
+    const std::string ply = (directory / "toph_bench_import_ascii.ply").string();
+    const std::string binaryPly = (directory / "toph_bench_import_binary.ply").string();
+    writeStl(stl, soup);
+    writeObj(obj, soup);
+    writePly(ply, soup, false);
+    writePly(binaryPly, soup, true);
+
+    const std::string cache = (directory / "toph_bench_import_cache").string();
+    for (const auto &path : {stl, obj, ply, binaryPly}) {
+        run(path, false);
+        run(path, true);
+        runCached(path, cache);
+        std::filesystem::remove(path);
+    }
+    std::filesystem::remove_all(cache);
+    return 0;
+}
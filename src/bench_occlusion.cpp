@@ -0,0 +1,115 @@
+// Occlusion culling benchmark on a factory floor: rows of tall racks with aisles between them, small parts scattered in
+// every bay, and a camera at eye height in the first bay looking down the central aisle. Reports how many frames are
+// drawn after frustum culling alone and after the Hi-Z test, and what each pass costs.
+#include "bvh.h"
+#include "frame.h"
+#include "occlusion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr int kBays = 20;
+constexpr float kBayDepth = 5.0f;
+
+// Box centered on the frame's origin.
+toph::Mesh::Ptr box(const Eigen::Vector3f &size) {
+    std::vector<Eigen::Vector3f> corners(8);
+    for (int c = 0; c < 8; ++c) {
+        corners[c] = Eigen::Vector3f((c & 1) ? 0.5f : -0.5f, (c & 2) ? 0.5f : -0.5f, (c & 4) ? 0.5f : -0.5f)
+                         .cwiseProduct(size);
+    }
+    const std::vector<Eigen::Vector3i> faces = {{0, 2, 1}, {1, 2, 3}, {4, 5, 6}, {5, 7, 6}, {0, 1, 4}, {1, 5, 4},
+                                                {2, 6, 3}, {3, 6, 7}, {0, 4, 2}, {2, 4, 6}, {1, 3, 5}, {3, 7, 5}};
+    return toph::Mesh::Create(corners, faces);
+}
+
+toph::Frame::Ptr place(const char *name, const toph::Mesh::Ptr &mesh, const Eigen::Vector3f &at) {
+    auto frame = std::make_shared<toph::Frame>(name, Eigen::Isometry3f(Eigen::Translation3f(at)));
+    frame->setMesh(mesh);
+    return frame;
+}
+
+toph::Frame::Ptr buildFloor(std::size_t parts) {
+    auto root = std::make_shared<toph::Frame>("floor");
+    root->addChild(place("slab", box({kBays * kBayDepth, 60.0f, 0.1f}), {kBays * kBayDepth / 2, 0.0f, -0.05f}));
+    // Rack segments 8 m long with 2 m aisles at y = -10, 0 and 10.
+    const auto rack = box({0.5f, 8.0f, 4.0f});
+    for (int b = 1; b <= kBays; ++b) {
+        for (float y : {-15.0f, -5.0f, 5.0f, 15.0f}) {
+            root->addChild(place("rack", rack, {b * kBayDepth, y, 2.0f}));
+        }
+    }
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> inBay(0.5f, kBayDepth - 0.5f), across(-19.0f, 19.0f), up(0.1f, 3.5f);
+    const auto part = box({0.2f, 0.2f, 0.2f});
+    for (std::size_t i = 0; i < parts; ++i) {
+        const float x = static_cast<float>(i % kBays) * kBayDepth + inBay(rng);
+        root->addChild(place("part", part, {x, across(rng), up(rng)}));
+    }
+    return root;
+}
+
+void collect(const toph::Frame::Ptr &frame, std::vector<toph::Frame::Ptr> &out) {
+    out.push_back(frame);
+    for (const auto &child : frame->children()) {
+        collect(child, out);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    using Clock = std::chrono::steady_clock;
+    const std::size_t parts = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    const int reps = 20;
+
+    std::vector<toph::Frame::Ptr> frames;
+    collect(buildFloor(parts), frames);
+    std::vector<toph::Aabb> worldBounds(frames.size());
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        const toph::Mesh::Ptr &mesh = frames[i]->mesh();
+        worldBounds[i] = mesh ? mesh->bounds().transformed(frames[i]->worldX()) : toph::Aabb();
+    }
+    toph::Bvh bvh;
+    bvh.build(worldBounds);
+
+    toph::OcclusionBuffer occlusion;
+    const Eigen::Matrix4f viewProjection =
+        toph::perspective(45.0f * static_cast<float>(M_PI) / 180.0f, 2.0f, 0.1f, 100.0f) *
+        toph::lookAt({2.5f, 0.0f, 1.7f}, {20.0f, 0.0f, 1.5f}, {0.0f, 0.0f, 1.0f});
+
+    std::vector<std::uint8_t> inFrustum, drawn;
+    double frustumTime = 0.0, occlusionTime = 0.0;
+    std::size_t hidden = 0;
+    for (int r = 0; r < reps; ++r) {
+        auto start = Clock::now();
+        inFrustum.assign(frames.size(), 0);
+        bvh.query(toph::Frustum(viewProjection), [&](std::uint32_t i) { inFrustum[i] = 1; });
+        frustumTime += std::chrono::duration<double>(Clock::now() - start).count();
+
+        drawn = inFrustum;
+        start = Clock::now();
+        hidden = occlusion.cull(viewProjection, bvh, frames, worldBounds, drawn);
+        occlusionTime += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    const auto count = [](const std::vector<std::uint8_t> &mask) {
+        return static_cast<std::size_t>(std::count(mask.begin(), mask.end(), 1));
+    };
+    const std::size_t frustumDrawn = count(inFrustum), occlusionDrawn = count(drawn);
+    std::printf("%-22s %10s %14s\n", "pass", "drawn", "ms/pass");
+    std::printf("%-22s %10zu %14s\n", "none", frames.size(), "-");
+    std::printf("%-22s %10zu %14.3f\n", "frustum", frustumDrawn, frustumTime / reps * 1e3);
+    std::printf("%-22s %10zu %14.3f\n", "frustum + occlusion", occlusionDrawn, occlusionTime / reps * 1e3);
+    std::printf("occluded %zu of %zu frustum survivors (%.1f%%)\n", hidden, frustumDrawn,
+                frustumDrawn ? 100.0 * hidden / frustumDrawn : 0.0);
+    return 0;
+}
@@ -0,0 +1,91 @@
+// Pose buffer benchmark: a writer thread publishes the poses of a set of frames as fast as it can while a reader
+// applies them, as the viewer's render loop does. First checks that poses left out of a publish keep their last
+// published value, then reports the cost of a publish and of an apply.
+#include "frame.h"
+#include "pose_buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+double seconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+Eigen::Isometry3f translation(float x) { return Eigen::Isometry3f(Eigen::Translation3f(x, 0.0f, 0.0f)); }
+
+// Sets pose 1 once, then only pose 0 in the next two publishes; pose 1 has to survive both swaps of the back slot.
+bool partialUpdatesKeepPoses() {
+    std::vector<toph::Frame::Ptr> frames{std::make_shared<toph::Frame>("a"), std::make_shared<toph::Frame>("b")};
+    toph::PoseBuffer poses(frames);
+    poses.set(1, translation(1.0f));
+    poses.publish();
+    for (float x : {2.0f, 3.0f}) {
+        poses.set(0, translation(x));
+        poses.publish();
+        poses.apply();
+        if (frames[0]->X().translation().x() != x || frames[1]->X().translation().x() != 1.0f) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const int frameCount = argc > 1 ? std::atoi(argv[1]) : 10000;
+    const double duration = argc > 2 ? std::atof(argv[2]) : 1.0;
+
+    if (!partialUpdatesKeepPoses()) {
+        std::printf("partial update: FAILED, a pose not set in the last publish was lost\n");
+        return 1;
+    }
+    std::printf("partial update: ok\n");
+
+    std::vector<toph::Frame::Ptr> frames;
+    frames.reserve(frameCount);
+    for (int i = 0; i < frameCount; ++i) {
+        frames.push_back(std::make_shared<toph::Frame>("f"));
+    }
+    toph::PoseBuffer poses(frames);
+
+    std::atomic<bool> done{false};
+    long published = 0;
+    double publishSeconds = 0.0;
+    std::thread writer([&] {
+        while (!done) {
+            for (int i = 0; i < frameCount; ++i) {
+                poses.set(i, translation(static_cast<float>(published)));
+            }
+            const auto t0 = std::chrono::steady_clock::now();
+            poses.publish();
+            publishSeconds += seconds(t0);
+            ++published;
+        }
+    });
+
+    long applied = 0;
+    double applySeconds = 0.0;
+    const auto start = std::chrono::steady_clock::now();
+    while (seconds(start) < duration) {
+        const auto t0 = std::chrono::steady_clock::now();
+        if (poses.apply()) {
+            applySeconds += seconds(t0);
+            ++applied;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    done = true;
+    writer.join();
+
+    std::printf("%d frames, %.1f s\n", frameCount, duration);
+    std::printf("publish: %8ld times, %8.1f us each\n", published, 1e6 * publishSeconds / std::max(published, 1L));
+    std::printf("apply:   %8ld times, %8.1f us each\n", applied, 1e6 * applySeconds / std::max(applied, 1L));
+}
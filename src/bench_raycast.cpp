@@ -0,0 +1,89 @@
+// Ray casting benchmark: four frames sharing a wavy terrain mesh of two million triangles, probed by a 1024x1024 grid
+// of rays looking down at it. Reports the BVH build time, single-ray throughput and raycastMany() throughput.
+#include "frame.h"
+#include "scene.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace {
+
+toph::Mesh::Ptr terrain(int side) {
+    std::vector<Eigen::Vector3f> positions;
+    positions.reserve(static_cast<std::size_t>(side + 1) * (side + 1));
+    for (int y = 0; y <= side; ++y) {
+        for (int x = 0; x <= side; ++x) {
+            const float u = static_cast<float>(x) / side, v = static_cast<float>(y) / side;
+            positions.emplace_back(u, v, 0.05f * std::sin(40.0f * u) * std::cos(30.0f * v));
+        }
+    }
+    std::vector<Eigen::Vector3i> faces;
+    faces.reserve(2 * static_cast<std::size_t>(side) * side);
+    for (int y = 0; y < side; ++y) {
+        for (int x = 0; x < side; ++x) {
+            const int i = y * (side + 1) + x;
+            faces.emplace_back(i, i + 1, i + side + 2);
+            faces.emplace_back(i, i + side + 2, i + side + 1);
+        }
+    }
+    return toph::Mesh::Create(positions, faces);
+}
+
+double seconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const int side = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const int raysPerSide = 1024;
+
+    const auto mesh = terrain(side);
+    auto root = std::make_shared<toph::Frame>("root");
+    for (int i = 0; i < 4; ++i) {
+        const Eigen::Translation3f offset(static_cast<float>(i % 2), static_cast<float>(i / 2), 0.0f);
+        auto tile = std::make_shared<toph::Frame>("tile", Eigen::Isometry3f(offset));
+        tile->setMesh(mesh);
+        root->addChild(tile);
+    }
+    toph::Scene scene;
+    scene.addFrame(root);
+
+    std::vector<toph::Ray> rays(static_cast<std::size_t>(raysPerSide) * raysPerSide);
+    for (int y = 0; y < raysPerSide; ++y) {
+        for (int x = 0; x < raysPerSide; ++x) {
+            toph::Ray &ray = rays[static_cast<std::size_t>(y) * raysPerSide + x];
+            ray.origin = {2.0f * (x + 0.5f) / raysPerSide, 2.0f * (y + 0.5f) / raysPerSide, 1.0f};
+            ray.direction = {0.1f, 0.05f, -1.0f};
+        }
+    }
+
+    std::printf("%zu triangles in %zu frames, %zu rays\n", mesh->triangleCount() * 4, scene.frames().size(),
+                rays.size());
+    auto t0 = std::chrono::steady_clock::now();
+    scene.raycast(rays[0]);
+    std::printf("build:        %8.1f ms\n", 1e3 * seconds(t0));
+
+    t0 = std::chrono::steady_clock::now();
+    std::size_t hits = 0;
+    for (const auto &ray : rays) {
+        hits += scene.raycast(ray) ? 1 : 0;
+    }
+    std::printf("raycast:      %8.2f Mrays/s (%zu hits)\n", rays.size() / seconds(t0) / 1e6, hits);
+
+    // Moving a frame only refits the top level.
+    root->children()[0]->setX(Eigen::Isometry3f(Eigen::Translation3f(0.0f, 0.0f, 0.1f)));
+    t0 = std::chrono::steady_clock::now();
+    const auto results = scene.raycastMany(rays);
+    hits = 0;
+    for (const auto &hit : results) {
+        hits += hit ? 1 : 0;
+    }
+    std::printf("raycastMany:  %8.2f Mrays/s (%zu hits)\n", rays.size() / seconds(t0) / 1e6, hits);
+    return 0;
+}
@@ -0,0 +1,106 @@
+// Range sensor benchmark: a 64-channel spinning lidar and a 640x480 depth camera above a wavy terrain of half a million
+// triangles scattered with boxes. Reports rays per second of the packet tracer for a growing number of threads, and
+// of raycastMany() with single rays for comparison.
+#include "frame.h"
+#include "scene.h"
+#include "sensor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+toph::Mesh::Ptr terrain(int side, float size) {
+    std::vector<Eigen::Vector3f> positions;
+    positions.reserve(static_cast<std::size_t>(side + 1) * (side + 1));
+    for (int y = 0; y <= side; ++y) {
+        for (int x = 0; x <= side; ++x) {
+            const float u = static_cast<float>(x) / side, v = static_cast<float>(y) / side;
+            positions.emplace_back(size * (u - 0.5f), size * (v - 0.5f),
+                                   0.3f * std::sin(12.0f * u) * std::cos(9.0f * v));
+        }
+    }
+    std::vector<Eigen::Vector3i> faces;
+    faces.reserve(2 * static_cast<std::size_t>(side) * side);
+    for (int y = 0; y < side; ++y) {
+        for (int x = 0; x < side; ++x) {
+            const int i = y * (side + 1) + x;
+            faces.emplace_back(i, i + 1, i + side + 2);
+            faces.emplace_back(i, i + side + 2, i + side + 1);
+        }
+    }
+    return toph::Mesh::Create(positions, faces);
+}
+
+double seconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+void run(const char *name, toph::Scene &scene, const toph::RangeSensor &sensor, int scans) {
+    std::vector<float> ranges;
+    sensor.scan(scene, ranges);
+    const std::size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < scans; ++i) {
+            sensor.scan(scene, ranges, threads);
+        }
+        const double s = seconds(t0);
+        const auto returns = std::count_if(ranges.begin(), ranges.end(), [](float r) { return std::isfinite(r); });
+        std::printf("%-7s %2zu threads: %8.2f Mrays/s (%.1f%% returns)\n", name, threads,
+                    scans * ranges.size() / s / 1e6, 100.0 * returns / ranges.size());
+        if (threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2;
+    }
+}
+
+} // namespace
+
+int main() {
+    auto world = std::make_shared<toph::Frame>("world");
+    auto ground = std::make_shared<toph::Frame>("terrain");
+    ground->setMesh(terrain(500, 60.0f));
+    world->addChild(ground);
+    const auto box = toph::Mesh::Cube({2.0f, 2.0f, 3.0f});
+    for (int i = 0; i < 400; ++i) {
+        const float x = -28.0f + 2.8f * (i % 20), y = -28.0f + 2.8f * (i / 20);
+        if (std::abs(x) < 3.0f && std::abs(y) < 3.0f) continue;
+        auto frame = std::make_shared<toph::Frame>("box", Eigen::Isometry3f(Eigen::Translation3f(x, y, 0.0f)));
+        frame->setMesh(box);
+        world->addChild(frame);
+    }
+    auto mount = std::make_shared<toph::Frame>("sensor", Eigen::Isometry3f(Eigen::Translation3f(0.0f, 0.0f, 1.5f)));
+    world->addChild(mount);
+    // The depth camera looks along +x, tilted 20 degrees down; its x axis points to -y and its y axis down the image.
+    const float tilt = 20.0f * static_cast<float>(M_PI) / 180.0f;
+    const Eigen::Vector3f forward(std::cos(tilt), 0.0f, -std::sin(tilt));
+    Eigen::Isometry3f cameraPose = Eigen::Isometry3f::Identity();
+    cameraPose.linear() << -Eigen::Vector3f::UnitY(), forward.cross(-Eigen::Vector3f::UnitY()), forward;
+    auto cameraMount = std::make_shared<toph::Frame>("camera", cameraPose);
+    mount->addChild(cameraMount);
+
+    toph::Scene scene;
+    scene.addFrame(world);
+    const float degree = static_cast<float>(M_PI) / 180.0f;
+    const toph::RangeSensor lidar(mount, toph::BeamPattern::Spinning(64, 2048, -25.0f * degree, 15.0f * degree));
+    const toph::RangeSensor camera(cameraMount, toph::BeamPattern::Pinhole(640, 480, 500.0f, 500.0f, 319.5f, 239.5f));
+    std::printf("%zu frames, lidar %zu beams, depth camera %zu beams\n", scene.frames().size(),
+                lidar.pattern().directions.size(), camera.pattern().directions.size());
+    run("lidar", scene, lidar, 20);
+    run("camera", scene, camera, 10);
+
+    // Single rays through raycastMany(), one thread.
+    std::vector<toph::Ray> rays;
+    const Eigen::Isometry3f &pose = mount->worldX();
+    for (const auto &d : lidar.pattern().directions) {
+        rays.push_back({pose.translation(), pose.linear() * d, lidar.maxRange()});
+    }
+    const auto t0 = std::chrono::steady_clock::now();
+    scene.raycastMany(rays, 1);
+    std::printf("lidar    1 thread, single rays: %8.2f Mrays/s\n", rays.size() / seconds(t0) / 1e6);
+    return 0;
+}
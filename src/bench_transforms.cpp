@@ -0,0 +1,78 @@
+// Scaling benchmark for world transform propagation: a fleet of robot arms under one root, fully invalidated before
+// every update. Reports the time per update and the speedup over the serial pass for each thread count.
+#include "frame.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr int kLinksPerArm = 7;
+
+toph::Frame::Ptr buildFleet(std::size_t frameCount) {
+    auto root = std::make_shared<toph::Frame>("world");
+    const std::size_t arms = std::max<std::size_t>(frameCount / (kLinksPerArm + 1), 1);
+    for (std::size_t a = 0; a < arms; ++a) {
+        auto base = std::make_shared<toph::Frame>("base");
+        base->mutableX().translation() << static_cast<float>(a % 100), static_cast<float>(a / 100), 0.0f;
+        root->addChild(base);
+        auto link = base;
+        for (int l = 0; l < kLinksPerArm; ++l) {
+            auto next = std::make_shared<toph::Frame>("link");
+            next->mutableX() =
+                Eigen::Translation3f(0.0f, 0.0f, 0.3f) * Eigen::AngleAxisf(0.1f, Eigen::Vector3f::UnitY());
+            link->addChild(next);
+            link = next;
+        }
+    }
+    return root;
+}
+
+double secondsPerUpdate(const toph::Frame::Ptr &root, std::size_t threads, int reps) {
+    auto &tree = *root->tree();
+    const Eigen::Isometry3f X = root->X();
+    using Clock = std::chrono::steady_clock;
+    double total = 0.0;
+    for (int r = 0; r < reps; ++r) {
+        root->setX(X); // invalidates every frame
+        const auto start = Clock::now();
+        if (threads == 1) {
+            tree.updateWorldTransforms();
+        } else {
+            tree.updateWorldTransforms(threads);
+        }
+        total += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    return total / reps;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const std::size_t maxThreads = toph::ThreadPool::shared().size();
+    const std::size_t largest = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    std::printf("%-10s %-8s %12s %10s\n", "frames", "threads", "ms/update", "speedup");
+    for (std::size_t frames = 1000; frames <= largest; frames *= 10) {
+        auto root = buildFleet(frames);
+        const int reps = static_cast<int>(std::max<std::size_t>(2000000 / frames, 5));
+        secondsPerUpdate(root, maxThreads, 1); // warm up the pool and the level index
+
+        const double serial = secondsPerUpdate(root, 1, reps);
+        std::printf("%-10zu %-8d %12.3f %10.2f\n", root->tree()->size(), 1, serial * 1e3, 1.0);
+        for (std::size_t threads = 2; threads <= maxThreads; threads *= 2) {
+            const double t = secondsPerUpdate(root, threads, reps);
+            std::printf("%-10zu %-8zu %12.3f %10.2f\n", root->tree()->size(), threads, t * 1e3, serial / t);
+        }
+        if (maxThreads > 1 && (maxThreads & (maxThreads - 1)) != 0) {
+            const double t = secondsPerUpdate(root, maxThreads, reps);
+            std::printf("%-10zu %-8zu %12.3f %10.2f\n", root->tree()->size(), maxThreads, t * 1e3, serial / t);
+        }
+    }
+    return 0;
+}
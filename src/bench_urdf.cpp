@@ -0,0 +1,98 @@
+// URDF loading benchmark: writes a chain robot whose links share a set of binary STL meshes to a temporary package,
+// then times the first load, which imports every distinct mesh once across the thread pool, and a second load while
+// the first robot is alive, which reuses its meshes.
+#include "urdf.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace {
+
+double milliseconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+// A UV sphere of 2 * slices^2 triangles as binary STL; `seed` moves it so every file differs.
+std::uintmax_t writeSphere(const std::filesystem::path &path, int slices, int seed) {
+    std::ofstream out(path, std::ios::binary);
+    const char header[80] = "toph bench_urdf";
+    out.write(header, sizeof(header));
+    const std::uint32_t count = 2 * slices * slices;
+    out.write(reinterpret_cast<const char *>(&count), 4);
+    const auto point = [&](int i, int j) {
+        const float theta = static_cast<float>(M_PI) * i / slices, phi = 2.0f * static_cast<float>(M_PI) * j / slices;
+        return std::array<float, 3>{0.05f * std::sin(theta) * std::cos(phi) + 0.01f * seed,
+                                    0.05f * std::sin(theta) * std::sin(phi), 0.05f * std::cos(theta)};
+    };
+    for (int i = 0; i < slices; ++i) {
+        for (int j = 0; j < slices; ++j) {
+            for (const auto &triangle : {std::array<std::array<int, 2>, 3>{{{i, j}, {i + 1, j}, {i, j + 1}}},
+                                         std::array<std::array<int, 2>, 3>{{{i, j + 1}, {i + 1, j}, {i + 1, j + 1}}}}) {
+                float record[12] = {};
+                for (int k = 0; k < 3; ++k) {
+                    const auto p = point(triangle[k][0], triangle[k][1]);
+                    std::copy(p.begin(), p.end(), record + 3 + 3 * k);
+                }
+                const std::uint16_t attributes = 0;
+                out.write(reinterpret_cast<const char *>(record), sizeof(record));
+                out.write(reinterpret_cast<const char *>(&attributes), 2);
+            }
+        }
+    }
+    return 84 + 50 * static_cast<std::uintmax_t>(count);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const int links = argc > 1 ? std::atoi(argv[1]) : 60;
+    const int meshes = argc > 2 ? std::atoi(argv[2]) : 20;
+    const int slices = argc > 3 ? std::atoi(argv[3]) : 320;
+
+    namespace fs = std::filesystem;
+    const fs::path package = fs::temp_directory_path() / "toph_bench_urdf";
+    fs::create_directories(package / "meshes");
+    fs::create_directories(package / "urdf");
+    std::uintmax_t bytes = 0;
+    for (int m = 0; m < meshes; ++m) {
+        bytes += writeSphere(package / "meshes" / ("part" + std::to_string(m) + ".stl"), slices, m);
+    }
+    {
+        std::ofstream urdf(package / "urdf" / "robot.urdf");
+        urdf << "<?xml version=\"1.0\"?>\n<robot name=\"bench\">\n";
+        for (int l = 0; l < links; ++l) {
+            urdf << "  <link name=\"link" << l << "\"><visual><geometry><mesh filename=\"package://toph_bench_urdf/"
+                 << "meshes/part" << l % meshes << ".stl\"/></geometry></visual></link>\n";
+        }
+        for (int l = 1; l < links; ++l) {
+            urdf << "  <joint name=\"joint" << l << "\" type=\"revolute\"><parent link=\"link" << l - 1
+                 << "\"/><child link=\"link" << l << "\"/><origin xyz=\"0 0 0.1\" rpy=\"0 0.1 0\"/>"
+                 << "<axis xyz=\"0 1 0\"/><limit lower=\"-3\" upper=\"3\"/></joint>\n";
+        }
+        urdf << "</robot>\n";
+    }
+    const std::string path = (package / "urdf" / "robot.urdf").string();
+    std::printf("%d links, %d meshes of %u triangles, %.0f MB of STL\n", links, meshes, 2 * slices * slices,
+                bytes / 1e6);
+
+    auto t0 = std::chrono::steady_clock::now();
+    const toph::UrdfRobot first = toph::loadUrdf(path);
+    const double cold = milliseconds(t0);
+    std::printf("first load:  %8.1f ms (%.0f MB/s)\n", cold, bytes / 1e3 / cold);
+    t0 = std::chrono::steady_clock::now();
+    const toph::UrdfRobot second = toph::loadUrdf(path);
+    std::printf("second load: %8.1f ms, meshes shared with the first: %s\n", milliseconds(t0),
+                second.links.back()->children().front()->mesh() == first.links.back()->children().front()->mesh()
+                    ? "yes"
+                    : "no");
+    fs::remove_all(package);
+    return 0;
+}
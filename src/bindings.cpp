@@ -1,23 +1,119 @@
 #include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
+#include "collision.h"
 #include "frame.h"
+#include "gltf.h"
+#include "mesh_import.h"
+#include "pose_buffer.h"
+#include "scene.h"
+#include "scene_file.h"
+#include "sensor.h"
+#include "urdf.h"
 #include "viewer.h"
+#ifdef TOPH_HEADLESS
+#include "batch.h"
+#include "headless.h"
+#endif
 
 namespace py = pybind11;
 using namespace toph;
 
+using MeshVertices = Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor>;
+using MeshFaces = Eigen::Matrix<int, Eigen::Dynamic, 3, Eigen::RowMajor>;
+
+// Wraps a Python callable for the render thread, which holds no GIL; the callable is released with the GIL held too.
+Viewer::PickCallback pickCallback(const py::function &callback) {
+    std::shared_ptr<py::function> f(new py::function(callback), [](py::function *p) {
+        py::gil_scoped_acquire gil;
+        delete p;
+    });
+    return [f](const Frame::Ptr &frame) {
+        py::gil_scoped_acquire gil;
+        (*f)(frame);
+    };
+}
+
+// Destroys viewers with the GIL released. The destructor joins the render thread, which may itself be waiting for the
+// GIL to run a pick callback.
+struct ViewerDeleter {
+    void operator()(Viewer *viewer) const {
+        py::gil_scoped_release release;
+        delete viewer;
+    }
+};
+using ViewerHolder = std::unique_ptr<Viewer, ViewerDeleter>;
+
+template <typename Vec, typename Mat> std::vector<Vec> rows(const Mat &m) {
+    std::vector<Vec> out(m.rows());
+    for (Eigen::Index i = 0; i < m.rows(); ++i) {
+        out[i] = m.row(i).transpose();
+    }
+    return out;
+}
+
 PYBIND11_MODULE(pytoph, m) {
+    // Meshes are immutable once created; the bindings only ever hand out const meshes through a non-const holder.
+    py::class_<Mesh, std::shared_ptr<Mesh>>(m, "Mesh")
+        .def(py::init([](const MeshVertices &vertices, const MeshFaces &faces, const MeshVertices &colors) {
+                 auto mesh = Mesh::Create(rows<Eigen::Vector3f>(vertices), rows<Eigen::Vector3i>(faces),
+                                          rows<Eigen::Vector3f>(colors));
+                 return std::const_pointer_cast<Mesh>(mesh);
+             }),
+             py::arg("vertices"), py::arg("faces"), py::arg("colors") = MeshVertices(0, 3))
+
+        .def_static(
+            "cube",
+            [](const Eigen::Vector3f &size, const Eigen::Vector3f &color) {
+                return std::const_pointer_cast<Mesh>(Mesh::Cube(size, color));
+            },
+            py::arg("size"), py::arg("color") = Eigen::Vector3f(1.0f, 1.0f, 1.0f))
+
+        .def_static(
+            "load",
+            [](const std::string &path, bool weld, float weldEpsilon, float scale, const Eigen::Vector3f &color,
+               const std::string &cacheDirectory) {
+                MeshImportOptions options;
+                options.weld = weld;
+                options.weldEpsilon = weldEpsilon;
+                options.scale = scale;
+                options.color = color;
+                options.cacheDirectory = cacheDirectory;
+                py::gil_scoped_release release;
+                return std::const_pointer_cast<Mesh>(importMesh(path, options));
+            },
+            py::arg("path"), py::arg("weld") = true, py::arg("weld_epsilon") = 0.0f, py::arg("scale") = 1.0f,
+            py::arg("color") = Eigen::Vector3f(1.0f, 1.0f, 1.0f), py::arg("cache_directory") = "")
+
+        .def_property_readonly("vertex_count", &Mesh::vertexCount)
+        .def_property_readonly("triangle_count", &Mesh::triangleCount);
+
     py::class_<Frame, Frame::Ptr>(m, "Frame")
         .def(py::init<const std::string &>(), py::arg("name"))
 
+        .def_static(
+            "cube",
+            [](const std::string &name, const Eigen::Vector3f &size, const Eigen::Vector3f &color) {
+                return Frame::Cube(name, size, color);
+            },
+            py::arg("name"), py::arg("size"), py::arg("color") = Eigen::Vector3f(1.0f, 1.0f, 1.0f))
+
         .def_property("name", &Frame::name, &Frame::setName)
         .def_property_readonly("parent", &Frame::parent)
         .def_property_readonly("children", &Frame::children)
 
         .def("add_child", &Frame::addChild, py::arg("child"))
 
+        .def_property(
+            "mesh", [](const Frame &f) { return std::const_pointer_cast<Mesh>(f.mesh()); },
+            [](Frame &f, const std::shared_ptr<Mesh> &mesh) { f.setMesh(mesh); })
+
+        .def_property(
+            "color", [](const Frame &f) { return f.frameColor; },
+            [](Frame &f, const Eigen::Vector3f &c) { f.frameColor = c; })
+
         .def_property(
             "matrix", [](const Frame &f) { return f.X().matrix(); },
             [](Frame &f, const Eigen::Matrix4f &M) { f.setX(Eigen::Isometry3f(M)); })
@@ -52,8 +148,10 @@ PYBIND11_MODULE(pytoph, m) {
             })
 
         .def_property_readonly("world_matrix", [](const Frame &f) { return f.worldX().matrix(); })
-        .def_property_readonly("world_translation", [](const Frame &f) { return f.worldX().translation(); })
-        .def_property_readonly("world_rotation", [](const Frame &f) { return f.worldX().rotation(); })
+        .def_property_readonly("world_translation",
+                               [](const Frame &f) -> Eigen::Vector3f { return f.worldX().translation(); })
+        .def_property_readonly("world_rotation",
+                               [](const Frame &f) -> Eigen::Matrix3f { return f.worldX().rotation(); })
 
         .def_property_readonly("world_quaternion",
                                [](const Frame &f) {
@@ -64,12 +162,303 @@ PYBIND11_MODULE(pytoph, m) {
         .def("translate", [](Frame &f, const Eigen::Vector3f &delta) { f.mutableX().pretranslate(delta); })
         .def("rotate", [](Frame &f, const Eigen::AngleAxisf &aa) { f.mutableX().rotate(aa); })
 
-        .def("show",
-             [](const Frame::Ptr &self) {
-                 Viewer v;
-                 v.addFrame(self);
-                 v.run();
-             })
+        // Blocks until the window is closed, or returns the viewer rendering on its own thread with block=False; the
+        // caller then keeps the window responsive with Viewer.poll_events().
+        .def(
+            "show",
+            [](const Frame::Ptr &self, bool block) -> ViewerHolder {
+                ViewerHolder viewer(new Viewer());
+                viewer->addFrame(self);
+                if (!block) {
+                    viewer->start();
+                    return viewer;
+                }
+                py::gil_scoped_release release;
+                viewer->run();
+                return nullptr;
+            },
+            py::arg("block") = true)
 
         .def("__repr__", &Frame::to_string);
-}
\ No newline at end of file
+
+    py::class_<PoseBuffer, PoseBuffer::Ptr>(m, "PoseBuffer")
+        .def(py::init<std::vector<Frame::Ptr>>(), py::arg("frames"))
+        .def_property_readonly("frames", &PoseBuffer::frames)
+        .def(
+            "set",
+            [](PoseBuffer &b, std::size_t i, const Eigen::Matrix4f &M) {
+                if (i >= b.frames().size()) throw py::index_error();
+                b.set(i, Eigen::Isometry3f(M));
+            },
+            py::arg("index"), py::arg("matrix"))
+        .def("publish", &PoseBuffer::publish);
+
+    py::class_<RayHit>(m, "RayHit")
+        .def_readonly("frame", &RayHit::frame)
+        .def_readonly("triangle", &RayHit::triangle)
+        .def_readonly("distance", &RayHit::distance)
+        .def("__bool__", [](const RayHit &h) { return static_cast<bool>(h); });
+
+    py::class_<Scene>(m, "Scene")
+        .def(py::init<>())
+        .def("add_frame", &Scene::addFrame, py::arg("frame"))
+        .def_property_readonly("frames", &Scene::frames)
+        .def("raycast", py::overload_cast<const Eigen::Vector3f &, const Eigen::Vector3f &, float>(&Scene::raycast),
+             py::arg("origin"), py::arg("direction"), py::arg("max_distance") = std::numeric_limits<float>::infinity())
+        // Takes (n, 3) arrays of origins and directions; returns (distances, triangles, frames), with an infinite
+        // distance and None for rays that hit nothing.
+        .def(
+            "raycast_many",
+            [](Scene &scene, const MeshVertices &origins, const MeshVertices &directions, float maxDistance) {
+                if (origins.rows() != directions.rows()) {
+                    throw py::value_error("origins and directions differ in length");
+                }
+                std::vector<Ray> rays(origins.rows());
+                for (Eigen::Index i = 0; i < origins.rows(); ++i) {
+                    rays[i] = {origins.row(i).transpose(), directions.row(i).transpose(), maxDistance};
+                }
+                std::vector<RayHit> hits;
+                {
+                    py::gil_scoped_release release;
+                    hits = scene.raycastMany(rays);
+                }
+                py::array_t<float> distances(static_cast<py::ssize_t>(hits.size()));
+                py::array_t<std::uint32_t> triangles(static_cast<py::ssize_t>(hits.size()));
+                std::vector<Frame::Ptr> frames(hits.size());
+                for (std::size_t i = 0; i < hits.size(); ++i) {
+                    distances.mutable_at(i) = hits[i].distance;
+                    triangles.mutable_at(i) = hits[i].triangle;
+                    frames[i] = std::move(hits[i].frame);
+                }
+                return py::make_tuple(distances, triangles, frames);
+            },
+            py::arg("origins"), py::arg("directions"),
+            py::arg("max_distance") = std::numeric_limits<float>::infinity());
+
+    py::class_<BeamPattern>(m, "BeamPattern")
+        .def(py::init([](const MeshVertices &directions) {
+                 BeamPattern pattern;
+                 pattern.directions = rows<Eigen::Vector3f>(directions);
+                 for (auto &d : pattern.directions) {
+                     d.normalize();
+                 }
+                 return pattern;
+             }),
+             py::arg("directions"))
+        .def_static("spinning", &BeamPattern::Spinning, py::arg("channels"), py::arg("steps"),
+                    py::arg("min_elevation"), py::arg("max_elevation"))
+        .def_static("pinhole", &BeamPattern::Pinhole, py::arg("width"), py::arg("height"), py::arg("fx"),
+                    py::arg("fy"), py::arg("cx"), py::arg("cy"))
+        .def_property_readonly("size", [](const BeamPattern &p) { return p.directions.size(); });
+
+    py::class_<RangeSensor>(m, "RangeSensor")
+        .def(py::init<Frame::Ptr, BeamPattern, float, float>(), py::arg("frame"), py::arg("pattern"),
+             py::arg("min_range") = 0.0f, py::arg("max_range") = 100.0f)
+        .def_property_readonly("frame", &RangeSensor::frame)
+        .def_property_readonly("min_range", &RangeSensor::minRange)
+        .def_property_readonly("max_range", &RangeSensor::maxRange)
+        // Ranges as a float32 array in pattern order, inf for beams without a return.
+        .def(
+            "scan",
+            [](const RangeSensor &sensor, Scene &scene) {
+                std::vector<float> ranges;
+                {
+                    py::gil_scoped_release release;
+                    sensor.scan(scene, ranges);
+                }
+                return py::array_t<float>(static_cast<py::ssize_t>(ranges.size()), ranges.data());
+            },
+            py::arg("scene"))
+        // (n, 3) float32 array of the returns in the sensor frame.
+        .def(
+            "point_cloud",
+            [](const RangeSensor &sensor, const std::vector<float> &ranges) {
+                const auto points = sensor.pointCloud(ranges);
+                py::array_t<float> out({static_cast<py::ssize_t>(points.size()), py::ssize_t(3)});
+                auto view = out.mutable_unchecked<2>();
+                for (std::size_t i = 0; i < points.size(); ++i) {
+                    for (int k = 0; k < 3; ++k) {
+                        view(i, k) = points[i][k];
+                    }
+                }
+                return out;
+            },
+            py::arg("ranges"));
+
+    py::class_<Contact>(m, "Contact")
+        .def_readonly("a", &Contact::a)
+        .def_readonly("b", &Contact::b)
+        .def_readonly("distance", &Contact::distance)
+        .def_readonly("point_a", &Contact::pointA)
+        .def_readonly("point_b", &Contact::pointB)
+        .def_readonly("triangle_a", &Contact::triangleA)
+        .def_readonly("triangle_b", &Contact::triangleB);
+
+    py::class_<CollisionWorld>(m, "CollisionWorld")
+        .def(py::init<float>(), py::arg("margin") = 0.0f)
+        .def("add_frame", &CollisionWorld::addFrame, py::arg("frame"))
+        .def_property_readonly("frames", &CollisionWorld::frames)
+        .def_property_readonly("margin", &CollisionWorld::margin)
+        .def("ignore", &CollisionWorld::ignore, py::arg("a"), py::arg("b"))
+        .def("candidate_pairs", &CollisionWorld::candidatePairs)
+        .def_property_readonly("moved_frames", &CollisionWorld::movedFrames)
+        .def(
+            "contacts", [](CollisionWorld &w) { return w.contacts(); }, py::call_guard<py::gil_scoped_release>());
+
+    py::class_<UrdfJoint> joint(m, "UrdfJoint");
+    py::enum_<UrdfJoint::Type>(joint, "Type")
+        .value("FIXED", UrdfJoint::Type::Fixed)
+        .value("REVOLUTE", UrdfJoint::Type::Revolute)
+        .value("CONTINUOUS", UrdfJoint::Type::Continuous)
+        .value("PRISMATIC", UrdfJoint::Type::Prismatic)
+        .value("FLOATING", UrdfJoint::Type::Floating)
+        .value("PLANAR", UrdfJoint::Type::Planar);
+    joint.def_readonly("name", &UrdfJoint::name)
+        .def_readonly("type", &UrdfJoint::type)
+        .def_readonly("parent", &UrdfJoint::parent)
+        .def_readonly("child", &UrdfJoint::child)
+        .def_property_readonly("origin", [](const UrdfJoint &j) { return Eigen::Matrix4f(j.origin.matrix()); })
+        .def_readonly("axis", &UrdfJoint::axis)
+        .def_readonly("lower", &UrdfJoint::lower)
+        .def_readonly("upper", &UrdfJoint::upper);
+
+    py::class_<UrdfRobot>(m, "UrdfRobot")
+        .def_readonly("name", &UrdfRobot::name)
+        .def_readonly("root", &UrdfRobot::root)
+        .def_readonly("links", &UrdfRobot::links)
+        .def_readonly("joints", &UrdfRobot::joints)
+        .def("link", &UrdfRobot::link, py::arg("name"))
+        .def("set_joint_position", &UrdfRobot::setJointPosition, py::arg("name"), py::arg("position"));
+
+    m.def(
+        "load_urdf",
+        [](const std::string &path, const std::map<std::string, std::string> &packages, bool visuals,
+           const std::string &cacheDirectory) {
+            UrdfOptions options;
+            options.packages = packages;
+            options.visuals = visuals;
+            options.mesh.cacheDirectory = cacheDirectory;
+            py::gil_scoped_release release;
+            return loadUrdf(path, options);
+        },
+        py::arg("path"), py::arg("packages") = std::map<std::string, std::string>{}, py::arg("visuals") = true,
+        py::arg("cache_directory") = "");
+
+    m.def("save_scene", &saveScene, py::arg("path"), py::arg("roots"), py::call_guard<py::gil_scoped_release>());
+    m.def("load_scene", &loadScene, py::arg("path"), py::call_guard<py::gil_scoped_release>());
+    m.def(
+        "load_glb",
+        [](const std::string &path) {
+            py::gil_scoped_release release;
+            return loadGlb(path);
+        },
+        py::arg("path"));
+    m.def("save_glb", &saveGlb, py::arg("path"), py::arg("roots"), py::call_guard<py::gil_scoped_release>());
+
+    py::enum_<ImageFormat>(m, "ImageFormat")
+        .value("RAW", ImageFormat::Raw)
+        .value("PPM", ImageFormat::Ppm)
+        .value("PNG", ImageFormat::Png);
+
+    py::class_<Viewer, ViewerHolder>(m, "Viewer")
+        .def(py::init<int, int, const char *>(), py::arg("width") = 800, py::arg("height") = 600,
+             py::arg("title") = "Toph Viewer")
+        .def("add_frame", &Viewer::addFrame, py::arg("frame"))
+        .def("run", &Viewer::run, py::call_guard<py::gil_scoped_release>())
+        .def("start", &Viewer::start)
+        .def("stop", &Viewer::stop, py::call_guard<py::gil_scoped_release>())
+        .def_property_readonly("running", &Viewer::running)
+        .def("poll_events", &Viewer::pollEvents, py::arg("timeout") = 0.0, py::call_guard<py::gil_scoped_release>())
+        .def("request_redraw", &Viewer::requestRedraw)
+        .def("add_pose_buffer", &Viewer::addPoseBuffer, py::arg("poses"))
+        .def("start_recording", &Viewer::startRecording, py::arg("path_pattern"),
+             py::arg("format") = ImageFormat::Png)
+        .def("stop_recording", &Viewer::stopRecording)
+        .def("set_id_buffer", &Viewer::setIdBuffer, py::arg("enabled"))
+        .def(
+            "pick",
+            [](Viewer &v, double x, double y, const py::function &callback) { v.pick(x, y, pickCallback(callback)); },
+            py::arg("x"), py::arg("y"), py::arg("callback"))
+        .def(
+            "set_click_callback",
+            [](Viewer &v, const py::function &callback) { v.setClickCallback(pickCallback(callback)); },
+            py::arg("callback"))
+        .def(
+            "post_transform",
+            [](Viewer &v, const Frame::Ptr &frame, const Eigen::Matrix4f &M) {
+                v.postTransform(frame, Eigen::Isometry3f(M));
+            },
+            py::arg("frame"), py::arg("matrix"))
+        .def(
+            "post_mesh",
+            [](Viewer &v, const Frame::Ptr &frame, const std::shared_ptr<Mesh> &mesh) { v.postMesh(frame, mesh); },
+            py::arg("frame"), py::arg("mesh"));
+
+#ifdef TOPH_HEADLESS
+    py::class_<HeadlessRenderer>(m, "HeadlessRenderer")
+        .def(py::init<int, int>(), py::arg("width") = 800, py::arg("height") = 600)
+        .def_property_readonly("width", &HeadlessRenderer::width)
+        .def_property_readonly("height", &HeadlessRenderer::height)
+        .def("add_frame", &HeadlessRenderer::addFrame, py::arg("frame"))
+        .def("set_camera", &HeadlessRenderer::setCamera, py::arg("eye"), py::arg("target"),
+             py::arg("up") = Eigen::Vector3f::UnitZ(), py::arg("fov_y") = 0.785398f, py::arg("near") = 0.1f,
+             py::arg("far") = 100.0f)
+        // Returns (color, depth, ids) as (h, w, 4) uint8, (h, w) float32 and (h, w) uint32 arrays, top row first.
+        .def("render", [](HeadlessRenderer &r) {
+            auto image = std::make_shared<HeadlessRenderer::Image>(r.render());
+            const py::ssize_t h = image->height, w = image->width;
+            py::capsule owner(new std::shared_ptr<HeadlessRenderer::Image>(image),
+                              [](void *p) { delete static_cast<std::shared_ptr<HeadlessRenderer::Image> *>(p); });
+            py::array_t<std::uint8_t> color({h, w, py::ssize_t(4)}, image->color.data(), owner);
+            py::array_t<float> depth({h, w}, image->depth.data(), owner);
+            py::array_t<std::uint32_t> ids({h, w}, image->ids.data(), owner);
+            return py::make_tuple(color, depth, ids);
+        });
+
+    py::class_<CameraIntrinsics>(m, "CameraIntrinsics")
+        .def(py::init<>())
+        .def_readwrite("width", &CameraIntrinsics::width)
+        .def_readwrite("height", &CameraIntrinsics::height)
+        .def_readwrite("fx", &CameraIntrinsics::fx)
+        .def_readwrite("fy", &CameraIntrinsics::fy)
+        .def_readwrite("cx", &CameraIntrinsics::cx)
+        .def_readwrite("cy", &CameraIntrinsics::cy)
+        .def_readwrite("near", &CameraIntrinsics::zNear)
+        .def_readwrite("far", &CameraIntrinsics::zFar);
+
+    py::class_<CameraView>(m, "CameraView")
+        .def(py::init([](const Eigen::Matrix4f &pose, const CameraIntrinsics &intrinsics) {
+                 return CameraView{Eigen::Isometry3f(pose), intrinsics};
+             }),
+             py::arg("pose"), py::arg("intrinsics"))
+        .def_property(
+            "pose", [](const CameraView &v) { return Eigen::Matrix4f(v.pose.matrix()); },
+            [](CameraView &v, const Eigen::Matrix4f &M) { v.pose = Eigen::Isometry3f(M); })
+        .def_readwrite("intrinsics", &CameraView::intrinsics);
+
+    py::class_<BatchRenderer>(m, "BatchRenderer")
+        .def(py::init<std::size_t>(), py::arg("contexts") = 0)
+        .def_property_readonly("context_count", &BatchRenderer::contextCount)
+        .def("add_frame", &BatchRenderer::addFrame, py::arg("frame"))
+        .def_property_readonly("frames", &BatchRenderer::frames)
+        // Calls callback(camera, color, depth, ids) with (h, w, 4) uint8, (h, w) float32 and (h, w) uint32 arrays.
+        .def(
+            "render",
+            [](BatchRenderer &b, const std::vector<CameraView> &views, const py::function &callback) {
+                py::gil_scoped_release release;
+                b.render(views, [&](BatchRenderer::Image &image) {
+                    py::gil_scoped_acquire acquire;
+                    const py::ssize_t h = image.height, w = image.width;
+                    callback(image.camera, py::array_t<std::uint8_t>({h, w, py::ssize_t(4)}, image.color.data()),
+                             py::array_t<float>({h, w}, image.depth.data()),
+                             py::array_t<std::uint32_t>({h, w}, image.ids.data()));
+                });
+            },
+            py::arg("views"), py::arg("callback"))
+        .def("render_to_disk",
+             [](BatchRenderer &b, const std::vector<CameraView> &views, const std::string &directory,
+                ImageFormat format) { b.renderToDisk(views, directory, format); },
+             py::arg("views"), py::arg("directory"), py::arg("format") = ImageFormat::Png,
+             py::call_guard<py::gil_scoped_release>());
+#endif
+}
@@ -0,0 +1,125 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <array>
+
+namespace toph {
+
+namespace {
+
+constexpr int kBins = 12;
+// Past this depth splits fall back to the median, which keeps the traversal stacks in bvh.h from overflowing.
+constexpr int kMaxSahDepth = 40;
+
+} // namespace
+
+void Bvh::build(const std::vector<Aabb> &boxes, std::uint32_t maxLeafSize) {
+    nodes_.clear();
+    primitives_.resize(boxes.size());
+    if (boxes.empty()) return;
+
+    std::vector<Eigen::Vector3f> centroids(boxes.size());
+    for (std::size_t i = 0; i < boxes.size(); ++i) {
+        primitives_[i] = static_cast<std::uint32_t>(i);
+        centroids[i] = boxes[i].empty() ? Eigen::Vector3f::Zero() : boxes[i].center();
+    }
+    nodes_.reserve(2 * boxes.size() / std::max<std::uint32_t>(maxLeafSize, 1) + 1);
+    buildRecursive(boxes, centroids, 0, static_cast<std::uint32_t>(boxes.size()),
+                   std::max<std::uint32_t>(maxLeafSize, 1), 0);
+}
+
+std::uint32_t Bvh::buildRecursive(const std::vector<Aabb> &boxes, const std::vector<Eigen::Vector3f> &centroids,
+                                  std::uint32_t begin, std::uint32_t end, std::uint32_t maxLeafSize, int depth) {
+    const std::uint32_t index = static_cast<std::uint32_t>(nodes_.size());
+    nodes_.emplace_back();
+
+    Aabb bounds, centroidBounds;
+    for (std::uint32_t i = begin; i < end; ++i) {
+        bounds.extend(boxes[primitives_[i]]);
+        centroidBounds.extend(centroids[primitives_[i]]);
+    }
+    nodes_[index].bounds = bounds;
+
+    const std::uint32_t count = end - begin;
+    const Eigen::Vector3f span = centroidBounds.max - centroidBounds.min;
+    int axis;
+    span.maxCoeff(&axis);
+    if (count <= maxLeafSize || span[axis] <= 0.0f) {
+        nodes_[index].offset = begin;
+        nodes_[index].count = count;
+        return index;
+    }
+
+    auto binOf = [&](std::uint32_t prim) {
+        const float t = (centroids[prim][axis] - centroidBounds.min[axis]) / span[axis];
+        return std::min(static_cast<int>(t * kBins), kBins - 1);
+    };
+
+    std::uint32_t mid = begin + count / 2;
+    bool split = false;
+    if (depth < kMaxSahDepth) {
+        std::array<Aabb, kBins> binBounds;
+        std::array<std::uint32_t, kBins> binCounts{};
+        for (std::uint32_t i = begin; i < end; ++i) {
+            const int b = binOf(primitives_[i]);
+            binBounds[b].extend(boxes[primitives_[i]]);
+            ++binCounts[b];
+        }
+
+        // Sweep from the right to get the cost of every split plane between bins.
+        std::array<float, kBins - 1> rightCost{};
+        Aabb right;
+        std::uint32_t rightCount = 0;
+        for (int b = kBins - 1; b > 0; --b) {
+            right.extend(binBounds[b]);
+            rightCount += binCounts[b];
+            rightCost[b - 1] = right.surfaceArea() * rightCount;
+        }
+        Aabb left;
+        std::uint32_t leftCount = 0;
+        float bestCost = bounds.surfaceArea() * count; // cost of not splitting
+        int bestPlane = -1;
+        for (int b = 0; b < kBins - 1; ++b) {
+            left.extend(binBounds[b]);
+            leftCount += binCounts[b];
+            const float cost = left.surfaceArea() * leftCount + rightCost[b];
+            if (leftCount > 0 && leftCount < count && cost < bestCost) {
+                bestCost = cost;
+                bestPlane = b;
+            }
+        }
+        if (bestPlane >= 0) {
+            auto it = std::partition(primitives_.begin() + begin, primitives_.begin() + end,
+                                     [&](std::uint32_t prim) { return binOf(prim) <= bestPlane; });
+            mid = static_cast<std::uint32_t>(it - primitives_.begin());
+            split = true;
+        }
+    }
+    if (!split) {
+        std::nth_element(primitives_.begin() + begin, primitives_.begin() + mid, primitives_.begin() + end,
+                         [&](std::uint32_t a, std::uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+    }
+
+    buildRecursive(boxes, centroids, begin, mid, maxLeafSize, depth + 1);
+    const std::uint32_t right = buildRecursive(boxes, centroids, mid, end, maxLeafSize, depth + 1);
+    nodes_[index].offset = right;
+    nodes_[index].count = 0;
+    return index;
+}
+
+void Bvh::refit(const std::vector<Aabb> &boxes) {
+    for (std::size_t i = nodes_.size(); i-- > 0;) {
+        Node &node = nodes_[i];
+        node.bounds = Aabb();
+        if (node.isLeaf()) {
+            for (std::uint32_t k = 0; k < node.count; ++k) {
+                node.bounds.extend(boxes[primitives_[node.offset + k]]);
+            }
+        } else {
+            node.bounds.extend(nodes_[i + 1].bounds);
+            node.bounds.extend(nodes_[node.offset].bounds);
+        }
+    }
+}
+
+} // namespace toph
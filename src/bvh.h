@@ -0,0 +1,124 @@
+#pragma once
+
+#include "geometry.h"
+#include <cstdint>
+#include <vector>
+
+namespace toph {
+
+// Bounding volume hierarchy over a set of boxes, built with binned SAH. Nodes are stored depth-first, so a node's left
+// child directly follows it and every child comes after its parent. Primitives are referred to by their index in the
+// vector passed to build().
+class Bvh {
+  public:
+    struct Node {
+        Aabb bounds;
+        // Interior nodes: index of the right child. Leaves: first entry in primitives().
+        std::uint32_t offset = 0;
+        // Zero for interior nodes.
+        std::uint32_t count = 0;
+
+        bool isLeaf() const { return count > 0; }
+    };
+
+    void build(const std::vector<Aabb> &boxes, std::uint32_t maxLeafSize = 4);
+    // Recomputes node bounds for moved boxes, keeping the topology. Cheap, but the tree degrades under large motion.
+    void refit(const std::vector<Aabb> &boxes);
+
+    bool empty() const { return nodes_.empty(); }
+    const std::vector<Node> &nodes() const { return nodes_; }
+    const std::vector<std::uint32_t> &primitives() const { return primitives_; }
+
+    // Calls visit(primitive) for every box not entirely outside the frustum. Boxes of subtrees entirely inside are
+    // reported without being tested.
+    template <typename Visit> void query(const Frustum &frustum, Visit &&visit) const;
+
+    // Calls visit(primitive) for every box overlapping `box`.
+    template <typename Visit> void query(const Aabb &box, Visit &&visit) const;
+
+    // Calls visit(primitive) for every primitive of the leaves reached by only descending into nodes for which
+    // enter(bounds) returns true.
+    template <typename Enter, typename Visit> void traverse(Enter &&enter, Visit &&visit) const;
+
+  private:
+    // Bounds the depth of the traversal stacks below; see kMaxSahDepth in bvh.cpp.
+    static constexpr int kStackSize = 128;
+
+    std::uint32_t buildRecursive(const std::vector<Aabb> &boxes, const std::vector<Eigen::Vector3f> &centroids,
+                                 std::uint32_t begin, std::uint32_t end, std::uint32_t maxLeafSize, int depth);
+
+    std::vector<Node> nodes_;
+    std::vector<std::uint32_t> primitives_;
+};
+
+template <typename Visit> void Bvh::query(const Frustum &frustum, Visit &&visit) const {
+    if (nodes_.empty()) return;
+    std::uint32_t stack[kStackSize];
+    bool inside[kStackSize];
+    int top = 0;
+    stack[top] = 0;
+    inside[top++] = false;
+    while (top > 0) {
+        --top;
+        const Node &node = nodes_[stack[top]];
+        bool fullyInside = inside[top];
+        if (!fullyInside) {
+            const auto result = frustum.test(node.bounds);
+            if (result == Frustum::Test::Outside) continue;
+            fullyInside = result == Frustum::Test::Inside;
+        }
+        if (node.isLeaf()) {
+            for (std::uint32_t i = 0; i < node.count; ++i) {
+                visit(primitives_[node.offset + i]);
+            }
+            continue;
+        }
+        const std::uint32_t self = static_cast<std::uint32_t>(&node - nodes_.data());
+        stack[top] = node.offset;
+        inside[top++] = fullyInside;
+        stack[top] = self + 1;
+        inside[top++] = fullyInside;
+    }
+}
+
+template <typename Visit> void Bvh::query(const Aabb &box, Visit &&visit) const {
+    if (nodes_.empty()) return;
+    std::uint32_t stack[kStackSize];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const std::uint32_t index = stack[--top];
+        const Node &node = nodes_[index];
+        if (!node.bounds.overlaps(box)) continue;
+        if (node.isLeaf()) {
+            for (std::uint32_t i = 0; i < node.count; ++i) {
+                visit(primitives_[node.offset + i]);
+            }
+            continue;
+        }
+        stack[top++] = node.offset;
+        stack[top++] = index + 1;
+    }
+}
+
+template <typename Enter, typename Visit> void Bvh::traverse(Enter &&enter, Visit &&visit) const {
+    if (nodes_.empty()) return;
+    std::uint32_t stack[kStackSize];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const std::uint32_t index = stack[--top];
+        const Node &node = nodes_[index];
+        if (!enter(node.bounds)) continue;
+        if (node.isLeaf()) {
+            for (std::uint32_t i = 0; i < node.count; ++i) {
+                visit(primitives_[node.offset + i]);
+            }
+            continue;
+        }
+        stack[top++] = node.offset;
+        stack[top++] = index + 1;
+    }
+}
+
+} // namespace toph
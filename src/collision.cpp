@@ -0,0 +1,453 @@
+#include "collision.h"
+#include "bvh.h"
+#include "mesh_bvh.h"
+#include "thread_pool.h"
+#include "transform_tree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <unordered_set>
+
+namespace toph {
+
+namespace {
+
+using Triangle = MeshBvh::Triangle;
+
+// Where the segment from p along e crosses the triangle, if it does (Moller-Trumbore with t limited to [0, 1]).
+bool segmentCrosses(const Eigen::Vector3f &p, const Eigen::Vector3f &e, const Triangle &tri, Eigen::Vector3f &point) {
+    const Eigen::Vector3f h = e.cross(tri.e2);
+    const float det = tri.e1.dot(h);
+    if (det == 0.0f) return false;
+    const float invDet = 1.0f / det;
+    const Eigen::Vector3f s = p - tri.v0;
+    const float u = s.dot(h) * invDet;
+    if (!(u >= 0.0f && u <= 1.0f)) return false;
+    const Eigen::Vector3f q = s.cross(tri.e1);
+    const float v = e.dot(q) * invDet;
+    if (!(v >= 0.0f && u + v <= 1.0f)) return false;
+    const float t = tri.e2.dot(q) * invDet;
+    if (!(t >= 0.0f && t <= 1.0f)) return false;
+    point = p + t * e;
+    return true;
+}
+
+// Two triangles that aren't coplanar intersect exactly when an edge of one crosses the other.
+bool trianglesIntersect(const Triangle &a, const Triangle &b, Eigen::Vector3f &point) {
+    for (const auto *tri : {&a, &b}) {
+        const Triangle &other = tri == &a ? b : a;
+        const Eigen::Vector3f v1 = tri->v0 + tri->e1, v2 = tri->v0 + tri->e2;
+        if (segmentCrosses(tri->v0, tri->e1, other, point) || segmentCrosses(tri->v0, tri->e2, other, point) ||
+            segmentCrosses(v1, v2 - v1, other, point)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Closest point of the triangle to p, by the Voronoi regions of its features (Ericson, Real-Time Collision Detection
+// 5.1.5).
+Eigen::Vector3f closestOnTriangle(const Eigen::Vector3f &p, const Triangle &tri) {
+    const Eigen::Vector3f &a = tri.v0, &ab = tri.e1, &ac = tri.e2;
+    const Eigen::Vector3f ap = p - a;
+    const float d1 = ab.dot(ap), d2 = ac.dot(ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return a;
+    const Eigen::Vector3f bp = ap - ab;
+    const float d3 = ab.dot(bp), d4 = ac.dot(bp);
+    if (d3 >= 0.0f && d4 <= d3) return a + ab;
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + d1 / (d1 - d3) * ab;
+    const Eigen::Vector3f cp = ap - ac;
+    const float d5 = ab.dot(cp), d6 = ac.dot(cp);
+    if (d6 >= 0.0f && d5 <= d6) return a + ac;
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + d2 / (d2 - d6) * ac;
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+        return a + ab + (d4 - d3) / ((d4 - d3) + (d5 - d6)) * (ac - ab);
+    }
+    const float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Closest points of the segments p1 + s * d1 and p2 + t * d2 with s, t in [0, 1] (Ericson 5.1.9).
+void closestOnSegments(const Eigen::Vector3f &p1, const Eigen::Vector3f &d1, const Eigen::Vector3f &p2,
+                       const Eigen::Vector3f &d2, Eigen::Vector3f &c1, Eigen::Vector3f &c2) {
+    const Eigen::Vector3f r = p1 - p2;
+    const float a = d1.squaredNorm(), e = d2.squaredNorm(), f = d2.dot(r);
+    float s = 0.0f, t = 0.0f;
+    if (a <= 1e-12f && e <= 1e-12f) {
+        // Both degenerate to points.
+    } else if (a <= 1e-12f) {
+        t = std::clamp(f / e, 0.0f, 1.0f);
+    } else {
+        const float c = d1.dot(r);
+        if (e <= 1e-12f) {
+            s = std::clamp(-c / a, 0.0f, 1.0f);
+        } else {
+            const float b = d1.dot(d2), denom = a * e - b * b;
+            s = denom != 0.0f ? std::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+            t = (b * s + f) / e;
+            if (t < 0.0f) {
+                t = 0.0f;
+                s = std::clamp(-c / a, 0.0f, 1.0f);
+            } else if (t > 1.0f) {
+                t = 1.0f;
+                s = std::clamp((b - c) / a, 0.0f, 1.0f);
+            }
+        }
+    }
+    c1 = p1 + s * d1;
+    c2 = p2 + t * d2;
+}
+
+// Squared distance of two triangles known not to intersect: the closest pair is among the vertex-triangle and
+// edge-edge pairs.
+float triangleDistance2(const Triangle &a, const Triangle &b, Eigen::Vector3f &pointA, Eigen::Vector3f &pointB) {
+    float best = std::numeric_limits<float>::infinity();
+    const auto consider = [&](const Eigen::Vector3f &pa, const Eigen::Vector3f &pb) {
+        const float d2 = (pa - pb).squaredNorm();
+        if (d2 < best) {
+            best = d2;
+            pointA = pa;
+            pointB = pb;
+        }
+    };
+    const Eigen::Vector3f va[3] = {a.v0, a.v0 + a.e1, a.v0 + a.e2};
+    const Eigen::Vector3f vb[3] = {b.v0, b.v0 + b.e1, b.v0 + b.e2};
+    for (int i = 0; i < 3; ++i) {
+        consider(va[i], closestOnTriangle(va[i], b));
+        consider(closestOnTriangle(vb[i], a), vb[i]);
+    }
+    Eigen::Vector3f ca, cb;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            closestOnSegments(va[i], va[(i + 1) % 3] - va[i], vb[j], vb[(j + 1) % 3] - vb[j], ca, cb);
+            consider(ca, cb);
+        }
+    }
+    return best;
+}
+
+// Gap between two boxes, zero if they overlap.
+float boxDistance(const Aabb &a, const Aabb &b) {
+    return (a.min - b.max).cwiseMax(b.min - a.max).cwiseMax(0.0f).norm();
+}
+
+Aabb grown(const Aabb &box, float by) {
+    if (box.empty() || by <= 0.0f) return box;
+    return {box.min.array() - by, box.max.array() + by};
+}
+
+// Closest features of two meshes, b placed in a's local space by bToA.
+struct MeshQuery {
+    float distance = std::numeric_limits<float>::infinity();
+    Eigen::Vector3f pointA, pointB; // in a's local space
+    std::uint32_t triangleA = 0, triangleB = 0;
+};
+
+// Walks both triangle BVHs together, splitting the larger node of each pair. Node pairs for which skip(boxA, boxB)
+// holds are passed over; leaf(ka, kb, ta, tb) gets the surviving triangle pairs, b's triangles placed in a's space, and
+// stops the walk by returning true.
+template <typename Skip, typename Leaf>
+void walkMeshes(const MeshBvh &a, const MeshBvh &b, const Eigen::Isometry3f &bToA, Skip &&skip, Leaf &&leaf) {
+    const auto &nodesA = a.bvh.nodes(), &nodesB = b.bvh.nodes();
+    if (nodesA.empty() || nodesB.empty()) return;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> stack;
+    stack.reserve(64);
+    stack.emplace_back(0, 0);
+    while (!stack.empty()) {
+        const auto [ia, ib] = stack.back();
+        stack.pop_back();
+        const Bvh::Node &na = nodesA[ia], &nb = nodesB[ib];
+        const Aabb boxB = nb.bounds.transformed(bToA);
+        if (skip(na.bounds, boxB)) continue;
+
+        if (na.isLeaf() && nb.isLeaf()) {
+            for (std::uint32_t kb = nb.offset; kb < nb.offset + nb.count; ++kb) {
+                const Triangle &src = b.triangles[kb];
+                const Triangle tb{bToA * src.v0, bToA.linear() * src.e1, bToA.linear() * src.e2};
+                for (std::uint32_t ka = na.offset; ka < na.offset + na.count; ++ka) {
+                    if (leaf(ka, kb, a.triangles[ka], tb)) return;
+                }
+            }
+            continue;
+        }
+        const bool splitA = !na.isLeaf() && (nb.isLeaf() || na.bounds.surfaceArea() >= boxB.surfaceArea());
+        if (splitA) {
+            stack.emplace_back(na.offset, ib);
+            stack.emplace_back(ia + 1, ib);
+        } else {
+            stack.emplace_back(ia, nb.offset);
+            stack.emplace_back(ia, ib + 1);
+        }
+    }
+}
+
+Aabb triangleBounds(const Triangle &t) {
+    Aabb box;
+    box.extend(t.v0);
+    box.extend(t.v0 + t.e1);
+    box.extend(t.v0 + t.e2);
+    return box;
+}
+
+// Looks for an intersection first, which stops at the first crossing triangle pair, then for one mesh inside the other.
+// Without either and with maxDistance > 0, finds the closest triangle pair below maxDistance, pruning node and triangle
+// pairs whose boxes are farther apart than the best so far. Returns false if the meshes neither intersect nor come
+// that close.
+bool queryMeshes(const MeshBvh &a, const MeshBvh &b, const Eigen::Isometry3f &bToA, float maxDistance,
+                 MeshQuery &result) {
+    bool found = false;
+    walkMeshes(
+        a, b, bToA, [](const Aabb &boxA, const Aabb &boxB) { return !boxA.overlaps(boxB); },
+        [&](std::uint32_t ka, std::uint32_t kb, const Triangle &ta, const Triangle &tb) {
+            Eigen::Vector3f point;
+            if (!trianglesIntersect(ta, tb, point)) return false;
+            result = {0.0f, point, point, a.bvh.primitives()[ka], b.bvh.primitives()[kb]};
+            found = true;
+            return true;
+        });
+    if (found) return true;
+
+    // Without crossing triangles, one mesh may still lie entirely inside the other; then all its vertices are inside,
+    // so testing one of them settles it.
+    const Eigen::Vector3f vertexB = bToA * b.triangles[0].v0;
+    if (a.contains(vertexB)) {
+        result = {0.0f, vertexB, vertexB, 0, b.bvh.primitives()[0]};
+        return true;
+    }
+    const Eigen::Vector3f &vertexA = a.triangles[0].v0;
+    if (b.contains(bToA.inverse(Eigen::Isometry) * vertexA)) {
+        result = {0.0f, vertexA, vertexA, a.bvh.primitives()[0], 0};
+        return true;
+    }
+    if (maxDistance <= 0.0f) return false;
+
+    float best = maxDistance;
+    walkMeshes(
+        a, b, bToA, [&](const Aabb &boxA, const Aabb &boxB) { return boxDistance(boxA, boxB) >= best; },
+        [&](std::uint32_t ka, std::uint32_t kb, const Triangle &ta, const Triangle &tb) {
+            if (boxDistance(triangleBounds(ta), triangleBounds(tb)) >= best) return false;
+            Eigen::Vector3f pa, pb;
+            const float d2 = triangleDistance2(ta, tb, pa, pb);
+            if (d2 < best * best) {
+                best = std::sqrt(d2);
+                result = {best, pa, pb, a.bvh.primitives()[ka], b.bvh.primitives()[kb]};
+                found = true;
+            }
+            return false;
+        });
+    return found;
+}
+
+struct PairHash {
+    std::size_t operator()(const std::pair<const Frame *, const Frame *> &p) const noexcept {
+        return std::hash<const Frame *>()(p.first) * 31 + std::hash<const Frame *>()(p.second);
+    }
+};
+
+} // namespace
+
+struct CollisionWorld::Impl {
+    float margin_;
+    std::vector<Frame::Ptr> frames_;
+    MeshBvhCache meshBvhs_;
+
+    // Per frame, as of the last update: its mesh and triangle BVH, world transform and world bounds grown by half the
+    // margin, so that bounds closer than the margin overlap.
+    std::vector<const Mesh *> meshes_;
+    std::vector<const MeshBvh *> bvhs_;
+    std::vector<Eigen::Isometry3f> world_;
+    std::vector<Aabb> bounds_;
+    TreeVersions treeVersions_;
+
+    // BVH over bounds_, refit on every update with moved frames and rebuilt when frames are added or it has loosened.
+    Bvh bvh_;
+    bool bvhNeedsBuild_ = true;
+    float builtRootArea_ = 0.0f;
+
+    // Per frame, the frames whose bounds overlap its own; kept symmetric. Only moved frames' entries are redone.
+    std::vector<std::vector<std::uint32_t>> overlaps_;
+    std::vector<std::uint8_t> moved_;
+    std::size_t movedCount_ = 0;
+    PairList pairs_;
+
+    std::unordered_set<std::pair<const Frame *, const Frame *>, PairHash> ignored_;
+    // Frames of newly ignored pairs, treated as moved on the next update.
+    std::unordered_set<const Frame *> requery_;
+
+    explicit Impl(float margin) : margin_(std::max(margin, 0.0f)) {}
+
+    void addFrame(const Frame::Ptr &frame);
+    bool ignored(std::uint32_t i, std::uint32_t j) const;
+    void update();
+
+  private:
+    void detectMoves();
+    void updateOverlaps();
+};
+
+void CollisionWorld::Impl::addFrame(const Frame::Ptr &frame) {
+    frames_.push_back(frame);
+    for (const auto &child : frame->children()) {
+        addFrame(child);
+    }
+}
+
+bool CollisionWorld::Impl::ignored(std::uint32_t i, std::uint32_t j) const {
+    if (ignored_.empty()) return false;
+    const Frame *a = frames_[i].get(), *b = frames_[j].get();
+    return ignored_.count(a < b ? std::make_pair(a, b) : std::make_pair(b, a)) > 0;
+}
+
+void CollisionWorld::Impl::detectMoves() {
+    const std::size_t n = frames_.size();
+    const std::size_t known = meshes_.size();
+    moved_.assign(n, 0);
+    if (known != n) bvhNeedsBuild_ = true;
+
+    bool meshesChanged = known != n;
+    for (std::size_t i = 0; i < known && !meshesChanged; ++i) {
+        meshesChanged = meshes_[i] != frames_[i]->mesh().get();
+    }
+    if (meshesChanged) {
+        const std::vector<const MeshBvh *> bvhs = meshBvhs_.update(frames_);
+        meshes_.resize(n);
+        bvhs_.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            if (i >= known || meshes_[i] != frames_[i]->mesh().get()) moved_[i] = 1;
+            meshes_[i] = frames_[i]->mesh().get();
+            bvhs_[i] = bvhs[i];
+        }
+    }
+
+    const bool transformsChanged = treeVersions_.update(frames_);
+
+    world_.resize(n, Eigen::Isometry3f::Identity());
+    bounds_.resize(n);
+    if (transformsChanged) {
+        for (const auto &frame : frames_) {
+            if (frame->tree()->dirty()) frame->tree()->updateWorldTransforms();
+        }
+    }
+    movedCount_ = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        // A new version only says that something in the tree moved; the comparison finds what.
+        if (transformsChanged && frames_[i]->worldX().matrix() != world_[i].matrix()) moved_[i] = 1;
+        if (!requery_.empty() && requery_.count(frames_[i].get())) moved_[i] = 1;
+        if (!moved_[i]) continue;
+        ++movedCount_;
+        world_[i] = frames_[i]->worldX();
+        bounds_[i] = bvhs_[i] ? grown(bvhs_[i]->mesh->bounds().transformed(world_[i]), 0.5f * margin_) : Aabb();
+    }
+    requery_.clear();
+}
+
+void CollisionWorld::Impl::updateOverlaps() {
+    const std::size_t n = frames_.size();
+    overlaps_.resize(n);
+    // Forget the overlaps of moved frames, on both sides.
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!moved_[i]) continue;
+        for (const std::uint32_t j : overlaps_[i]) {
+            if (moved_[j]) continue;
+            auto &list = overlaps_[j];
+            auto it = std::find(list.begin(), list.end(), static_cast<std::uint32_t>(i));
+            *it = list.back();
+            list.pop_back();
+        }
+        overlaps_[i].clear();
+    }
+
+    // Refitting is cheap but loosens the tree as frames move apart, so rebuild once it has grown a lot.
+    if (!bvhNeedsBuild_) {
+        bvh_.refit(bounds_);
+        bvhNeedsBuild_ = !bvh_.empty() && bvh_.nodes()[0].bounds.surfaceArea() > 2.0f * builtRootArea_;
+    }
+    if (bvhNeedsBuild_) {
+        bvh_.build(bounds_);
+        builtRootArea_ = bvh_.empty() ? 0.0f : bvh_.nodes()[0].bounds.surfaceArea();
+        bvhNeedsBuild_ = false;
+    }
+
+    // Requery the moved frames. A pair of two moved frames is found from both sides and kept from the lower index.
+    for (std::uint32_t i = 0; i < n; ++i) {
+        if (!moved_[i] || bounds_[i].empty()) continue;
+        bvh_.query(bounds_[i], [&](std::uint32_t j) {
+            // Leaves are reported whole, so test the frame's own bounds too.
+            if (j == i || (moved_[j] && j < i) || !bounds_[j].overlaps(bounds_[i]) || ignored(i, j)) return;
+            overlaps_[i].push_back(j);
+            overlaps_[j].push_back(i);
+        });
+    }
+
+    pairs_.clear();
+    for (std::uint32_t i = 0; i < n; ++i) {
+        for (const std::uint32_t j : overlaps_[i]) {
+            if (i < j) pairs_.emplace_back(i, j);
+        }
+    }
+    std::sort(pairs_.begin(), pairs_.end());
+}
+
+void CollisionWorld::Impl::update() {
+    detectMoves();
+    if (movedCount_ > 0) updateOverlaps();
+}
+
+CollisionWorld::CollisionWorld(float margin) : pimpl_(std::make_unique<Impl>(margin)) {}
+
+CollisionWorld::~CollisionWorld() = default;
+
+void CollisionWorld::addFrame(const Frame::Ptr &frame) { pimpl_->addFrame(frame); }
+
+const std::vector<Frame::Ptr> &CollisionWorld::frames() const noexcept { return pimpl_->frames_; }
+
+float CollisionWorld::margin() const noexcept { return pimpl_->margin_; }
+
+void CollisionWorld::ignore(const Frame::Ptr &a, const Frame::Ptr &b) {
+    const Frame *pa = a.get(), *pb = b.get();
+    pimpl_->ignored_.insert(pa < pb ? std::make_pair(pa, pb) : std::make_pair(pb, pa));
+    // Requeried on the next update, which drops the pair.
+    pimpl_->requery_.insert(pa);
+    pimpl_->requery_.insert(pb);
+}
+
+const CollisionWorld::PairList &CollisionWorld::candidatePairs() {
+    pimpl_->update();
+    return pimpl_->pairs_;
+}
+
+std::size_t CollisionWorld::movedFrames() const noexcept { return pimpl_->movedCount_; }
+
+std::vector<Contact> CollisionWorld::contacts(std::size_t threadCount) {
+    Impl &impl = *pimpl_;
+    impl.update();
+    const PairList &pairs = impl.pairs_;
+    std::vector<Contact> found(pairs.size());
+    std::vector<std::uint8_t> hit(pairs.size(), 0);
+    ThreadPool &pool = ThreadPool::shared();
+    pool.parallelFor(pairs.size(), threadCount == 0 ? pool.size() + 1 : threadCount,
+                     [&](std::size_t begin, std::size_t end) {
+                         for (std::size_t k = begin; k < end; ++k) {
+                             const auto [i, j] = pairs[k];
+                             const Eigen::Isometry3f &Xa = impl.world_[i];
+                             const Eigen::Isometry3f bToA = Xa.inverse(Eigen::Isometry) * impl.world_[j];
+                             MeshQuery query;
+                             if (!queryMeshes(*impl.bvhs_[i], *impl.bvhs_[j], bToA, impl.margin_, query)) continue;
+                             found[k] = {impl.frames_[i], impl.frames_[j], query.distance, Xa * query.pointA,
+                                         Xa * query.pointB, query.triangleA, query.triangleB};
+                             hit[k] = 1;
+                         }
+                     });
+    std::vector<Contact> result;
+    for (std::size_t k = 0; k < pairs.size(); ++k) {
+        if (hit[k]) result.push_back(std::move(found[k]));
+    }
+    return result;
+}
+
+} // namespace toph
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "frame.h"
+#include <Eigen/Core>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace toph {
+
+struct Contact {
+    Frame::Ptr a, b;
+    // Zero for meshes that intersect; otherwise their distance, which is below the world's margin.
+    float distance = 0.0f;
+    // World-space closest points on the two meshes. For intersecting meshes both are a point where an edge of one
+    // crosses a triangle of the other; for a mesh inside the other, both are a vertex of the inner mesh.
+    Eigen::Vector3f pointA = Eigen::Vector3f::Zero();
+    Eigen::Vector3f pointB = Eigen::Vector3f::Zero();
+    // Indices of the triangles holding the points, see Mesh::face(). For a mesh inside the other, the outer mesh's
+    // index is 0.
+    std::uint32_t triangleA = 0;
+    std::uint32_t triangleB = 0;
+};
+
+// Collision checks between the triangle meshes of frames. The broadphase keeps the pairs of frames whose world bounds
+// overlap, over a BVH that is refit as frames move; only frames whose world transform or mesh changed since the last
+// update are queried against it again. The narrowphase walks the two meshes' triangle BVHs together. Frames without a
+// mesh, and line meshes, never collide. Triangles lying in a common plane are not reported as intersecting.
+//
+// A mesh entirely inside a closed mesh, one whose every edge is shared by exactly two triangles, intersects it too,
+// even though no triangles cross. Open meshes have no inside: a mesh within an open one, say a box without a lid, only
+// collides with it where their surfaces cross or, with a margin, come close.
+class CollisionWorld {
+  public:
+    using PairList = std::vector<std::pair<std::uint32_t, std::uint32_t>>;
+
+    // With a margin, frames closer than it are reported as well, with their distance.
+    explicit CollisionWorld(float margin = 0.0f);
+    ~CollisionWorld();
+
+    CollisionWorld(const CollisionWorld &) = delete;
+    CollisionWorld &operator=(const CollisionWorld &) = delete;
+
+    // Adds the frame and its subtree.
+    void addFrame(const Frame::Ptr &frame);
+    const std::vector<Frame::Ptr> &frames() const noexcept;
+    float margin() const noexcept;
+
+    // Never reports this pair, e.g. neighbouring links of a robot whose meshes touch at the joint.
+    void ignore(const Frame::Ptr &a, const Frame::Ptr &b);
+
+    // Picks up changes since the last update and returns the pairs of frames whose world bounds, grown by the margin,
+    // overlap; as indices into frames(), first < second, sorted. Don't change the frames while this or contacts() runs.
+    const PairList &candidatePairs();
+    // Number of frames that re-entered the broadphase in the last update.
+    std::size_t movedFrames() const noexcept;
+
+    // Updates the broadphase and tests every candidate pair on up to threadCount threads of the shared pool (0 = all
+    // of them). Contacts come in the order of candidatePairs().
+    std::vector<Contact> contacts(std::size_t threadCount = 0);
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+} // namespace toph
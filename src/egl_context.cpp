@@ -0,0 +1,105 @@
+#include "egl_context.h"
+#include "gl_ext.h"
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+namespace toph {
+
+namespace {
+
+// The Mesa surfaceless platform needs no display server or device node; fall back to the default display elsewhere.
+EGLDisplay openDisplay() {
+    const auto getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (getPlatformDisplay && clientExtensions && std::strstr(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) return display;
+    }
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        throw std::runtime_error("EglContext: no EGL display");
+    }
+    const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!extensions || !std::strstr(extensions, "EGL_KHR_surfaceless_context")) {
+        throw std::runtime_error("EglContext: EGL_KHR_surfaceless_context is not supported");
+    }
+    return display;
+}
+
+// Opened on first use and kept for the life of the process; eglTerminate would invalidate the contexts of every user
+// of the display at once.
+EGLDisplay display() {
+    static const EGLDisplay display = openDisplay();
+    return display;
+}
+
+EGLConfig chooseConfig(EGLDisplay display) {
+    // Only the context is needed; framebuffer objects provide the color and depth storage.
+    const EGLint attributes[] = {EGL_SURFACE_TYPE, 0, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config = nullptr;
+    EGLint count = 0;
+    if (!eglChooseConfig(display, attributes, &config, 1, &count) || count == 0) {
+        throw std::runtime_error("EglContext: no EGL config for OpenGL");
+    }
+    return config;
+}
+
+} // namespace
+
+EglContext::EglContext(const EglContext *share) {
+    EGLDisplay dpy = display();
+    if (!eglBindAPI(EGL_OPENGL_API)) throw std::runtime_error("EglContext: desktop OpenGL is not supported");
+    const EGLConfig config = chooseConfig(dpy);
+    const EGLContext shareContext = share ? static_cast<EGLContext>(share->context_) : EGL_NO_CONTEXT;
+    const EGLint versions[][2] = {{4, 3}, {3, 3}};
+    for (const auto &version : versions) {
+        const EGLint attributes[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                     version[0],
+                                     EGL_CONTEXT_MINOR_VERSION,
+                                     version[1],
+                                     EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                     EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                     EGL_NONE};
+        context_ = eglCreateContext(dpy, config, shareContext, attributes);
+        if (context_ != EGL_NO_CONTEXT) break;
+    }
+    if (context_ == EGL_NO_CONTEXT) throw std::runtime_error("EglContext: failed to create an OpenGL 3.3 core context");
+
+    // The entry points are the same for every context of the display, so they are loaded once.
+    static std::once_flag loaded;
+    static bool gladLoaded = false;
+    makeCurrent();
+    std::call_once(loaded, [] {
+        gladLoaded = gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress));
+        if (gladLoaded) glext::load(reinterpret_cast<GLADloadproc>(eglGetProcAddress));
+    });
+    if (!gladLoaded) {
+        releaseCurrent();
+        eglDestroyContext(dpy, static_cast<EGLContext>(context_));
+        throw std::runtime_error("Failed to initialize GLAD");
+    }
+}
+
+EglContext::~EglContext() {
+    if (eglGetCurrentContext() == static_cast<EGLContext>(context_)) releaseCurrent();
+    // Destruction is deferred while the context is still current on another thread.
+    eglDestroyContext(display(), static_cast<EGLContext>(context_));
+}
+
+void EglContext::makeCurrent() {
+    if (eglGetCurrentContext() == static_cast<EGLContext>(context_)) return;
+    if (!eglMakeCurrent(display(), EGL_NO_SURFACE, EGL_NO_SURFACE, static_cast<EGLContext>(context_))) {
+        throw std::runtime_error("EglContext: eglMakeCurrent failed");
+    }
+}
+
+void EglContext::releaseCurrent() { eglMakeCurrent(display(), EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT); }
+
+} // namespace toph
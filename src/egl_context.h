@@ -0,0 +1,27 @@
+#pragma once
+
+namespace toph {
+
+// An OpenGL core context without a window, on Mesa's surfaceless EGL platform when available and the default EGL
+// display otherwise; render into framebuffer objects. Prefers 4.3 for GPU culling and falls back to 3.3. The GL entry
+// points (glad and glext) are loaded when the first context is created.
+class EglContext {
+  public:
+    // With share, buffers, textures and other shareable objects are shared with that context. The new context is left
+    // current on the calling thread. Throws std::runtime_error if no display or context is available.
+    explicit EglContext(const EglContext *share = nullptr);
+    ~EglContext();
+
+    EglContext(const EglContext &) = delete;
+    EglContext &operator=(const EglContext &) = delete;
+
+    // Makes the context current on the calling thread. A context is current on at most one thread at a time.
+    void makeCurrent();
+    // Detaches whatever context is current on the calling thread.
+    static void releaseCurrent();
+
+  private:
+    void *context_ = nullptr; // EGLContext
+};
+
+} // namespace toph
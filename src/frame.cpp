@@ -1,64 +1,68 @@
 #include "frame.h"
 #include <Eigen/Core>
-
-#define PAR_SHAPES_IMPLEMENTATION
-#include "par/par_shapes.h"
+#include <algorithm>
+#include <stdexcept>
 
 namespace toph {
 
-Frame::Frame(std::string name, Eigen::Isometry3f X) : name_(std::move(name)), X_(std::move(X)) {}
+Frame::Frame(std::string name, Eigen::Isometry3f X)
+    : name_(std::move(name)), tree_(std::make_shared<TransformTree>()), node_(tree_->create(X)) {}
+
+Frame::Frame(ChildTag, std::string name, const Ptr &parent, const Eigen::Isometry3f &X)
+    : name_(std::move(name)), tree_(parent->tree_), node_(tree_->create(X, parent->node_)), parent_(parent) {}
+
+Frame::~Frame() {
+    // Children kept alive elsewhere become roots.
+    for (const auto &child : children_) {
+        tree_->setParent(child->node_, TransformTree::kNone);
+    }
+    tree_->destroy(node_);
+}
 
 void Frame::addChild(const Frame::Ptr &child) {
     if (!child) return;
+    if (child->tree_ == tree_ && tree_->isAncestor(child->node_, node_)) {
+        throw std::invalid_argument("Frame::addChild: '" + child->name_ + "' is an ancestor of '" + name_ + "'");
+    }
+
+    if (auto old = child->parent_.lock()) {
+        auto &siblings = old->children_;
+        siblings.erase(std::remove(siblings.begin(), siblings.end(), child), siblings.end());
+    }
+
+    if (child->tree_ != tree_) {
+        child->moveToTree(tree_, node_);
+    } else {
+        tree_->setParent(child->node_, node_);
+    }
     child->parent_ = weak_from_this();
     children_.push_back(child);
 }
 
+void Frame::moveToTree(const std::shared_ptr<TransformTree> &tree, TransformTree::NodeId parent) {
+    const auto node = tree->create(X(), parent);
+    tree_->destroy(node_);
+    tree_ = tree;
+    node_ = node;
+    for (const auto &child : children_) {
+        child->moveToTree(tree, node);
+    }
+}
+
 Frame::Ptr Frame::parent() const { return parent_.lock(); }
 
 const std::vector<Frame::Ptr> &Frame::children() const noexcept { return children_; }
 
-Eigen::Isometry3f Frame::worldX() const {
-    if (auto p = parent_.lock()) { return p->worldX() * X_; }
-    return X_;
+Frame::Ptr Frame::CreateChild(const Ptr &parent, std::string name, const Eigen::Isometry3f &X) {
+    auto frame = std::make_shared<Frame>(ChildTag{}, std::move(name), parent, X);
+    parent->children_.push_back(frame);
+    return frame;
 }
 
 Frame::Ptr Frame::Cube(const std::string &name, const Eigen::Vector3f &size, const Eigen::Vector3f &color,
                        const Eigen::Isometry3f &X) {
     auto frame = std::make_shared<Frame>(name, X);
-    auto cube = par_shapes_create_cube();
-
-    for (int i = 0; i < cube->npoints; i++) {
-        cube->points[3 * i + 0] *= size.x() * 0.5f;
-        cube->points[3 * i + 1] *= size.y() * 0.5f;
-        cube->points[3 * i + 2] *= size.z() * 0.5f;
-    }
-
-    frame->vertices.resize(cube->npoints);
-    for (int i = 0; i < cube->npoints; i++) {
-        frame->vertices[i] = Eigen::Vector3f(cube->points[3 * i + 0], cube->points[3 * i + 1], cube->points[3 * i + 2]);
-    }
-
-    frame->faces.resize(cube->ntriangles);
-    for (int i = 0; i < cube->ntriangles; i++) {
-        frame->faces[i] =
-            Eigen::Vector3i(cube->triangles[3 * i + 0], cube->triangles[3 * i + 1], cube->triangles[3 * i + 2]);
-    }
-
-    if (cube->normals) {
-        frame->normals.resize(cube->npoints);
-        for (int i = 0; i < cube->npoints; i++) {
-            frame->normals[i] =
-                Eigen::Vector3f(cube->normals[3 * i + 0], cube->normals[3 * i + 1], cube->normals[3 * i + 2]);
-        }
-    } else {
-        frame->normals.clear();
-    }
-
-    frame->colors.assign(cube->npoints, color);
-
-    par_shapes_free_mesh(cube);
-
+    frame->setMesh(Mesh::Cube(size, color));
     return frame;
 }
 
@@ -72,4 +76,29 @@ std::string Frame::to_string() const {
 
 std::ostream &operator<<(std::ostream &os, const Frame &frame) { return os << frame.to_string(); }
 
+bool TreeVersions::update(const std::vector<Frame::Ptr> &frames) {
+    bool changed = false;
+    std::size_t k = 0;
+    const TransformTree *last = nullptr;
+    for (const auto &frame : frames) {
+        const TransformTree *tree = frame->tree().get();
+        if (tree == last) continue;
+        last = tree;
+        const std::pair<const TransformTree *, std::uint64_t> entry(tree, tree->version());
+        if (!changed && k < versions_.size() && versions_[k] == entry) {
+            ++k;
+            continue;
+        }
+        if (!changed) versions_.resize(k);
+        changed = true;
+        versions_.push_back(entry);
+        ++k;
+    }
+    if (k != versions_.size()) {
+        changed = true;
+        versions_.resize(k);
+    }
+    return changed;
+}
+
 } // namespace toph
\ No newline at end of file
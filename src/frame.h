@@ -1,10 +1,14 @@
 #pragma once
 
+#include "mesh.h"
+#include "transform_tree.h"
 #include <Eigen/Geometry>
+#include <cstdint>
 #include <memory>
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace toph {
@@ -13,14 +17,21 @@ class Frame : public std::enable_shared_from_this<Frame> {
   public:
     using Ptr = std::shared_ptr<Frame>;
 
-    std::vector<Eigen::Vector3f> vertices;
-    std::vector<Eigen::Vector3i> faces;
-    std::vector<Eigen::Vector3f> normals;
-    std::vector<Eigen::Vector3f> colors;
-
+    // Multiplied with the mesh's vertex colors.
     Eigen::Vector3f frameColor{1.0f, 1.0f, 1.0f};
 
+    // Only CreateChild() can make one.
+    class ChildTag {
+        explicit ChildTag() = default;
+        friend class Frame;
+    };
+
     explicit Frame(std::string name, Eigen::Isometry3f X = Eigen::Isometry3f::Identity());
+    Frame(ChildTag, std::string name, const Ptr &parent, const Eigen::Isometry3f &X);
+    ~Frame();
+
+    Frame(const Frame &) = delete;
+    Frame &operator=(const Frame &) = delete;
 
     void addChild(const Ptr &child);
     Ptr parent() const;
@@ -29,11 +40,27 @@ class Frame : public std::enable_shared_from_this<Frame> {
     const std::string &name() const noexcept { return name_; }
     void setName(const std::string &n) { name_ = n; }
 
-    const Eigen::Isometry3f &X() const noexcept { return X_; }
-    Eigen::Isometry3f &mutableX() noexcept { return X_; }
-    void setX(const Eigen::Isometry3f &x) { X_ = x; }
+    // Frames without a mesh are drawn as axes.
+    const Mesh::Ptr &mesh() const noexcept { return mesh_; }
+    void setMesh(Mesh::Ptr mesh) { mesh_ = std::move(mesh); }
+
+    const Eigen::Isometry3f &X() const noexcept { return tree_->local(node_); }
+    // Marks the subtree dirty up front, so don't hold on to the reference across worldX() reads or addChild().
+    Eigen::Isometry3f &mutableX() noexcept { return tree_->mutableLocal(node_); }
+    void setX(const Eigen::Isometry3f &x) { tree_->setLocal(node_, x); }
 
-    Eigen::Isometry3f worldX() const;
+    // Cached; only recomputed after a local transform above this frame changed. Although const, a read may bring the
+    // cache of the whole tree up to date, so it is not thread-safe: don't call it on frames of one tree from several
+    // threads, or while another thread changes the tree, without a lock of your own.
+    const Eigen::Isometry3f &worldX() const { return tree_->world(node_); }
+
+    // All frames of one hierarchy share a tree; addChild() moves the child's subtree into the parent's tree.
+    const std::shared_ptr<TransformTree> &tree() const noexcept { return tree_; }
+
+    // A new frame below `parent`, created in its tree. Same as addChild() on a new frame, but without building a tree
+    // for the frame first and moving it over, which makes it the way to build large hierarchies.
+    static Ptr CreateChild(const Ptr &parent, std::string name,
+                           const Eigen::Isometry3f &X = Eigen::Isometry3f::Identity());
 
     static Ptr Cube(const std::string &name, const Eigen::Vector3f &size,
                     const Eigen::Vector3f &color = Eigen::Vector3f{1.0f, 1.0f, 1.0f},
@@ -42,8 +69,13 @@ class Frame : public std::enable_shared_from_this<Frame> {
     std::string to_string() const;
 
   private:
+    void moveToTree(const std::shared_ptr<TransformTree> &tree, TransformTree::NodeId parent);
+
     std::string name_;
-    Eigen::Isometry3f X_;
+    Mesh::Ptr mesh_;
+
+    std::shared_ptr<TransformTree> tree_;
+    TransformTree::NodeId node_;
 
     std::weak_ptr<Frame> parent_;
     std::vector<Ptr> children_;
@@ -51,4 +83,16 @@ class Frame : public std::enable_shared_from_this<Frame> {
 
 std::ostream &operator<<(std::ostream &os, const Frame &frame);
 
+// The versions of the transform trees that a list of frames lives in, for telling whether any of them moved without
+// looking at the transforms. Frames of one hierarchy are usually adjacent in such lists, so each run of frames sharing
+// a tree is visited once and nothing is sorted or allocated while the trees stay the same.
+class TreeVersions {
+  public:
+    // True if a tree of `frames` has a new version or the trees differ from the last call; remembers them either way.
+    bool update(const std::vector<Frame::Ptr> &frames);
+
+  private:
+    std::vector<std::pair<const TransformTree *, std::uint64_t>> versions_;
+};
+
 } // namespace toph
\ No newline at end of file
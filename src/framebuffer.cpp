@@ -0,0 +1,94 @@
+#include "framebuffer.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace toph {
+
+namespace {
+
+// GL rows start at the bottom.
+template <typename T> void flipRows(std::vector<T> &pixels, std::size_t rowLength, int height) {
+    for (int top = 0, bottom = height - 1; top < bottom; ++top, --bottom) {
+        std::swap_ranges(pixels.begin() + top * rowLength, pixels.begin() + (top + 1) * rowLength,
+                         pixels.begin() + bottom * rowLength);
+    }
+}
+
+GLuint createRenderbuffer(GLenum format, int width, int height) {
+    GLuint renderbuffer = 0;
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, format, width, height);
+    return renderbuffer;
+}
+
+} // namespace
+
+Framebuffer::Framebuffer(int width, int height) : width_(width), height_(height) {
+    if (width <= 0 || height <= 0) throw std::invalid_argument("Framebuffer: size must be positive");
+    color_ = createRenderbuffer(GL_RGBA8, width, height);
+    ids_ = createRenderbuffer(GL_R32UI, width, height);
+    depth_ = createRenderbuffer(GL_DEPTH_COMPONENT32F, width, height);
+
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, ids_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_);
+    static const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, drawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        release();
+        throw std::runtime_error("Framebuffer: incomplete framebuffer");
+    }
+}
+
+Framebuffer::~Framebuffer() { release(); }
+
+void Framebuffer::release() {
+    if (framebuffer_) glDeleteFramebuffers(1, &framebuffer_);
+    if (color_) glDeleteRenderbuffers(1, &color_);
+    if (ids_) glDeleteRenderbuffers(1, &ids_);
+    if (depth_) glDeleteRenderbuffers(1, &depth_);
+    framebuffer_ = color_ = ids_ = depth_ = 0;
+}
+
+void Framebuffer::bind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glViewport(0, 0, width_, height_);
+}
+
+void Framebuffer::blitColorToWindow() const {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Framebuffer::readColor(std::vector<std::uint8_t> &rgba) const {
+    rgba.resize(static_cast<std::size_t>(width_) * height_ * 4);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+    flipRows(rgba, static_cast<std::size_t>(width_) * 4, height_);
+}
+
+void Framebuffer::readDepth(std::vector<float> &depth) const {
+    depth.resize(static_cast<std::size_t>(width_) * height_);
+    glReadPixels(0, 0, width_, height_, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+    flipRows(depth, static_cast<std::size_t>(width_), height_);
+}
+
+void Framebuffer::readIds(std::vector<std::uint32_t> &ids) const {
+    ids.resize(static_cast<std::size_t>(width_) * height_);
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glReadPixels(0, 0, width_, height_, GL_RED_INTEGER, GL_UNSIGNED_INT, ids.data());
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    flipRows(ids, static_cast<std::size_t>(width_), height_);
+}
+
+} // namespace toph
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace toph {
+
+// An offscreen render target with an RGBA8 color attachment, an R32UI frame id attachment as the second draw buffer
+// (see Renderer) and a 32-bit float depth attachment. Create, use and destroy it with the same GL context current.
+class Framebuffer {
+  public:
+    // Throws std::runtime_error if the framebuffer is incomplete.
+    Framebuffer(int width, int height);
+    ~Framebuffer();
+
+    Framebuffer(const Framebuffer &) = delete;
+    Framebuffer &operator=(const Framebuffer &) = delete;
+
+    int width() const noexcept { return width_; }
+    int height() const noexcept { return height_; }
+
+    // Binds it for drawing and reading and sets the viewport to cover it.
+    void bind();
+
+    // Copies the color attachment to the default framebuffer, which is left bound.
+    void blitColorToWindow() const;
+
+    // Synchronous readbacks of the bound framebuffer, top row first like image files.
+    void readColor(std::vector<std::uint8_t> &rgba) const;
+    // Window-space depth in [0, 1], 1 where nothing was drawn.
+    void readDepth(std::vector<float> &depth) const;
+    void readIds(std::vector<std::uint32_t> &ids) const;
+
+  private:
+    void release();
+
+    int width_;
+    int height_;
+    unsigned int framebuffer_ = 0;
+    unsigned int color_ = 0;
+    unsigned int ids_ = 0;
+    unsigned int depth_ = 0;
+};
+
+} // namespace toph
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <Eigen/Geometry>
+#include <cmath>
+#include <limits>
+
+namespace toph {
+
+// OpenGL-style projection and view matrices.
+inline Eigen::Matrix4f perspective(float fovyRadians, float aspect, float zNear, float zFar) {
+    const float f = 1.0f / std::tan(fovyRadians / 2.0f);
+    Eigen::Matrix4f m = Eigen::Matrix4f::Zero();
+    m(0, 0) = f / aspect;
+    m(1, 1) = f;
+    m(2, 2) = (zFar + zNear) / (zNear - zFar);
+    m(2, 3) = (2.0f * zFar * zNear) / (zNear - zFar);
+    m(3, 2) = -1.0f;
+    return m;
+}
+
+inline Eigen::Matrix4f lookAt(const Eigen::Vector3f &eye, const Eigen::Vector3f &center, const Eigen::Vector3f &up) {
+    Eigen::Vector3f f = (center - eye).normalized();
+    Eigen::Vector3f s = f.cross(up.normalized()).normalized();
+    Eigen::Vector3f u = s.cross(f);
+
+    Eigen::Matrix4f m = Eigen::Matrix4f::Identity();
+    m.block<1, 3>(0, 0) = s.transpose();
+    m.block<1, 3>(1, 0) = u.transpose();
+    m.block<1, 3>(2, 0) = -f.transpose();
+
+    Eigen::Matrix4f trans = Eigen::Matrix4f::Identity();
+    trans.block<3, 1>(0, 3) = -eye;
+    return m * trans;
+}
+
+struct Aabb {
+    Eigen::Vector3f min{Eigen::Vector3f::Constant(std::numeric_limits<float>::infinity())};
+    Eigen::Vector3f max{Eigen::Vector3f::Constant(-std::numeric_limits<float>::infinity())};
+
+    Aabb() = default;
+    Aabb(const Eigen::Vector3f &lo, const Eigen::Vector3f &hi) : min(lo), max(hi) {}
+
+    bool empty() const { return (min.array() > max.array()).any(); }
+    Eigen::Vector3f center() const { return 0.5f * (min + max); }
+    Eigen::Vector3f extent() const { return 0.5f * (max - min); }
+
+    void extend(const Eigen::Vector3f &p) {
+        min = min.cwiseMin(p);
+        max = max.cwiseMax(p);
+    }
+    void extend(const Aabb &b) {
+        min = min.cwiseMin(b.min);
+        max = max.cwiseMax(b.max);
+    }
+
+    bool overlaps(const Aabb &b) const {
+        return (min.array() <= b.max.array()).all() && (b.min.array() <= max.array()).all();
+    }
+    bool contains(const Eigen::Vector3f &p) const {
+        return (min.array() <= p.array()).all() && (p.array() <= max.array()).all();
+    }
+
+    float surfaceArea() const {
+        if (empty()) return 0.0f;
+        const Eigen::Vector3f d = max - min;
+        return 2.0f * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+    }
+
+    // Bounds of the transformed box (Arvo's method), exact for the box but not for its contents.
+    Aabb transformed(const Eigen::Isometry3f &X) const {
+        if (empty()) return *this;
+        const Eigen::Vector3f c = X * center();
+        const Eigen::Vector3f e = X.linear().cwiseAbs() * extent();
+        return {c - e, c + e};
+    }
+};
+
+// Six inward-facing planes (a, b, c, d) with a*x + b*y + c*z + d >= 0 inside, extracted from a view-projection matrix.
+struct Frustum {
+    enum class Test { Outside, Intersects, Inside };
+
+    Eigen::Matrix<float, 6, 4> planes;
+
+    explicit Frustum(const Eigen::Matrix4f &viewProjection) {
+        const auto &m = viewProjection;
+        for (int i = 0; i < 3; ++i) {
+            planes.row(2 * i + 0) = m.row(3) + m.row(i);
+            planes.row(2 * i + 1) = m.row(3) - m.row(i);
+        }
+        for (int i = 0; i < 6; ++i) {
+            planes.row(i) /= planes.row(i).head<3>().norm();
+        }
+    }
+
+    Test test(const Aabb &box) const {
+        if (box.empty()) return Test::Outside;
+        const Eigen::Vector3f c = box.center();
+        const Eigen::Vector3f e = box.extent();
+        Test result = Test::Inside;
+        for (int i = 0; i < 6; ++i) {
+            const Eigen::Vector3f n = planes.row(i).head<3>().transpose();
+            const float distance = n.dot(c) + planes(i, 3);
+            const float radius = n.cwiseAbs().dot(e);
+            if (distance < -radius) return Test::Outside;
+            if (distance < radius) result = Test::Intersects;
+        }
+        return result;
+    }
+};
+
+} // namespace toph
@@ -0,0 +1,22 @@
+#include "gl_ext.h"
+
+namespace toph::glext {
+
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect = nullptr;
+PFNGLDISPATCHCOMPUTEPROC DispatchCompute = nullptr;
+PFNGLMEMORYBARRIERPROC MemoryBarrier = nullptr;
+
+void load(GLADloadproc loader) {
+    MultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)loader("glMultiDrawElementsIndirect");
+    DispatchCompute = (PFNGLDISPATCHCOMPUTEPROC)loader("glDispatchCompute");
+    MemoryBarrier = (PFNGLMEMORYBARRIERPROC)loader("glMemoryBarrier");
+}
+
+Version currentVersion() {
+    Version version;
+    glGetIntegerv(GL_MAJOR_VERSION, &version.major);
+    glGetIntegerv(GL_MINOR_VERSION, &version.minor);
+    return version;
+}
+
+} // namespace toph::glext
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Entry points and enums above the GL 3.3 core profile that glad was generated for. They are loaded at runtime and
+// stay null when the context doesn't provide them, so callers check the has*() helpers before use.
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_TEXTURE_FETCH_BARRIER_BIT
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+
+namespace toph::glext {
+
+typedef void(APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect,
+                                                           GLsizei drawcount, GLsizei stride);
+
+typedef void(APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint numGroupsX, GLuint numGroupsY, GLuint numGroupsZ);
+typedef void(APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+
+extern PFNGLMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect;
+extern PFNGLDISPATCHCOMPUTEPROC DispatchCompute;
+extern PFNGLMEMORYBARRIERPROC MemoryBarrier;
+
+// Call once per process after gladLoadGLLoader, with the same loader.
+void load(GLADloadproc loader);
+
+// glad's GLVersion describes whichever context was current when gladLoadGLLoader ran, and the viewer's window and
+// the headless contexts can differ, so each user of a context records that context's own version.
+struct Version {
+    int major = 0;
+    int minor = 0;
+
+    bool atLeast(int atLeastMajor, int atLeastMinor) const {
+        return major > atLeastMajor || (major == atLeastMajor && minor >= atLeastMinor);
+    }
+};
+// Version of the context current on the calling thread.
+Version currentVersion();
+
+inline bool hasMultiDrawIndirect(const Version &version) {
+    return MultiDrawElementsIndirect != nullptr && version.atLeast(4, 3);
+}
+inline bool hasComputeShaders(const Version &version) {
+    return DispatchCompute != nullptr && MemoryBarrier != nullptr && version.atLeast(4, 3);
+}
+
+// Layout of one GL_DRAW_INDIRECT_BUFFER entry for glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+} // namespace toph::glext
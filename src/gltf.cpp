@@ -0,0 +1,1020 @@
+#include "gltf.h"
+#include "atomic_file.h"
+#include "mapped_file.h"
+#include "text.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+namespace toph {
+
+namespace {
+
+constexpr std::uint32_t kGlbMagic = 0x46546C67; // "glTF"
+constexpr std::uint32_t kJsonChunk = 0x4E4F534A;
+constexpr std::uint32_t kBinChunk = 0x004E4942;
+
+enum ComponentType : int {
+    Byte = 5120,
+    UnsignedByte = 5121,
+    Short = 5122,
+    UnsignedShort = 5123,
+    UnsignedInt = 5125,
+    Float = 5126,
+};
+
+enum Mode : int { Lines = 1, Triangles = 4, TriangleStrip = 5, TriangleFan = 6 };
+
+// Mesh::Vertex is position, color and normal, three floats each, which is what the zero-copy path matches against.
+static_assert(sizeof(Mesh::Vertex) == 9 * sizeof(float), "Mesh::Vertex is three packed float vec3s");
+constexpr std::size_t kColorOffset = 3 * sizeof(float);
+constexpr std::size_t kNormalOffset = 6 * sizeof(float);
+
+[[noreturn]] void fail(const std::string &path, const std::string &what) {
+    throw std::runtime_error("loadGlb: " + path + ": " + what);
+}
+
+// --- JSON ---
+
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    // nullptr if this isn't an object or has no such member.
+    const JsonValue *member(const char *key) const {
+        for (const auto &m : members) {
+            if (m.first == key) return &m.second;
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser {
+  public:
+    JsonParser(const char *begin, const char *end, const std::string &path) : p_(begin), end_(end), path_(path) {}
+
+    JsonValue document() {
+        JsonValue v = value(0);
+        skipSpace();
+        if (p_ != end_) fail(path_, "trailing characters after the JSON");
+        return v;
+    }
+
+  private:
+    // glTF nests a handful of levels; the limit keeps hostile files from exhausting the stack.
+    static constexpr int kMaxDepth = 64;
+
+    void skipSpace() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\r' || *p_ == '\n')) ++p_;
+    }
+
+    char peek() {
+        skipSpace();
+        return p_ < end_ ? *p_ : '\0';
+    }
+
+    void expect(char c) {
+        if (peek() != c) fail(path_, std::string("expected '") + c + "' in the JSON");
+        ++p_;
+    }
+
+    bool literal(const char *word) {
+        const std::size_t n = std::strlen(word);
+        if (static_cast<std::size_t>(end_ - p_) < n || std::memcmp(p_, word, n) != 0) return false;
+        p_ += n;
+        return true;
+    }
+
+    JsonValue value(int depth) {
+        if (depth > kMaxDepth) fail(path_, "JSON nested too deeply");
+        JsonValue v;
+        const char c = peek();
+        if (c == '{') {
+            ++p_;
+            v.type = JsonValue::Type::Object;
+            if (peek() == '}') {
+                ++p_;
+                return v;
+            }
+            for (;;) {
+                if (peek() != '"') fail(path_, "expected a member name in the JSON");
+                std::string key = string();
+                expect(':');
+                v.members.emplace_back(std::move(key), value(depth + 1));
+                if (peek() != ',') break;
+                ++p_;
+            }
+            expect('}');
+        } else if (c == '[') {
+            ++p_;
+            v.type = JsonValue::Type::Array;
+            if (peek() == ']') {
+                ++p_;
+                return v;
+            }
+            for (;;) {
+                v.array.push_back(value(depth + 1));
+                if (peek() != ',') break;
+                ++p_;
+            }
+            expect(']');
+        } else if (c == '"') {
+            v.type = JsonValue::Type::String;
+            v.string = string();
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            v.type = JsonValue::Type::Number;
+            const auto result = std::from_chars(p_, end_, v.number);
+            if (result.ec != std::errc()) fail(path_, "malformed number in the JSON");
+            p_ = result.ptr;
+        } else if (literal("true")) {
+            v.type = JsonValue::Type::Bool;
+            v.boolean = true;
+        } else if (literal("false")) {
+            v.type = JsonValue::Type::Bool;
+        } else if (!literal("null")) {
+            fail(path_, "unexpected character in the JSON");
+        }
+        return v;
+    }
+
+    std::uint32_t hex4() {
+        if (end_ - p_ < 4) fail(path_, "truncated \\u escape in the JSON");
+        std::uint32_t code = 0;
+        const auto result = std::from_chars(p_, p_ + 4, code, 16);
+        if (result.ptr != p_ + 4) fail(path_, "malformed \\u escape in the JSON");
+        p_ += 4;
+        return code;
+    }
+
+    std::string string() {
+        ++p_;
+        std::string out;
+        for (;;) {
+            const char *start = p_;
+            while (p_ < end_ && *p_ != '"' && *p_ != '\\' && static_cast<unsigned char>(*p_) >= 0x20) ++p_;
+            out.append(start, p_);
+            if (p_ == end_) fail(path_, "unterminated string in the JSON");
+            if (*p_ == '"') {
+                ++p_;
+                return out;
+            }
+            if (*p_ != '\\') fail(path_, "control character in a JSON string");
+            if (++p_ == end_) fail(path_, "unterminated string in the JSON");
+            switch (*p_++) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                std::uint32_t code = hex4();
+                if (code >= 0xD800 && code < 0xDC00 && literal("\\u")) {
+                    const std::uint32_t low = hex4();
+                    if (low >= 0xDC00 && low < 0xE000) code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(out, code);
+                break;
+            }
+            default: fail(path_, "unknown escape in a JSON string");
+            }
+        }
+    }
+
+    const char *p_;
+    const char *end_;
+    const std::string &path_;
+};
+
+// --- glTF ---
+
+struct Buffer {
+    std::shared_ptr<const void> owner;
+    const std::uint8_t *data;
+    std::size_t length;
+};
+
+struct BufferView {
+    std::size_t buffer;
+    const std::uint8_t *data;
+    std::size_t length;
+    std::size_t stride; // 0 if the elements are packed
+};
+
+struct Accessor {
+    const BufferView *view = nullptr;
+    const std::uint8_t *data = nullptr; // first element
+    std::size_t count = 0;
+    std::size_t stride = 0;
+    int componentType = 0;
+    int components = 0;
+    bool normalized = false;
+    const JsonValue *min = nullptr;
+    const JsonValue *max = nullptr;
+
+    bool isFloatVec3() const { return componentType == Float && components == 3 && !normalized; }
+};
+
+std::size_t componentSize(int componentType) {
+    switch (componentType) {
+    case Byte:
+    case UnsignedByte: return 1;
+    case Short:
+    case UnsignedShort: return 2;
+    case UnsignedInt:
+    case Float: return 4;
+    default: return 0;
+    }
+}
+
+// One component as a float, normalized integers mapped to [0, 1] or [-1, 1] as the spec defines.
+float component(const std::uint8_t *p, int componentType, bool normalized) {
+    switch (componentType) {
+    case Float: {
+        float f;
+        std::memcpy(&f, p, sizeof(f));
+        return f;
+    }
+    case UnsignedByte: return normalized ? *p / 255.0f : *p;
+    case Byte: {
+        const auto c = static_cast<std::int8_t>(*p);
+        return normalized ? std::max(c / 127.0f, -1.0f) : c;
+    }
+    case UnsignedShort: {
+        std::uint16_t c;
+        std::memcpy(&c, p, sizeof(c));
+        return normalized ? c / 65535.0f : c;
+    }
+    case Short: {
+        std::int16_t c;
+        std::memcpy(&c, p, sizeof(c));
+        return normalized ? std::max(c / 32767.0f, -1.0f) : c;
+    }
+    default: {
+        std::uint32_t c;
+        std::memcpy(&c, p, sizeof(c));
+        return static_cast<float>(c);
+    }
+    }
+}
+
+std::uint32_t indexAt(const Accessor &a, std::size_t i) {
+    const std::uint8_t *p = a.data + i * a.stride;
+    switch (a.componentType) {
+    case UnsignedByte: return *p;
+    case UnsignedShort: {
+        std::uint16_t c;
+        std::memcpy(&c, p, sizeof(c));
+        return c;
+    }
+    default: {
+        std::uint32_t c;
+        std::memcpy(&c, p, sizeof(c));
+        return c;
+    }
+    }
+}
+
+class GlbReader {
+  public:
+    GlbReader(const std::string &path, const GltfOptions &options) : path_(path) {
+        ThreadPool &pool = ThreadPool::shared();
+        threads_ = options.threadCount > 0 ? options.threadCount : pool.size() + 1;
+
+        file_ = std::make_shared<const MappedFile>(path);
+        const std::uint8_t *data = file_->data();
+        std::size_t size = file_->size();
+        std::uint32_t header[3];
+        if (size < sizeof(header)) fail(path_, "too short for a GLB header");
+        std::memcpy(header, data, sizeof(header));
+        if (header[0] != kGlbMagic) fail(path_, "not a binary glTF file");
+        if (header[1] != 2) fail(path_, "unsupported glTF version " + std::to_string(header[1]));
+        size = std::min<std::size_t>(size, header[2]);
+
+        const std::uint8_t *bin = nullptr;
+        std::size_t binLength = 0;
+        bool haveJson = false;
+        for (std::size_t offset = sizeof(header); offset + 8 <= size;) {
+            std::uint32_t chunk[2];
+            std::memcpy(chunk, data + offset, sizeof(chunk));
+            offset += sizeof(chunk);
+            if (chunk[0] > size - offset) fail(path_, "truncated chunk");
+            if (chunk[1] == kJsonChunk && !haveJson) {
+                const char *json = reinterpret_cast<const char *>(data + offset);
+                document_ = JsonParser(json, json + chunk[0], path_).document();
+                haveJson = true;
+            } else if (chunk[1] == kBinChunk && !bin) {
+                bin = data + offset;
+                binLength = chunk[0];
+            }
+            offset += (chunk[0] + 3) & ~std::size_t(3);
+        }
+        if (!haveJson) fail(path_, "no JSON chunk");
+        if (document_.type != JsonValue::Type::Object) fail(path_, "the JSON isn't an object");
+
+        const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+        const JsonValue &buffers = list("buffers");
+        for (std::size_t b = 0; b < buffers.array.size(); ++b) {
+            const JsonValue &buffer = buffers.array[b];
+            const std::string what = "buffer " + std::to_string(b);
+            const std::size_t length = integer(buffer.member("byteLength"), "byteLength of " + what);
+            const JsonValue *uri = buffer.member("uri");
+            if (!uri) {
+                if (b != 0 || !bin) fail(path_, what + " has no uri and no BIN chunk");
+                if (length > binLength) fail(path_, "buffer 0 is longer than the BIN chunk");
+                buffers_.push_back({file_, bin, length});
+                continue;
+            }
+            if (uri->type != JsonValue::Type::String) fail(path_, "malformed uri of " + what);
+            if (uri->string.compare(0, 5, "data:") == 0) fail(path_, "data URIs are not supported");
+            auto external = std::make_shared<const MappedFile>((directory / uri->string).string());
+            if (length > external->size()) fail(path_, uri->string + " is shorter than " + what);
+            buffers_.push_back({external, external->data(), length});
+        }
+
+        const JsonValue &views = list("bufferViews");
+        for (std::size_t v = 0; v < views.array.size(); ++v) {
+            const JsonValue &view = views.array[v];
+            const std::string what = "bufferView " + std::to_string(v);
+            BufferView out;
+            out.buffer = index(view.member("buffer"), buffers_.size(), what);
+            const std::size_t offset = optionalInteger(view.member("byteOffset"), what);
+            out.length = integer(view.member("byteLength"), what);
+            out.stride = optionalInteger(view.member("byteStride"), what);
+            const Buffer &buffer = buffers_[out.buffer];
+            if (offset > buffer.length || out.length > buffer.length - offset) fail(path_, what + " out of range");
+            out.data = buffer.data + offset;
+            views_.push_back(out);
+        }
+    }
+
+    std::vector<Frame::Ptr> scene() {
+        const JsonValue &nodes = list("nodes");
+        std::vector<std::size_t> roots;
+        const JsonValue &scenes = list("scenes");
+        const JsonValue *defaultScene = document_.member("scene");
+        if (defaultScene || !scenes.array.empty()) {
+            const JsonValue &s = scenes.array.at(defaultScene ? index(defaultScene, scenes.array.size(), "scene") : 0);
+            if (const JsonValue *list = s.member("nodes")) {
+                for (const auto &n : list->array) {
+                    roots.push_back(index(&n, nodes.array.size(), "scene node"));
+                }
+            }
+        } else {
+            std::vector<bool> isChild(nodes.array.size());
+            for (const auto &node : nodes.array) {
+                if (const JsonValue *children = node.member("children")) {
+                    for (const auto &c : children->array) {
+                        isChild[index(&c, nodes.array.size(), "child node")] = true;
+                    }
+                }
+            }
+            for (std::size_t n = 0; n < nodes.array.size(); ++n) {
+                if (!isChild[n]) roots.push_back(n);
+            }
+        }
+
+        // Pre-order, so that every parent's frame exists before its children's and each hierarchy is one run.
+        struct Visit {
+            std::size_t node;
+            std::int64_t parent; // into `order`
+            Eigen::Vector3f scale;
+        };
+        std::vector<Visit> order;
+        std::vector<Visit> stack;
+        std::vector<bool> visited(nodes.array.size());
+        for (auto root = roots.rbegin(); root != roots.rend(); ++root) {
+            stack.push_back({*root, -1, Eigen::Vector3f::Ones()});
+        }
+        while (!stack.empty()) {
+            const Visit visit = stack.back();
+            stack.pop_back();
+            if (visited[visit.node]) fail(path_, "node " + std::to_string(visit.node) + " has more than one parent");
+            visited[visit.node] = true;
+            const auto position = static_cast<std::int64_t>(order.size());
+            order.push_back(visit);
+            if (const JsonValue *children = nodes.array[visit.node].member("children")) {
+                const Eigen::Vector3f scale = visit.scale.cwiseProduct(nodeScale(nodes.array[visit.node]));
+                for (auto c = children->array.rbegin(); c != children->array.rend(); ++c) {
+                    stack.push_back({index(&*c, nodes.array.size(), "child node"), position, scale});
+                }
+            }
+        }
+
+        std::vector<Frame::Ptr> frames(order.size());
+        std::vector<Frame::Ptr> result;
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            const Visit &visit = order[i];
+            const JsonValue &node = nodes.array[visit.node];
+            const JsonValue *nameValue = node.member("name");
+            std::string name = nameValue && nameValue->type == JsonValue::Type::String
+                                   ? nameValue->string
+                                   : "node" + std::to_string(visit.node);
+            Eigen::Isometry3f X;
+            Eigen::Vector3f scale;
+            transform(node, X, scale);
+            X.translation() = X.translation().cwiseProduct(visit.scale);
+            if (visit.parent < 0) {
+                frames[i] = std::make_shared<Frame>(std::move(name), X);
+                std::size_t end = i + 1;
+                while (end < order.size() && order[end].parent >= 0) {
+                    ++end;
+                }
+                frames[i]->tree()->reserve(end - i);
+                result.push_back(frames[i]);
+            } else {
+                frames[i] = Frame::CreateChild(frames[visit.parent], std::move(name), X);
+            }
+            if (const JsonValue *meshIndex = node.member("mesh")) {
+                const auto &[mesh, color] = meshFor(index(meshIndex, list("meshes").array.size(), "node mesh"));
+                frames[i]->setMesh(scaledMesh(mesh, visit.scale.cwiseProduct(scale)));
+                frames[i]->frameColor = color;
+            }
+        }
+        return result;
+    }
+
+  private:
+    // A top-level array, or an empty one if missing.
+    const JsonValue &list(const char *key) const {
+        static const JsonValue empty;
+        const JsonValue *v = document_.member(key);
+        return v && v->type == JsonValue::Type::Array ? *v : empty;
+    }
+
+    std::size_t integer(const JsonValue *v, const std::string &what) const {
+        if (!v || v->type != JsonValue::Type::Number || v->number < 0 || v->number > 9007199254740992.0 ||
+            v->number != static_cast<double>(static_cast<std::uint64_t>(v->number))) {
+            fail(path_, "missing or invalid " + what);
+        }
+        return static_cast<std::size_t>(v->number);
+    }
+
+    std::size_t optionalInteger(const JsonValue *v, const std::string &what) const {
+        return v ? integer(v, what) : 0;
+    }
+
+    std::size_t index(const JsonValue *v, std::size_t count, const std::string &what) const {
+        const std::size_t i = integer(v, what);
+        if (i >= count) fail(path_, what + " " + std::to_string(i) + " out of range");
+        return i;
+    }
+
+    template <int N>
+    Eigen::Matrix<float, N, 1> numbers(const JsonValue *v, const Eigen::Matrix<float, N, 1> &fallback,
+                                       const char *what) const {
+        if (!v) return fallback;
+        if (v->type != JsonValue::Type::Array || v->array.size() != N) fail(path_, std::string("malformed ") + what);
+        Eigen::Matrix<float, N, 1> out;
+        for (int k = 0; k < N; ++k) {
+            if (v->array[k].type != JsonValue::Type::Number) fail(path_, std::string("malformed ") + what);
+            out[k] = static_cast<float>(v->array[k].number);
+        }
+        return out;
+    }
+
+    Eigen::Vector3f nodeScale(const JsonValue &node) const {
+        Eigen::Isometry3f X;
+        Eigen::Vector3f scale;
+        transform(node, X, scale);
+        return scale;
+    }
+
+    // Splits a node's matrix or TRS into a rigid transform and a scale along its axes.
+    void transform(const JsonValue &node, Eigen::Isometry3f &X, Eigen::Vector3f &scale) const {
+        X = Eigen::Isometry3f::Identity();
+        if (const JsonValue *matrix = node.member("matrix")) {
+            const Eigen::Matrix<float, 16, 1> m = numbers<16>(matrix, {}, "node matrix");
+            const Eigen::Matrix4f M = Eigen::Map<const Eigen::Matrix4f>(m.data());
+            Eigen::Matrix3f linear = M.topLeftCorner<3, 3>();
+            scale = linear.colwise().norm().transpose();
+            if (linear.determinant() < 0.0f) scale.x() = -scale.x();
+            if (scale.cwiseAbs().minCoeff() > 0.0f) {
+                linear = linear * scale.cwiseInverse().asDiagonal();
+                X.linear() = Eigen::Quaternionf(linear).normalized().toRotationMatrix();
+            }
+            X.translation() = M.topRightCorner<3, 1>();
+            return;
+        }
+        X.translation() = numbers<3>(node.member("translation"), Eigen::Vector3f::Zero(), "node translation");
+        const Eigen::Vector4f q = numbers<4>(node.member("rotation"), Eigen::Vector4f(0, 0, 0, 1), "node rotation");
+        X.linear() = Eigen::Quaternionf(q.w(), q.x(), q.y(), q.z()).normalized().toRotationMatrix();
+        scale = numbers<3>(node.member("scale"), Eigen::Vector3f::Ones(), "node scale");
+    }
+
+    Accessor accessor(std::size_t i) const {
+        const JsonValue &a = list("accessors").array.at(i);
+        const std::string what = "accessor " + std::to_string(i);
+        if (a.member("sparse")) fail(path_, "sparse accessors are not supported");
+        if (!a.member("bufferView")) fail(path_, what + " has no bufferView");
+        Accessor out;
+        out.view = &views_[index(a.member("bufferView"), views_.size(), what)];
+        out.count = integer(a.member("count"), what + " count");
+        out.componentType = static_cast<int>(integer(a.member("componentType"), what + " componentType"));
+        const JsonValue *type = a.member("type");
+        const std::string typeName = type && type->type == JsonValue::Type::String ? type->string : "";
+        out.components = typeName == "SCALAR" ? 1 : typeName == "VEC2" ? 2 : typeName == "VEC3" ? 3 : 4;
+        if (typeName != "SCALAR" && typeName.compare(0, 3, "VEC") != 0) fail(path_, what + " has type " + typeName);
+        const JsonValue *normalized = a.member("normalized");
+        out.normalized = normalized && normalized->boolean;
+        out.min = a.member("min");
+        out.max = a.member("max");
+
+        const std::size_t size = componentSize(out.componentType);
+        if (size == 0) fail(path_, what + " has an unknown componentType");
+        const std::size_t elementSize = size * out.components;
+        const std::size_t offset = optionalInteger(a.member("byteOffset"), what);
+        out.stride = out.view->stride ? out.view->stride : elementSize;
+        // Checked piecewise so that absurd counts can't overflow.
+        if (out.count > 0 && (offset > out.view->length || elementSize > out.view->length - offset ||
+                              out.count - 1 > (out.view->length - offset - elementSize) / out.stride)) {
+            fail(path_, what + " overruns its bufferView");
+        }
+        out.data = out.view->data + offset;
+        return out;
+    }
+
+    Eigen::Vector3f materialColor(const JsonValue &primitive) const {
+        const JsonValue *material = primitive.member("material");
+        if (!material) return Eigen::Vector3f::Ones();
+        const JsonValue &m = list("materials").array.at(index(material, list("materials").array.size(), "material"));
+        const JsonValue *pbr = m.member("pbrMetallicRoughness");
+        const JsonValue *factor = pbr ? pbr->member("baseColorFactor") : nullptr;
+        return numbers<4>(factor, Eigen::Vector4f::Ones(), "baseColorFactor").head<3>();
+    }
+
+    int mode(const JsonValue &primitive) const {
+        const JsonValue *m = primitive.member("mode");
+        return m ? static_cast<int>(integer(m, "primitive mode")) : Triangles;
+    }
+
+    const Buffer &bufferOf(const Accessor &a) const { return buffers_[a.view->buffer]; }
+
+    // The primitive viewed in place, or nullptr if its layout isn't the one of Mesh::Vertex.
+    Mesh::Ptr view(const JsonValue &primitive) const {
+        const int m = mode(primitive);
+        const JsonValue *attributes = primitive.member("attributes");
+        const JsonValue *positionIndex = attributes->member("POSITION");
+        const JsonValue *colorIndex = attributes->member("COLOR_0");
+        const JsonValue *normalIndex = attributes->member("NORMAL");
+        const JsonValue *indicesIndex = primitive.member("indices");
+        if ((m != Triangles && m != Lines) || !colorIndex || !normalIndex || (m == Triangles) != !!indicesIndex) {
+            return nullptr;
+        }
+        const std::size_t accessorCount = list("accessors").array.size();
+        const Accessor position = accessor(index(positionIndex, accessorCount, "POSITION"));
+        const Accessor color = accessor(index(colorIndex, accessorCount, "COLOR_0"));
+        const Accessor normal = accessor(index(normalIndex, accessorCount, "NORMAL"));
+        if (!position.isFloatVec3() || !color.isFloatVec3() || !normal.isFloatVec3() || color.view != position.view ||
+            normal.view != position.view || position.stride != sizeof(Mesh::Vertex) ||
+            color.data != position.data + kColorOffset || normal.data != position.data + kNormalOffset ||
+            color.count != position.count || normal.count != position.count ||
+            reinterpret_cast<std::uintptr_t>(position.data) % alignof(Mesh::Vertex) != 0) {
+            return nullptr;
+        }
+        if (!position.min || !position.max) return nullptr;
+        const Aabb bounds(numbers<3>(position.min, Eigen::Vector3f::Zero(), "POSITION min"),
+                          numbers<3>(position.max, Eigen::Vector3f::Zero(), "POSITION max"));
+        const auto *vertices = reinterpret_cast<const Mesh::Vertex *>(position.data);
+        if (m == Lines) {
+            if (position.count % 2 != 0) return nullptr;
+            return std::make_shared<const Mesh>(bufferOf(position).owner, vertices, position.count, nullptr, 0,
+                                                bounds);
+        }
+
+        const Accessor indices = accessor(index(indicesIndex, accessorCount, "indices"));
+        if (indices.componentType != UnsignedInt || indices.components != 1 ||
+            indices.stride != sizeof(std::uint32_t) || indices.count % 3 != 0 ||
+            indices.view->buffer != position.view->buffer ||
+            reinterpret_cast<std::uintptr_t>(indices.data) % alignof(std::uint32_t) != 0) {
+            return nullptr;
+        }
+        // The indices are the one part read up front: out of range ones would send the renderer and collision
+        // queries outside the vertices.
+        const auto *data = reinterpret_cast<const std::uint32_t *>(indices.data);
+        if (!indicesInRange(data, indices.count, position.count, threads_)) fail(path_, "index out of range");
+        return std::make_shared<const Mesh>(bufferOf(position).owner, vertices, position.count, data, indices.count,
+                                            bounds);
+    }
+
+    // Gathers the primitives into one mesh, all of them line lists or all of them triangles.
+    Mesh::Ptr convert(const std::vector<const JsonValue *> &primitives, bool tint) const {
+        ThreadPool &pool = ThreadPool::shared();
+        const std::size_t accessorCount = list("accessors").array.size();
+        std::vector<Mesh::Vertex> vertices;
+        std::vector<std::uint32_t> indices;
+        for (const JsonValue *primitive : primitives) {
+            const JsonValue *attributes = primitive->member("attributes");
+            const Accessor position = accessor(index(attributes->member("POSITION"), accessorCount, "POSITION"));
+            if (!position.isFloatVec3()) fail(path_, "POSITION isn't float vec3; quantized meshes are not supported");
+            const Eigen::Vector3f factor = tint ? materialColor(*primitive) : Eigen::Vector3f::Ones();
+            const JsonValue *normalIndex = attributes->member("NORMAL");
+            const JsonValue *colorIndex = attributes->member("COLOR_0");
+            Accessor normal, color;
+            if (normalIndex) {
+                normal = accessor(index(normalIndex, accessorCount, "NORMAL"));
+                if (!normal.isFloatVec3() || normal.count != position.count) fail(path_, "malformed NORMAL");
+            }
+            if (colorIndex) {
+                color = accessor(index(colorIndex, accessorCount, "COLOR_0"));
+                if (color.components < 3 || color.count != position.count || color.componentType == UnsignedInt) {
+                    fail(path_, "malformed COLOR_0");
+                }
+            }
+
+            const std::size_t base = vertices.size();
+            vertices.resize(base + position.count);
+            pool.parallelFor(position.count, threads_, [&](std::size_t begin, std::size_t end) {
+                const auto read = [](const Accessor &a, std::size_t i) {
+                    const std::uint8_t *p = a.data + i * a.stride;
+                    const std::size_t size = componentSize(a.componentType);
+                    return Eigen::Vector3f(component(p, a.componentType, a.normalized),
+                                           component(p + size, a.componentType, a.normalized),
+                                           component(p + 2 * size, a.componentType, a.normalized));
+                };
+                for (std::size_t i = begin; i < end; ++i) {
+                    Mesh::Vertex &v = vertices[base + i];
+                    v.position = read(position, i);
+                    v.color = colorIndex ? read(color, i).cwiseProduct(factor) : factor;
+                    v.normal = normalIndex ? read(normal, i) : Eigen::Vector3f::Zero();
+                }
+            });
+
+            // Indices of the primitive's own vertices, as listed or implied.
+            std::vector<std::uint32_t> listed;
+            if (const JsonValue *indicesIndex = primitive->member("indices")) {
+                const Accessor a = accessor(index(indicesIndex, accessorCount, "indices"));
+                if (a.components != 1 || a.normalized ||
+                    (a.componentType != UnsignedByte && a.componentType != UnsignedShort &&
+                     a.componentType != UnsignedInt)) {
+                    fail(path_, "malformed indices");
+                }
+                listed.resize(a.count);
+                std::atomic<bool> inRange{true};
+                pool.parallelFor(a.count, threads_, [&](std::size_t begin, std::size_t end) {
+                    for (std::size_t i = begin; i < end; ++i) {
+                        listed[i] = indexAt(a, i);
+                        if (listed[i] >= position.count) inRange = false;
+                    }
+                });
+                if (!inRange) fail(path_, "index out of range");
+            } else {
+                listed.resize(position.count);
+                for (std::size_t i = 0; i < listed.size(); ++i) {
+                    listed[i] = static_cast<std::uint32_t>(i);
+                }
+            }
+
+            const std::size_t firstIndex = indices.size();
+            switch (mode(*primitive)) {
+            case Lines: {
+                // Line meshes have no indices, so indexed lines are expanded into vertex pairs.
+                std::vector<Mesh::Vertex> pairs(listed.size() & ~std::size_t(1));
+                for (std::size_t i = 0; i < pairs.size(); ++i) {
+                    pairs[i] = vertices[base + listed[i]];
+                    if (!normalIndex) pairs[i].normal = Eigen::Vector3f(0, 0, 1);
+                }
+                vertices.resize(base);
+                vertices.insert(vertices.end(), pairs.begin(), pairs.end());
+                continue;
+            }
+            case Triangles:
+                for (std::size_t t = 0; t + 2 < listed.size(); t += 3) {
+                    for (int k = 0; k < 3; ++k) {
+                        indices.push_back(listed[t + k]);
+                    }
+                }
+                break;
+            case TriangleStrip:
+                for (std::size_t t = 0; t + 2 < listed.size(); ++t) {
+                    const std::size_t odd = t % 2;
+                    for (const std::size_t k : {t, t + 1 + odd, t + 2 - odd}) {
+                        indices.push_back(listed[k]);
+                    }
+                }
+                break;
+            case TriangleFan:
+                for (std::size_t t = 1; t + 1 < listed.size(); ++t) {
+                    for (const std::size_t k : {t, t + 1, std::size_t(0)}) {
+                        indices.push_back(listed[k]);
+                    }
+                }
+                break;
+            }
+
+            // The new indices count from the primitive's first vertex until they are offset into the merged mesh.
+            if (!normalIndex) {
+                averageNormals(vertices.data() + base, vertices.size() - base, indices.data() + firstIndex,
+                               indices.size() - firstIndex, threads_);
+            }
+            for (std::size_t t = firstIndex; t < indices.size(); ++t) {
+                indices[t] += static_cast<std::uint32_t>(base);
+            }
+        }
+        if (vertices.size() > std::numeric_limits<std::uint32_t>::max()) fail(path_, "mesh too large");
+        return std::make_shared<const Mesh>(std::move(vertices), std::move(indices));
+    }
+
+    // The mesh and frame color for a glTF mesh, built on first use and shared by meshes with the same accessors.
+    const std::pair<Mesh::Ptr, Eigen::Vector3f> &meshFor(std::size_t i) {
+        auto found = byMesh_.find(i);
+        if (found != byMesh_.end()) return found->second;
+
+        const JsonValue *primitives = list("meshes").array[i].member("primitives");
+        if (!primitives || primitives->type != JsonValue::Type::Array) fail(path_, "mesh without primitives");
+        std::vector<const JsonValue *> triangles, lines;
+        for (const auto &primitive : primitives->array) {
+            const JsonValue *attributes = primitive.member("attributes");
+            if (!attributes || !attributes->member("POSITION")) fail(path_, "primitive without POSITION");
+            const int m = mode(primitive);
+            if (m == Triangles || m == TriangleStrip || m == TriangleFan) triangles.push_back(&primitive);
+            else if (m == Lines) lines.push_back(&primitive);
+        }
+        // Points, line strips and loops have no counterpart; lines only count if there are no triangles.
+        const std::vector<const JsonValue *> &used = triangles.empty() ? lines : triangles;
+        std::pair<Mesh::Ptr, Eigen::Vector3f> result{nullptr, Eigen::Vector3f::Ones()};
+        if (!used.empty()) {
+            const bool single = used.size() == 1;
+            if (single) result.second = materialColor(*used.front());
+            std::vector<double> key;
+            for (const JsonValue *primitive : used) {
+                const JsonValue *attributes = primitive->member("attributes");
+                key.push_back(mode(*primitive));
+                for (const JsonValue *v : {attributes->member("POSITION"), attributes->member("COLOR_0"),
+                                           attributes->member("NORMAL"), primitive->member("indices"),
+                                           single ? nullptr : primitive->member("material")}) {
+                    key.push_back(v ? v->number : -1.0);
+                }
+            }
+            Mesh::Ptr &mesh = byAccessors_[key];
+            if (!mesh && single) mesh = view(*used.front());
+            if (!mesh) mesh = convert(used, !single);
+            result.first = mesh;
+        }
+        return byMesh_.emplace(i, std::move(result)).first->second;
+    }
+
+    Mesh::Ptr scaledMesh(const Mesh::Ptr &mesh, const Eigen::Vector3f &scale) {
+        if (!mesh || scale == Eigen::Vector3f::Ones()) return mesh;
+        Mesh::Ptr &copy = scaled_[{mesh.get(), scale.x(), scale.y(), scale.z()}];
+        if (!copy) copy = scaled(*mesh, scale);
+        return copy;
+    }
+
+    std::string path_;
+    std::size_t threads_;
+    std::shared_ptr<const MappedFile> file_;
+    JsonValue document_;
+    std::vector<Buffer> buffers_;
+    std::vector<BufferView> views_;
+    std::unordered_map<std::size_t, std::pair<Mesh::Ptr, Eigen::Vector3f>> byMesh_;
+    std::map<std::vector<double>, Mesh::Ptr> byAccessors_;
+    std::map<std::tuple<const Mesh *, float, float, float>, Mesh::Ptr> scaled_;
+};
+
+// --- Export ---
+
+void appendNumber(std::string &out, float value) {
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+template <typename Vector>
+void appendNumbers(std::string &out, const Vector &values) {
+    out += '[';
+    for (Eigen::Index k = 0; k < values.size(); ++k) {
+        if (k > 0) out += ',';
+        appendNumber(out, values[k]);
+    }
+    out += ']';
+}
+
+void appendString(std::string &out, const std::string &s) {
+    out += '"';
+    for (const char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+std::vector<Frame::Ptr> loadGlb(const std::string &path, const GltfOptions &options) {
+    return GlbReader(path, options).scene();
+}
+
+void saveGlb(const std::string &path, const std::vector<Frame::Ptr> &roots) {
+    const auto failSave = [&](const std::string &what) { throw std::runtime_error("saveGlb: " + path + ": " + what); };
+
+    // Pre-order, which keeps every hierarchy's nodes together.
+    struct Node {
+        const Frame *frame;
+        bool root;
+        std::vector<std::size_t> children;
+    };
+    std::vector<Node> nodes;
+    std::vector<std::pair<const Frame *, std::int64_t>> stack;
+    for (auto root = roots.rbegin(); root != roots.rend(); ++root) {
+        stack.emplace_back(root->get(), -1);
+    }
+    std::vector<std::size_t> rootNodes;
+    while (!stack.empty()) {
+        const auto [frame, parent] = stack.back();
+        stack.pop_back();
+        (parent < 0 ? rootNodes : nodes[parent].children).push_back(nodes.size());
+        nodes.push_back({frame, parent < 0, {}});
+        const auto &children = frame->children();
+        for (auto child = children.rbegin(); child != children.rend(); ++child) {
+            stack.emplace_back(child->get(), static_cast<std::int64_t>(nodes.size() - 1));
+        }
+    }
+
+    // Every distinct mesh's data once; a glTF mesh per mesh and frame color, all of one mesh sharing its accessors.
+    using Color = std::array<float, 3>;
+    std::vector<const Mesh *> meshes;
+    std::unordered_map<const Mesh *, std::size_t> meshIndex;
+    std::map<std::pair<std::size_t, Color>, std::size_t> gltfMeshIndex;
+    std::vector<std::pair<std::size_t, Color>> gltfMeshes;
+    std::map<Color, std::size_t> materialIndex;
+    std::vector<std::int64_t> nodeMesh(nodes.size(), -1);
+    for (std::size_t n = 0; n < nodes.size(); ++n) {
+        const Mesh *mesh = nodes[n].frame->mesh().get();
+        if (!mesh || mesh->vertexCount() == 0) continue;
+        const std::size_t m = meshIndex.emplace(mesh, meshes.size()).first->second;
+        if (m == meshes.size()) meshes.push_back(mesh);
+        const Eigen::Vector3f &c = nodes[n].frame->frameColor;
+        const Color color{c.x(), c.y(), c.z()};
+        if (color != Color{1.0f, 1.0f, 1.0f}) materialIndex.emplace(color, materialIndex.size());
+        const auto [it, inserted] = gltfMeshIndex.emplace(std::make_pair(m, color), gltfMeshes.size());
+        if (inserted) gltfMeshes.emplace_back(m, color);
+        nodeMesh[n] = static_cast<std::int64_t>(it->second);
+    }
+
+    // Vertices and indices are multiples of four bytes, so every view stays aligned without padding.
+    std::vector<std::uint64_t> vertexOffset(meshes.size()), indexOffset(meshes.size()), accessorBase(meshes.size());
+    std::uint64_t binLength = 0;
+    std::size_t accessors = 0;
+    for (std::size_t m = 0; m < meshes.size(); ++m) {
+        vertexOffset[m] = binLength;
+        binLength += meshes[m]->vertexCount() * sizeof(Mesh::Vertex);
+        indexOffset[m] = binLength;
+        binLength += meshes[m]->indexCount() * sizeof(std::uint32_t);
+        accessorBase[m] = accessors;
+        accessors += meshes[m]->indexCount() > 0 ? 4 : 3;
+    }
+
+    std::string json = R"({"asset":{"version":"2.0","generator":"toph"},"scene":0,"scenes":[{"nodes":[)";
+    for (std::size_t r = 0; r < rootNodes.size(); ++r) {
+        if (r > 0) json += ',';
+        json += std::to_string(rootNodes[r]);
+    }
+    json += "]}],\"nodes\":[";
+    for (std::size_t n = 0; n < nodes.size(); ++n) {
+        const Frame &frame = *nodes[n].frame;
+        json += n > 0 ? ",{\"name\":" : "{\"name\":";
+        appendString(json, frame.name());
+        if (nodeMesh[n] >= 0) json += ",\"mesh\":" + std::to_string(nodeMesh[n]);
+        const Eigen::Isometry3f X = nodes[n].root ? frame.worldX() : frame.X();
+        if (!X.translation().isZero(0.0f)) {
+            json += ",\"translation\":";
+            appendNumbers(json, X.translation());
+        }
+        if (!X.linear().isIdentity(0.0f)) {
+            json += ",\"rotation\":";
+            appendNumbers(json, Eigen::Quaternionf(X.linear()).coeffs());
+        }
+        if (!nodes[n].children.empty()) {
+            json += ",\"children\":[";
+            for (std::size_t c = 0; c < nodes[n].children.size(); ++c) {
+                if (c > 0) json += ',';
+                json += std::to_string(nodes[n].children[c]);
+            }
+            json += ']';
+        }
+        json += '}';
+    }
+    json += ']';
+    if (!meshes.empty()) {
+        json += ",\"meshes\":[";
+        for (std::size_t g = 0; g < gltfMeshes.size(); ++g) {
+            const auto &[m, color] = gltfMeshes[g];
+            const std::size_t a = accessorBase[m];
+            json += g > 0 ? "," : "";
+            json += "{\"primitives\":[{\"attributes\":{\"POSITION\":" + std::to_string(a) +
+                    ",\"COLOR_0\":" + std::to_string(a + 1) + ",\"NORMAL\":" + std::to_string(a + 2) + "}";
+            if (meshes[m]->indexCount() > 0) {
+                json += ",\"indices\":" + std::to_string(a + 3);
+            } else {
+                json += ",\"mode\":" + std::to_string(Lines);
+            }
+            const auto material = materialIndex.find(color);
+            if (material != materialIndex.end()) json += ",\"material\":" + std::to_string(material->second);
+            json += "}]}";
+        }
+        json += "],\"accessors\":[";
+        std::size_t view = 0;
+        for (std::size_t m = 0; m < meshes.size(); ++m) {
+            const Mesh &mesh = *meshes[m];
+            const std::string vertexView = std::to_string(view++);
+            const std::string count = std::to_string(mesh.vertexCount());
+            json += m > 0 ? "," : "";
+            json += "{\"bufferView\":" + vertexView + ",\"componentType\":" + std::to_string(Float) +
+                    ",\"count\":" + count + ",\"type\":\"VEC3\",\"min\":";
+            appendNumbers(json, mesh.bounds().min);
+            json += ",\"max\":";
+            appendNumbers(json, mesh.bounds().max);
+            for (const std::size_t offset : {kColorOffset, kNormalOffset}) {
+                json += "},{\"bufferView\":" + vertexView + ",\"byteOffset\":" + std::to_string(offset) +
+                        ",\"componentType\":" + std::to_string(Float) + ",\"count\":" + count + ",\"type\":\"VEC3\"";
+            }
+            json += '}';
+            if (mesh.indexCount() > 0) {
+                json += ",{\"bufferView\":" + std::to_string(view++) + ",\"componentType\":" +
+                        std::to_string(UnsignedInt) + ",\"count\":" + std::to_string(mesh.indexCount()) +
+                        ",\"type\":\"SCALAR\"}";
+            }
+        }
+        json += "],\"bufferViews\":[";
+        for (std::size_t m = 0; m < meshes.size(); ++m) {
+            json += m > 0 ? "," : "";
+            json += "{\"buffer\":0,\"byteOffset\":" + std::to_string(vertexOffset[m]) + ",\"byteLength\":" +
+                    std::to_string(meshes[m]->vertexCount() * sizeof(Mesh::Vertex)) +
+                    ",\"byteStride\":" + std::to_string(sizeof(Mesh::Vertex)) + ",\"target\":34962}";
+            if (meshes[m]->indexCount() > 0) {
+                json += ",{\"buffer\":0,\"byteOffset\":" + std::to_string(indexOffset[m]) + ",\"byteLength\":" +
+                        std::to_string(meshes[m]->indexCount() * sizeof(std::uint32_t)) + ",\"target\":34963}";
+            }
+        }
+        json += "],\"buffers\":[{\"byteLength\":" + std::to_string(binLength) + "}]";
+    }
+    if (!materialIndex.empty()) {
+        std::vector<Color> materials(materialIndex.size());
+        for (const auto &[color, m] : materialIndex) {
+            materials[m] = color;
+        }
+        json += ",\"materials\":[";
+        for (std::size_t m = 0; m < materials.size(); ++m) {
+            json += m > 0 ? "," : "";
+            json += "{\"pbrMetallicRoughness\":{\"baseColorFactor\":";
+            appendNumbers(json, Eigen::Vector4f(materials[m][0], materials[m][1], materials[m][2], 1.0f));
+            json += ",\"metallicFactor\":0}}";
+        }
+        json += ']';
+    }
+    json += '}';
+    json.resize((json.size() + 3) & ~std::size_t(3), ' ');
+
+    const std::uint64_t binPadded = (binLength + 3) & ~std::uint64_t(3);
+    const std::uint64_t total = 12 + 8 + json.size() + (meshes.empty() ? 0 : 8 + binPadded);
+    if (total > std::numeric_limits<std::uint32_t>::max()) failSave("larger than the 4 GB GLB limit");
+
+    AtomicFile file(path);
+    if (!file.isOpen()) failSave("cannot open for writing");
+    const std::uint32_t header[5] = {kGlbMagic, 2, static_cast<std::uint32_t>(total),
+                                     static_cast<std::uint32_t>(json.size()), kJsonChunk};
+    bool written = file.write(header, sizeof(header)) && file.write(json.data(), json.size());
+    if (!meshes.empty()) {
+        const std::uint32_t chunk[2] = {static_cast<std::uint32_t>(binPadded), kBinChunk};
+        written = written && file.write(chunk, sizeof(chunk));
+        for (const Mesh *mesh : meshes) {
+            written = written && file.write(mesh->vertices(), mesh->vertexCount() * sizeof(Mesh::Vertex)) &&
+                      file.write(mesh->indices(), mesh->indexCount() * sizeof(std::uint32_t));
+        }
+        const char zeros[4] = {};
+        written = written && file.write(zeros, binPadded - binLength);
+    }
+    if (!written || !file.commit()) failSave("cannot write");
+}
+
+} // namespace toph
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "frame.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace toph {
+
+struct GltfOptions {
+    // Threads of the shared pool to convert vertex data on; 0 uses all of them.
+    std::size_t threadCount = 0;
+};
+
+// Loads the default scene of a binary glTF 2.0 file (or the first scene, or else every node without a parent) and
+// returns its root nodes as frames. Every node becomes a frame named after it, or "node<i>", with its translation and
+// rotation; scales are applied to the meshes and child translations below the node, which is exact for uniform scales.
+// A mesh becomes one Mesh: triangle primitives (lists, strips and fans) are merged, with their material's
+// baseColorFactor multiplied into the vertex colors, while a mesh of one primitive keeps its color as the frameColor.
+// A mesh of one LINES primitive becomes a line mesh. Nodes using the same accessors share a Mesh.
+//
+// The file is memory-mapped. A primitive whose POSITION, COLOR_0 and NORMAL accessors interleave float vec3s in the
+// Mesh::Vertex layout and whose indices are 32-bit, as saveGlb() writes them, is viewed in place without copies;
+// other layouts are converted on the thread pool. Buffers in external files are mapped as well; data URIs, sparse
+// accessors and quantized positions are not supported. Throws std::runtime_error if the file can't be read or uses
+// something unsupported.
+std::vector<Frame::Ptr> loadGlb(const std::string &path, const GltfOptions &options = {});
+
+// Writes the hierarchies below `roots` as one scene of a binary glTF 2.0 file, roots at their world transform. The
+// data of every distinct mesh goes into the BIN chunk once, interleaved in the Mesh::Vertex layout, and nodes whose
+// frameColor differs from white get a mesh with a material of that color that references the same accessors. Streams
+// to a temporary file that replaces `path` once complete. Throws std::runtime_error if the file can't be written or
+// would exceed the 4 GB limit of the format.
+void saveGlb(const std::string &path, const std::vector<Frame::Ptr> &roots);
+
+} // namespace toph
@@ -0,0 +1,71 @@
+#include "headless.h"
+#include "egl_context.h"
+#include "framebuffer.h"
+#include "geometry.h"
+
+namespace toph {
+
+struct HeadlessRenderer::Impl {
+    // Declared first so that it is destroyed last, after the GL objects below.
+    EglContext context_;
+    Framebuffer framebuffer_;
+    Renderer renderer_;
+
+    Eigen::Matrix4f view_ =
+        lookAt(Eigen::Vector3f(3.0f, 3.0f, 3.0f), Eigen::Vector3f::Zero(), Eigen::Vector3f::UnitZ());
+    Eigen::Matrix4f projection_;
+
+    Impl(int width, int height);
+    ~Impl();
+
+    Image render(const Eigen::Matrix4f &view, const Eigen::Matrix4f &projection);
+};
+
+// The context is left current by its constructor, so the members after it are created in it.
+HeadlessRenderer::Impl::Impl(int width, int height)
+    : framebuffer_(width, height),
+      projection_(perspective(0.785398f, static_cast<float>(width) / height, 0.1f, 100.0f)) {}
+
+HeadlessRenderer::Impl::~Impl() { context_.makeCurrent(); }
+
+HeadlessRenderer::Image HeadlessRenderer::Impl::render(const Eigen::Matrix4f &view,
+                                                       const Eigen::Matrix4f &projection) {
+    context_.makeCurrent();
+    framebuffer_.bind();
+    renderer_.render(view, projection);
+
+    Image image;
+    image.width = framebuffer_.width();
+    image.height = framebuffer_.height();
+    framebuffer_.readColor(image.color);
+    framebuffer_.readDepth(image.depth);
+    framebuffer_.readIds(image.ids);
+    return image;
+}
+
+HeadlessRenderer::HeadlessRenderer(int width, int height) : pimpl_(std::make_unique<Impl>(width, height)) {}
+HeadlessRenderer::~HeadlessRenderer() = default;
+
+int HeadlessRenderer::width() const noexcept { return pimpl_->framebuffer_.width(); }
+int HeadlessRenderer::height() const noexcept { return pimpl_->framebuffer_.height(); }
+
+void HeadlessRenderer::addFrame(const Frame::Ptr &frame) {
+    pimpl_->context_.makeCurrent();
+    pimpl_->renderer_.addFrame(frame);
+}
+
+void HeadlessRenderer::setCamera(const Eigen::Vector3f &eye, const Eigen::Vector3f &target, const Eigen::Vector3f &up,
+                                 float fovY, float zNear, float zFar) {
+    pimpl_->view_ = lookAt(eye, target, up);
+    pimpl_->projection_ = perspective(fovY, static_cast<float>(width()) / height(), zNear, zFar);
+}
+
+HeadlessRenderer::Image HeadlessRenderer::render() { return pimpl_->render(pimpl_->view_, pimpl_->projection_); }
+
+HeadlessRenderer::Image HeadlessRenderer::render(const Eigen::Matrix4f &view, const Eigen::Matrix4f &projection) {
+    return pimpl_->render(view, projection);
+}
+
+Renderer &HeadlessRenderer::renderer() { return pimpl_->renderer_; }
+
+} // namespace toph
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "frame.h"
+#include "renderer.h"
+#include <Eigen/Core>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace toph {
+
+// Renders frames into an offscreen framebuffer through a surfaceless EGL context, with no window or event loop. Works
+// on GPU drivers and on Mesa's llvmpipe, so scenes can be rendered on machines without a display.
+class HeadlessRenderer {
+  public:
+    // One rendered view; rows run top to bottom like image files.
+    struct Image {
+        int width = 0;
+        int height = 0;
+        std::vector<std::uint8_t> color; // RGBA8
+        std::vector<float> depth;        // window-space depth in [0, 1], 1 where nothing was drawn
+        std::vector<std::uint32_t> ids;  // index into renderer().frames() plus one, 0 where nothing was drawn
+    };
+
+    // Throws std::runtime_error if no EGL display or OpenGL 3.3 core context is available.
+    HeadlessRenderer(int width = 800, int height = 600);
+    ~HeadlessRenderer();
+
+    HeadlessRenderer(const HeadlessRenderer &) = delete;
+    HeadlessRenderer &operator=(const HeadlessRenderer &) = delete;
+
+    int width() const noexcept;
+    int height() const noexcept;
+
+    // Adds the frame and its subtree.
+    void addFrame(const Frame::Ptr &frame);
+
+    // Looks from eye at target with a vertical field of view in radians, like the viewer's orbit camera.
+    void setCamera(const Eigen::Vector3f &eye, const Eigen::Vector3f &target,
+                   const Eigen::Vector3f &up = Eigen::Vector3f::UnitZ(), float fovY = 0.785398f, float zNear = 0.1f,
+                   float zFar = 100.0f);
+
+    Image render();
+    // Renders with explicit OpenGL-style matrices, ignoring setCamera().
+    Image render(const Eigen::Matrix4f &view, const Eigen::Matrix4f &projection);
+
+    // Culling switches and stats of the last render().
+    Renderer &renderer();
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+} // namespace toph
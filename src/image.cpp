@@ -0,0 +1,146 @@
+#include "image.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace toph {
+
+namespace {
+
+using File = std::unique_ptr<std::FILE, int (*)(std::FILE *)>;
+
+File openFile(const std::string &path) {
+    File file(std::fopen(path.c_str(), "wb"), &std::fclose);
+    if (!file) throw std::runtime_error("writeImage: cannot open " + path);
+    return file;
+}
+
+void write(std::FILE *file, const void *data, std::size_t size) {
+    if (size > 0 && std::fwrite(data, 1, size, file) != size) throw std::runtime_error("writeImage: write failed");
+}
+
+const std::uint8_t *row(const std::uint8_t *rgba, int width, int height, int y, bool bottomUp) {
+    return rgba + static_cast<std::size_t>(bottomUp ? height - 1 - y : y) * width * 4;
+}
+
+std::uint32_t crc32(std::uint32_t crc, const std::uint8_t *data, std::size_t size) {
+    static const std::array<std::uint32_t, 256> table = [] {
+        std::array<std::uint32_t, 256> t{};
+        for (std::uint32_t n = 0; n < 256; ++n) {
+            std::uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void putBigEndian(std::vector<std::uint8_t> &out, std::uint32_t v) {
+    out.insert(out.end(), {std::uint8_t(v >> 24), std::uint8_t(v >> 16), std::uint8_t(v >> 8), std::uint8_t(v)});
+}
+
+void writeChunk(std::FILE *file, const char type[4], const std::vector<std::uint8_t> &data) {
+    std::vector<std::uint8_t> header;
+    putBigEndian(header, static_cast<std::uint32_t>(data.size()));
+    header.insert(header.end(), type, type + 4);
+    write(file, header.data(), header.size());
+    write(file, data.data(), data.size());
+    std::vector<std::uint8_t> crc;
+    putBigEndian(crc, crc32(crc32(0, header.data() + 4, 4), data.data(), data.size()));
+    write(file, crc.data(), crc.size());
+}
+
+void writePng(std::FILE *file, int width, int height, const std::uint8_t *rgba, bool bottomUp) {
+    static const std::uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    write(file, signature, sizeof(signature));
+
+    std::vector<std::uint8_t> ihdr;
+    putBigEndian(ihdr, static_cast<std::uint32_t>(width));
+    putBigEndian(ihdr, static_cast<std::uint32_t>(height));
+    ihdr.insert(ihdr.end(), {8, 6, 0, 0, 0}); // 8 bits per channel, RGBA, deflate, no filter, no interlace
+    writeChunk(file, "IHDR", ihdr);
+
+    // The zlib stream: each scanline is a filter byte of 0 and the row, split into stored blocks of at most 65535
+    // bytes.
+    const std::size_t stride = static_cast<std::size_t>(width) * 4 + 1;
+    const std::size_t rawSize = stride * height;
+    std::vector<std::uint8_t> raw(rawSize);
+    for (int y = 0; y < height; ++y) {
+        raw[y * stride] = 0;
+        const std::uint8_t *src = row(rgba, width, height, y, bottomUp);
+        std::copy(src, src + stride - 1, raw.begin() + y * stride + 1);
+    }
+    std::vector<std::uint8_t> idat;
+    idat.reserve(rawSize + rawSize / 65535 * 5 + 16);
+    idat.insert(idat.end(), {0x78, 0x01});
+    std::size_t offset = 0;
+    do {
+        const std::size_t size = std::min<std::size_t>(rawSize - offset, 65535);
+        const bool last = offset + size == rawSize;
+        idat.insert(idat.end(), {std::uint8_t(last), std::uint8_t(size), std::uint8_t(size >> 8),
+                                 std::uint8_t(~size), std::uint8_t(~size >> 8)});
+        idat.insert(idat.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+    } while (offset < rawSize);
+    // Adler-32 of the uncompressed data; the sums are reduced every 5552 bytes, before they can overflow.
+    std::uint32_t a = 1, b = 0;
+    for (std::size_t i = 0; i < rawSize;) {
+        const std::size_t end = std::min(rawSize, i + 5552);
+        for (; i < end; ++i) {
+            a += raw[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    putBigEndian(idat, (b << 16) | a);
+    writeChunk(file, "IDAT", idat);
+    writeChunk(file, "IEND", {});
+}
+
+} // namespace
+
+void writeImage(const std::string &path, ImageFormat format, int width, int height, const std::uint8_t *rgba,
+                bool bottomUp) {
+    if (width <= 0 || height <= 0) throw std::invalid_argument("writeImage: size must be positive");
+    File file = openFile(path);
+    switch (format) {
+    case ImageFormat::Raw:
+        for (int y = 0; y < height; ++y) {
+            write(file.get(), row(rgba, width, height, y, bottomUp), static_cast<std::size_t>(width) * 4);
+        }
+        break;
+    case ImageFormat::Ppm: {
+        const std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        write(file.get(), header.data(), header.size());
+        std::vector<std::uint8_t> rgb(static_cast<std::size_t>(width) * 3);
+        for (int y = 0; y < height; ++y) {
+            const std::uint8_t *src = row(rgba, width, height, y, bottomUp);
+            for (int x = 0; x < width; ++x) {
+                rgb[x * 3 + 0] = src[x * 4 + 0];
+                rgb[x * 3 + 1] = src[x * 4 + 1];
+                rgb[x * 3 + 2] = src[x * 4 + 2];
+            }
+            write(file.get(), rgb.data(), rgb.size());
+        }
+        break;
+    }
+    case ImageFormat::Png:
+        writePng(file.get(), width, height, rgba, bottomUp);
+        break;
+    }
+    if (std::fflush(file.get()) != 0) throw std::runtime_error("writeImage: write failed for " + path);
+}
+
+} // namespace toph
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace toph {
+
+enum class ImageFormat {
+    Raw, // the RGBA8 pixels as they are, without a header
+    Ppm, // binary PPM (P6), alpha dropped
+    Png, // RGBA8 PNG with uncompressed deflate blocks, which keeps encoding at memcpy speed
+};
+
+// Writes width x height RGBA8 pixels, top row first unless bottomUp is set (as glReadPixels returns them). Throws
+// std::runtime_error if the file can't be written.
+void writeImage(const std::string &path, ImageFormat format, int width, int height, const std::uint8_t *rgba,
+                bool bottomUp = false);
+
+} // namespace toph
@@ -0,0 +1,46 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace toph {
+
+MappedFile::MappedFile(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("MappedFile: cannot open " + path + ": " + std::strerror(errno));
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        const int error = errno;
+        ::close(fd);
+        throw std::runtime_error("MappedFile: cannot stat " + path + ": " + std::strerror(error));
+    }
+    size_ = static_cast<std::size_t>(info.st_size);
+    // Empty files can't be mapped; they are represented by a null pointer and a zero size.
+    if (size_ > 0) {
+        void *p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            const int error = errno;
+            ::close(fd);
+            throw std::runtime_error("MappedFile: cannot map " + path + ": " + std::strerror(error));
+        }
+        data_ = static_cast<const std::uint8_t *>(p);
+    }
+    // The mapping stays valid without the descriptor.
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) ::munmap(const_cast<std::uint8_t *>(data_), size_);
+}
+
+void MappedFile::prefetch() const noexcept {
+    if (data_) ::madvise(const_cast<std::uint8_t *>(data_), size_, MADV_WILLNEED);
+}
+
+} // namespace toph
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace toph {
+
+// A file mapped read-only into memory for as long as the object lives. The kernel loads pages as they are touched, so
+// parsing straight from data() costs no read() copies.
+class MappedFile {
+  public:
+    // Throws std::runtime_error if the file can't be opened or mapped.
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const std::uint8_t *data() const noexcept { return data_; }
+    std::size_t size() const noexcept { return size_; }
+    const char *chars() const noexcept { return reinterpret_cast<const char *>(data_); }
+
+    // Asks the kernel to start reading the whole file in, ahead of the parser touching it.
+    void prefetch() const noexcept;
+
+  private:
+    const std::uint8_t *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+} // namespace toph
@@ -0,0 +1,151 @@
+#include "mesh.h"
+#include "thread_pool.h"
+
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+#define PAR_SHAPES_IMPLEMENTATION
+#include "par/par_shapes.h"
+
+namespace toph {
+
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<std::uint32_t> indices)
+    : vertexStorage_(std::move(vertices)), indexStorage_(std::move(indices)), vertices_(vertexStorage_.data()),
+      vertexCount_(vertexStorage_.size()), indices_(indexStorage_.data()), indexCount_(indexStorage_.size()) {
+    for (const auto &v : vertexStorage_) {
+        bounds_.extend(v.position);
+    }
+}
+
+Mesh::Mesh(std::shared_ptr<const void> storage, const Vertex *vertices, std::size_t vertexCount,
+           const std::uint32_t *indices, std::size_t indexCount, const Aabb &bounds)
+    : storage_(std::move(storage)), vertices_(vertices), vertexCount_(vertexCount), indices_(indices),
+      indexCount_(indexCount), bounds_(bounds) {}
+
+Mesh::Ptr Mesh::Create(const std::vector<Eigen::Vector3f> &positions, const std::vector<Eigen::Vector3i> &faces,
+                       const std::vector<Eigen::Vector3f> &colors, const std::vector<Eigen::Vector3f> &normals,
+                       const Eigen::Vector3f &color) {
+    std::vector<Vertex> vertices(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i) {
+        vertices[i].position = positions[i];
+        vertices[i].color = (i < colors.size()) ? colors[i] : color;
+        vertices[i].normal = (i < normals.size()) ? normals[i] : Eigen::Vector3f::Zero();
+    }
+
+    std::vector<std::uint32_t> indices;
+    indices.reserve(faces.size() * 3);
+    for (const auto &f : faces) {
+        for (int k = 0; k < 3; ++k) {
+            if (f[k] < 0 || static_cast<size_t>(f[k]) >= positions.size()) {
+                throw std::out_of_range("Mesh::Create: face index out of range");
+            }
+            indices.push_back(static_cast<std::uint32_t>(f[k]));
+        }
+    }
+
+    if (normals.size() < positions.size()) {
+        averageNormals(vertices.data(), vertices.size(), indices.data(), indices.size());
+    }
+
+    return std::make_shared<const Mesh>(std::move(vertices), std::move(indices));
+}
+
+void averageNormals(Mesh::Vertex *vertices, std::size_t vertexCount, const std::uint32_t *indices,
+                    std::size_t indexCount, std::size_t threadCount) {
+    // Accumulated serially, since neighbouring triangles share vertices.
+    for (std::size_t t = 0; t + 2 < indexCount; t += 3) {
+        Mesh::Vertex &a = vertices[indices[t]];
+        Mesh::Vertex &b = vertices[indices[t + 1]];
+        Mesh::Vertex &c = vertices[indices[t + 2]];
+        const Eigen::Vector3f n = (b.position - a.position).cross(c.position - a.position).normalized();
+        a.normal += n;
+        b.normal += n;
+        c.normal += n;
+    }
+    ThreadPool &pool = ThreadPool::shared();
+    pool.parallelFor(vertexCount, threadCount > 0 ? threadCount : pool.size() + 1,
+                     [&](std::size_t begin, std::size_t end) {
+                         for (std::size_t i = begin; i < end; ++i) {
+                             Eigen::Vector3f &n = vertices[i].normal;
+                             if (n.norm() > 0.0f) n.normalize();
+                             else n = Eigen::Vector3f(0, 0, 1);
+                         }
+                     });
+}
+
+Mesh::Ptr scaled(const Mesh &mesh, const Eigen::Vector3f &scale) {
+    // Normals transform with the inverse transpose, which for a diagonal scale is its cofactor over its determinant;
+    // the cofactor alone keeps flattened axes finite, and the determinant only contributes its sign.
+    const Eigen::Vector3f cofactor(scale.y() * scale.z(), scale.x() * scale.z(), scale.x() * scale.y());
+    const float sign = scale.prod() < 0.0f ? -1.0f : 1.0f;
+    std::vector<Mesh::Vertex> vertices(mesh.vertices(), mesh.vertices() + mesh.vertexCount());
+    for (auto &v : vertices) {
+        v.position = v.position.cwiseProduct(scale);
+        const Eigen::Vector3f n = sign * v.normal.cwiseProduct(cofactor);
+        v.normal = n.norm() > 0.0f ? n.normalized() : Eigen::Vector3f(0, 0, 1);
+    }
+    std::vector<std::uint32_t> indices(mesh.indices(), mesh.indices() + mesh.indexCount());
+    if (sign < 0.0f) {
+        for (std::size_t t = 0; t + 2 < indices.size(); t += 3) {
+            std::swap(indices[t + 1], indices[t + 2]);
+        }
+    }
+    return std::make_shared<const Mesh>(std::move(vertices), std::move(indices));
+}
+
+bool indicesInRange(const std::uint32_t *indices, std::size_t indexCount, std::size_t vertexCount,
+                    std::size_t threadCount) {
+    ThreadPool &pool = ThreadPool::shared();
+    std::atomic<bool> inRange{true};
+    pool.parallelFor(indexCount, threadCount > 0 ? threadCount : pool.size() + 1,
+                     [&](std::size_t begin, std::size_t end) {
+                         if (std::any_of(indices + begin, indices + end,
+                                         [&](std::uint32_t i) { return i >= vertexCount; })) {
+                             inRange = false;
+                         }
+                     });
+    return inRange;
+}
+
+Mesh::Ptr Mesh::Cube(const Eigen::Vector3f &size, const Eigen::Vector3f &color) {
+    static std::mutex mutex;
+    static std::map<std::array<float, 6>, std::weak_ptr<const Mesh>> cache;
+    static std::size_t sweepAt = 64;
+
+    const std::array<float, 6> key{size.x(), size.y(), size.z(), color.x(), color.y(), color.z()};
+    std::lock_guard<std::mutex> lock(mutex);
+    if (auto mesh = cache[key].lock()) return mesh;
+
+    auto cube = par_shapes_create_cube();
+    std::vector<Eigen::Vector3f> positions(cube->npoints);
+    for (int i = 0; i < cube->npoints; i++) {
+        positions[i] = Eigen::Vector3f(cube->points[3 * i + 0], cube->points[3 * i + 1], cube->points[3 * i + 2])
+                           .cwiseProduct(size * 0.5f);
+    }
+    std::vector<Eigen::Vector3i> faces(cube->ntriangles);
+    for (int i = 0; i < cube->ntriangles; i++) {
+        faces[i] = Eigen::Vector3i(cube->triangles[3 * i + 0], cube->triangles[3 * i + 1], cube->triangles[3 * i + 2]);
+    }
+    par_shapes_free_mesh(cube);
+
+    auto mesh = Create(positions, faces, {}, {}, color);
+    cache[key] = mesh;
+    // Cubes no frame uses any more leave expired entries behind; sweeping whenever the map has doubled keeps it
+    // proportional to the live cubes at constant amortized cost.
+    if (cache.size() >= sweepAt) {
+        for (auto it = cache.begin(); it != cache.end();) {
+            it = it->second.expired() ? cache.erase(it) : std::next(it);
+        }
+        sweepAt = std::max<std::size_t>(64, 2 * cache.size());
+    }
+    return mesh;
+}
+
+} // namespace toph
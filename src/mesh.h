@@ -0,0 +1,85 @@
+#pragma once
+
+#include "geometry.h"
+#include <Eigen/Core>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace toph {
+
+// Immutable geometry shared between frames. Vertices are stored interleaved in the layout the viewer uploads, so a
+// mesh costs one copy on the CPU and one buffer per viewer on the GPU no matter how many frames reference it.
+class Mesh {
+  public:
+    using Ptr = std::shared_ptr<const Mesh>;
+
+    struct Vertex {
+        Eigen::Vector3f position;
+        Eigen::Vector3f color;
+        Eigen::Vector3f normal;
+    };
+
+    Mesh(std::vector<Vertex> vertices, std::vector<std::uint32_t> indices);
+    // Views vertices and indices owned by `storage`, e.g. a mapped file, without copying them; the mesh keeps
+    // `storage` alive. The bounds are taken as given so that nothing has to touch the vertices up front.
+    Mesh(std::shared_ptr<const void> storage, const Vertex *vertices, std::size_t vertexCount,
+         const std::uint32_t *indices, std::size_t indexCount, const Aabb &bounds);
+
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+
+    // Normals are averaged from the faces when none are given; vertices without a color get `color`.
+    static Ptr Create(const std::vector<Eigen::Vector3f> &positions, const std::vector<Eigen::Vector3i> &faces,
+                      const std::vector<Eigen::Vector3f> &colors = {}, const std::vector<Eigen::Vector3f> &normals = {},
+                      const Eigen::Vector3f &color = Eigen::Vector3f{1.0f, 1.0f, 1.0f});
+
+    // Repeated calls with the same size and color return the same mesh for as long as it is referenced.
+    static Ptr Cube(const Eigen::Vector3f &size, const Eigen::Vector3f &color = Eigen::Vector3f{1.0f, 1.0f, 1.0f});
+
+    const Vertex *vertices() const noexcept { return vertices_; }
+    std::size_t vertexCount() const noexcept { return vertexCount_; }
+
+    // Triangle list; empty for meshes drawn as a line list.
+    const std::uint32_t *indices() const noexcept { return indices_; }
+    std::size_t indexCount() const noexcept { return indexCount_; }
+    std::size_t triangleCount() const noexcept { return indexCount_ / 3; }
+
+    // Local-space bounds of the vertices, computed once at construction.
+    const Aabb &bounds() const noexcept { return bounds_; }
+
+    const Eigen::Vector3f &position(std::size_t i) const { return vertices_[i].position; }
+    Eigen::Vector3i face(std::size_t t) const {
+        return Eigen::Vector3i(indices_[3 * t + 0], indices_[3 * t + 1], indices_[3 * t + 2]);
+    }
+
+  private:
+    // Empty for meshes viewing external storage.
+    std::vector<Vertex> vertexStorage_;
+    std::vector<std::uint32_t> indexStorage_;
+    std::shared_ptr<const void> storage_;
+
+    const Vertex *vertices_;
+    std::size_t vertexCount_;
+    const std::uint32_t *indices_;
+    std::size_t indexCount_;
+    Aabb bounds_;
+};
+
+// Adds the normal of every triangle to the normals of its three vertices, which normally start out zero, and then
+// normalizes them; vertices no triangle uses get +z. Indices count from `vertices`. The normalization runs on up to
+// threadCount threads of the shared pool (0 uses all of them).
+void averageNormals(Mesh::Vertex *vertices, std::size_t vertexCount, const std::uint32_t *indices,
+                    std::size_t indexCount, std::size_t threadCount = 0);
+
+// A copy of the mesh with its positions scaled per axis. Normals follow the cofactor of the scale, which stays defined
+// for flattening zero scales, and mirroring scales flip the winding so that triangles keep facing outwards.
+Mesh::Ptr scaled(const Mesh &mesh, const Eigen::Vector3f &scale);
+
+// Whether every index is below vertexCount, scanned on up to threadCount threads of the shared pool (0 uses all of
+// them). Meshes read from files are checked before anything indexes their vertices with them.
+bool indicesInRange(const std::uint32_t *indices, std::size_t indexCount, std::size_t vertexCount,
+                    std::size_t threadCount = 0);
+
+} // namespace toph
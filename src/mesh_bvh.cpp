@@ -0,0 +1,130 @@
+#include "mesh_bvh.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <utility>
+
+namespace toph {
+
+MeshBvh::MeshBvh(Mesh::Ptr m) : mesh(std::move(m)) {
+    const std::size_t n = mesh->triangleCount();
+    std::vector<Aabb> boxes(n);
+    for (std::size_t t = 0; t < n; ++t) {
+        const Eigen::Vector3i f = mesh->face(t);
+        for (int k = 0; k < 3; ++k) {
+            boxes[t].extend(mesh->position(f[k]));
+        }
+    }
+    bvh.build(boxes);
+
+    const auto &order = bvh.primitives();
+    triangles.resize(n);
+    for (std::size_t k = 0; k < n; ++k) {
+        const Eigen::Vector3i f = mesh->face(order[k]);
+        const Eigen::Vector3f &v0 = mesh->position(f[0]);
+        triangles[k] = {v0, mesh->position(f[1]) - v0, mesh->position(f[2]) - v0};
+    }
+
+    // Count the triangles on each edge, keyed by its end positions in a fixed order; adding zero turns -0 into +0.
+    using Edge = std::array<float, 6>;
+    struct EdgeHash {
+        std::size_t operator()(const Edge &e) const noexcept {
+            std::size_t h = 0;
+            for (const float c : e) {
+                h = h * 1000003 ^ std::hash<float>()(c);
+            }
+            return h;
+        }
+    };
+    std::unordered_map<Edge, std::uint32_t, EdgeHash> edges;
+    edges.reserve(3 * n / 2);
+    for (std::size_t t = 0; t < n; ++t) {
+        const Eigen::Vector3i f = mesh->face(t);
+        for (int k = 0; k < 3; ++k) {
+            Eigen::Vector3f a = mesh->position(f[k]).array() + 0.0f, b = mesh->position(f[(k + 1) % 3]).array() + 0.0f;
+            if (std::lexicographical_compare(b.data(), b.data() + 3, a.data(), a.data() + 3)) std::swap(a, b);
+            ++edges[{a.x(), a.y(), a.z(), b.x(), b.y(), b.z()}];
+        }
+    }
+    closed = n > 0 && std::all_of(edges.begin(), edges.end(), [](const auto &edge) { return edge.second == 2; });
+}
+
+bool MeshBvh::contains(const Eigen::Vector3f &point) const {
+    if (!closed || !mesh->bounds().contains(point)) return false;
+    // An arbitrary direction off the axes and diagonals, so that the ray is unlikely to graze an edge or a vertex,
+    // where neighbouring triangles would both count.
+    const Eigen::Vector3f direction(0.6402f, 0.5373f, 0.5490f);
+    const Eigen::Vector3f inverse = direction.cwiseInverse();
+    const auto &nodes = bvh.nodes();
+    std::vector<std::uint32_t> stack = {0};
+    bool inside = false;
+    while (!stack.empty()) {
+        const Bvh::Node &node = nodes[stack.back()];
+        const std::uint32_t index = stack.back();
+        stack.pop_back();
+        const Eigen::Array3f t0 = (node.bounds.min - point).array() * inverse.array();
+        const Eigen::Array3f t1 = (node.bounds.max - point).array() * inverse.array();
+        if (t0.max(t1).minCoeff() < std::max(t0.min(t1).maxCoeff(), 0.0f)) continue;
+        if (!node.isLeaf()) {
+            stack.push_back(node.offset);
+            stack.push_back(index + 1);
+            continue;
+        }
+        // Moller-Trumbore, two-sided, hits ahead of the point only.
+        for (std::uint32_t k = node.offset; k < node.offset + node.count; ++k) {
+            const Triangle &tri = triangles[k];
+            const Eigen::Vector3f p = direction.cross(tri.e2);
+            const float det = tri.e1.dot(p);
+            if (det == 0.0f) continue;
+            const float invDet = 1.0f / det;
+            const Eigen::Vector3f s = point - tri.v0;
+            const float u = s.dot(p) * invDet;
+            if (u < 0.0f || u > 1.0f) continue;
+            const Eigen::Vector3f q = s.cross(tri.e1);
+            const float v = direction.dot(q) * invDet;
+            if (v < 0.0f || u + v > 1.0f) continue;
+            if (tri.e2.dot(q) * invDet > 0.0f) inside = !inside;
+        }
+    }
+    return inside;
+}
+
+std::vector<const MeshBvh *> MeshBvhCache::update(const std::vector<Frame::Ptr> &frames) {
+    std::vector<Mesh::Ptr> missing;
+    std::unordered_map<const Mesh *, std::shared_ptr<const MeshBvh>> used;
+    for (const auto &frame : frames) {
+        const Mesh::Ptr &mesh = frame->mesh();
+        if (!mesh || mesh->triangleCount() == 0 || used.count(mesh.get())) continue;
+        auto it = bvhs_.find(mesh.get());
+        if (it == bvhs_.end()) {
+            used.emplace(mesh.get(), nullptr);
+            missing.push_back(mesh);
+        } else {
+            used.emplace(mesh.get(), it->second);
+        }
+    }
+    // One huge mesh still builds on a single thread.
+    std::vector<std::shared_ptr<const MeshBvh>> built(missing.size());
+    ThreadPool &pool = ThreadPool::shared();
+    pool.parallelFor(missing.size(), pool.size() + 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            built[i] = std::make_shared<const MeshBvh>(missing[i]);
+        }
+    });
+    for (std::size_t i = 0; i < missing.size(); ++i) {
+        used[missing[i].get()] = std::move(built[i]);
+    }
+    // Dropping the BVHs of meshes no longer in use also releases the meshes they hold on to.
+    bvhs_ = std::move(used);
+
+    std::vector<const MeshBvh *> result(frames.size(), nullptr);
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        auto it = bvhs_.find(frames[i]->mesh().get());
+        if (it != bvhs_.end()) result[i] = it->second.get();
+    }
+    return result;
+}
+
+} // namespace toph
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "bvh.h"
+#include "frame.h"
+#include "mesh.h"
+#include <Eigen/Core>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace toph {
+
+// Triangle BVH of one mesh in its local space, for the ray and collision queries. triangles follow bvh.primitives(),
+// so a leaf's range indexes them directly and bvh.primitives() maps back to the mesh's triangle numbers.
+struct MeshBvh {
+    // One vertex and the edges to the other two, the form the intersection tests want.
+    struct Triangle {
+        Eigen::Vector3f v0, e1, e2;
+    };
+
+    Mesh::Ptr mesh;
+    Bvh bvh;
+    std::vector<Triangle> triangles;
+    // Every edge is shared by exactly two triangles. Edges are compared by their end positions, so unwelded copies of
+    // a vertex, as flat-shaded meshes have them, still close the surface.
+    bool closed = false;
+
+    explicit MeshBvh(Mesh::Ptr mesh);
+
+    // Whether a point in the mesh's local space is inside it, by the parity of the triangles a ray from the point
+    // crosses. Always false for open meshes, which have no inside.
+    bool contains(const Eigen::Vector3f &point) const;
+};
+
+// The triangle BVHs of the meshes used by a set of frames, each built once no matter how many frames share the mesh.
+class MeshBvhCache {
+  public:
+    // Returns the BVH of every frame's mesh, nullptr for frames without triangles. Missing BVHs are built side by side
+    // on the shared thread pool; those of meshes no frame uses anymore are dropped.
+    std::vector<const MeshBvh *> update(const std::vector<Frame::Ptr> &frames);
+
+  private:
+    std::unordered_map<const Mesh *, std::shared_ptr<const MeshBvh>> bvhs_;
+};
+
+} // namespace toph
@@ -0,0 +1,169 @@
+#include "mesh_cache.h"
+#include "atomic_file.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+namespace toph {
+
+std::size_t meshBlobSize(const Mesh &mesh) {
+    return sizeof(MeshBlobHeader) + mesh.vertexCount() * sizeof(Mesh::Vertex) +
+           mesh.indexCount() * sizeof(std::uint32_t);
+}
+
+bool writeMeshBlob(std::FILE *out, const Mesh &mesh) {
+    MeshBlobHeader header{};
+    std::memcpy(header.magic, MeshBlobHeader::kMagic, sizeof(header.magic));
+    header.version = MeshBlobHeader::kVersion;
+    header.vertexSize = sizeof(Mesh::Vertex);
+    header.vertexCount = mesh.vertexCount();
+    header.indexCount = mesh.indexCount();
+    for (int k = 0; k < 3; ++k) {
+        header.boundsMin[k] = mesh.bounds().min[k];
+        header.boundsMax[k] = mesh.bounds().max[k];
+    }
+    return std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+           std::fwrite(mesh.vertices(), sizeof(Mesh::Vertex), mesh.vertexCount(), out) == mesh.vertexCount() &&
+           std::fwrite(mesh.indices(), sizeof(std::uint32_t), mesh.indexCount(), out) == mesh.indexCount();
+}
+
+Mesh::Ptr meshFromBlob(std::shared_ptr<const void> storage, const std::uint8_t *data, std::size_t size) {
+    MeshBlobHeader header;
+    if (size < sizeof(header)) return nullptr;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, MeshBlobHeader::kMagic, sizeof(header.magic)) != 0 ||
+        header.version != MeshBlobHeader::kVersion || header.vertexSize != sizeof(Mesh::Vertex)) {
+        return nullptr;
+    }
+    // Checked piecewise so that absurd counts can't overflow the sum.
+    const std::size_t available = size - sizeof(header);
+    if (header.vertexCount > available / sizeof(Mesh::Vertex)) return nullptr;
+    const std::size_t vertexBytes = header.vertexCount * sizeof(Mesh::Vertex);
+    if (header.indexCount != (available - vertexBytes) / sizeof(std::uint32_t) ||
+        (available - vertexBytes) % sizeof(std::uint32_t) != 0) {
+        return nullptr;
+    }
+    const Aabb bounds(Eigen::Vector3f(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]),
+                      Eigen::Vector3f(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]));
+    // Both ranges are 4-byte aligned as long as the blob is, which covers every member of Mesh::Vertex.
+    const auto *vertices = reinterpret_cast<const Mesh::Vertex *>(data + sizeof(header));
+    const auto *indices = reinterpret_cast<const std::uint32_t *>(data + sizeof(header) + vertexBytes);
+    // The one part read up front, since a damaged or hostile file could otherwise point past the vertices.
+    if (!indicesInRange(indices, header.indexCount, header.vertexCount)) return nullptr;
+    return std::make_shared<const Mesh>(std::move(storage), vertices, static_cast<std::size_t>(header.vertexCount),
+                                        indices, static_cast<std::size_t>(header.indexCount), bounds);
+}
+
+namespace {
+
+// Bumped whenever the importer would produce different meshes from the same file, which retires old entries.
+constexpr std::uint64_t kImporterVersion = 1;
+
+constexpr std::uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+constexpr std::uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr std::uint64_t kPrime3 = 0x165667B19E3779F9ull;
+
+std::uint64_t rotl(std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+std::uint64_t accumulate(std::uint64_t acc, std::uint64_t input) {
+    return rotl(acc + input * kPrime2, 31) * kPrime1;
+}
+
+std::uint64_t avalanche(std::uint64_t h) {
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    return h ^ (h >> 32);
+}
+
+// xxHash64-style: four independent lanes over 32-byte stripes, which keeps the multipliers busy.
+std::uint64_t hashBytes(const std::uint8_t *p, std::size_t n, std::uint64_t seed) {
+    std::uint64_t lanes[4] = {seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1};
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        for (int k = 0; k < 4; ++k) {
+            std::uint64_t word;
+            std::memcpy(&word, p + i + 8 * k, 8);
+            lanes[k] = accumulate(lanes[k], word);
+        }
+    }
+    std::uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18) + n;
+    for (; i + 8 <= n; i += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, p + i, 8);
+        h = rotl(h ^ accumulate(0, word), 27) * kPrime1 + kPrime3;
+    }
+    for (; i < n; ++i) {
+        h = rotl(h ^ (p[i] * kPrime3), 11) * kPrime1;
+    }
+    return avalanche(h);
+}
+
+} // namespace
+
+MeshCache::MeshCache(std::string directory) : directory_(std::move(directory)) {
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    if (error) throw std::runtime_error("MeshCache: cannot create " + directory_ + ": " + error.message());
+}
+
+std::string MeshCache::key(const MappedFile &source, const std::string &format,
+                           const MeshImportOptions &options) const {
+    // Fixed-size blocks hashed in parallel and then hashed together in order, so the key doesn't depend on the
+    // number of threads.
+    constexpr std::size_t kBlock = std::size_t(4) << 20;
+    const std::size_t blocks = (source.size() + kBlock - 1) / kBlock;
+    std::vector<std::uint64_t> words(blocks);
+    ThreadPool &pool = ThreadPool::shared();
+    const std::size_t threads = options.threadCount > 0 ? options.threadCount : pool.size() + 1;
+    pool.parallelFor(blocks, threads, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t b = begin; b < end; ++b) {
+            const std::size_t offset = b * kBlock;
+            words[b] = hashBytes(source.data() + offset, std::min(kBlock, source.size() - offset), b);
+        }
+    });
+
+    words.push_back(kImporterVersion);
+    words.push_back(source.size());
+    for (const char c : format) {
+        words.push_back(static_cast<unsigned char>(c));
+    }
+    words.push_back(options.weld);
+    for (const float value : {options.weldEpsilon, options.scale, options.color.x(), options.color.y(),
+                              options.color.z()}) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        words.push_back(bits);
+    }
+    const auto *bytes = reinterpret_cast<const std::uint8_t *>(words.data());
+    const std::size_t size = words.size() * sizeof(std::uint64_t);
+    char hex[33];
+    std::snprintf(hex, sizeof(hex), "%016llx%016llx", static_cast<unsigned long long>(hashBytes(bytes, size, 0)),
+                  static_cast<unsigned long long>(hashBytes(bytes, size, kPrime3)));
+    return hex;
+}
+
+Mesh::Ptr MeshCache::find(const std::string &key) const {
+    const std::string path = directory_ + "/" + key + ".mesh";
+    if (!std::filesystem::exists(path)) return nullptr;
+    try {
+        auto file = std::make_shared<const MappedFile>(path);
+        return meshFromBlob(file, file->data(), file->size());
+    } catch (const std::runtime_error &) {
+        return nullptr;
+    }
+}
+
+bool MeshCache::store(const std::string &key, const Mesh &mesh) const {
+    AtomicFile file(directory_ + "/" + key + ".mesh");
+    return file.isOpen() && writeMeshBlob(file.stream(), mesh) && file.commit();
+}
+
+} // namespace toph
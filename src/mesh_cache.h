@@ -0,0 +1,63 @@
+#pragma once
+
+#include "mesh.h"
+#include "mesh_import.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+namespace toph {
+
+class MappedFile;
+
+// A mesh serialized for mapping: this header, then the vertices in the Mesh::Vertex layout, then the indices. A mapped
+// blob backs a Mesh without copies, and its vertex and index ranges can go to glBufferData as they are.
+struct MeshBlobHeader {
+    static constexpr char kMagic[8] = {'T', 'O', 'P', 'H', 'M', 'S', 'H', '\0'};
+    static constexpr std::uint32_t kVersion = 1;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t vertexSize;
+    std::uint64_t vertexCount;
+    std::uint64_t indexCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    std::uint8_t reserved[8];
+};
+static_assert(sizeof(MeshBlobHeader) == 64, "the vertices start 64 bytes into a blob");
+
+std::size_t meshBlobSize(const Mesh &mesh);
+// Streams the blob to `out`; false on a write error.
+bool writeMeshBlob(std::FILE *out, const Mesh &mesh);
+// A mesh viewing the blob at `data`, which `storage` keeps alive; nullptr if the bytes don't hold a blob of this
+// version and vertex layout, or if an index points past the vertices. Checking the indices reads them in, in
+// parallel; the vertices are left to be paged in on first use.
+Mesh::Ptr meshFromBlob(std::shared_ptr<const void> storage, const std::uint8_t *data, std::size_t size);
+
+// A directory of imported meshes, each stored as a blob named after a hash of the source file's contents, its format
+// and the import options that shape the result. A hit maps the blob instead of parsing, welding and computing normals.
+// Entries are never modified once written, so several processes can share a directory.
+class MeshCache {
+  public:
+    // Creates the directory if needed; throws std::runtime_error if that fails.
+    explicit MeshCache(std::string directory);
+
+    const std::string &directory() const noexcept { return directory_; }
+
+    // Hashes the whole file, split into blocks on up to options.threadCount threads of the shared pool.
+    std::string key(const MappedFile &source, const std::string &format, const MeshImportOptions &options) const;
+
+    // nullptr if there is no readable entry.
+    Mesh::Ptr find(const std::string &key) const;
+    // Writes a temporary file and renames it into place, so readers never see half an entry. Returns false if it
+    // couldn't be written; the cache only ever speeds things up, so callers may carry on.
+    bool store(const std::string &key, const Mesh &mesh) const;
+
+  private:
+    std::string directory_;
+};
+
+} // namespace toph
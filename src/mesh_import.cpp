@@ -0,0 +1,939 @@
+#include "mesh_import.h"
+#include "mapped_file.h"
+#include "mesh_cache.h"
+#include "thread_pool.h"
+
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace toph {
+
+double MeshImportStats::megabytesPerSecond() const noexcept {
+    return seconds > 0.0 ? static_cast<double>(bytes) / seconds / 1e6 : 0.0;
+}
+
+namespace {
+
+// Vertices and triangles as read from a file, before scaling and welding. Normals are zero unless the file has them.
+struct RawMesh {
+    std::vector<Mesh::Vertex> vertices;
+    std::vector<std::uint32_t> indices;
+    bool hasNormals = false;
+};
+
+[[noreturn]] void fail(const std::string &path, const std::string &what) {
+    throw std::runtime_error("importMesh: " + path + ": " + what);
+}
+
+// Runs fn(block, begin, end) on `blocks` contiguous ranges of [0, count), each on its own thread if the pool has one.
+// Passes that must agree on which items a block holds use the same count and blocks.
+template <typename F> void forBlocks(std::size_t count, std::size_t blocks, const F &fn) {
+    ThreadPool::shared().parallelFor(blocks, blocks, [&](std::size_t first, std::size_t last) {
+        for (std::size_t b = first; b < last; ++b) {
+            fn(b, count * b / blocks, count * (b + 1) / blocks);
+        }
+    });
+}
+
+Mesh::Vertex makeVertex(const Eigen::Vector3f &position, const Eigen::Vector3f &color) {
+    return {position, color, Eigen::Vector3f::Zero()};
+}
+
+// Moves the pieces into one vector in order, in parallel, and frees them.
+template <typename T> void concatenate(std::vector<std::vector<T>> &pieces, std::vector<T> &out, std::size_t threads) {
+    std::vector<std::size_t> offsets(pieces.size() + 1, 0);
+    for (std::size_t i = 0; i < pieces.size(); ++i) {
+        offsets[i + 1] = offsets[i] + pieces[i].size();
+    }
+    out.resize(offsets.back());
+    ThreadPool::shared().parallelFor(pieces.size(), threads, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            std::copy(pieces[i].begin(), pieces[i].end(), out.begin() + offsets[i]);
+            std::vector<T>().swap(pieces[i]);
+        }
+    });
+}
+
+// --- Text ---
+
+bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+const char *skipBlanks(const char *p, const char *end) {
+    while (p < end && isBlank(*p)) ++p;
+    return p;
+}
+
+const char *skipToken(const char *p, const char *end) {
+    while (p < end && !isBlank(*p) && *p != '\n') ++p;
+    return p;
+}
+
+const char *lineEnd(const char *p, const char *end) {
+    const void *newline = std::memchr(p, '\n', static_cast<std::size_t>(end - p));
+    return newline ? static_cast<const char *>(newline) : end;
+}
+
+const char *nextLine(const char *p, const char *end) {
+    p = lineEnd(p, end);
+    return p < end ? p + 1 : end;
+}
+
+// Parses a number after optional blanks with std::from_chars, which also takes a leading '+' here. Returns false,
+// leaving p alone, if there is none.
+template <typename T> bool parseNumber(const char *&p, const char *end, T &value) {
+    const char *q = skipBlanks(p, end);
+    if (q < end && *q == '+') ++q;
+    const auto result = std::from_chars(q, end, value);
+    if (result.ptr == q) return false;
+    if (result.ec == std::errc::result_out_of_range) {
+        // from_chars leaves the value alone. For floats this is nearly always an underflow like 1e-50.
+        if constexpr (!std::is_floating_point_v<T>) return false;
+        value = T(0);
+    }
+    p = result.ptr;
+    return true;
+}
+
+bool startsWithWord(const char *p, const char *end, const char *word) {
+    const std::size_t n = std::strlen(word);
+    return static_cast<std::size_t>(end - p) >= n && std::memcmp(p, word, n) == 0 &&
+           (static_cast<std::size_t>(end - p) == n || isBlank(p[n]) || p[n] == '\n');
+}
+
+// Splits text into pieces of whole lines: about a megabyte each, but no more than keep every thread busy.
+std::vector<const char *> splitLines(const char *begin, const char *end, std::size_t threads) {
+    const std::size_t size = static_cast<std::size_t>(end - begin);
+    const std::size_t pieces = std::clamp<std::size_t>(size >> 20, 1, 8 * threads);
+    std::vector<const char *> bounds{begin};
+    for (std::size_t i = 1; i < pieces; ++i) {
+        const char *p = nextLine(begin + size * i / pieces, end);
+        if (p > bounds.back() && p < end) bounds.push_back(p);
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+// --- STL ---
+
+RawMesh readBinaryStl(const MappedFile &file, std::size_t triangles, const MeshImportOptions &options,
+                      std::size_t threads) {
+    RawMesh mesh;
+    mesh.vertices.resize(3 * triangles);
+    mesh.indices.resize(3 * triangles);
+    // 80 byte header and a triangle count, then 50 byte records: normal, three corners and an attribute word. The
+    // records are unaligned, hence the memcpy.
+    const std::uint8_t *records = file.data() + 84;
+    forBlocks(triangles, threads, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t t = begin; t < end; ++t) {
+            float corners[9];
+            std::memcpy(corners, records + 50 * t + 12, sizeof(corners));
+            for (std::size_t k = 0; k < 3; ++k) {
+                const Eigen::Vector3f position(corners[3 * k], corners[3 * k + 1], corners[3 * k + 2]);
+                mesh.vertices[3 * t + k] = makeVertex(position, options.color);
+                mesh.indices[3 * t + k] = static_cast<std::uint32_t>(3 * t + k);
+            }
+        }
+    });
+    return mesh;
+}
+
+RawMesh readAsciiStl(const MappedFile &file, const std::string &path, const MeshImportOptions &options,
+                     std::size_t threads) {
+    const auto bounds = splitLines(file.chars(), file.chars() + file.size(), threads);
+    std::vector<std::vector<Mesh::Vertex>> pieces(bounds.size() - 1);
+    ThreadPool::shared().parallelFor(pieces.size(), threads, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            for (const char *p = bounds[i]; p < bounds[i + 1];) {
+                const char *eol = lineEnd(p, bounds[i + 1]);
+                p = skipBlanks(p, eol);
+                if (startsWithWord(p, eol, "vertex")) {
+                    p += 6;
+                    Eigen::Vector3f position;
+                    if (!parseNumber(p, eol, position.x()) || !parseNumber(p, eol, position.y()) ||
+                        !parseNumber(p, eol, position.z())) {
+                        fail(path, "bad vertex");
+                    }
+                    pieces[i].push_back(makeVertex(position, options.color));
+                }
+                p = eol < bounds[i + 1] ? eol + 1 : eol;
+            }
+        }
+    });
+    RawMesh mesh;
+    concatenate(pieces, mesh.vertices, threads);
+    if (mesh.vertices.size() % 3 != 0) fail(path, "facet without three vertices");
+    mesh.indices.resize(mesh.vertices.size());
+    std::iota(mesh.indices.begin(), mesh.indices.end(), 0u);
+    return mesh;
+}
+
+// Binary headers often start with "solid" too, so this also wants the start of the file to be text up to a facet or
+// the end of the solid. The triangle count and the float records of a binary file hold control bytes.
+bool looksLikeAsciiStl(const MappedFile &file) {
+    if (file.size() < 5 || std::memcmp(file.data(), "solid", 5) != 0) return false;
+    const std::size_t checked = std::min<std::size_t>(file.size(), 512);
+    for (std::size_t i = 0; i < checked; ++i) {
+        const unsigned char c = file.data()[i];
+        if ((c < 0x20 && !std::isspace(c)) || c == 0x7f) return false;
+    }
+    const std::string_view start(file.chars(), checked);
+    return start.find("facet") != std::string_view::npos || start.find("endsolid") != std::string_view::npos;
+}
+
+RawMesh readStl(const MappedFile &file, const std::string &path, const MeshImportOptions &options,
+                std::size_t threads) {
+    std::uint32_t triangles = 0;
+    if (file.size() >= 84) std::memcpy(&triangles, file.data() + 80, 4);
+    const std::size_t binarySize = 84 + 50 * static_cast<std::size_t>(triangles);
+    if (file.size() >= 84 && file.size() == binarySize) return readBinaryStl(file, triangles, options, threads);
+    if (looksLikeAsciiStl(file)) return readAsciiStl(file, path, options, threads);
+    // Some exporters pad binary files past the last record.
+    if (file.size() >= 84 && file.size() > binarySize) return readBinaryStl(file, triangles, options, threads);
+    fail(path, "truncated binary STL");
+}
+
+// --- OBJ ---
+
+struct ObjPiece {
+    std::vector<Mesh::Vertex> vertices;
+    std::vector<std::uint32_t> indices;
+    // Entries of `indices` written from negative references, relative to the piece's first vertex until the number
+    // of vertices in earlier pieces is known.
+    std::vector<std::size_t> relative;
+};
+
+void parseObj(const char *p, const char *end, const std::string &path, const MeshImportOptions &options,
+              ObjPiece &piece) {
+    std::vector<std::pair<std::uint32_t, bool>> corners;
+    while (p < end) {
+        const char *eol = lineEnd(p, end);
+        p = skipBlanks(p, eol);
+        if (startsWithWord(p, eol, "v")) {
+            ++p;
+            Eigen::Vector3f position, color;
+            if (!parseNumber(p, eol, position.x()) || !parseNumber(p, eol, position.y()) ||
+                !parseNumber(p, eol, position.z())) {
+                fail(path, "bad vertex");
+            }
+            // Some exporters append a color to the position.
+            const bool colored =
+                parseNumber(p, eol, color.x()) && parseNumber(p, eol, color.y()) && parseNumber(p, eol, color.z());
+            piece.vertices.push_back(makeVertex(position, colored ? color : options.color));
+        } else if (startsWithWord(p, eol, "f")) {
+            ++p;
+            corners.clear();
+            for (p = skipBlanks(p, eol); p < eol; p = skipBlanks(p, eol)) {
+                long long index = 0;
+                if (!parseNumber(p, eol, index) || index == 0 || index > std::numeric_limits<std::uint32_t>::max()) {
+                    fail(path, "bad face");
+                }
+                // Skips the texture and normal references of v/vt/vn.
+                p = skipToken(p, eol);
+                if (index > 0) {
+                    corners.emplace_back(static_cast<std::uint32_t>(index - 1), false);
+                } else {
+                    // Wraps around below the piece's first vertex; adding the base later unwraps it.
+                    corners.emplace_back(static_cast<std::uint32_t>(piece.vertices.size() + index), true);
+                }
+            }
+            for (std::size_t k = 1; k + 1 < corners.size(); ++k) {
+                for (const auto &corner : {corners[0], corners[k], corners[k + 1]}) {
+                    if (corner.second) piece.relative.push_back(piece.indices.size());
+                    piece.indices.push_back(corner.first);
+                }
+            }
+        }
+        p = eol < end ? eol + 1 : eol;
+    }
+}
+
+RawMesh readObj(const MappedFile &file, const std::string &path, const MeshImportOptions &options,
+                std::size_t threads) {
+    const auto bounds = splitLines(file.chars(), file.chars() + file.size(), threads);
+    std::vector<ObjPiece> pieces(bounds.size() - 1);
+    ThreadPool &pool = ThreadPool::shared();
+    pool.parallelFor(pieces.size(), threads, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            parseObj(bounds[i], bounds[i + 1], path, options, pieces[i]);
+        }
+    });
+
+    std::vector<std::vector<Mesh::Vertex>> vertices(pieces.size());
+    std::vector<std::vector<std::uint32_t>> indices(pieces.size());
+    std::size_t base = 0;
+    for (std::size_t i = 0; i < pieces.size(); ++i) {
+        for (const std::size_t k : pieces[i].relative) {
+            pieces[i].indices[k] += static_cast<std::uint32_t>(base);
+        }
+        base += pieces[i].vertices.size();
+        vertices[i] = std::move(pieces[i].vertices);
+        indices[i] = std::move(pieces[i].indices);
+    }
+    RawMesh mesh;
+    concatenate(vertices, mesh.vertices, threads);
+    concatenate(indices, mesh.indices, threads);
+    return mesh;
+}
+
+// --- PLY ---
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+bool plyType(const std::string &name, PlyType &type) {
+    static const std::pair<const char *, PlyType> names[] = {
+        {"char", PlyType::Int8},     {"int8", PlyType::Int8},       {"uchar", PlyType::UInt8},
+        {"uint8", PlyType::UInt8},   {"short", PlyType::Int16},     {"int16", PlyType::Int16},
+        {"ushort", PlyType::UInt16}, {"uint16", PlyType::UInt16},   {"int", PlyType::Int32},
+        {"int32", PlyType::Int32},   {"uint", PlyType::UInt32},     {"uint32", PlyType::UInt32},
+        {"float", PlyType::Float32}, {"float32", PlyType::Float32}, {"double", PlyType::Float64},
+        {"float64", PlyType::Float64}};
+    for (const auto &entry : names) {
+        if (name == entry.first) {
+            type = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t plySize(PlyType type) {
+    switch (type) {
+    case PlyType::Int8:
+    case PlyType::UInt8: return 1;
+    case PlyType::Int16:
+    case PlyType::UInt16: return 2;
+    case PlyType::Int32:
+    case PlyType::UInt32:
+    case PlyType::Float32: return 4;
+    case PlyType::Float64: return 8;
+    }
+    return 0;
+}
+
+template <typename T> T load(const std::uint8_t *bytes) {
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+double plyValue(const std::uint8_t *p, PlyType type, bool swap) {
+    std::uint8_t bytes[8];
+    const std::size_t size = plySize(type);
+    std::memcpy(bytes, p, size);
+    if (swap) std::reverse(bytes, bytes + size);
+    switch (type) {
+    case PlyType::Int8: return load<std::int8_t>(bytes);
+    case PlyType::UInt8: return load<std::uint8_t>(bytes);
+    case PlyType::Int16: return load<std::int16_t>(bytes);
+    case PlyType::UInt16: return load<std::uint16_t>(bytes);
+    case PlyType::Int32: return load<std::int32_t>(bytes);
+    case PlyType::UInt32: return load<std::uint32_t>(bytes);
+    case PlyType::Float32: return load<float>(bytes);
+    case PlyType::Float64: return load<double>(bytes);
+    }
+    return 0.0;
+}
+
+// Negative indices become out of range ones, which importMesh() rejects.
+std::uint32_t plyIndex(double value) {
+    constexpr std::uint32_t invalid = std::numeric_limits<std::uint32_t>::max();
+    return value >= 0.0 && value < invalid ? static_cast<std::uint32_t>(value) : invalid;
+}
+
+struct PlyProperty {
+    std::string name;
+    PlyType type = PlyType::Float32;
+    bool list = false;
+    PlyType countType = PlyType::UInt8;
+};
+
+struct PlyElement {
+    std::string name;
+    std::size_t count = 0;
+    std::vector<PlyProperty> properties;
+
+    int find(const std::string &property) const {
+        for (std::size_t i = 0; i < properties.size(); ++i) {
+            if (properties[i].name == property) return static_cast<int>(i);
+        }
+        return -1;
+    }
+    bool hasLists() const {
+        return std::any_of(properties.begin(), properties.end(), [](const PlyProperty &p) { return p.list; });
+    }
+};
+
+struct PlyHeader {
+    enum class Format { Ascii, BinaryLittleEndian, BinaryBigEndian } format = Format::Ascii;
+    std::vector<PlyElement> elements;
+    std::size_t bodyOffset = 0;
+};
+
+PlyHeader readPlyHeader(const MappedFile &file, const std::string &path) {
+    const char *begin = file.chars();
+    const char *end = begin + file.size();
+    if (file.size() < 4 || std::memcmp(begin, "ply", 3) != 0) fail(path, "not a PLY file");
+    PlyHeader header;
+    bool hasFormat = false;
+    for (const char *p = nextLine(begin, end); p < end;) {
+        const char *eol = lineEnd(p, end);
+        std::istringstream line(std::string(p, eol));
+        p = eol < end ? eol + 1 : eol;
+        std::string keyword;
+        line >> keyword;
+        if (keyword == "format") {
+            std::string format;
+            line >> format;
+            if (format == "ascii") header.format = PlyHeader::Format::Ascii;
+            else if (format == "binary_little_endian") header.format = PlyHeader::Format::BinaryLittleEndian;
+            else if (format == "binary_big_endian") header.format = PlyHeader::Format::BinaryBigEndian;
+            else fail(path, "unknown PLY format " + format);
+            hasFormat = true;
+        } else if (keyword == "element") {
+            PlyElement element;
+            if (!(line >> element.name >> element.count)) fail(path, "bad PLY element");
+            header.elements.push_back(std::move(element));
+        } else if (keyword == "property") {
+            if (header.elements.empty()) fail(path, "PLY property outside an element");
+            PlyProperty property;
+            std::string type;
+            line >> type;
+            if (type == "list") {
+                std::string countType;
+                line >> countType >> type;
+                property.list = true;
+                if (!plyType(countType, property.countType)) fail(path, "unknown PLY type " + countType);
+            }
+            if (!plyType(type, property.type)) fail(path, "unknown PLY type " + type);
+            line >> property.name;
+            header.elements.back().properties.push_back(std::move(property));
+        } else if (keyword == "end_header") {
+            if (!hasFormat) fail(path, "PLY header without a format");
+            header.bodyOffset = static_cast<std::size_t>(p - begin);
+            return header;
+        }
+    }
+    fail(path, "PLY header without end_header");
+}
+
+// Where the properties the mesh uses sit in the vertex element: x, y, z, nx, ny, nz, red, green, blue; -1 if missing.
+struct PlyVertexLayout {
+    std::array<int, 9> property{};
+    bool hasNormals = false;
+    bool hasColors = false;
+    std::array<float, 3> colorScale{};
+
+    PlyVertexLayout(const PlyElement &element, const std::string &path) {
+        static const char *names[] = {"x", "y", "z", "nx", "ny", "nz", "red", "green", "blue"};
+        for (std::size_t i = 0; i < 9; ++i) {
+            property[i] = element.find(names[i]);
+            if (property[i] >= 0 && element.properties[property[i]].list) {
+                fail(path, std::string("PLY list property ") + names[i]);
+            }
+        }
+        if (property[0] < 0 || property[1] < 0 || property[2] < 0) fail(path, "PLY vertex without x, y and z");
+        hasNormals = property[3] >= 0 && property[4] >= 0 && property[5] >= 0;
+        hasColors = property[6] >= 0 && property[7] >= 0 && property[8] >= 0;
+        // Integer colors span their type's range.
+        for (std::size_t k = 0; k < 3 && hasColors; ++k) {
+            const PlyType type = element.properties[property[6 + k]].type;
+            colorScale[k] = type == PlyType::UInt8 ? 1.0f / 255.0f : type == PlyType::UInt16 ? 1.0f / 65535.0f : 1.0f;
+        }
+    }
+
+    // From the values of all the element's properties, in order.
+    Mesh::Vertex vertex(const double *values, const MeshImportOptions &options) const {
+        Mesh::Vertex v = makeVertex(Eigen::Vector3f(values[property[0]], values[property[1]], values[property[2]]),
+                                    options.color);
+        if (hasNormals) v.normal = Eigen::Vector3f(values[property[3]], values[property[4]], values[property[5]]);
+        if (hasColors) {
+            for (std::size_t k = 0; k < 3; ++k) {
+                v.color[k] = static_cast<float>(values[property[6 + k]]) * colorScale[k];
+            }
+        }
+        return v;
+    }
+};
+
+void appendFan(const std::vector<std::uint32_t> &corners, std::vector<std::uint32_t> &indices) {
+    for (std::size_t k = 1; k + 1 < corners.size(); ++k) {
+        indices.insert(indices.end(), {corners[0], corners[k], corners[k + 1]});
+    }
+}
+
+int plyFaceList(const PlyElement &face) {
+    int list = face.find("vertex_indices");
+    if (list < 0) list = face.find("vertex_index");
+    return list >= 0 && face.properties[list].list ? list : -1;
+}
+
+RawMesh readAsciiPly(const MappedFile &file, const PlyHeader &header, const std::string &path,
+                     const MeshImportOptions &options, std::size_t threads) {
+    const char *body = file.chars() + header.bodyOffset;
+    const auto bounds = splitLines(body, file.chars() + file.size(), threads);
+    const std::size_t pieceCount = bounds.size() - 1;
+    ThreadPool &pool = ThreadPool::shared();
+
+    // Elements come one after another, one line per item, so numbering the lines tells each piece which element its
+    // lines belong to.
+    std::vector<std::size_t> firstLine(pieceCount + 1, 0);
+    pool.parallelFor(pieceCount, threads, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            firstLine[i + 1] = static_cast<std::size_t>(std::count(bounds[i], bounds[i + 1], '\n'));
+        }
+    });
+    std::partial_sum(firstLine.begin(), firstLine.end(), firstLine.begin());
+    std::vector<std::size_t> elementLine(header.elements.size() + 1, 0);
+    for (std::size_t e = 0; e < header.elements.size(); ++e) {
+        elementLine[e + 1] = elementLine[e] + header.elements[e].count;
+    }
+    const bool unterminated = bounds.back() > bounds.front() && bounds.back()[-1] != '\n';
+    if (firstLine.back() + unterminated < elementLine.back()) fail(path, "truncated PLY");
+
+    RawMesh mesh;
+    std::size_t vertexElement = header.elements.size(), faceElement = header.elements.size();
+    for (std::size_t e = 0; e < header.elements.size(); ++e) {
+        if (header.elements[e].name == "vertex") vertexElement = e;
+        if (header.elements[e].name == "face") faceElement = e;
+    }
+    if (vertexElement == header.elements.size()) fail(path, "PLY without vertices");
+    const PlyVertexLayout layout(header.elements[vertexElement], path);
+    mesh.hasNormals = layout.hasNormals;
+    mesh.vertices.resize(header.elements[vertexElement].count);
+    const int faceList = faceElement < header.elements.size() ? plyFaceList(header.elements[faceElement]) : -1;
+
+    std::vector<std::vector<std::uint32_t>> faces(pieceCount);
+    pool.parallelFor(pieceCount, threads, [&](std::size_t begin, std::size_t end) {
+        std::vector<double> values;
+        std::vector<std::uint32_t> corners;
+        for (std::size_t i = begin; i < end; ++i) {
+            std::size_t line = firstLine[i];
+            std::size_t e = 0;
+            for (const char *p = bounds[i]; p < bounds[i + 1]; ++line) {
+                const char *eol = lineEnd(p, bounds[i + 1]);
+                while (e < header.elements.size() && line >= elementLine[e + 1]) ++e;
+                if (e == header.elements.size()) break;
+                if (e == vertexElement) {
+                    values.clear();
+                    for (std::size_t k = 0; k < header.elements[e].properties.size(); ++k) {
+                        double value = 0.0;
+                        if (!parseNumber(p, eol, value)) fail(path, "bad PLY vertex");
+                        values.push_back(value);
+                    }
+                    mesh.vertices[line - elementLine[e]] = layout.vertex(values.data(), options);
+                } else if (e == faceElement) {
+                    const auto &properties = header.elements[e].properties;
+                    for (std::size_t k = 0; k < properties.size(); ++k) {
+                        std::size_t count = 1;
+                        if (properties[k].list && !parseNumber(p, eol, count)) fail(path, "bad PLY face");
+                        corners.clear();
+                        for (std::size_t c = 0; c < count; ++c) {
+                            double value = 0.0;
+                            if (!parseNumber(p, eol, value)) fail(path, "bad PLY face");
+                            if (static_cast<int>(k) == faceList) {
+                                if (value < 0.0 || value > std::numeric_limits<std::uint32_t>::max()) {
+                                    fail(path, "bad PLY face");
+                                }
+                                corners.push_back(static_cast<std::uint32_t>(value));
+                            }
+                        }
+                        if (static_cast<int>(k) == faceList) appendFan(corners, faces[i]);
+                    }
+                }
+                p = eol < bounds[i + 1] ? eol + 1 : eol;
+            }
+        }
+    });
+    concatenate(faces, mesh.indices, threads);
+    return mesh;
+}
+
+// Reads the faces of a binary face element one by one from `offset`, appending their fans to `indices` unless it is
+// null. Returns the offset past the element.
+std::size_t walkBinaryPlyElement(const MappedFile &file, std::size_t offset, const PlyElement &element, int list,
+                                 bool swap, std::vector<std::uint32_t> *indices, const std::string &path) {
+    std::vector<std::uint32_t> corners;
+    for (std::size_t f = 0; f < element.count; ++f) {
+        for (std::size_t k = 0; k < element.properties.size(); ++k) {
+            const PlyProperty &property = element.properties[k];
+            std::size_t count = 1;
+            if (property.list) {
+                if (offset + plySize(property.countType) > file.size()) fail(path, "truncated PLY");
+                count = static_cast<std::size_t>(plyValue(file.data() + offset, property.countType, swap));
+                offset += plySize(property.countType);
+            }
+            const std::size_t size = plySize(property.type);
+            if (offset + count * size > file.size()) fail(path, "truncated PLY");
+            if (indices && static_cast<int>(k) == list) {
+                corners.resize(count);
+                for (std::size_t c = 0; c < count; ++c) {
+                    corners[c] = plyIndex(plyValue(file.data() + offset + c * size, property.type, swap));
+                }
+                appendFan(corners, *indices);
+            }
+            offset += count * size;
+        }
+    }
+    return offset;
+}
+
+// Reads a face element in parallel assuming every face is a triangle, which makes its items equally long, and moves
+// `offset` past it. Returns false, with `indices` in an unspecified state, if one isn't.
+bool readBinaryPlyTriangles(const MappedFile &file, std::size_t &offset, const PlyElement &element, int list, bool swap,
+                            std::vector<std::uint32_t> &indices, std::size_t threads) {
+    std::size_t stride = 0, listOffset = 0;
+    for (std::size_t k = 0; k < element.properties.size(); ++k) {
+        const PlyProperty &property = element.properties[k];
+        if (static_cast<int>(k) == list) listOffset = stride;
+        stride += property.list ? plySize(property.countType) + 3 * plySize(property.type) : plySize(property.type);
+    }
+    if (element.count == 0) return true;
+    if (offset + stride * element.count > file.size()) return false;
+    const PlyProperty &property = element.properties[list];
+    const std::size_t countSize = plySize(property.countType), indexSize = plySize(property.type);
+    // Other list properties, like texture coordinates per corner, would need their own length check.
+    for (std::size_t k = 0; k < element.properties.size(); ++k) {
+        if (element.properties[k].list && static_cast<int>(k) != list) return false;
+    }
+    if (plyValue(file.data() + offset + listOffset, property.countType, swap) != 3.0) return false;
+
+    indices.resize(3 * element.count);
+    std::atomic<bool> triangles{true};
+    forBlocks(element.count, threads, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t f = begin; f < end && triangles.load(std::memory_order_relaxed); ++f) {
+            const std::uint8_t *p = file.data() + offset + f * stride + listOffset;
+            if (plyValue(p, property.countType, swap) != 3.0) {
+                triangles = false;
+                return;
+            }
+            for (std::size_t c = 0; c < 3; ++c) {
+                indices[3 * f + c] = plyIndex(plyValue(p + countSize + c * indexSize, property.type, swap));
+            }
+        }
+    });
+    if (!triangles) return false;
+    offset += stride * element.count;
+    return true;
+}
+
+RawMesh readBinaryPly(const MappedFile &file, const PlyHeader &header, const std::string &path,
+                      const MeshImportOptions &options, std::size_t threads) {
+    const bool swap = header.format == PlyHeader::Format::BinaryBigEndian;
+    RawMesh mesh;
+    bool hasVertices = false;
+    std::size_t offset = header.bodyOffset;
+    for (const PlyElement &element : header.elements) {
+        if (!element.hasLists()) {
+            std::vector<std::size_t> propertyOffset;
+            std::size_t stride = 0;
+            for (const auto &property : element.properties) {
+                propertyOffset.push_back(stride);
+                stride += plySize(property.type);
+            }
+            if (offset + stride * element.count > file.size()) fail(path, "truncated PLY");
+            if (element.name == "vertex") {
+                const PlyVertexLayout layout(element, path);
+                mesh.hasNormals = layout.hasNormals;
+                mesh.vertices.resize(element.count);
+                hasVertices = true;
+                forBlocks(element.count, threads, [&](std::size_t, std::size_t begin, std::size_t end) {
+                    std::vector<double> values(element.properties.size());
+                    for (std::size_t v = begin; v < end; ++v) {
+                        const std::uint8_t *p = file.data() + offset + v * stride;
+                        for (std::size_t k = 0; k < values.size(); ++k) {
+                            values[k] = plyValue(p + propertyOffset[k], element.properties[k].type, swap);
+                        }
+                        mesh.vertices[v] = layout.vertex(values.data(), options);
+                    }
+                });
+            }
+            offset += stride * element.count;
+        } else if (element.name == "face" && plyFaceList(element) >= 0) {
+            const int list = plyFaceList(element);
+            if (!readBinaryPlyTriangles(file, offset, element, list, swap, mesh.indices, threads)) {
+                mesh.indices.clear();
+                offset = walkBinaryPlyElement(file, offset, element, list, swap, &mesh.indices, path);
+            }
+        } else {
+            offset = walkBinaryPlyElement(file, offset, element, -1, swap, nullptr, path);
+        }
+    }
+    if (!hasVertices) fail(path, "PLY without vertices");
+    return mesh;
+}
+
+RawMesh readPly(const MappedFile &file, const std::string &path, const MeshImportOptions &options,
+                std::size_t threads) {
+    const PlyHeader header = readPlyHeader(file, path);
+    if (header.format == PlyHeader::Format::Ascii) return readAsciiPly(file, header, path, options, threads);
+    return readBinaryPly(file, header, path, options, threads);
+}
+
+// --- Welding ---
+
+// What decides whether two vertices weld: the bits of their attributes, with -0 folded into 0 and the position
+// snapped to the grid when welding with an epsilon.
+using WeldKey = std::array<std::uint32_t, 9>;
+
+WeldKey weldKey(const Mesh::Vertex &v, float inverseEpsilon) {
+    std::array<float, 9> values;
+    for (int k = 0; k < 3; ++k) {
+        values[k] = inverseEpsilon > 0.0f ? std::floor(v.position[k] * inverseEpsilon + 0.5f) : v.position[k];
+        values[3 + k] = v.color[k];
+        values[6 + k] = v.normal[k];
+    }
+    WeldKey key;
+    for (std::size_t k = 0; k < 9; ++k) {
+        const float value = values[k] + 0.0f;
+        std::memcpy(&key[k], &value, sizeof(float));
+    }
+    return key;
+}
+
+std::uint64_t hash(const WeldKey &key) {
+    std::uint64_t h = 0x9e3779b97f4a7c15ull;
+    for (const std::uint32_t word : key) {
+        h = (h ^ word) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    return h ^ (h >> 33);
+}
+
+// Merges vertices with equal weld keys into the first of them and rewrites the indices; survivors keep their order.
+// Vertices are split into partitions by hash, and each partition is deduplicated with its own open addressing table,
+// so the threads never share one. par_shapes_weld does the same job with 16-bit indices and a grid sized for unit
+// shapes, neither of which suits multi-million vertex CAD models.
+void weld(RawMesh &mesh, float epsilon, std::size_t threads) {
+    const std::size_t n = mesh.vertices.size();
+    if (n == 0) return;
+    const auto &vertices = mesh.vertices;
+    const float inverseEpsilon = epsilon > 0.0f ? 1.0f / epsilon : 0.0f;
+    std::vector<std::uint64_t> hashes(n);
+    forBlocks(n, threads, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            hashes[i] = hash(weldKey(vertices[i], inverseEpsilon));
+        }
+    });
+
+    // A stable counting sort by partition, on the high hash bits; the tables index with the low ones.
+    const int bits = threads > 1 ? 6 : 0;
+    const std::size_t partitions = std::size_t(1) << bits;
+    const auto partition = [&](std::uint64_t h) { return bits ? static_cast<std::size_t>(h >> (64 - bits)) : 0; };
+    std::vector<std::size_t> cursor(threads * partitions, 0);
+    forBlocks(n, threads, [&](std::size_t b, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            ++cursor[b * partitions + partition(hashes[i])];
+        }
+    });
+    std::vector<std::size_t> partitionBegin(partitions + 1, 0);
+    std::size_t position = 0;
+    for (std::size_t p = 0; p < partitions; ++p) {
+        partitionBegin[p] = position;
+        for (std::size_t b = 0; b < threads; ++b) {
+            const std::size_t count = cursor[b * partitions + p];
+            cursor[b * partitions + p] = position;
+            position += count;
+        }
+    }
+    partitionBegin[partitions] = n;
+    std::vector<std::uint32_t> order(n);
+    forBlocks(n, threads, [&](std::size_t b, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            order[cursor[b * partitions + partition(hashes[i])]++] = static_cast<std::uint32_t>(i);
+        }
+    });
+
+    constexpr std::uint32_t empty = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> survivor(n);
+    ThreadPool::shared().parallelFor(partitions, threads, [&](std::size_t begin, std::size_t end) {
+        std::vector<std::uint32_t> table;
+        for (std::size_t p = begin; p < end; ++p) {
+            std::size_t capacity = 16;
+            while (capacity < 2 * (partitionBegin[p + 1] - partitionBegin[p])) capacity *= 2;
+            table.assign(capacity, empty);
+            for (std::size_t k = partitionBegin[p]; k < partitionBegin[p + 1]; ++k) {
+                const std::uint32_t i = order[k];
+                for (std::size_t slot = hashes[i] & (capacity - 1);; slot = (slot + 1) & (capacity - 1)) {
+                    const std::uint32_t j = table[slot];
+                    if (j == empty) {
+                        table[slot] = survivor[i] = i;
+                        break;
+                    }
+                    if (hashes[j] == hashes[i] &&
+                        weldKey(vertices[j], inverseEpsilon) == weldKey(vertices[i], inverseEpsilon)) {
+                        survivor[i] = j;
+                        break;
+                    }
+                }
+            }
+        }
+    });
+    std::vector<std::uint64_t>().swap(hashes);
+    std::vector<std::uint32_t>().swap(order);
+
+    std::vector<std::size_t> kept(threads + 1, 0);
+    forBlocks(n, threads, [&](std::size_t b, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            kept[b + 1] += survivor[i] == i;
+        }
+    });
+    std::partial_sum(kept.begin(), kept.end(), kept.begin());
+    std::vector<Mesh::Vertex> welded(kept.back());
+    std::vector<std::uint32_t> newIndex(n);
+    forBlocks(n, threads, [&](std::size_t b, std::size_t begin, std::size_t end) {
+        std::size_t next = kept[b];
+        for (std::size_t i = begin; i < end; ++i) {
+            if (survivor[i] != i) continue;
+            newIndex[i] = static_cast<std::uint32_t>(next);
+            welded[next++] = vertices[i];
+        }
+    });
+    // Survivors come before the vertices merged into them, possibly in an earlier block, hence the separate pass.
+    forBlocks(n, threads, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            if (survivor[i] != i) newIndex[i] = newIndex[survivor[i]];
+        }
+    });
+    forBlocks(mesh.indices.size(), threads, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t k = begin; k < end; ++k) {
+            mesh.indices[k] = newIndex[mesh.indices[k]];
+        }
+    });
+    mesh.vertices = std::move(welded);
+}
+
+} // namespace
+
+Mesh::Ptr importMesh(const std::string &path, const MeshImportOptions &options, MeshImportStats *stats) {
+    const auto start = std::chrono::steady_clock::now();
+    ThreadPool &pool = ThreadPool::shared();
+    const std::size_t threads = options.threadCount > 0 ? options.threadCount : pool.size() + 1;
+
+    std::string extension = path.substr(std::min(path.size(), path.rfind('.')));
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (extension != ".stl" && extension != ".obj" && extension != ".ply") fail(path, "unknown mesh format");
+
+    MappedFile file(path);
+    file.prefetch();
+    const auto report = [&](const Mesh::Ptr &mesh, bool cached) {
+        if (!stats) return;
+        stats->bytes = file.size();
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats->vertices = mesh->vertexCount();
+        stats->triangles = mesh->triangleCount();
+        stats->cached = cached;
+    };
+    std::unique_ptr<MeshCache> cache;
+    std::string key;
+    if (!options.cacheDirectory.empty()) {
+        // A directory that can't be created only costs the speed-up, like any other cache failure.
+        try {
+            cache = std::make_unique<MeshCache>(options.cacheDirectory);
+        } catch (const std::runtime_error &) {
+        }
+    }
+    if (cache) {
+        key = cache->key(file, extension, options);
+        if (Mesh::Ptr mesh = cache->find(key)) {
+            report(mesh, true);
+            return mesh;
+        }
+    }
+
+    RawMesh mesh = extension == ".stl"   ? readStl(file, path, options, threads)
+                   : extension == ".obj" ? readObj(file, path, options, threads)
+                                         : readPly(file, path, options, threads);
+
+    const std::size_t vertexCount = mesh.vertices.size();
+    if (!indicesInRange(mesh.indices.data(), mesh.indices.size(), vertexCount, threads)) {
+        fail(path, "face index out of range");
+    }
+    if (options.scale != 1.0f) {
+        forBlocks(vertexCount, threads, [&](std::size_t, std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                mesh.vertices[i].position *= options.scale;
+            }
+        });
+    }
+    if (options.weld) weld(mesh, options.weldEpsilon, threads);
+
+    if (!mesh.hasNormals) {
+        averageNormals(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(), threads);
+    }
+
+    auto result = std::make_shared<const Mesh>(std::move(mesh.vertices), std::move(mesh.indices));
+    if (cache) cache->store(key, *result);
+    report(result, false);
+    return result;
+}
+
+Mesh::Ptr loadMesh(const std::string &path, const MeshImportOptions &options) {
+    using Key = std::tuple<std::string, std::uintmax_t, std::int64_t, bool, float, float, float, float, float>;
+    static std::mutex mutex;
+    static std::map<Key, std::weak_ptr<const Mesh>> cache;
+    static std::size_t sweepAt = 64;
+
+    // The size and modification time stand in for the contents; a file rewritten in place gets a new mesh.
+    std::filesystem::path canonical;
+    std::uintmax_t size = 0;
+    std::filesystem::file_time_type modified;
+    try {
+        canonical = std::filesystem::canonical(path);
+        size = std::filesystem::file_size(canonical);
+        modified = std::filesystem::last_write_time(canonical);
+    } catch (const std::filesystem::filesystem_error &error) {
+        fail(path, error.code().message());
+    }
+    const Key key{canonical.string(),
+                  size,
+                  static_cast<std::int64_t>(modified.time_since_epoch().count()),
+                  options.weld,
+                  options.weldEpsilon,
+                  options.scale,
+                  options.color.x(),
+                  options.color.y(),
+                  options.color.z()};
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (auto mesh = cache[key].lock()) return mesh;
+    }
+    // Imported without the lock, so other files load meanwhile; two threads racing for one file both import it.
+    auto mesh = importMesh(path, options);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (auto cached = cache[key].lock()) return cached;
+    cache[key] = mesh;
+    // Files no longer referenced, or since rewritten, leave expired entries; a sweep whenever the map has doubled
+    // drops them at constant amortized cost.
+    if (cache.size() >= sweepAt) {
+        for (auto it = cache.begin(); it != cache.end();) {
+            it = it->second.expired() ? cache.erase(it) : std::next(it);
+        }
+        sweepAt = std::max<std::size_t>(64, 2 * cache.size());
+    }
+    return mesh;
+}
+
+} // namespace toph
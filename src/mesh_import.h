@@ -0,0 +1,54 @@
+#pragma once
+
+#include "mesh.h"
+#include <Eigen/Core>
+#include <cstddef>
+#include <string>
+
+namespace toph {
+
+struct MeshImportOptions {
+    // Merges vertices with the same position, color and normal. With a positive epsilon positions are compared after
+    // snapping them to a grid of that spacing, which also merges the near-duplicates left by CAD exporters.
+    bool weld = true;
+    float weldEpsilon = 0.0f;
+    // Applied to positions before welding, e.g. 0.001 for files in millimetres.
+    float scale = 1.0f;
+    // For files without vertex colors.
+    Eigen::Vector3f color{1.0f, 1.0f, 1.0f};
+    // Threads of the shared pool to parse and weld on; 0 uses all of them.
+    std::size_t threadCount = 0;
+    // If set, a MeshCache directory: imported meshes are stored there, and files imported before with the same
+    // options are mapped from it instead of being parsed. If it can't be created, imports go ahead uncached.
+    std::string cacheDirectory;
+};
+
+struct MeshImportStats {
+    std::size_t bytes = 0;
+    double seconds = 0.0;
+    std::size_t vertices = 0;
+    std::size_t triangles = 0;
+    // Whether the mesh was mapped from the cache directory.
+    bool cached = false;
+
+    double megabytesPerSecond() const noexcept;
+};
+
+// Loads a triangle mesh from an STL, OBJ or PLY file, picked by extension. The file is memory-mapped: binary STL and
+// PLY are read straight from the mapping, text files are split into chunks of whole lines parsed in parallel.
+//   STL: binary or ASCII. Facet normals are ignored.
+//   OBJ: `v` lines, optionally followed by a color, and `f` lines; polygons are split into fans and negative
+//        indices count back from the last vertex. Texture coordinates, normals, groups and materials are ignored.
+//   PLY: ASCII and binary of either byte order. Reads the x, y, z, nx, ny, nz, red, green and blue properties of the
+//        vertex element and the vertex_indices (or vertex_index) list of the face element; polygons are split into
+//        fans.
+// Normals are averaged from the faces when the file has none. With options.cacheDirectory the file is hashed first,
+// and a mesh stored for the same contents and options is mapped instead, see MeshCache. Throws std::runtime_error if
+// the file can't be read or parsed. Fills in `stats` if given.
+Mesh::Ptr importMesh(const std::string &path, const MeshImportOptions &options = {}, MeshImportStats *stats = nullptr);
+
+// Like importMesh(), but repeated calls for the same file, unchanged on disk, with the same options return the same
+// mesh for as long as it is referenced. Safe to call from several threads.
+Mesh::Ptr loadMesh(const std::string &path, const MeshImportOptions &options = {});
+
+} // namespace toph
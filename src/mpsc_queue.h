@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace toph {
+
+// Unbounded multi-producer, single-consumer queue (Vyukov). push() is wait-free: one allocation and one atomic
+// exchange, so producers never wait on each other or on the consumer. Only one thread may pop().
+template <typename T> class MpscQueue {
+  public:
+    MpscQueue() : head_(new Node), tail_(head_.load(std::memory_order_relaxed)) {}
+    ~MpscQueue() {
+        T value;
+        while (pop(value)) {
+        }
+        delete tail_;
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    void push(T value) {
+        Node *node = new Node(std::move(value));
+        Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // An element whose push() is still between its two steps is not seen yet; a later pop() returns it.
+    bool pop(T &out) {
+        Node *next = tail_->next.load(std::memory_order_acquire);
+        if (!next) return false;
+        out = std::move(next->value);
+        delete tail_;
+        tail_ = next;
+        return true;
+    }
+
+  private:
+    struct Node {
+        explicit Node(T v = T()) : value(std::move(v)) {}
+        T value;
+        std::atomic<Node *> next{nullptr};
+    };
+
+    // Producers append at head_; the consumer owns tail_, a stub whose successor is the next element.
+    std::atomic<Node *> head_;
+    Node *tail_;
+};
+
+} // namespace toph
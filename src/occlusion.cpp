@@ -0,0 +1,231 @@
+#include "occlusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+namespace toph {
+
+namespace {
+
+// Depth recorded for a texel corner outside the triangle; farther than any window-space depth.
+constexpr float kOutside = std::numeric_limits<float>::infinity();
+
+// Twice the signed area of (a, b, p); positive when p is left of a->b.
+inline float edge(const Eigen::Vector3f &a, const Eigen::Vector3f &b, float px, float py) {
+    return (b.x() - a.x()) * (py - a.y()) - (b.y() - a.y()) * (px - a.x());
+}
+
+} // namespace
+
+OcclusionBuffer::OcclusionBuffer(int width, int height) {
+    if (width <= 0 || height <= 0) throw std::invalid_argument("OcclusionBuffer: size must be positive");
+    do {
+        Level level;
+        level.width = width;
+        level.height = height;
+        level.depth.assign(static_cast<std::size_t>(width) * height, 1.0f);
+        levels_.push_back(std::move(level));
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    } while (levels_.back().width > 1 || levels_.back().height > 1);
+}
+
+void OcclusionBuffer::begin(const Eigen::Matrix4f &viewProjection) {
+    viewProjection_ = viewProjection;
+    std::fill(levels_[0].depth.begin(), levels_[0].depth.end(), 1.0f);
+}
+
+void OcclusionBuffer::rasterize(const Mesh &mesh, const Eigen::Isometry3f &X) {
+    Level &target = levels_[0];
+    const float w = static_cast<float>(target.width), h = static_cast<float>(target.height);
+    const Eigen::Matrix4f m = viewProjection_ * X.matrix();
+
+    for (std::size_t t = 0; t < mesh.triangleCount(); ++t) {
+        const Eigen::Vector3i face = mesh.face(t);
+        Eigen::Vector3f s[3];
+        bool clipped = false;
+        for (int k = 0; k < 3 && !clipped; ++k) {
+            const Eigen::Vector4f c = m * mesh.position(face[k]).homogeneous();
+            clipped = c.w() <= 0.0f || c.z() < -c.w();
+            const Eigen::Vector3f ndc = c.head<3>() / c.w();
+            s[k] = (ndc * 0.5f + Eigen::Vector3f::Constant(0.5f)).cwiseProduct(Eigen::Vector3f(w, h, 1.0f));
+        }
+        if (clipped) continue;
+        const float area = edge(s[0], s[1], s[2].x(), s[2].y());
+        if (area == 0.0f) continue;
+
+        // Texels whose four corners lie within the bounding rectangle. Clamp in float first; far off-screen vertices
+        // would overflow the int conversion.
+        const float minX = std::min({s[0].x(), s[1].x(), s[2].x()}), maxX = std::max({s[0].x(), s[1].x(), s[2].x()});
+        const float minY = std::min({s[0].y(), s[1].y(), s[2].y()}), maxY = std::max({s[0].y(), s[1].y(), s[2].y()});
+        const int x0 = static_cast<int>(std::ceil(std::clamp(minX, 0.0f, w)));
+        const int x1 = static_cast<int>(std::floor(std::clamp(maxX, 0.0f, w))) - 1;
+        const int y0 = static_cast<int>(std::ceil(std::clamp(minY, 0.0f, h)));
+        const int y1 = static_cast<int>(std::floor(std::clamp(maxY, 0.0f, h))) - 1;
+        if (x0 > x1 || y0 > y1) continue;
+
+        // A texel counts as covered only when all four of its corners are inside the triangle, in either winding, and
+        // gets the farthest of their depths; depth is affine in window space, so that bounds the triangle's depth over
+        // the whole texel. Sampling texel centers instead would let the buffer hide boxes the triangle doesn't.
+        const float invArea = 1.0f / area;
+        const int columns = x1 - x0 + 2;
+        std::vector<float> &above = cornerDepths_[0], &below = cornerDepths_[1];
+        above.resize(columns);
+        below.resize(columns);
+        const auto cornerRow = [&](int y, std::vector<float> &depths) {
+            for (int i = 0; i < columns; ++i) {
+                const float px = static_cast<float>(x0 + i), py = static_cast<float>(y);
+                const float b0 = edge(s[1], s[2], px, py) * invArea;
+                const float b1 = edge(s[2], s[0], px, py) * invArea;
+                const float b2 = 1.0f - b0 - b1;
+                const bool inside = b0 >= 0.0f && b1 >= 0.0f && b2 >= 0.0f;
+                depths[i] = inside ? b0 * s[0].z() + b1 * s[1].z() + b2 * s[2].z() : kOutside;
+            }
+        };
+        cornerRow(y0, above);
+        for (int y = y0; y <= y1; ++y) {
+            cornerRow(y + 1, below);
+            float *row = target.depth.data() + static_cast<std::size_t>(y) * target.width;
+            for (int i = 0; i + 1 < columns; ++i) {
+                const float farthest = std::max({above[i], above[i + 1], below[i], below[i + 1]});
+                if (farthest != kOutside) row[x0 + i] = std::min(row[x0 + i], farthest);
+            }
+            std::swap(above, below);
+        }
+    }
+}
+
+void OcclusionBuffer::buildPyramid() {
+    for (std::size_t l = 1; l < levels_.size(); ++l) {
+        const Level &below = levels_[l - 1];
+        Level &level = levels_[l];
+        for (int y = 0; y < level.height; ++y) {
+            const int by0 = 2 * y, by1 = std::min(2 * y + 1, below.height - 1);
+            for (int x = 0; x < level.width; ++x) {
+                const int bx0 = 2 * x, bx1 = std::min(2 * x + 1, below.width - 1);
+                const auto at = [&](int bx, int by) {
+                    return below.depth[static_cast<std::size_t>(by) * below.width + bx];
+                };
+                level.depth[static_cast<std::size_t>(y) * level.width + x] =
+                    std::max({at(bx0, by0), at(bx1, by0), at(bx0, by1), at(bx1, by1)});
+            }
+        }
+    }
+}
+
+OcclusionBuffer::Footprint OcclusionBuffer::project(const Aabb &box) const {
+    Footprint f;
+    if (box.empty()) {
+        f.empty = true;
+        return f;
+    }
+    // Corners as the projected center plus or minus the projected half axes.
+    const Eigen::Vector3f e = box.extent();
+    const Eigen::Vector4f center = viewProjection_ * box.center().homogeneous();
+    const Eigen::Matrix<float, 4, 3> axes = viewProjection_.topLeftCorner<4, 3>() * e.asDiagonal();
+
+    const Eigen::Vector2f size(static_cast<float>(width()), static_cast<float>(height()));
+    f.lo.setConstant(std::numeric_limits<float>::infinity());
+    f.hi.setConstant(-std::numeric_limits<float>::infinity());
+    f.nearest = std::numeric_limits<float>::infinity();
+    for (int corner = 0; corner < 8; ++corner) {
+        const Eigen::Vector4f c = center + axes.col(0) * ((corner & 1) ? 1.0f : -1.0f) +
+                                  axes.col(1) * ((corner & 2) ? 1.0f : -1.0f) +
+                                  axes.col(2) * ((corner & 4) ? 1.0f : -1.0f);
+        if (c.w() <= 0.0f || c.z() < -c.w()) {
+            f.clipped = true;
+            return f;
+        }
+        const float invW = 1.0f / c.w();
+        const Eigen::Vector2f s = (c.head<2>() * (0.5f * invW) + Eigen::Vector2f::Constant(0.5f)).cwiseProduct(size);
+        f.lo = f.lo.cwiseMin(s);
+        f.hi = f.hi.cwiseMax(s);
+        f.nearest = std::min(f.nearest, c.z() * (0.5f * invW) + 0.5f);
+    }
+    return f;
+}
+
+bool OcclusionBuffer::visible(const Aabb &box) const { return visible(project(box)); }
+
+bool OcclusionBuffer::visible(const Footprint &f) const {
+    if (f.empty) return false;
+    if (f.clipped) return true;
+    const int w = width(), h = height();
+    if (f.hi.x() < 0.0f || f.hi.y() < 0.0f || f.lo.x() >= w || f.lo.y() >= h || f.nearest > 1.0f) return false;
+
+    const int x0 = static_cast<int>(std::max(f.lo.x(), 0.0f)), x1 = static_cast<int>(std::min(f.hi.x(), w - 1.0f));
+    const int y0 = static_cast<int>(std::max(f.lo.y(), 0.0f)), y1 = static_cast<int>(std::min(f.hi.y(), h - 1.0f));
+    // The finest level where the rectangle spans at most 2x2 texels.
+    std::size_t l = 0;
+    while (l + 1 < levels_.size() && ((x1 >> l) - (x0 >> l) > 1 || (y1 >> l) - (y0 >> l) > 1)) {
+        ++l;
+    }
+    const Level &level = levels_[l];
+    float farthest = 0.0f;
+    for (int y = y0 >> l; y <= (y1 >> l); ++y) {
+        for (int x = x0 >> l; x <= (x1 >> l); ++x) {
+            farthest = std::max(farthest, level.depth[static_cast<std::size_t>(y) * level.width + x]);
+        }
+    }
+    return f.nearest <= farthest;
+}
+
+float OcclusionBuffer::screenCoverage(const Aabb &box) const { return screenCoverage(project(box)); }
+
+float OcclusionBuffer::screenCoverage(const Footprint &f) const {
+    if (f.empty) return 0.0f;
+    if (f.clipped) return 1.0f;
+    const Eigen::Vector2f size(static_cast<float>(width()), static_cast<float>(height()));
+    const Eigen::Vector2f extent = (f.hi.cwiseMin(size) - f.lo.cwiseMax(Eigen::Vector2f::Zero())).cwiseMax(0.0f);
+    return extent.prod() / size.prod();
+}
+
+std::size_t OcclusionBuffer::cull(const Eigen::Matrix4f &viewProjection, const Bvh &bvh,
+                                  const std::vector<Frame::Ptr> &frames, const std::vector<Aabb> &worldBounds,
+                                  std::vector<std::uint8_t> &mask, float minCoverage, std::size_t triangleBudget) {
+    begin(viewProjection);
+
+    // A box's screen rectangle is at most about (2 r s / (w - r))^2 / 4 of the viewport for bounding radius r at clip
+    // depth w, where s is the projection scale. That rejects most occluder candidates before projecting their corners.
+    const float scale = std::max(viewProjection.row(0).head<3>().norm(), viewProjection.row(1).head<3>().norm());
+    occluders_.clear();
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        if (!mask[i] || worldBounds[i].empty()) continue;
+        const float r = worldBounds[i].extent().norm();
+        const float w = viewProjection.row(3).dot(worldBounds[i].center().homogeneous()) - r;
+        if (w > 0.0f && r * scale / w * r * scale / w < minCoverage) continue;
+        const Mesh::Ptr &mesh = frames[i]->mesh();
+        if (!mesh || mesh->triangleCount() == 0) continue;
+        const float coverage = screenCoverage(worldBounds[i]);
+        if (coverage >= minCoverage) occluders_.emplace_back(coverage, i);
+    }
+    if (occluders_.empty()) return 0;
+
+    std::sort(occluders_.begin(), occluders_.end(), std::greater<>());
+    std::size_t triangles = 0;
+    for (const auto &occluder : occluders_) {
+        const Frame &frame = *frames[occluder.second];
+        const std::size_t count = frame.mesh()->triangleCount();
+        if (triangles > 0 && triangles + count > triangleBudget) continue;
+        rasterize(*frame.mesh(), frame.worldX());
+        triangles += count;
+    }
+    buildPyramid();
+
+    survivors_.assign(frames.size(), 0);
+    bvh.traverse([&](const Aabb &bounds) { return visible(bounds); },
+                 [&](std::uint32_t i) { survivors_[i] = mask[i] && visible(worldBounds[i]); });
+    std::size_t hidden = 0;
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        if (mask[i] && !survivors_[i]) {
+            mask[i] = 0;
+            ++hidden;
+        }
+    }
+    return hidden;
+}
+
+} // namespace toph
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "bvh.h"
+#include "frame.h"
+#include "geometry.h"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace toph {
+
+// Low-resolution software depth buffer of a few large occluders and its hierarchical-Z pyramid. Every pyramid level
+// keeps the farthest depth of the 2x2 texels below it, so a box is hidden when its nearest depth is behind each of the
+// (at most four) texels covering its screen rectangle. Depths are in window space: 0 at the near and 1 at the far
+// plane.
+class OcclusionBuffer {
+  public:
+    explicit OcclusionBuffer(int width = 256, int height = 128);
+
+    int width() const noexcept { return levels_[0].width; }
+    int height() const noexcept { return levels_[0].height; }
+    std::size_t levelCount() const noexcept { return levels_.size(); }
+
+    // Clears to the far plane and sets the matrix used by the calls below.
+    void begin(const Eigen::Matrix4f &viewProjection);
+    // Rasterizes the triangles of a mesh placed at X. A texel is only written when a triangle covers it entirely, and
+    // then with the triangle's farthest depth over it, so the buffer never hides more than the triangles do. Triangles
+    // reaching in front of the near plane are skipped, which only makes the buffer occlude less.
+    void rasterize(const Mesh &mesh, const Eigen::Isometry3f &X);
+    // Call after the last rasterize() and before visible().
+    void buildPyramid();
+    // False only if the box is certainly hidden behind the rasterized occluders or off screen.
+    bool visible(const Aabb &box) const;
+
+    // Fraction of the viewport covered by the screen rectangle of a box; 1 for boxes reaching in front of the near
+    // plane.
+    float screenCoverage(const Aabb &box) const;
+
+    // The whole pass for one view: among the frames with mask[i] set, the triangle meshes covering at least minCoverage
+    // of the screen are rasterized, largest first and up to triangleBudget triangles, and every frame they hide is
+    // cleared in the mask. worldBounds[i] are the bounds of frames[i] and `bvh` is built over them; whole subtrees
+    // are rejected at once. Returns the number of frames cleared.
+    std::size_t cull(const Eigen::Matrix4f &viewProjection, const Bvh &bvh, const std::vector<Frame::Ptr> &frames,
+                     const std::vector<Aabb> &worldBounds, std::vector<std::uint8_t> &mask,
+                     float minCoverage = 0.02f, std::size_t triangleBudget = 20000);
+
+  private:
+    struct Level {
+        int width = 0;
+        int height = 0;
+        std::vector<float> depth;
+    };
+
+    // Window-space rectangle and nearest depth of a box.
+    struct Footprint {
+        Eigen::Vector2f lo, hi;
+        float nearest = 0.0f;
+        bool empty = false;
+        // The box reaches in front of the near plane; lo, hi and nearest are not set.
+        bool clipped = false;
+    };
+
+    Footprint project(const Aabb &box) const;
+    bool visible(const Footprint &footprint) const;
+    float screenCoverage(const Footprint &footprint) const;
+
+    Eigen::Matrix4f viewProjection_ = Eigen::Matrix4f::Identity();
+    std::vector<Level> levels_;
+    std::vector<std::pair<float, std::size_t>> occluders_;
+    std::vector<std::uint8_t> survivors_;
+    // Depths at the texel corners of two adjacent rows, reused across rasterize() calls.
+    std::vector<float> cornerDepths_[2];
+};
+
+} // namespace toph
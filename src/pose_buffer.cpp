@@ -0,0 +1,29 @@
+#include "pose_buffer.h"
+
+namespace toph {
+
+namespace {
+
+std::vector<Eigen::Isometry3f> localTransforms(const std::vector<Frame::Ptr> &frames) {
+    std::vector<Eigen::Isometry3f> poses;
+    poses.reserve(frames.size());
+    for (const auto &frame : frames) {
+        poses.push_back(frame->X());
+    }
+    return poses;
+}
+
+} // namespace
+
+PoseBuffer::PoseBuffer(std::vector<Frame::Ptr> frames) : frames_(std::move(frames)), poses_(localTransforms(frames_)) {}
+
+bool PoseBuffer::apply() {
+    if (!poses_.acquire()) return false;
+    const auto &poses = poses_.front();
+    for (std::size_t i = 0; i < frames_.size(); ++i) {
+        frames_[i]->setX(poses[i]);
+    }
+    return true;
+}
+
+} // namespace toph
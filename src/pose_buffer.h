@@ -0,0 +1,78 @@
+#pragma once
+
+#include "frame.h"
+#include <Eigen/Geometry>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace toph {
+
+// Three copies of a value shared by one writer and one reader without locks. The writer fills back() and publishes it
+// with a single atomic exchange against the middle slot; the reader swaps the middle slot in as its front when it
+// holds something newer. Neither side ever waits, and the reader never sees a half-written value. publish() then
+// copies the published value into the new back slot, which costs a copy of T but lets the writer change only parts
+// of it next time.
+template <typename T> class TripleBuffer {
+  public:
+    explicit TripleBuffer(const T &initial = T()) : slots_{initial, initial, initial} {}
+
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    // Writer side. After publish(), back() holds a copy of the value just published.
+    T &back() noexcept { return slots_[back_]; }
+    void publish() {
+        const std::uint8_t published = back_;
+        back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kIndex;
+        // The reader may take the published slot as its front meanwhile, but it only ever reads it.
+        slots_[back_] = slots_[published];
+    }
+
+    // Reader side. Returns false and keeps the current front if nothing was published since the last call.
+    bool acquire() noexcept {
+        if (!(middle_.load(std::memory_order_relaxed) & kFresh)) return false;
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+        return true;
+    }
+    const T &front() const noexcept { return slots_[front_]; }
+
+  private:
+    static constexpr std::uint8_t kIndex = 0x3;
+    static constexpr std::uint8_t kFresh = 0x4;
+
+    T slots_[3];
+    std::uint8_t back_ = 0;
+    std::atomic<std::uint8_t> middle_{1};
+    std::uint8_t front_ = 2;
+};
+
+// Snapshots of the local transforms of a fixed set of frames, written by a simulation thread and applied to the
+// frames by the viewer's render loop, so the two threads never touch the same Frame.
+class PoseBuffer {
+  public:
+    using Ptr = std::shared_ptr<PoseBuffer>;
+
+    // The buffers start out with the frames' current local transforms.
+    explicit PoseBuffer(std::vector<Frame::Ptr> frames);
+
+    const std::vector<Frame::Ptr> &frames() const noexcept { return frames_; }
+
+    // Writer side: local transforms indexed like frames(). Poses that aren't set keep their last published value;
+    // see TripleBuffer.
+    std::vector<Eigen::Isometry3f> &back() noexcept { return poses_.back(); }
+    void set(std::size_t i, const Eigen::Isometry3f &X) { poses_.back()[i] = X; }
+    void publish() { poses_.publish(); }
+
+    // Reader side: sets the local transforms of the frames from the newest published snapshot, if there is one
+    // that wasn't applied yet. Returns whether anything was applied.
+    bool apply();
+
+  private:
+    std::vector<Frame::Ptr> frames_;
+    TripleBuffer<std::vector<Eigen::Isometry3f>> poses_;
+};
+
+} // namespace toph
@@ -0,0 +1,190 @@
+#include "recorder.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace toph {
+
+FrameRecorder::FrameRecorder(const std::string &pathPattern, ImageFormat format, std::size_t ringSize)
+    : format_(format), slots_(std::max<std::size_t>(ringSize, 1)) {
+    // The pattern is never used as a printf format: user text such as "%s" would read arbitrary memory.
+    const auto invalid = [&pathPattern] {
+        return std::invalid_argument("FrameRecorder: path pattern needs exactly one %d conversion: " + pathPattern);
+    };
+    bool converted = false;
+    for (std::size_t i = 0; i < pathPattern.size(); ++i) {
+        std::string &text = converted ? pathSuffix_ : pathPrefix_;
+        if (pathPattern[i] != '%') {
+            text += pathPattern[i];
+        } else if (i + 1 < pathPattern.size() && pathPattern[i + 1] == '%') {
+            text += '%';
+            ++i;
+        } else {
+            if (converted) throw invalid();
+            ++i;
+            zeroPad_ = i < pathPattern.size() && pathPattern[i] == '0';
+            for (; i < pathPattern.size() && std::isdigit(static_cast<unsigned char>(pathPattern[i])); ++i) {
+                numberWidth_ = std::min(10 * numberWidth_ + (pathPattern[i] - '0'), 64);
+            }
+            if (i == pathPattern.size() || (pathPattern[i] != 'd' && pathPattern[i] != 'i')) throw invalid();
+            converted = true;
+        }
+    }
+    if (!converted) throw invalid();
+    writer_ = std::thread([this] { writerLoop(); });
+}
+
+FrameRecorder::~FrameRecorder() {
+    try {
+        finish();
+    } catch (...) {
+        // Errors of the last frames are only reported through finish().
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    queued_.notify_one();
+    writer_.join();
+}
+
+void FrameRecorder::capture(int width, int height) {
+    if (width <= 0 || height <= 0) return;
+    if (width != width_ || height != height_ || slots_.front().pbo == 0) {
+        finish();
+        allocate(width, height);
+    }
+
+    // Hand off every readback that has completed, oldest first; next_ is the oldest slot.
+    const std::size_t n = slots_.size();
+    for (std::size_t k = 0; k < n; ++k) {
+        Slot &slot = slots_[(next_ + k) % n];
+        if (slot.fence && !collect(slot, false)) break;
+    }
+    Slot &slot = slots_[next_];
+    if (slot.fence) collect(slot, true);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = frame_++;
+    next_ = (next_ + 1) % n;
+
+    // Bounds the memory held by frames waiting for the writer.
+    waitForWrites(n + 1);
+}
+
+void FrameRecorder::finish() {
+    const std::size_t n = slots_.size();
+    for (std::size_t k = 0; k < n; ++k) {
+        Slot &slot = slots_[(next_ + k) % n];
+        if (slot.fence) collect(slot, true);
+    }
+    release();
+    waitForWrites(0);
+}
+
+std::size_t FrameRecorder::framesWritten() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_;
+}
+
+void FrameRecorder::allocate(int width, int height) {
+    width_ = width;
+    height_ = height;
+    next_ = 0;
+    const GLsizeiptr size = static_cast<GLsizeiptr>(width) * height * 4;
+    for (Slot &slot : slots_) {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameRecorder::release() {
+    for (Slot &slot : slots_) {
+        if (slot.fence) glDeleteSync(static_cast<GLsync>(slot.fence));
+        if (slot.pbo) glDeleteBuffers(1, &slot.pbo);
+        slot = Slot();
+    }
+}
+
+bool FrameRecorder::collect(Slot &slot, bool wait) {
+    const GLsync fence = static_cast<GLsync>(slot.fence);
+    GLenum status = glClientWaitSync(fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, 0);
+    while (wait && status == GL_TIMEOUT_EXPIRED) {
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);
+    }
+    if (status == GL_TIMEOUT_EXPIRED) return false;
+    glDeleteSync(fence);
+    slot.fence = nullptr;
+    if (status == GL_WAIT_FAILED) throw std::runtime_error("FrameRecorder: waiting for a readback failed");
+
+    // The copy out of the mapping is the only per-frame work left on this thread. A buffer that can't be mapped loses
+    // its frame rather than writing an image of uninitialized memory.
+    const std::size_t size = static_cast<std::size_t>(width_) * height_ * 4;
+    Write write{framePath(slot.frame), {}, width_, height_};
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if (const void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT)) {
+        write.pixels.resize(size);
+        std::memcpy(write.pixels.data(), mapped, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (write.pixels.empty()) return true;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        writes_.push_back(std::move(write));
+    }
+    queued_.notify_one();
+    return true;
+}
+
+std::string FrameRecorder::framePath(int frame) const {
+    const std::string number = std::to_string(frame);
+    const std::size_t width = static_cast<std::size_t>(numberWidth_);
+    const std::string padding(width > number.size() ? width - number.size() : 0, zeroPad_ ? '0' : ' ');
+    return pathPrefix_ + padding + number + pathSuffix_;
+}
+
+void FrameRecorder::waitForWrites(std::size_t maxPending) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return writes_.size() + (writing_ ? 1 : 0) <= maxPending; });
+    if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+void FrameRecorder::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        queued_.wait(lock, [this] { return stop_ || !writes_.empty(); });
+        if (writes_.empty()) return;
+        Write write = std::move(writes_.front());
+        writes_.pop_front();
+        writing_ = true;
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            writeImage(write.path, format_, write.width, write.height, write.pixels.data(), true);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+        writing_ = false;
+        if (!error) {
+            ++written_;
+        } else if (!error_) {
+            error_ = error;
+        }
+        done_.notify_all();
+    }
+}
+
+} // namespace toph
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "image.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace toph {
+
+// Captures rendered frames to numbered image files without stalling the GL pipeline. Each capture() starts an
+// asynchronous glReadPixels into one of a ring of pixel buffer objects and puts a fence behind it; a later capture()
+// copies the PBOs whose fences have signalled out of GL memory and hands them to the recorder's own writer thread,
+// which encodes and writes the files. The render thread only blocks when the GPU falls a whole ring behind or the
+// writer falls a few frames behind.
+//
+// Use it from the thread the GL context is current on. The destructor calls finish().
+class FrameRecorder {
+  public:
+    // pathPattern holds exactly one %d conversion for the frame number, optionally with a width and zero padding as in
+    // "capture/frame_%06d.png"; write a literal percent sign as %%. Throws std::invalid_argument for anything else.
+    explicit FrameRecorder(const std::string &pathPattern, ImageFormat format = ImageFormat::Png,
+                           std::size_t ringSize = 3);
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder &) = delete;
+    FrameRecorder &operator=(const FrameRecorder &) = delete;
+
+    // Reads the lower left width x height pixels of the current read framebuffer. Rethrows the error of a failed write
+    // of an earlier frame.
+    void capture(int width, int height);
+    // Waits for every captured frame to be written, then releases the PBOs and rethrows the error of a failed write.
+    // Capturing again starts a new ring.
+    void finish();
+
+    // Frames written to disk so far. Frames whose PBO could not be mapped are skipped and not counted.
+    std::size_t framesWritten() const;
+
+  private:
+    struct Slot {
+        unsigned int pbo = 0;
+        void *fence = nullptr; // GLsync
+        int frame = 0;
+    };
+
+    struct Write {
+        std::string path;
+        std::vector<std::uint8_t> pixels;
+        int width = 0;
+        int height = 0;
+    };
+
+    void allocate(int width, int height);
+    void release();
+    // Copies the slot's pixels out of its PBO and queues the file write; with wait, blocks until the GPU is done.
+    bool collect(Slot &slot, bool wait);
+    std::string framePath(int frame) const;
+    // Blocks until at most maxPending writes are queued or running, then rethrows the first failed write's error.
+    void waitForWrites(std::size_t maxPending);
+    void writerLoop();
+
+    // The pattern split around its conversion, with %% already turned into %.
+    std::string pathPrefix_;
+    std::string pathSuffix_;
+    int numberWidth_ = 0;
+    bool zeroPad_ = false;
+    ImageFormat format_;
+    std::vector<Slot> slots_;
+    std::size_t next_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    int frame_ = 0;
+
+    // Shared with the writer thread.
+    mutable std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable done_;
+    std::deque<Write> writes_;
+    bool writing_ = false;
+    bool stop_ = false;
+    std::exception_ptr error_;
+    std::size_t written_ = 0;
+    std::thread writer_;
+};
+
+} // namespace toph
@@ -0,0 +1,1045 @@
+#include "renderer.h"
+#include "bvh.h"
+#include "gl_ext.h"
+#include "occlusion.h"
+
+#include <glad/glad.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace toph {
+
+// Compiled as GLSL 330, or as 430 with GPU_CULLING defined for draws whose instances were compacted by the culling
+// compute shader.
+constexpr char VERTEX_SHADER_SRC[] = R"(
+layout(location=0) in vec3 a_position;
+layout(location=1) in vec3 a_color;
+layout(location=2) in vec3 a_normal;
+layout(location=3) in int a_instance; // per instance; includes the base instance of indirect draws
+
+out vec3 v_color;
+out vec3 v_normal;
+out vec3 v_worldPos;
+flat out uint v_id;
+
+uniform mat4 u_view;
+uniform mat4 u_proj;
+
+// Seven texels per instance: the model matrix columns, then the normal matrix columns with the tint in w. The model
+// matrix is rigid, so its bottom row is implied and its first entry carries the frame's id instead.
+uniform samplerBuffer u_instances;
+uniform int u_baseInstance;
+
+#ifdef GPU_CULLING
+// Indices relative to u_baseInstance of the instances that passed culling, one run per indirect command.
+uniform usamplerBuffer u_visibleIds;
+#endif
+
+void main() {
+#ifdef GPU_CULLING
+    int base = (u_baseInstance + int(texelFetch(u_visibleIds, a_instance).r)) * 7;
+#else
+    int base = (u_baseInstance + a_instance) * 7;
+#endif
+    mat4 model = mat4(texelFetch(u_instances, base + 0), texelFetch(u_instances, base + 1),
+                      texelFetch(u_instances, base + 2), texelFetch(u_instances, base + 3));
+    vec4 n0 = texelFetch(u_instances, base + 4);
+    vec4 n1 = texelFetch(u_instances, base + 5);
+    vec4 n2 = texelFetch(u_instances, base + 6);
+
+    v_id = uint(model[0].w);
+    vec4 worldPos = vec4(mat4x3(model) * vec4(a_position, 1.0), 1.0);
+    v_worldPos = worldPos.xyz;
+    v_normal = mat3(n0.xyz, n1.xyz, n2.xyz) * a_normal;
+    v_color = a_color * vec3(n0.w, n1.w, n2.w);
+    gl_Position = u_proj * u_view * worldPos;
+}
+)";
+
+constexpr char FRAGMENT_SHADER_SRC[] = R"(
+#version 330 core
+in vec3 v_color;
+in vec3 v_normal;
+in vec3 v_worldPos;
+flat in uint v_id;
+
+layout(location=0) out vec4 FragColor;
+// Only stored when the framebuffer has an integer attachment as its second draw buffer.
+layout(location=1) out uint FragId;
+
+uniform vec3 u_lightPos;
+uniform vec3 u_viewPos;
+
+void main() {
+    vec3 N = normalize(v_normal);
+    vec3 L = normalize(u_lightPos - v_worldPos);
+    vec3 V = normalize(u_viewPos - v_worldPos);
+
+    float diff = max(dot(N, L), 0.0);
+
+    vec3 ambient = 0.2 * v_color;
+    vec3 diffuse = diff * v_color;
+
+    FragColor = vec4(ambient + diffuse, 1.0);
+    FragId = v_id;
+}
+)";
+
+// One invocation per instance in draw order. Instances whose transformed local bounds are inside the frustum are
+// appended to their command's run of u_visibleIds, bumping the command's instance count.
+constexpr char CULL_SHADER_SRC[] = R"(
+#version 430 core
+layout(local_size_x = 64) in;
+
+struct CullRecord {
+    vec3 center;
+    uint command;
+    vec3 extent;
+    uint pad;
+};
+
+layout(std430, binding = 0) readonly buffer Instances { vec4 instances[]; };
+layout(std430, binding = 1) readonly buffer Records { CullRecord records[]; };
+layout(std430, binding = 2) buffer Commands { uint commands[]; }; // DrawElementsIndirectCommand, 5 words each
+layout(std430, binding = 3) writeonly buffer VisibleIds { uint visibleIds[]; };
+
+uniform vec4 u_planes[6];
+uniform int u_baseInstance;
+uniform uint u_count;
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= u_count) return;
+
+    CullRecord r = records[i];
+    int base = (u_baseInstance + int(i)) * 7;
+    mat4 model = mat4(instances[base + 0], instances[base + 1], instances[base + 2], instances[base + 3]);
+    vec3 c = (model * vec4(r.center, 1.0)).xyz;
+    vec3 e = mat3(abs(model[0].xyz), abs(model[1].xyz), abs(model[2].xyz)) * r.extent;
+    for (int p = 0; p < 6; ++p) {
+        if (dot(u_planes[p].xyz, c) + u_planes[p].w < -dot(abs(u_planes[p].xyz), e)) return;
+    }
+
+    uint slot = atomicAdd(commands[r.command * 5u + 1u], 1u);
+    visibleIds[commands[r.command * 5u + 4u] + slot] = i;
+}
+)";
+
+// Per-instance data as the vertex shader reads it from u_instances.
+struct InstanceData {
+    // The bottom row holds the frame's id in its first entry; see the vertex shader.
+    Eigen::Matrix4f model;
+    // Columns of the normal matrix in xyz, the tint in w.
+    Eigen::Matrix<float, 4, 3> normalTint;
+};
+static_assert(sizeof(InstanceData) == 7 * 4 * sizeof(float), "InstanceData must match the shader's texel layout");
+
+// Ring of per-frame sections in one buffer, read by the shader as a texture buffer. Each rendered frame writes the next
+// section with an unsynchronized map and fences it, so the CPU never waits for draws still reading an older section.
+struct InstanceRing {
+    static constexpr std::size_t kSections = 3;
+
+    GLuint buffer = 0;
+    GLuint texture = 0;
+    std::size_t capacity = 0; // instances per section
+    std::size_t section = 0;
+    std::array<GLsync, kSections> fences{};
+
+    InstanceRing() = default;
+    ~InstanceRing();
+
+    InstanceRing(const InstanceRing &) = delete;
+    InstanceRing &operator=(const InstanceRing &) = delete;
+
+    // Copies the instances into the next section and returns the index of its first instance.
+    std::size_t write(const std::vector<InstanceData> &instances);
+    // Call after the draws that read the section returned by the last write().
+    void fence();
+
+  private:
+    void reserve(std::size_t count);
+};
+
+InstanceRing::~InstanceRing() {
+    for (auto &f : fences) {
+        if (f) glDeleteSync(f);
+    }
+    if (texture) glDeleteTextures(1, &texture);
+    if (buffer) glDeleteBuffers(1, &buffer);
+}
+
+void InstanceRing::reserve(std::size_t count) {
+    if (count <= capacity && buffer) return;
+
+    std::size_t newCapacity = std::max<std::size_t>(capacity, 256);
+    while (newCapacity < count) {
+        newCapacity *= 2;
+    }
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    if (newCapacity * kSections * 7 > static_cast<std::size_t>(maxTexels)) {
+        newCapacity = static_cast<std::size_t>(maxTexels) / (kSections * 7);
+        if (newCapacity < count) throw std::runtime_error("Too many instances for GL_MAX_TEXTURE_BUFFER_SIZE");
+    }
+
+    // The old buffer may still be in use, but deleting it is deferred by the driver until the draws are done.
+    for (auto &f : fences) {
+        if (f) glDeleteSync(f);
+        f = nullptr;
+    }
+    if (!buffer) glGenBuffers(1, &buffer);
+    if (!texture) glGenTextures(1, &texture);
+    capacity = newCapacity;
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, kSections * capacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+}
+
+std::size_t InstanceRing::write(const std::vector<InstanceData> &instances) {
+    reserve(instances.size());
+    section = (section + 1) % kSections;
+    if (GLsync &f = fences[section]) {
+        glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(f);
+        f = nullptr;
+    }
+
+    const std::size_t bytes = instances.size() * sizeof(InstanceData);
+    if (bytes > 0) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        void *dst = glMapBufferRange(GL_TEXTURE_BUFFER, section * capacity * sizeof(InstanceData), bytes,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        std::memcpy(dst, instances.data(), bytes);
+        glUnmapBuffer(GL_TEXTURE_BUFFER);
+    }
+    return section * capacity;
+}
+
+void InstanceRing::fence() { fences[section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0); }
+
+// All meshes suballocated out of one vertex and one index buffer, so the whole scene can be drawn without switching
+// vertex state. Released ranges go to free lists that later meshes are placed in first; otherwise meshes are appended
+// and the buffers grow by doubling. Buffers are shared between contexts of a share group but vertex arrays are not, so
+// each renderer reads the arena through its own ArenaBinding.
+struct GeometryArena {
+    struct Range {
+        GLenum mode = GL_TRIANGLES;
+        GLsizei indexCount = 0;
+        GLuint firstIndex = 0;
+        GLint baseVertex = 0;
+        GLsizei vertexCount = 0;
+    };
+
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+    // The used prefix of each buffer, free blocks inside it included.
+    std::size_t vertexCount = 0, vertexCapacity = 0;
+    std::size_t indexCount = 0, indexCapacity = 0;
+
+    GeometryArena() = default;
+    ~GeometryArena();
+
+    GeometryArena(const GeometryArena &) = delete;
+    GeometryArena &operator=(const GeometryArena &) = delete;
+
+    // Meshes without indices are drawn as a line list.
+    Range add(const Mesh &mesh);
+    // Makes the range's space available to later add() calls. Nothing may draw from it anymore.
+    void release(const Range &range);
+
+  private:
+    // Free blocks below vertexCount and indexCount, as offset to size; adjacent blocks are merged.
+    using FreeList = std::map<std::size_t, std::size_t>;
+    FreeList freeVertices_, freeIndices_;
+
+    void grow(GLuint &buffer, std::size_t used, std::size_t needed, std::size_t &capacity, std::size_t elementSize);
+    // First fit from the free list, or else appended after `used`.
+    static std::size_t allocate(FreeList &free, std::size_t &used, std::size_t count);
+    static void free(FreeList &list, std::size_t &used, std::size_t offset, std::size_t count);
+};
+
+GeometryArena::~GeometryArena() {
+    if (vbo) glDeleteBuffers(1, &vbo);
+    if (ebo) glDeleteBuffers(1, &ebo);
+}
+
+void GeometryArena::grow(GLuint &buffer, std::size_t used, std::size_t needed, std::size_t &capacity,
+                         std::size_t elementSize) {
+    if (needed <= capacity && buffer) return;
+    std::size_t newCapacity = std::max<std::size_t>(capacity, 1024);
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+
+    GLuint grown = 0;
+    glGenBuffers(1, &grown);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * elementSize, nullptr, GL_STATIC_DRAW);
+    if (used > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used * elementSize);
+    }
+    if (buffer) glDeleteBuffers(1, &buffer);
+    buffer = grown;
+    capacity = newCapacity;
+}
+
+std::size_t GeometryArena::allocate(FreeList &list, std::size_t &used, std::size_t count) {
+    if (count == 0) return used;
+    for (auto it = list.begin(); it != list.end(); ++it) {
+        if (it->second < count) continue;
+        const std::size_t offset = it->first;
+        if (it->second > count) list.emplace(offset + count, it->second - count);
+        list.erase(it);
+        return offset;
+    }
+    used += count;
+    return used - count;
+}
+
+void GeometryArena::free(FreeList &list, std::size_t &used, std::size_t offset, std::size_t count) {
+    if (count == 0) return;
+    auto next = list.lower_bound(offset);
+    if (next != list.end() && offset + count == next->first) {
+        count += next->second;
+        next = list.erase(next);
+    }
+    if (next != list.begin()) {
+        const auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            count += previous->second;
+            list.erase(previous);
+        }
+    }
+    // A block at the end just shortens the used prefix.
+    if (offset + count == used) used = offset;
+    else list.emplace(offset, count);
+}
+
+GeometryArena::Range GeometryArena::add(const Mesh &mesh) {
+    using Vertex = Mesh::Vertex;
+
+    Range range;
+    range.vertexCount = static_cast<GLsizei>(mesh.vertexCount());
+    if (mesh.indexCount() > 0) {
+        range.mode = GL_TRIANGLES;
+        range.indexCount = static_cast<GLsizei>(mesh.indexCount());
+    } else {
+        range.mode = GL_LINES;
+        range.indexCount = static_cast<GLsizei>(mesh.vertexCount());
+    }
+
+    const std::size_t usedVertices = vertexCount, usedIndices = indexCount;
+    const std::size_t baseVertex = allocate(freeVertices_, vertexCount, mesh.vertexCount());
+    const std::size_t firstIndex = allocate(freeIndices_, indexCount, range.indexCount);
+    range.baseVertex = static_cast<GLint>(baseVertex);
+    range.firstIndex = static_cast<GLuint>(firstIndex);
+    grow(vbo, usedVertices, vertexCount, vertexCapacity, sizeof(Vertex));
+    grow(ebo, usedIndices, indexCount, indexCapacity, sizeof(std::uint32_t));
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, baseVertex * sizeof(Vertex), mesh.vertexCount() * sizeof(Vertex),
+                    mesh.vertices());
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+    if (mesh.indexCount() > 0) {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(std::uint32_t),
+                        mesh.indexCount() * sizeof(std::uint32_t), mesh.indices());
+    } else {
+        std::vector<std::uint32_t> lineIndices(mesh.vertexCount());
+        for (std::size_t i = 0; i < lineIndices.size(); ++i) {
+            lineIndices[i] = static_cast<std::uint32_t>(i);
+        }
+        glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(std::uint32_t),
+                        lineIndices.size() * sizeof(std::uint32_t), lineIndices.data());
+    }
+    return range;
+}
+
+void GeometryArena::release(const Range &range) {
+    free(freeVertices_, vertexCount, static_cast<std::size_t>(range.baseVertex),
+         static_cast<std::size_t>(range.vertexCount));
+    free(freeIndices_, indexCount, range.firstIndex, static_cast<std::size_t>(range.indexCount));
+}
+
+// One context's vertex array over an arena, plus the per-instance attribute holding 0..n-1; with a base instance it
+// yields the instance's index into the ring. Picks up the arena's buffers again whenever they were regrown.
+struct ArenaBinding {
+    GLuint vao = 0;
+    GLuint instanceIds = 0;
+    std::size_t instanceIdCount = 0;
+    GLuint boundVbo = 0, boundEbo = 0;
+
+    ArenaBinding() = default;
+    ~ArenaBinding();
+
+    ArenaBinding(const ArenaBinding &) = delete;
+    ArenaBinding &operator=(const ArenaBinding &) = delete;
+
+    void reserveInstanceIds(std::size_t count);
+    // Leaves the vertex array bound.
+    void bind(const GeometryArena &arena);
+
+  private:
+    void init();
+};
+
+ArenaBinding::~ArenaBinding() {
+    if (instanceIds) glDeleteBuffers(1, &instanceIds);
+    if (vao) glDeleteVertexArrays(1, &vao);
+}
+
+void ArenaBinding::init() {
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &instanceIds);
+}
+
+void ArenaBinding::reserveInstanceIds(std::size_t count) {
+    if (count <= instanceIdCount) return;
+    if (!vao) init();
+    std::vector<GLint> ids(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        ids[i] = static_cast<GLint>(i);
+    }
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceIds);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(GLint), ids.data(), GL_STATIC_DRAW);
+    glVertexAttribIPointer(3, 1, GL_INT, sizeof(GLint), nullptr);
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+    instanceIdCount = count;
+}
+
+void ArenaBinding::bind(const GeometryArena &arena) {
+    using Vertex = Mesh::Vertex;
+    if (!vao) init();
+    glBindVertexArray(vao);
+    if (boundVbo == arena.vbo && boundEbo == arena.ebo) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, arena.vbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, position));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, color));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(2);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.ebo);
+    boundVbo = arena.vbo;
+    boundEbo = arena.ebo;
+}
+
+// The meshes some renderer's frames use, with one arena range per unique mesh. Shared by renderers whose contexts share
+// objects. Each renderer acquires a mesh once however many of its frames use it, and the range is released when the
+// last renderer lets go of it.
+struct SharedGeometry {
+    struct GpuMesh {
+        Mesh::Ptr mesh; // keeps the key alive
+        GeometryArena::Range range;
+        std::size_t users = 0;
+    };
+
+    GeometryArena arena;
+    GeometryArena::Range fallbackAxes;
+    // Guards gpuMeshes and the arena's free lists: renderers on different threads acquire and release meshes that are
+    // already uploaded at the same time. Uploads themselves must not run concurrently, see Renderer.
+    std::mutex mutex;
+    std::unordered_map<const Mesh *, GpuMesh> gpuMeshes;
+
+    // Uploads the mesh on its first use.
+    void acquire(const Mesh::Ptr &mesh);
+    void release(const Mesh *mesh);
+};
+
+void SharedGeometry::acquire(const Mesh::Ptr &mesh) {
+    std::lock_guard<std::mutex> lock(mutex);
+    GpuMesh &entry = gpuMeshes[mesh.get()];
+    if (entry.users++ > 0) return;
+    entry.mesh = mesh;
+    entry.range = arena.add(*mesh);
+}
+
+void SharedGeometry::release(const Mesh *mesh) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = gpuMeshes.find(mesh);
+    if (--it->second.users > 0) return;
+    arena.release(it->second.range);
+    gpuMeshes.erase(it);
+}
+
+// Local bounds of an instance as the cull shader reads them, and the indirect command the instance is drawn by.
+struct CullRecord {
+    Eigen::Vector3f center;
+    GLuint command;
+    Eigen::Vector3f extent;
+    GLuint pad = 0;
+};
+static_assert(sizeof(CullRecord) == 8 * sizeof(float), "CullRecord must match the shader's std430 layout");
+
+// Frustum culling in a compute shader for GL 4.3 contexts. The instance ring, the records and the indirect commands are
+// bound as storage buffers; the shader fills in the instance counts and the ids the draw program reads its instances
+// through, so per-object visibility never reaches the CPU.
+struct GpuCuller {
+    GLuint program = 0;
+    GLuint records = 0;
+    GLuint visibleIds = 0;
+    GLuint visibleIdsTexture = 0;
+    std::size_t count = 0;
+    GLint planesLoc = -1, baseInstanceLoc = -1, countLoc = -1;
+
+    GpuCuller() = default;
+    ~GpuCuller();
+
+    GpuCuller(const GpuCuller &) = delete;
+    GpuCuller &operator=(const GpuCuller &) = delete;
+
+    // Takes ownership of the linked cull program.
+    void init(GLuint cullProgram);
+    // One record per instance in draw order. Only needs to change with the draw groups.
+    void setRecords(const std::vector<CullRecord> &cullRecords);
+    // Expects the commands with zero instance counts and each base instance pointing at the command's first record.
+    // Leaves the cull program bound.
+    void dispatch(GLuint instances, std::size_t base, GLuint commands,
+                  const Eigen::Matrix<float, 6, 4, Eigen::RowMajor> &planes);
+};
+
+GpuCuller::~GpuCuller() {
+    if (visibleIdsTexture) glDeleteTextures(1, &visibleIdsTexture);
+    if (visibleIds) glDeleteBuffers(1, &visibleIds);
+    if (records) glDeleteBuffers(1, &records);
+    if (program) glDeleteProgram(program);
+}
+
+void GpuCuller::init(GLuint cullProgram) {
+    program = cullProgram;
+    planesLoc = glGetUniformLocation(program, "u_planes");
+    baseInstanceLoc = glGetUniformLocation(program, "u_baseInstance");
+    countLoc = glGetUniformLocation(program, "u_count");
+    glGenBuffers(1, &records);
+    glGenBuffers(1, &visibleIds);
+    glGenTextures(1, &visibleIdsTexture);
+}
+
+void GpuCuller::setRecords(const std::vector<CullRecord> &cullRecords) {
+    count = cullRecords.size();
+    if (count == 0) return;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, records);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(CullRecord), cullRecords.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleIds);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glBindTexture(GL_TEXTURE_BUFFER, visibleIdsTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, visibleIds);
+}
+
+void GpuCuller::dispatch(GLuint instances, std::size_t base, GLuint commands,
+                         const Eigen::Matrix<float, 6, 4, Eigen::RowMajor> &planes) {
+    if (count == 0) return;
+    glUseProgram(program);
+    glUniform4fv(planesLoc, 6, planes.data());
+    glUniform1i(baseInstanceLoc, static_cast<GLint>(base));
+    glUniform1ui(countLoc, static_cast<GLuint>(count));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instances);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, records);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commands);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, visibleIds);
+    glext::DispatchCompute(static_cast<GLuint>((count + 63) / 64), 1, 1);
+    glext::MemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+// Uniform locations of one variant of the draw program.
+struct DrawProgram {
+    GLuint id = 0;
+    GLint view = -1, proj = -1, lightPos = -1, viewPos = -1;
+    GLint instances = -1, baseInstance = -1, visibleIds = -1;
+
+    void locate(GLuint program) {
+        id = program;
+        view = glGetUniformLocation(id, "u_view");
+        proj = glGetUniformLocation(id, "u_proj");
+        lightPos = glGetUniformLocation(id, "u_lightPos");
+        viewPos = glGetUniformLocation(id, "u_viewPos");
+        instances = glGetUniformLocation(id, "u_instances");
+        baseInstance = glGetUniformLocation(id, "u_baseInstance");
+        visibleIds = glGetUniformLocation(id, "u_visibleIds");
+    }
+};
+
+// Local bounds of a frame's geometry; frames without a mesh are drawn as unit axes.
+const Aabb &localBounds(const Mesh::Ptr &mesh) {
+    static const Aabb axesBounds({0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f});
+    return (mesh && mesh->vertexCount() > 0) ? mesh->bounds() : axesBounds;
+}
+
+struct Renderer::Impl {
+    DrawProgram drawProgram_;
+    // Of the context the renderer was created in.
+    glext::Version glVersion_;
+    bool multiDrawIndirect_ = false;
+
+    // Scene data
+    std::vector<Frame::Ptr> frames_;
+    std::shared_ptr<SharedGeometry> geometry_;
+    ArenaBinding arenaBinding_;
+    // Per frame, the mesh this renderer holds in the shared geometry on its behalf (nullptr for the axes), and how many
+    // frames hold each mesh. Brought up to date with the frames' meshes by syncMeshes().
+    std::vector<const Mesh *> heldMeshes_;
+    std::unordered_map<const Mesh *, std::size_t> meshHolders_;
+
+    // Frames sorted by geometry so that each group is one instanced draw. Rebuilt when a frame's mesh changes.
+    struct DrawGroup {
+        const GeometryArena::Range *geometry;
+        std::size_t first;
+        GLsizei count;
+    };
+    std::vector<const Mesh *> groupedMeshes_;
+    std::vector<std::size_t> drawOrder_;
+    std::vector<DrawGroup> drawGroups_;
+    std::vector<InstanceData> instances_;
+    InstanceRing instanceRing_;
+
+    // Frustum culling over world bounds. The BVH is rebuilt when the frame set or a mesh changes and refit when any
+    // transform tree reports a new version.
+    bool frustumCulling_ = true;
+    Bvh bvh_;
+    bool bvhNeedsBuild_ = true;
+    float builtRootArea_ = 0.0f;
+    std::vector<Aabb> worldBounds_;
+    TreeVersions treeVersions_;
+    std::vector<std::uint8_t> visible_;
+    // Hi-Z test of the frustum survivors against their largest members, when enabled.
+    bool occlusionCulling_ = false;
+    OcclusionBuffer occlusion_;
+    std::vector<DrawGroup> visibleGroups_;
+    RenderStats stats_;
+
+    // Culling on the GPU instead of the BVH. Needs compute shaders; gpuCuller_.program stays zero without them.
+    bool gpuCulling_ = false;
+    GpuCuller gpuCuller_;
+    DrawProgram gpuCulledDrawProgram_;
+    std::vector<CullRecord> cullRecords_;
+    bool cullRecordsDirty_ = true;
+
+    // Indirect commands, triangles first, then lines; rebuilt every frame since the ring base moves.
+    std::vector<glext::DrawElementsIndirectCommand> commands_;
+    std::size_t triangleCommands_ = 0;
+    GLuint commandBuffer_ = 0;
+
+    explicit Impl(std::shared_ptr<SharedGeometry> geometry);
+    ~Impl();
+
+    void addFrame(const Frame::Ptr &f);
+    void syncMeshes();
+    void render(const Eigen::Matrix4f &view, const Eigen::Matrix4f &projection);
+    bool meshesChanged() const;
+
+  private:
+    void initShaders();
+    void initFallbackGeometry();
+
+    void hold(const Mesh::Ptr &mesh);
+    void letGo(const Mesh *mesh);
+    // Only looks the mesh up; it must be held.
+    const GeometryArena::Range &geometryFor(const Mesh::Ptr &mesh);
+    void updateDrawGroups();
+    void cullFrames(const Eigen::Matrix4f &viewProjection);
+    void updateCullRecords();
+    std::size_t uploadInstances();
+    // With a view-projection matrix, the commands are filled in by the cull shader.
+    void drawGroups(std::size_t base, const DrawProgram &program, const Eigen::Matrix4f *gpuCullViewProjection);
+};
+
+Renderer::Impl::Impl(std::shared_ptr<SharedGeometry> geometry) : geometry_(std::move(geometry)) {
+    glVersion_ = glext::currentVersion();
+    multiDrawIndirect_ = glext::hasMultiDrawIndirect(glVersion_);
+    if (multiDrawIndirect_) glGenBuffers(1, &commandBuffer_);
+    glEnable(GL_DEPTH_TEST);
+    initShaders();
+    if (!geometry_) {
+        geometry_ = std::make_shared<SharedGeometry>();
+        initFallbackGeometry();
+    }
+}
+
+Renderer::Impl::~Impl() {
+    for (const auto &held : meshHolders_) {
+        geometry_->release(held.first);
+    }
+    if (commandBuffer_) glDeleteBuffers(1, &commandBuffer_);
+    if (drawProgram_.id) glDeleteProgram(drawProgram_.id);
+    if (gpuCulledDrawProgram_.id) glDeleteProgram(gpuCulledDrawProgram_.id);
+}
+
+void Renderer::Impl::initShaders() {
+    auto compileShader = [](GLenum type, std::initializer_list<const char *> sources) -> GLuint {
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, static_cast<GLsizei>(sources.size()), sources.begin(), nullptr);
+        glCompileShader(shader);
+        return shader;
+    };
+    // Returns zero if linking fails. The shaders are released either way.
+    auto linkProgram = [](std::initializer_list<GLuint> shaders) -> GLuint {
+        GLuint program = glCreateProgram();
+        for (GLuint shader : shaders) {
+            glAttachShader(program, shader);
+        }
+        glLinkProgram(program);
+        for (GLuint shader : shaders) {
+            glDeleteShader(shader);
+        }
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked) return program;
+
+        char log[1024] = {};
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        std::cerr << "Shader program failed to link: " << log << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    };
+
+    const GLuint program = linkProgram({compileShader(GL_VERTEX_SHADER, {"#version 330 core\n", VERTEX_SHADER_SRC}),
+                                        compileShader(GL_FRAGMENT_SHADER, {FRAGMENT_SHADER_SRC})});
+    if (!program) throw std::runtime_error("Failed to link the shader program");
+    drawProgram_.locate(program);
+
+    // The culling path is optional; without it everything stays on the GL 3.3 path.
+    if (!multiDrawIndirect_ || !glext::hasComputeShaders(glVersion_)) return;
+    const GLuint cullProgram = linkProgram({compileShader(GL_COMPUTE_SHADER, {CULL_SHADER_SRC})});
+    const GLuint culledProgram =
+        linkProgram({compileShader(GL_VERTEX_SHADER, {"#version 430 core\n#define GPU_CULLING\n", VERTEX_SHADER_SRC}),
+                     compileShader(GL_FRAGMENT_SHADER, {FRAGMENT_SHADER_SRC})});
+    if (cullProgram && culledProgram) {
+        gpuCuller_.init(cullProgram);
+        gpuCulledDrawProgram_.locate(culledProgram);
+    } else {
+        if (cullProgram) glDeleteProgram(cullProgram);
+        if (culledProgram) glDeleteProgram(culledProgram);
+    }
+}
+
+void Renderer::Impl::initFallbackGeometry() {
+    const std::vector<Eigen::Vector3f> verts = {
+        {0, 0, 0}, {1, 0, 0}, // X
+        {0, 0, 0}, {0, 1, 0}, // Y
+        {0, 0, 0}, {0, 0, 1}  // Z
+    };
+    const std::vector<Eigen::Vector3f> colors = {
+        {1, 0, 0}, {1, 0, 0}, // Red
+        {0, 1, 0}, {0, 1, 0}, // Green
+        {0, 0, 1}, {0, 0, 1}  // Blue
+    };
+    geometry_->fallbackAxes = geometry_->arena.add(*Mesh::Create(verts, {}, colors));
+}
+
+namespace {
+
+// Meshes without vertices are drawn as axes, like frames without a mesh.
+bool drawable(const Mesh::Ptr &mesh) { return mesh && mesh->vertexCount() > 0; }
+
+} // namespace
+
+void Renderer::Impl::addFrame(const Frame::Ptr &frame) {
+    frames_.push_back(frame);
+    hold(frame->mesh());
+    heldMeshes_.push_back(drawable(frame->mesh()) ? frame->mesh().get() : nullptr);
+    for (const auto &child : frame->children()) {
+        addFrame(child);
+    }
+}
+
+void Renderer::Impl::hold(const Mesh::Ptr &mesh) {
+    if (drawable(mesh) && meshHolders_[mesh.get()]++ == 0) geometry_->acquire(mesh);
+}
+
+void Renderer::Impl::letGo(const Mesh *mesh) {
+    if (!mesh) return;
+    auto it = meshHolders_.find(mesh);
+    if (--it->second > 0) return;
+    meshHolders_.erase(it);
+    geometry_->release(mesh);
+}
+
+void Renderer::Impl::syncMeshes() {
+    for (std::size_t i = 0; i < frames_.size(); ++i) {
+        const Mesh::Ptr &mesh = frames_[i]->mesh();
+        const Mesh *current = drawable(mesh) ? mesh.get() : nullptr;
+        if (current == heldMeshes_[i]) continue;
+        // Held before the old one is let go, so that nothing is released just to be uploaded again.
+        hold(mesh);
+        letGo(heldMeshes_[i]);
+        heldMeshes_[i] = current;
+    }
+}
+
+const GeometryArena::Range &Renderer::Impl::geometryFor(const Mesh::Ptr &mesh) {
+    if (!drawable(mesh)) return geometry_->fallbackAxes;
+    return geometry_->gpuMeshes.find(mesh.get())->second.range;
+}
+
+bool Renderer::Impl::meshesChanged() const {
+    if (groupedMeshes_.size() != frames_.size()) return true;
+    for (std::size_t i = 0; i < frames_.size(); ++i) {
+        if (groupedMeshes_[i] != frames_[i]->mesh().get()) return true;
+    }
+    return false;
+}
+
+void Renderer::Impl::updateDrawGroups() {
+    if (!meshesChanged()) return;
+    groupedMeshes_.resize(frames_.size());
+    for (std::size_t i = 0; i < frames_.size(); ++i) {
+        groupedMeshes_[i] = frames_[i]->mesh().get();
+    }
+    bvhNeedsBuild_ = true;
+    cullRecordsDirty_ = true;
+
+    // Meshes no frame of any renderer uses anymore are released here, and their arena ranges reused by later uploads.
+    syncMeshes();
+    std::vector<const GeometryArena::Range *> geometry(frames_.size());
+    {
+        std::lock_guard<std::mutex> lock(geometry_->mutex);
+        for (std::size_t i = 0; i < frames_.size(); ++i) {
+            geometry[i] = &geometryFor(frames_[i]->mesh());
+        }
+    }
+    drawOrder_.resize(frames_.size());
+    for (std::size_t i = 0; i < drawOrder_.size(); ++i) {
+        drawOrder_[i] = i;
+    }
+    // Triangle groups first so that each primitive mode is one contiguous run of indirect commands.
+    std::stable_sort(drawOrder_.begin(), drawOrder_.end(), [&](std::size_t a, std::size_t b) {
+        const bool linesA = geometry[a]->mode == GL_LINES, linesB = geometry[b]->mode == GL_LINES;
+        if (linesA != linesB) return linesB;
+        return std::less<>()(geometry[a], geometry[b]);
+    });
+
+    drawGroups_.clear();
+    for (std::size_t k = 0; k < drawOrder_.size(); ++k) {
+        const GeometryArena::Range *g = geometry[drawOrder_[k]];
+        if (drawGroups_.empty() || drawGroups_.back().geometry != g) drawGroups_.push_back({g, k, 0});
+        ++drawGroups_.back().count;
+    }
+}
+
+void Renderer::Impl::cullFrames(const Eigen::Matrix4f &viewProjection) {
+    const std::size_t n = frames_.size();
+    visible_.assign(n, frustumCulling_ ? 0 : 1);
+    stats_.occluded = 0;
+    if (!frustumCulling_) return;
+
+    if (treeVersions_.update(frames_) || bvhNeedsBuild_) {
+        worldBounds_.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            worldBounds_[i] = localBounds(frames_[i]->mesh()).transformed(frames_[i]->worldX());
+        }
+
+        // Refitting is cheap but loosens the tree as frames move apart, so rebuild once it has grown a lot.
+        if (!bvhNeedsBuild_) {
+            bvh_.refit(worldBounds_);
+            bvhNeedsBuild_ = !bvh_.empty() && bvh_.nodes()[0].bounds.surfaceArea() > 2.0f * builtRootArea_;
+        }
+        if (bvhNeedsBuild_) {
+            bvh_.build(worldBounds_);
+            builtRootArea_ = bvh_.empty() ? 0.0f : bvh_.nodes()[0].bounds.surfaceArea();
+            bvhNeedsBuild_ = false;
+        }
+    }
+
+    bvh_.query(Frustum(viewProjection), [&](std::uint32_t i) { visible_[i] = 1; });
+    if (occlusionCulling_) stats_.occluded = occlusion_.cull(viewProjection, bvh_, frames_, worldBounds_, visible_);
+}
+
+void Renderer::Impl::updateCullRecords() {
+    if (!cullRecordsDirty_) return;
+    cullRecords_.resize(drawOrder_.size());
+    for (std::size_t g = 0; g < drawGroups_.size(); ++g) {
+        const DrawGroup &group = drawGroups_[g];
+        for (std::size_t k = group.first; k < group.first + group.count; ++k) {
+            const Aabb &bounds = localBounds(frames_[drawOrder_[k]]->mesh());
+            cullRecords_[k] = {bounds.center(), static_cast<GLuint>(g), bounds.extent()};
+        }
+    }
+    gpuCuller_.setRecords(cullRecords_);
+    cullRecordsDirty_ = false;
+}
+
+std::size_t Renderer::Impl::uploadInstances() {
+    instances_.clear();
+    visibleGroups_.clear();
+    for (const auto &group : drawGroups_) {
+        const std::size_t first = instances_.size();
+        for (std::size_t k = group.first; k < group.first + group.count; ++k) {
+            const std::size_t i = drawOrder_[k];
+            if (!visible_[i]) continue;
+            const Frame &frame = *frames_[i];
+            const Eigen::Isometry3f &X = frame.worldX();
+            InstanceData &instance = instances_.emplace_back();
+            instance.model = X.matrix();
+            instance.model(3, 0) = static_cast<float>(i + 1);
+            instance.normalTint.topRows<3>() = X.linear().inverse().transpose();
+            instance.normalTint.row(3) = frame.frameColor.transpose();
+        }
+        if (instances_.size() > first) {
+            visibleGroups_.push_back({group.geometry, first, static_cast<GLsizei>(instances_.size() - first)});
+        }
+    }
+    stats_.visible = instances_.size();
+    stats_.culled = frames_.size() - instances_.size();
+
+    const std::size_t base = instanceRing_.write(instances_);
+    arenaBinding_.reserveInstanceIds(InstanceRing::kSections * instanceRing_.capacity);
+    return base;
+}
+
+void Renderer::Impl::drawGroups(std::size_t base, const DrawProgram &program,
+                              const Eigen::Matrix4f *gpuCullViewProjection) {
+    const GLint baseInstanceLoc = program.baseInstance;
+    arenaBinding_.bind(geometry_->arena);
+
+    if (!multiDrawIndirect_) {
+        // Without base instance support the ring offset goes through a uniform, one draw per group.
+        stats_.drawCalls = visibleGroups_.size();
+        for (const auto &group : visibleGroups_) {
+            const auto &g = *group.geometry;
+            glUniform1i(baseInstanceLoc, static_cast<GLint>(base + group.first));
+            glDrawElementsInstancedBaseVertex(g.mode, g.indexCount, GL_UNSIGNED_INT,
+                                              (void *)(g.firstIndex * sizeof(std::uint32_t)), group.count,
+                                              g.baseVertex);
+        }
+        return;
+    }
+
+    commands_.clear();
+    triangleCommands_ = 0;
+    for (const auto &group : visibleGroups_) {
+        const auto &g = *group.geometry;
+        if (gpuCullViewProjection) {
+            // The cull shader counts the instances; the base instance indexes the group's run of visible ids.
+            commands_.push_back({static_cast<GLuint>(g.indexCount), 0, g.firstIndex, g.baseVertex,
+                                 static_cast<GLuint>(group.first)});
+        } else {
+            commands_.push_back({static_cast<GLuint>(g.indexCount), static_cast<GLuint>(group.count), g.firstIndex,
+                                 g.baseVertex, static_cast<GLuint>(base + group.first)});
+        }
+        if (g.mode == GL_TRIANGLES) ++triangleCommands_;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer_);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands_.size() * sizeof(commands_[0]), commands_.data(),
+                 GL_STREAM_DRAW);
+
+    if (gpuCullViewProjection) {
+        Eigen::Matrix<float, 6, 4, Eigen::RowMajor> planes;
+        if (frustumCulling_) {
+            planes = Frustum(*gpuCullViewProjection).planes;
+        } else {
+            planes.setZero();
+            planes.col(3).setOnes();
+        }
+        gpuCuller_.dispatch(instanceRing_.buffer, base, commandBuffer_, planes);
+        glUseProgram(program.id);
+        glUniform1i(baseInstanceLoc, static_cast<GLint>(base));
+    } else {
+        glUniform1i(baseInstanceLoc, 0);
+    }
+    const GLsizei lineCommands = static_cast<GLsizei>(commands_.size() - triangleCommands_);
+    stats_.drawCalls = (triangleCommands_ > 0) + (lineCommands > 0);
+    if (triangleCommands_ > 0) {
+        glext::MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr,
+                                         static_cast<GLsizei>(triangleCommands_), 0);
+    }
+    if (lineCommands > 0) {
+        glext::MultiDrawElementsIndirect(GL_LINES, GL_UNSIGNED_INT,
+                                         (void *)(triangleCommands_ * sizeof(commands_[0])), lineCommands, 0);
+    }
+}
+
+void Renderer::Impl::render(const Eigen::Matrix4f &view, const Eigen::Matrix4f &projection) {
+    const Eigen::Matrix4f viewProjection = projection * view;
+    const Eigen::Vector3f eye = -view.topLeftCorner<3, 3>().transpose() * view.topRightCorner<3, 1>();
+
+    const bool gpuCulling = gpuCulling_ && gpuCuller_.program;
+    const DrawProgram &program = gpuCulling ? gpuCulledDrawProgram_ : drawProgram_;
+
+    // Per draw buffer, since glClear leaves integer attachments undefined. Clearing a draw buffer that is GL_NONE, like
+    // the second one of the default framebuffer, does nothing.
+    static const GLfloat background[] = {0.1f, 0.1f, 0.1f, 1.0f}, farDepth = 1.0f;
+    static const GLuint noFrame = 0;
+    glClearBufferfv(GL_COLOR, 0, background);
+    glClearBufferuiv(GL_COLOR, 1, &noFrame);
+    glClearBufferfv(GL_DEPTH, 0, &farDepth);
+    glUseProgram(program.id);
+
+    glUniformMatrix4fv(program.view, 1, GL_FALSE, view.data());
+    glUniformMatrix4fv(program.proj, 1, GL_FALSE, projection.data());
+    glUniform3fv(program.lightPos, 1, Eigen::Vector3f(5.0f, 5.0f, 5.0f).data());
+    glUniform3fv(program.viewPos, 1, eye.data());
+
+    updateDrawGroups();
+    if (gpuCulling) {
+        // Every frame is uploaded in draw order; the cull shader picks the visible ones.
+        visible_.assign(frames_.size(), 1);
+        updateCullRecords();
+    } else {
+        cullFrames(viewProjection);
+    }
+    const std::size_t base = uploadInstances();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, instanceRing_.texture);
+    glUniform1i(program.instances, 0);
+    if (gpuCulling) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_BUFFER, gpuCuller_.visibleIdsTexture);
+        glUniform1i(program.visibleIds, 1);
+    }
+    drawGroups(base, program, gpuCulling ? &viewProjection : nullptr);
+    instanceRing_.fence();
+}
+
+Renderer::Renderer(const Renderer *shareGeometry)
+    : pimpl_(std::make_unique<Impl>(shareGeometry ? shareGeometry->pimpl_->geometry_ : nullptr)) {}
+
+Renderer::~Renderer() = default;
+
+void Renderer::addFrame(const Frame::Ptr &frame) { pimpl_->addFrame(frame); }
+
+const std::vector<Frame::Ptr> &Renderer::frames() const noexcept { return pimpl_->frames_; }
+
+void Renderer::uploadMeshes() { pimpl_->syncMeshes(); }
+
+void Renderer::render(const Eigen::Matrix4f &view, const Eigen::Matrix4f &projection) {
+    pimpl_->render(view, projection);
+}
+
+void Renderer::setFrustumCulling(bool enabled) { pimpl_->frustumCulling_ = enabled; }
+
+void Renderer::setGpuCulling(bool enabled) { pimpl_->gpuCulling_ = enabled; }
+
+void Renderer::setOcclusionCulling(bool enabled) { pimpl_->occlusionCulling_ = enabled; }
+
+bool Renderer::gpuCullingSupported() const { return pimpl_->gpuCuller_.program != 0; }
+
+const RenderStats &Renderer::stats() const noexcept { return pimpl_->stats_; }
+
+bool Renderer::meshesChanged() const { return pimpl_->meshesChanged(); }
+
+bool Renderer::transformsChanged(TreeVersions &seen) const { return seen.update(pimpl_->frames_); }
+
+} // namespace toph
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "frame.h"
+#include "transform_tree.h"
+#include <Eigen/Core>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace toph {
+
+// Counters of the last rendered frame.
+struct RenderStats {
+    std::size_t visible = 0;
+    std::size_t culled = 0;
+    // Part of culled hidden behind occluders.
+    std::size_t occluded = 0;
+    std::size_t drawCalls = 0;
+};
+
+// Draws a scene of frames into the framebuffer and viewport bound in the current GL context. Shared by the windowed
+// Viewer and the HeadlessRenderer; it owns the GPU copies of the scene, so it must be created and used with the same
+// context current, after gladLoadGLLoader and glext::load.
+//
+// Besides the color, each fragment writes the id of its frame, the frame's index in frames() plus one, to the second
+// draw buffer; bind a GL_R32UI attachment there to get per-pixel frame ids at no extra pass. Background pixels are 0.
+class Renderer {
+  public:
+    // With shareGeometry, meshes are uploaded once into buffers both renderers draw from; the current context must
+    // then share objects with shareGeometry's. Uploading new meshes through renderers on different threads at the same
+    // time is not supported: to render from several threads, call uploadMeshes() on one renderer first.
+    explicit Renderer(const Renderer *shareGeometry = nullptr);
+    ~Renderer();
+
+    Renderer(const Renderer &) = delete;
+    Renderer &operator=(const Renderer &) = delete;
+
+    // Adds the frame and its subtree.
+    void addFrame(const Frame::Ptr &frame);
+    const std::vector<Frame::Ptr> &frames() const noexcept;
+
+    // Uploads the current mesh of every frame that isn't on the GPU yet, which render() would otherwise do on demand,
+    // and frees the space of meshes no frame of any sharing renderer uses anymore for later uploads. Other contexts
+    // only see the data once the upload commands have completed.
+    void uploadMeshes();
+
+    // Clears the framebuffer and draws every frame.
+    void render(const Eigen::Matrix4f &view, const Eigen::Matrix4f &projection);
+
+    // See the Viewer setters of the same names.
+    void setFrustumCulling(bool enabled);
+    void setGpuCulling(bool enabled);
+    void setOcclusionCulling(bool enabled);
+    bool gpuCullingSupported() const;
+
+    const RenderStats &stats() const noexcept;
+
+    // True if a frame's mesh changed since the last render().
+    bool meshesChanged() const;
+    // Compares the transform trees of the scene with `seen` and updates it.
+    bool transformsChanged(TreeVersions &seen) const;
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+} // namespace toph
@@ -0,0 +1,393 @@
+#include "scene.h"
+#include "bvh.h"
+#include "mesh_bvh.h"
+#include "thread_pool.h"
+#include "transform_tree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace toph {
+
+namespace {
+
+// Deep enough for any tree Bvh::build() makes: the SAH levels are capped and the median splits below them halve.
+constexpr int kStackSize = 128;
+
+using Triangle = MeshBvh::Triangle;
+
+// 1 / c for the slab tests, with zero components nudged off zero: an infinite inverse times a zero distance to a slab
+// would give NaN for rays starting on a box face.
+float safeInverse(float c) { return 1.0f / (c != 0.0f ? c : 1e-30f); }
+
+// A ray with a unit direction and its componentwise inverse for the slab tests.
+struct TracedRay {
+    Eigen::Vector3f origin;
+    Eigen::Vector3f direction;
+    Eigen::Vector3f inverse;
+
+    TracedRay(const Eigen::Vector3f &o, const Eigen::Vector3f &d)
+        : origin(o), direction(d), inverse(d.unaryExpr(&safeInverse)) {}
+};
+
+// Distance at which the ray enters the box, or infinity if it misses it or only reaches it beyond tMax.
+float enter(const Aabb &box, const TracedRay &ray, float tMax) {
+    const Eigen::Array3f t0 = (box.min - ray.origin).array() * ray.inverse.array();
+    const Eigen::Array3f t1 = (box.max - ray.origin).array() * ray.inverse.array();
+    const float tEnter = std::max(t0.min(t1).maxCoeff(), 0.0f);
+    const float tExit = std::min(t0.max(t1).minCoeff(), tMax);
+    return tEnter <= tExit ? tEnter : std::numeric_limits<float>::infinity();
+}
+
+// Moller-Trumbore, two-sided. Updates t if the triangle is hit closer than it.
+bool intersect(const Triangle &tri, const TracedRay &ray, float &t) {
+    const Eigen::Vector3f p = ray.direction.cross(tri.e2);
+    const float det = tri.e1.dot(p);
+    if (det == 0.0f) return false;
+    const float invDet = 1.0f / det;
+    const Eigen::Vector3f s = ray.origin - tri.v0;
+    const float u = s.dot(p) * invDet;
+    if (u < 0.0f || u > 1.0f) return false;
+    const Eigen::Vector3f q = s.cross(tri.e1);
+    const float v = ray.direction.dot(q) * invDet;
+    if (v < 0.0f || u + v > 1.0f) return false;
+    const float hit = tri.e2.dot(q) * invDet;
+    if (hit < 0.0f || hit >= t) return false;
+    t = hit;
+    return true;
+}
+
+// Visits the leaves the ray enters before tMax, nearer children first, so that leaf(node) shortening tMax prunes the
+// rest of the tree.
+template <typename Leaf>
+void traverseNearestFirst(const Bvh &bvh, const TracedRay &ray, const float &tMax, Leaf &&leaf) {
+    const auto &nodes = bvh.nodes();
+    if (nodes.empty() || std::isinf(enter(nodes[0].bounds, ray, tMax))) return;
+    std::uint32_t stack[kStackSize];
+    float entry[kStackSize];
+    int top = 0;
+    std::uint32_t index = 0;
+    while (true) {
+        const Bvh::Node &node = nodes[index];
+        if (!node.isLeaf()) {
+            std::uint32_t nearChild = index + 1, farChild = node.offset;
+            float nearT = enter(nodes[nearChild].bounds, ray, tMax);
+            float farT = enter(nodes[farChild].bounds, ray, tMax);
+            if (farT < nearT) {
+                std::swap(nearChild, farChild);
+                std::swap(nearT, farT);
+            }
+            if (!std::isinf(nearT)) {
+                if (!std::isinf(farT)) {
+                    stack[top] = farChild;
+                    entry[top++] = farT;
+                }
+                index = nearChild;
+                continue;
+            }
+        } else {
+            leaf(node);
+        }
+        // Pop the next subtree that still starts before the closest hit so far.
+        while (top > 0 && entry[top - 1] >= tMax) {
+            --top;
+        }
+        if (top == 0) return;
+        index = stack[--top];
+    }
+}
+
+// Rays with one origin traced together. Eigen maps the lanes onto SSE or AVX registers, whichever the build enables.
+constexpr int kPacketSize = 8;
+using Lanes = Eigen::Array<float, kPacketSize, 1>;
+
+struct RayPacket {
+    Eigen::Vector3f origin;
+    Lanes dx, dy, dz;
+    Lanes ix, iy, iz;
+
+    RayPacket(const Eigen::Vector3f &o, const Lanes &x, const Lanes &y, const Lanes &z)
+        : origin(o), dx(x), dy(y), dz(z), ix(safeInverse(x)), iy(safeInverse(y)), iz(safeInverse(z)) {}
+
+    static Lanes safeInverse(const Lanes &c) { return (c == 0.0f).select(Lanes::Constant(1e-30f), c).inverse(); }
+
+    // The packet in the space of X, which must be rigid.
+    RayPacket transformed(const Eigen::Isometry3f &X) const {
+        const Eigen::Matrix3f R = X.linear();
+        return RayPacket(X * origin, R(0, 0) * dx + R(0, 1) * dy + R(0, 2) * dz,
+                         R(1, 0) * dx + R(1, 1) * dy + R(1, 2) * dz, R(2, 0) * dx + R(2, 1) * dy + R(2, 2) * dz);
+    }
+};
+
+// Per lane, like enter() for single rays.
+Lanes enter(const Aabb &box, const RayPacket &packet, const Lanes &tMax) {
+    const Eigen::Vector3f lo = box.min - packet.origin, hi = box.max - packet.origin;
+    const Lanes x0 = lo.x() * packet.ix, x1 = hi.x() * packet.ix;
+    const Lanes y0 = lo.y() * packet.iy, y1 = hi.y() * packet.iy;
+    const Lanes z0 = lo.z() * packet.iz, z1 = hi.z() * packet.iz;
+    const Lanes tEnter = x0.min(x1).max(y0.min(y1)).max(z0.min(z1).max(0.0f));
+    const Lanes tExit = x0.max(x1).min(y0.max(y1)).min(z0.max(z1).min(tMax));
+    return (tEnter <= tExit).select(tEnter, std::numeric_limits<float>::infinity());
+}
+
+// Per lane, like intersect() for single rays, keeping only hits no closer than tMin. The packet's shared origin makes
+// the second edge cross product and the distance numerator scalars.
+void intersect(const Triangle &tri, const RayPacket &packet, float tMin, Lanes &tMax) {
+    const Eigen::Vector3f &e1 = tri.e1, &e2 = tri.e2;
+    const Lanes px = packet.dy * e2.z() - packet.dz * e2.y();
+    const Lanes py = packet.dz * e2.x() - packet.dx * e2.z();
+    const Lanes pz = packet.dx * e2.y() - packet.dy * e2.x();
+    const Lanes invDet = (e1.x() * px + e1.y() * py + e1.z() * pz).inverse();
+    const Eigen::Vector3f s = packet.origin - tri.v0;
+    const Eigen::Vector3f q = s.cross(e1);
+    const Lanes u = (s.x() * px + s.y() * py + s.z() * pz) * invDet;
+    const Lanes v = (q.x() * packet.dx + q.y() * packet.dy + q.z() * packet.dz) * invDet;
+    const Lanes t = e2.dot(q) * invDet;
+    // Written so that the NaNs of parallel rays fail every comparison.
+    const auto hit = (u >= 0.0f) && (v >= 0.0f) && (u + v <= 1.0f) && (t >= tMin) && (t < tMax);
+    tMax = hit.select(t, tMax);
+}
+
+// traverseNearestFirst() for a packet: descends into a node while any lane enters it before its tMax. Children are
+// ordered by the smallest entry distance over the lanes.
+template <typename Leaf> void traversePacket(const Bvh &bvh, const RayPacket &packet, const Lanes &tMax, Leaf &&leaf) {
+    constexpr float kMiss = std::numeric_limits<float>::infinity();
+    const auto &nodes = bvh.nodes();
+    if (nodes.empty() || enter(nodes[0].bounds, packet, tMax).minCoeff() == kMiss) return;
+    std::uint32_t stack[kStackSize];
+    float entry[kStackSize];
+    int top = 0;
+    std::uint32_t index = 0;
+    while (true) {
+        const Bvh::Node &node = nodes[index];
+        if (!node.isLeaf()) {
+            std::uint32_t nearChild = index + 1, farChild = node.offset;
+            float nearT = enter(nodes[nearChild].bounds, packet, tMax).minCoeff();
+            float farT = enter(nodes[farChild].bounds, packet, tMax).minCoeff();
+            if (farT < nearT) {
+                std::swap(nearChild, farChild);
+                std::swap(nearT, farT);
+            }
+            if (nearT != kMiss) {
+                if (farT != kMiss) {
+                    stack[top] = farChild;
+                    entry[top++] = farT;
+                }
+                index = nearChild;
+                continue;
+            }
+        } else {
+            leaf(node);
+        }
+        const float farthest = tMax.maxCoeff();
+        while (top > 0 && entry[top - 1] >= farthest) {
+            --top;
+        }
+        if (top == 0) return;
+        index = stack[--top];
+    }
+}
+
+} // namespace
+
+struct Scene::Impl {
+    std::vector<Frame::Ptr> frames_;
+    // Each frame's mesh when the instances were last gathered, to notice setMesh().
+    std::vector<const Mesh *> meshes_;
+    MeshBvhCache meshBvhs_;
+
+    // The frames with triangles, with the world-to-local transforms of the last refresh().
+    struct Instance {
+        std::uint32_t frame;
+        const MeshBvh *mesh;
+        Eigen::Isometry3f toLocal;
+    };
+    std::vector<Instance> instances_;
+
+    // Top-level BVH over the instances' world bounds, rebuilt when the instances change and refit when a transform
+    // tree reports a new version.
+    Bvh bvh_;
+    bool bvhNeedsBuild_ = true;
+    float builtRootArea_ = 0.0f;
+    std::vector<Aabb> worldBounds_;
+    TreeVersions treeVersions_;
+
+    void addFrame(const Frame::Ptr &frame);
+    // Brings the BVHs and transforms up to date with the frames; raycasts only read them afterwards.
+    void refresh();
+    RayHit trace(const Eigen::Vector3f &origin, const Eigen::Vector3f &direction, float maxDistance) const;
+    // Returns the distance per lane, infinity for misses.
+    Lanes tracePacket(const RayPacket &packet, float minDistance, float maxDistance) const;
+
+  private:
+    bool meshesChanged() const;
+    void gatherInstances();
+};
+
+void Scene::Impl::addFrame(const Frame::Ptr &frame) {
+    frames_.push_back(frame);
+    for (const auto &child : frame->children()) {
+        addFrame(child);
+    }
+}
+
+bool Scene::Impl::meshesChanged() const {
+    if (meshes_.size() != frames_.size()) return true;
+    for (std::size_t i = 0; i < frames_.size(); ++i) {
+        if (meshes_[i] != frames_[i]->mesh().get()) return true;
+    }
+    return false;
+}
+
+void Scene::Impl::gatherInstances() {
+    meshes_.resize(frames_.size());
+    for (std::size_t i = 0; i < frames_.size(); ++i) {
+        meshes_[i] = frames_[i]->mesh().get();
+    }
+    const std::vector<const MeshBvh *> bvhs = meshBvhs_.update(frames_);
+    instances_.clear();
+    for (std::size_t i = 0; i < frames_.size(); ++i) {
+        if (bvhs[i]) instances_.push_back({static_cast<std::uint32_t>(i), bvhs[i], Eigen::Isometry3f::Identity()});
+    }
+    bvhNeedsBuild_ = true;
+}
+
+void Scene::Impl::refresh() {
+    if (meshesChanged()) gatherInstances();
+    if (!treeVersions_.update(frames_) && !bvhNeedsBuild_) return;
+
+    // World transforms are computed lazily; settle them here so that parallel traces only read.
+    for (const auto &frame : frames_) {
+        if (frame->tree()->dirty()) frame->tree()->updateWorldTransforms();
+    }
+    worldBounds_.resize(instances_.size());
+    for (std::size_t k = 0; k < instances_.size(); ++k) {
+        Instance &instance = instances_[k];
+        const Eigen::Isometry3f &X = frames_[instance.frame]->worldX();
+        instance.toLocal = X.inverse(Eigen::Isometry);
+        worldBounds_[k] = instance.mesh->mesh->bounds().transformed(X);
+    }
+
+    // Refitting is cheap but loosens the tree as frames move apart, so rebuild once it has grown a lot.
+    if (!bvhNeedsBuild_) {
+        bvh_.refit(worldBounds_);
+        bvhNeedsBuild_ = !bvh_.empty() && bvh_.nodes()[0].bounds.surfaceArea() > 2.0f * builtRootArea_;
+    }
+    if (bvhNeedsBuild_) {
+        bvh_.build(worldBounds_);
+        builtRootArea_ = bvh_.empty() ? 0.0f : bvh_.nodes()[0].bounds.surfaceArea();
+        bvhNeedsBuild_ = false;
+    }
+}
+
+RayHit Scene::Impl::trace(const Eigen::Vector3f &origin, const Eigen::Vector3f &direction, float maxDistance) const {
+    RayHit hit;
+    const float length = direction.norm();
+    if (!(length > 0.0f)) return hit;
+    const TracedRay ray(origin, direction / length);
+
+    // Frame transforms are rigid, so distances along the local rays are world distances.
+    float tMax = maxDistance;
+    const Instance *hitInstance = nullptr;
+    std::uint32_t hitTriangle = 0;
+    const auto &instanceOrder = bvh_.primitives();
+    traverseNearestFirst(bvh_, ray, tMax, [&](const Bvh::Node &leaf) {
+        for (std::uint32_t i = 0; i < leaf.count; ++i) {
+            const Instance &instance = instances_[instanceOrder[leaf.offset + i]];
+            const MeshBvh &mesh = *instance.mesh;
+            const TracedRay local(instance.toLocal * ray.origin, instance.toLocal.linear() * ray.direction);
+            traverseNearestFirst(mesh.bvh, local, tMax, [&](const Bvh::Node &meshLeaf) {
+                for (std::uint32_t k = meshLeaf.offset; k < meshLeaf.offset + meshLeaf.count; ++k) {
+                    if (intersect(mesh.triangles[k], local, tMax)) {
+                        hitInstance = &instance;
+                        hitTriangle = mesh.bvh.primitives()[k];
+                    }
+                }
+            });
+        }
+    });
+    if (hitInstance) {
+        hit.frame = frames_[hitInstance->frame];
+        hit.triangle = hitTriangle;
+        hit.distance = tMax;
+    }
+    return hit;
+}
+
+Lanes Scene::Impl::tracePacket(const RayPacket &packet, float minDistance, float maxDistance) const {
+    Lanes tMax = Lanes::Constant(maxDistance);
+    const auto &instanceOrder = bvh_.primitives();
+    traversePacket(bvh_, packet, tMax, [&](const Bvh::Node &leaf) {
+        for (std::uint32_t i = 0; i < leaf.count; ++i) {
+            const Instance &instance = instances_[instanceOrder[leaf.offset + i]];
+            const MeshBvh &mesh = *instance.mesh;
+            const RayPacket local = packet.transformed(instance.toLocal);
+            traversePacket(mesh.bvh, local, tMax, [&](const Bvh::Node &meshLeaf) {
+                for (std::uint32_t k = meshLeaf.offset; k < meshLeaf.offset + meshLeaf.count; ++k) {
+                    intersect(mesh.triangles[k], local, minDistance, tMax);
+                }
+            });
+        }
+    });
+    return (tMax < maxDistance).select(tMax, std::numeric_limits<float>::infinity());
+}
+
+Scene::Scene() : pimpl_(std::make_unique<Impl>()) {}
+
+Scene::~Scene() = default;
+
+void Scene::addFrame(const Frame::Ptr &frame) { pimpl_->addFrame(frame); }
+
+const std::vector<Frame::Ptr> &Scene::frames() const noexcept { return pimpl_->frames_; }
+
+RayHit Scene::raycast(const Eigen::Vector3f &origin, const Eigen::Vector3f &direction, float maxDistance) {
+    pimpl_->refresh();
+    return pimpl_->trace(origin, direction, maxDistance);
+}
+
+std::vector<RayHit> Scene::raycastMany(const std::vector<Ray> &rays, std::size_t threadCount) {
+    pimpl_->refresh();
+    std::vector<RayHit> hits(rays.size());
+    ThreadPool &pool = ThreadPool::shared();
+    const Impl &impl = *pimpl_;
+    pool.parallelFor(rays.size(), threadCount == 0 ? pool.size() + 1 : threadCount,
+                     [&](std::size_t begin, std::size_t end) {
+                         for (std::size_t i = begin; i < end; ++i) {
+                             hits[i] = impl.trace(rays[i].origin, rays[i].direction, rays[i].maxDistance);
+                         }
+                     });
+    return hits;
+}
+
+void Scene::raycastDistances(const Eigen::Isometry3f &pose, const std::vector<Eigen::Vector3f> &directions,
+                             float minDistance, float maxDistance, std::vector<float> &distances,
+                             std::size_t threadCount) {
+    pimpl_->refresh();
+    const std::size_t n = directions.size();
+    distances.resize(n);
+    ThreadPool &pool = ThreadPool::shared();
+    const Impl &impl = *pimpl_;
+    const std::size_t packets = (n + kPacketSize - 1) / kPacketSize;
+    pool.parallelFor(packets, threadCount == 0 ? pool.size() + 1 : threadCount,
+                     [&](std::size_t begin, std::size_t end) {
+                         Lanes x, y, z;
+                         for (std::size_t p = begin; p < end; ++p) {
+                             // The last packet repeats its final ray in the lanes past the end.
+                             const std::size_t first = p * kPacketSize;
+                             for (int k = 0; k < kPacketSize; ++k) {
+                                 const Eigen::Vector3f &d = directions[std::min(first + k, n - 1)];
+                                 x[k] = d.x();
+                                 y[k] = d.y();
+                                 z[k] = d.z();
+                             }
+                             const RayPacket packet = RayPacket(Eigen::Vector3f::Zero(), x, y, z).transformed(pose);
+                             const Lanes t = impl.tracePacket(packet, minDistance, maxDistance);
+                             for (int k = 0; k < kPacketSize && first + k < n; ++k) {
+                                 distances[first + k] = t[k];
+                             }
+                         }
+                     });
+}
+
+} // namespace toph
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "frame.h"
+#include <Eigen/Geometry>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace toph {
+
+struct Ray {
+    Eigen::Vector3f origin = Eigen::Vector3f::Zero();
+    // Needn't be normalized.
+    Eigen::Vector3f direction = Eigen::Vector3f::UnitX();
+    float maxDistance = std::numeric_limits<float>::infinity();
+};
+
+struct RayHit {
+    Frame::Ptr frame; // nullptr on a miss
+    // Index of the hit triangle in frame->mesh(), see Mesh::face().
+    std::uint32_t triangle = 0;
+    // World-space distance from the ray origin.
+    float distance = std::numeric_limits<float>::infinity();
+
+    explicit operator bool() const noexcept { return frame != nullptr; }
+};
+
+// Ray queries against the triangles of a set of frames. Each mesh gets a triangle BVH in its local space, built once
+// and shared by all frames using it; a top-level BVH over the frames' world bounds is refit when transforms change,
+// so moving frames costs no triangle work. Frames without a mesh, and line meshes, are never hit. Triangles are hit
+// from both sides.
+class Scene {
+  public:
+    Scene();
+    ~Scene();
+
+    Scene(const Scene &) = delete;
+    Scene &operator=(const Scene &) = delete;
+
+    // Adds the frame and its subtree. The first raycast afterwards builds the BVHs of meshes it hasn't seen yet.
+    void addFrame(const Frame::Ptr &frame);
+    const std::vector<Frame::Ptr> &frames() const noexcept;
+
+    // Closest hit along the ray. Picks up transform and mesh changes since the last call; don't change the frames
+    // while a raycast runs.
+    RayHit raycast(const Eigen::Vector3f &origin, const Eigen::Vector3f &direction,
+                   float maxDistance = std::numeric_limits<float>::infinity());
+    RayHit raycast(const Ray &ray) { return raycast(ray.origin, ray.direction, ray.maxDistance); }
+    // One result per ray, traced in parallel on up to threadCount threads of the shared pool (0 = all of them).
+    std::vector<RayHit> raycastMany(const std::vector<Ray> &rays, std::size_t threadCount = 0);
+
+    // Distances along rays from the origin of a sensor at `pose` (sensor to world), as range sensors cast them:
+    // infinity where no triangle lies between minDistance and maxDistance. Directions are unit vectors in the sensor
+    // frame. Consecutive directions are traced together as SIMD packets, so pass them in scan order. The packets are
+    // split across up to threadCount threads of the shared pool (0 = all of them).
+    void raycastDistances(const Eigen::Isometry3f &pose, const std::vector<Eigen::Vector3f> &directions,
+                          float minDistance, float maxDistance, std::vector<float> &distances,
+                          std::size_t threadCount = 0);
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+} // namespace toph
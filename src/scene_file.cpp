@@ -0,0 +1,230 @@
+#include "scene_file.h"
+#include "atomic_file.h"
+#include "mapped_file.h"
+#include "mesh_cache.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace toph {
+
+namespace {
+
+struct SceneHeader {
+    static constexpr char kMagic[8] = {'T', 'O', 'P', 'H', 'S', 'C', 'N', '\0'};
+    static constexpr std::uint32_t kVersion = 1;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t frameSize;
+    std::uint64_t frameCount;
+    std::uint64_t meshCount;
+    std::uint64_t framesOffset;
+    std::uint64_t meshesOffset;
+    std::uint64_t namesOffset;
+    std::uint64_t namesSize;
+};
+static_assert(sizeof(SceneHeader) == 64, "the frame records start 64 bytes in");
+
+struct FrameRecord {
+    std::uint64_t nameOffset; // into the names
+    std::uint32_t nameLength;
+    std::int32_t parent; // an earlier record, or -1 for a root
+    std::int32_t mesh;   // into the mesh table, or -1
+    float linear[9];     // column-major
+    float translation[3];
+    float color[3];
+};
+static_assert(sizeof(FrameRecord) == 80, "frame records are packed");
+
+struct MeshRecord {
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+constexpr std::uint64_t kAlignment = 64;
+
+std::uint64_t alignUp(std::uint64_t offset) { return (offset + kAlignment - 1) / kAlignment * kAlignment; }
+
+[[noreturn]] void fail(const std::string &path, const std::string &message) {
+    throw std::runtime_error("scene file " + path + ": " + message);
+}
+
+// Tracks the offset and turns write errors into exceptions.
+class SceneWriter {
+  public:
+    explicit SceneWriter(const std::string &path) : path_(path), file_(path) {
+        if (!file_.isOpen()) fail(path_, "cannot open for writing");
+    }
+
+    void write(const void *data, std::size_t size) {
+        if (!file_.write(data, size)) fail(path_, "write error");
+        offset_ += size;
+    }
+    void pad() {
+        static const char zeros[kAlignment] = {};
+        write(zeros, alignUp(offset_) - offset_);
+    }
+    void writeMesh(const Mesh &mesh) {
+        if (!writeMeshBlob(file_.stream(), mesh)) fail(path_, "write error");
+        offset_ += meshBlobSize(mesh);
+    }
+
+    void commit() {
+        if (!file_.commit()) fail(path_, "cannot write");
+    }
+
+  private:
+    std::string path_;
+    AtomicFile file_;
+    std::uint64_t offset_ = 0;
+};
+
+} // namespace
+
+void saveScene(const std::string &path, const std::vector<Frame::Ptr> &roots) {
+    // Pre-order, so every parent is recorded before its children.
+    std::vector<FrameRecord> frames;
+    std::vector<const Mesh *> meshes;
+    std::unordered_map<const Mesh *, std::int32_t> meshIndex;
+    std::string names;
+    std::vector<std::pair<const Frame *, std::int32_t>> stack;
+    for (auto root = roots.rbegin(); root != roots.rend(); ++root) {
+        stack.emplace_back(root->get(), -1);
+    }
+    while (!stack.empty()) {
+        const auto [frame, parent] = stack.back();
+        stack.pop_back();
+        FrameRecord record{};
+        record.nameOffset = names.size();
+        record.nameLength = static_cast<std::uint32_t>(frame->name().size());
+        names += frame->name();
+        record.parent = parent;
+        record.mesh = -1;
+        if (const Mesh *mesh = frame->mesh().get()) {
+            const auto [it, inserted] = meshIndex.emplace(mesh, static_cast<std::int32_t>(meshes.size()));
+            if (inserted) meshes.push_back(mesh);
+            record.mesh = it->second;
+        }
+        const Eigen::Isometry3f X = parent < 0 ? frame->worldX() : frame->X();
+        Eigen::Map<Eigen::Matrix3f>(record.linear) = X.linear();
+        Eigen::Map<Eigen::Vector3f>(record.translation) = X.translation();
+        Eigen::Map<Eigen::Vector3f>(record.color) = frame->frameColor;
+        const auto index = static_cast<std::int32_t>(frames.size());
+        frames.push_back(record);
+        const auto &children = frame->children();
+        for (auto child = children.rbegin(); child != children.rend(); ++child) {
+            stack.emplace_back(child->get(), index);
+        }
+    }
+
+    SceneHeader header{};
+    std::memcpy(header.magic, SceneHeader::kMagic, sizeof(header.magic));
+    header.version = SceneHeader::kVersion;
+    header.frameSize = sizeof(FrameRecord);
+    header.frameCount = frames.size();
+    header.meshCount = meshes.size();
+    header.framesOffset = sizeof(SceneHeader);
+    header.meshesOffset = header.framesOffset + frames.size() * sizeof(FrameRecord);
+    header.namesOffset = header.meshesOffset + meshes.size() * sizeof(MeshRecord);
+    header.namesSize = names.size();
+    // The blob offsets are known before any blob is written, so everything goes out in one pass.
+    std::vector<MeshRecord> meshRecords(meshes.size());
+    std::uint64_t offset = alignUp(header.namesOffset + header.namesSize);
+    for (std::size_t m = 0; m < meshes.size(); ++m) {
+        meshRecords[m] = {offset, meshBlobSize(*meshes[m])};
+        offset = alignUp(offset + meshRecords[m].size);
+    }
+
+    SceneWriter writer(path);
+    writer.write(&header, sizeof(header));
+    writer.write(frames.data(), frames.size() * sizeof(FrameRecord));
+    writer.write(meshRecords.data(), meshRecords.size() * sizeof(MeshRecord));
+    writer.write(names.data(), names.size());
+    for (const Mesh *mesh : meshes) {
+        writer.pad();
+        writer.writeMesh(*mesh);
+    }
+    writer.commit();
+}
+
+std::vector<Frame::Ptr> loadScene(const std::string &path) {
+    auto file = std::make_shared<const MappedFile>(path);
+    const std::uint8_t *data = file->data();
+    const std::uint64_t size = file->size();
+
+    SceneHeader header;
+    if (size < sizeof(header)) fail(path, "too short");
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, SceneHeader::kMagic, sizeof(header.magic)) != 0) fail(path, "not a scene file");
+    if (header.version != SceneHeader::kVersion) fail(path, "unsupported version " + std::to_string(header.version));
+    if (header.frameSize != sizeof(FrameRecord)) fail(path, "unexpected frame record size");
+    // Each range is checked against what is left, so absurd counts can't overflow.
+    const auto fits = [&](std::uint64_t offset, std::uint64_t count, std::uint64_t elementSize) {
+        return offset <= size && count <= (size - offset) / elementSize;
+    };
+    if (!fits(header.framesOffset, header.frameCount, sizeof(FrameRecord)) ||
+        !fits(header.meshesOffset, header.meshCount, sizeof(MeshRecord)) ||
+        !fits(header.namesOffset, header.namesSize, 1)) {
+        fail(path, "truncated");
+    }
+    if (header.framesOffset % alignof(FrameRecord) != 0 || header.meshesOffset % alignof(MeshRecord) != 0) {
+        fail(path, "misaligned tables");
+    }
+    const auto *frames = reinterpret_cast<const FrameRecord *>(data + header.framesOffset);
+    const auto *meshRecords = reinterpret_cast<const MeshRecord *>(data + header.meshesOffset);
+    const char *names = reinterpret_cast<const char *>(data + header.namesOffset);
+
+    // The meshes view their blobs in the mapping. Only their indices are read here, to check them against the vertex
+    // count; vertex pages come in once drawn or tested.
+    std::vector<Mesh::Ptr> meshes(header.meshCount);
+    for (std::size_t m = 0; m < meshes.size(); ++m) {
+        const MeshRecord &record = meshRecords[m];
+        if (record.offset % kAlignment != 0 || !fits(record.offset, record.size, 1)) {
+            fail(path, "mesh " + std::to_string(m) + " out of range");
+        }
+        meshes[m] = meshFromBlob(file, data + record.offset, record.size);
+        if (!meshes[m]) fail(path, "mesh " + std::to_string(m) + " is not a valid blob or has indices out of range");
+    }
+
+    std::vector<Frame::Ptr> created(header.frameCount);
+    std::vector<Frame::Ptr> roots;
+    for (std::size_t f = 0; f < created.size(); ++f) {
+        const FrameRecord &record = frames[f];
+        if (record.nameOffset > header.namesSize || record.nameLength > header.namesSize - record.nameOffset) {
+            fail(path, "name of frame " + std::to_string(f) + " out of range");
+        }
+        if (record.parent >= static_cast<std::int64_t>(f) || record.parent < -1) {
+            fail(path, "frame " + std::to_string(f) + " has an invalid parent");
+        }
+        if (record.mesh >= static_cast<std::int64_t>(meshes.size()) || record.mesh < -1) {
+            fail(path, "frame " + std::to_string(f) + " has an invalid mesh");
+        }
+        Eigen::Isometry3f X = Eigen::Isometry3f::Identity();
+        X.linear() = Eigen::Map<const Eigen::Matrix3f>(record.linear);
+        X.translation() = Eigen::Map<const Eigen::Vector3f>(record.translation);
+        std::string name(names + record.nameOffset, record.nameLength);
+        Frame::Ptr frame;
+        if (record.parent < 0) {
+            frame = std::make_shared<Frame>(std::move(name), X);
+            // Records stay in pre-order, so the hierarchy runs up to the next root.
+            std::size_t end = f + 1;
+            while (end < created.size() && frames[end].parent >= 0) {
+                ++end;
+            }
+            frame->tree()->reserve(end - f);
+            roots.push_back(frame);
+        } else {
+            frame = Frame::CreateChild(created[record.parent], std::move(name), X);
+        }
+        if (record.mesh >= 0) frame->setMesh(meshes[record.mesh]);
+        frame->frameColor = Eigen::Map<const Eigen::Vector3f>(record.color);
+        created[f] = std::move(frame);
+    }
+    return roots;
+}
+
+} // namespace toph
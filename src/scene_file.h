@@ -0,0 +1,23 @@
+#pragma once
+
+#include "frame.h"
+#include <string>
+#include <vector>
+
+namespace toph {
+
+// A binary scene file: a fixed header, one fixed-size record per frame (name, parent index, mesh index, local transform
+// and color) in an order where parents precede their children, a table of meshes, the names, and then every distinct
+// mesh once as a blob in the layout of MeshBlobHeader, 64-byte aligned. Loading maps the file and lets the meshes view
+// their blobs in place. The frame records and every mesh's indices, which are checked against its vertex count, are
+// read up front; vertex pages come in as they are first touched.
+
+// Streams the hierarchies below `roots` to `path`, replacing it only once it is complete. Roots are saved at their
+// world transform. Throws std::runtime_error if the file can't be written.
+void saveScene(const std::string &path, const std::vector<Frame::Ptr> &roots);
+
+// The roots saved in `path`, in order. Meshes shared between frames when saved are shared again, and keep the file
+// mapped while any is referenced. Throws std::runtime_error if the file can't be read or isn't a valid scene.
+std::vector<Frame::Ptr> loadScene(const std::string &path);
+
+} // namespace toph
@@ -0,0 +1,58 @@
+#include "sensor.h"
+
+#include <cmath>
+#include <utility>
+
+namespace toph {
+
+BeamPattern BeamPattern::Spinning(int channels, int steps, float minElevation, float maxElevation) {
+    BeamPattern pattern;
+    if (channels <= 0 || steps <= 0) return pattern;
+    pattern.directions.reserve(static_cast<std::size_t>(channels) * steps);
+    for (int c = 0; c < channels; ++c) {
+        const float elevation =
+            channels > 1 ? minElevation + (maxElevation - minElevation) * c / (channels - 1) : minElevation;
+        for (int s = 0; s < steps; ++s) {
+            const float azimuth = 2.0f * static_cast<float>(M_PI) * s / steps;
+            pattern.directions.emplace_back(std::cos(elevation) * std::cos(azimuth),
+                                            std::cos(elevation) * std::sin(azimuth), std::sin(elevation));
+        }
+    }
+    return pattern;
+}
+
+BeamPattern BeamPattern::Pinhole(int width, int height, float fx, float fy, float cx, float cy) {
+    BeamPattern pattern;
+    if (width <= 0 || height <= 0) return pattern;
+    pattern.directions.reserve(static_cast<std::size_t>(width) * height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            pattern.directions.push_back(Eigen::Vector3f((x - cx) / fx, (y - cy) / fy, 1.0f).normalized());
+        }
+    }
+    return pattern;
+}
+
+RangeSensor::RangeSensor(Frame::Ptr frame, BeamPattern pattern, float minRange, float maxRange)
+    : frame_(std::move(frame)), pattern_(std::move(pattern)), minRange_(minRange), maxRange_(maxRange) {}
+
+void RangeSensor::scan(Scene &scene, std::vector<float> &ranges, std::size_t threadCount) const {
+    scene.raycastDistances(frame_->worldX(), pattern_.directions, minRange_, maxRange_, ranges, threadCount);
+}
+
+std::vector<float> RangeSensor::scan(Scene &scene, std::size_t threadCount) const {
+    std::vector<float> ranges;
+    scan(scene, ranges, threadCount);
+    return ranges;
+}
+
+std::vector<Eigen::Vector3f> RangeSensor::pointCloud(const std::vector<float> &ranges) const {
+    std::vector<Eigen::Vector3f> points;
+    points.reserve(ranges.size());
+    for (std::size_t i = 0; i < ranges.size() && i < pattern_.directions.size(); ++i) {
+        if (std::isfinite(ranges[i])) points.push_back(ranges[i] * pattern_.directions[i]);
+    }
+    return points;
+}
+
+} // namespace toph
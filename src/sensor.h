@@ -0,0 +1,52 @@
+#pragma once
+
+#include "frame.h"
+#include "scene.h"
+#include <Eigen/Core>
+#include <cstddef>
+#include <vector>
+
+namespace toph {
+
+// Unit beam directions of a range sensor in its own frame.
+struct BeamPattern {
+    std::vector<Eigen::Vector3f> directions;
+
+    // A spinning lidar around the frame's z axis: `channels` beams evenly spread between the elevations (radians above
+    // the xy plane), fired at `steps` azimuths per revolution starting along +x. Beams are laid out like a range image:
+    // one row of azimuths per channel, lowest channel first. Neighbours within a row are nearly parallel, which keeps
+    // the ray packets tight.
+    static BeamPattern Spinning(int channels, int steps, float minElevation, float maxElevation);
+    // A depth camera with the OpenCV pinhole conventions: looking along +z, +x right, +y down, pixel centers at integer
+    // coordinates. Beams are in row-major pixel order.
+    static BeamPattern Pinhole(int width, int height, float fx, float fy, float cx, float cy);
+};
+
+// A range sensor mounted on a frame, casting its beams against a Scene on the CPU. Beams share the frame's origin and
+// are traced as SIMD packets split across the shared thread pool.
+class RangeSensor {
+  public:
+    // Returns closer than minRange are ignored, so a sensor mounted inside its robot's meshes sees past them.
+    RangeSensor(Frame::Ptr frame, BeamPattern pattern, float minRange = 0.0f, float maxRange = 100.0f);
+
+    const Frame::Ptr &frame() const noexcept { return frame_; }
+    const BeamPattern &pattern() const noexcept { return pattern_; }
+    float minRange() const noexcept { return minRange_; }
+    float maxRange() const noexcept { return maxRange_; }
+
+    // One range per beam, in pattern order; infinity where nothing is hit between minRange and maxRange. Reuses the
+    // storage of `ranges`. threadCount = 0 uses the whole shared pool.
+    void scan(Scene &scene, std::vector<float> &ranges, std::size_t threadCount = 0) const;
+    std::vector<float> scan(Scene &scene, std::size_t threadCount = 0) const;
+
+    // The returns of a scan as points in the sensor frame, skipping beams without one.
+    std::vector<Eigen::Vector3f> pointCloud(const std::vector<float> &ranges) const;
+
+  private:
+    Frame::Ptr frame_;
+    BeamPattern pattern_;
+    float minRange_;
+    float maxRange_;
+};
+
+} // namespace toph
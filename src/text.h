@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace toph {
+
+// Appends the UTF-8 encoding of a Unicode code point, e.g. one decoded from an XML character reference or a JSON
+// \u escape.
+void appendUtf8(std::string &out, std::uint32_t code);
+
+} // namespace toph
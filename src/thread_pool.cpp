@@ -0,0 +1,101 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace toph {
+
+ThreadPool::ThreadPool(std::size_t threadCount) {
+    threadCount = std::max<std::size_t>(threadCount, 1);
+    workers_.reserve(threadCount);
+    for (std::size_t i = 0; i < threadCount; ++i) {
+        workers_.emplace_back([this] { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto &worker : workers_) {
+        worker.join();
+    }
+}
+
+ThreadPool &ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+            if (stop_ && tasks_.empty()) return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(std::size_t count, std::size_t maxThreads,
+                             const std::function<void(std::size_t, std::size_t)> &fn) {
+    const std::size_t chunks = std::min({count, std::max<std::size_t>(maxThreads, 1), workers_.size() + 1});
+    if (chunks <= 1) {
+        if (count > 0) fn(0, count);
+        return;
+    }
+
+    std::atomic<std::size_t> pending{chunks - 1};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto runChunk = [&](std::size_t c) {
+        try {
+            fn(count * c / chunks, count * (c + 1) / chunks);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = std::current_exception();
+        }
+    };
+
+    for (std::size_t c = 1; c < chunks; ++c) {
+        enqueue([&, c] {
+            runChunk(c);
+            if (pending.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                cv_.notify_all();
+            }
+        });
+    }
+    runChunk(0);
+
+    while (pending.load() > 0) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&] { return pending.load() == 0 || !tasks_.empty(); });
+            if (pending.load() == 0) break;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+
+    if (error) std::rethrow_exception(error);
+}
+
+} // namespace toph
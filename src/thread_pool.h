@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace toph {
+
+class ThreadPool {
+  public:
+    explicit ThreadPool(std::size_t threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    std::size_t size() const noexcept { return workers_.size(); }
+
+    template <typename F> auto submit(F &&f) -> std::future<std::invoke_result_t<F>> {
+        using R = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        auto future = task->get_future();
+        enqueue([task] { (*task)(); });
+        return future;
+    }
+
+    // Splits [0, count) into at most maxThreads contiguous ranges and runs fn(begin, end) on them, using the calling
+    // thread for the first one. While waiting the caller runs other queued tasks, so nesting inside a task is safe.
+    // The first exception thrown by fn is rethrown once all ranges are done.
+    void parallelFor(std::size_t count, std::size_t maxThreads,
+                     const std::function<void(std::size_t, std::size_t)> &fn);
+
+    // Process-wide pool with one worker per hardware thread.
+    static ThreadPool &shared();
+
+  private:
+    void enqueue(std::function<void()> task);
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+} // namespace toph
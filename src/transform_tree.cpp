@@ -0,0 +1,235 @@
+#include "transform_tree.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace toph {
+
+TransformTree::NodeId TransformTree::create(const Eigen::Isometry3f &local, NodeId parent) {
+    NodeId id;
+    if (!freeIds_.empty()) {
+        id = freeIds_.back();
+        freeIds_.pop_back();
+    } else {
+        id = static_cast<NodeId>(slot_.size());
+        slot_.push_back(kNone);
+    }
+    slot_[id] = append(local, parent == kNone ? kNone : slot_[parent], id);
+    ++live_;
+    return id;
+}
+
+void TransformTree::reserve(std::size_t count) {
+    local_.reserve(count);
+    world_.reserve(count);
+    parent_.reserve(count);
+    node_.reserve(count);
+    dirty_.reserve(count);
+    slot_.reserve(count);
+}
+
+void TransformTree::destroy(NodeId id) {
+    kill(slot_[id]);
+    slot_[id] = kNone;
+    freeIds_.push_back(id);
+    --live_;
+    if (parent_.size() > 2 * live_ + 64) compact();
+}
+
+TransformTree::NodeId TransformTree::parent(NodeId id) const {
+    const Slot p = parent_[slot_[id]];
+    return p == kNone ? kNone : node_[p];
+}
+
+void TransformTree::setParent(NodeId id, NodeId parent) {
+    if (parent != kNone && isAncestor(id, parent)) {
+        throw std::invalid_argument("TransformTree::setParent would create a cycle");
+    }
+    Slot s = slot_[id];
+    levelsValid_ = false;
+    if (parent == kNone) {
+        parent_[s] = kNone;
+        markDirty(s);
+        return;
+    }
+    const Slot ps = slot_[parent];
+    if (ps > s) {
+        // The parent is not part of the moved subtree, so its slot stays put.
+        moveSubtreeToEnd(s);
+        s = slot_[id];
+    }
+    parent_[s] = ps;
+    markDirty(s);
+}
+
+bool TransformTree::isAncestor(NodeId ancestor, NodeId id) const {
+    const Slot target = slot_[ancestor];
+    for (Slot s = slot_[id]; s != kNone; s = parent_[s]) {
+        if (s == target) return true;
+    }
+    return false;
+}
+
+Eigen::Isometry3f &TransformTree::mutableLocal(NodeId id) {
+    const Slot s = slot_[id];
+    markDirty(s);
+    return local_[s];
+}
+
+void TransformTree::setLocal(NodeId id, const Eigen::Isometry3f &X) {
+    const Slot s = slot_[id];
+    local_[s] = X;
+    markDirty(s);
+}
+
+const Eigen::Isometry3f &TransformTree::world(NodeId id) {
+    const Slot s = slot_[id];
+    if (firstDirty_ <= static_cast<std::size_t>(s)) updateWorldTransforms();
+    return world_[s];
+}
+
+void TransformTree::updateWorldTransforms() {
+    const std::size_t n = parent_.size();
+    for (std::size_t i = firstDirty_; i < n; ++i) {
+        updateSlot(i);
+    }
+    std::fill(dirty_.begin() + firstDirty_, dirty_.end(), 0);
+    firstDirty_ = n;
+}
+
+void TransformTree::updateWorldTransforms(std::size_t threadCount) {
+    if (!dirty()) return;
+    auto &pool = ThreadPool::shared();
+    if (threadCount == 0) threadCount = pool.size();
+    if (threadCount <= 1) return updateWorldTransforms();
+
+    if (!levelsValid_) rebuildLevels();
+
+    // Below this many slots per thread, handing a level to the pool costs more than it saves.
+    constexpr std::size_t kMinSlotsPerThread = 512;
+    for (std::size_t d = 0; d + 1 < levelStart_.size(); ++d) {
+        const Slot *level = levelOrder_.data() + levelStart_[d];
+        const std::size_t width = levelStart_[d + 1] - levelStart_[d];
+        const std::size_t threads = std::min(threadCount, width / kMinSlotsPerThread);
+        pool.parallelFor(width, threads, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t k = begin; k < end; ++k) {
+                updateSlot(level[k]);
+            }
+        });
+    }
+    std::fill(dirty_.begin() + firstDirty_, dirty_.end(), 0);
+    firstDirty_ = parent_.size();
+}
+
+void TransformTree::updateSlot(std::size_t i) {
+    // Parents are final before their children are visited, in slot order as well as level order.
+    const Slot p = parent_[i];
+    if (p != kNone && dirty_[p]) dirty_[i] = 1;
+    if (!dirty_[i]) return;
+    if (p == kNone) {
+        world_[i] = local_[i];
+    } else {
+        // Full 4x4 product, which Eigen vectorizes; the bottom row of an isometry stays (0, 0, 0, 1).
+        world_[i].matrix().noalias() = world_[p].matrix() * local_[i].matrix();
+    }
+}
+
+void TransformTree::rebuildLevels() {
+    const std::size_t n = parent_.size();
+    std::vector<std::uint32_t> depth(n, 0);
+    std::uint32_t maxDepth = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const Slot p = parent_[i];
+        depth[i] = p == kNone ? 0 : depth[p] + 1;
+        maxDepth = std::max(maxDepth, depth[i]);
+    }
+
+    // Counting sort by depth keeps each level in slot order.
+    levelStart_.assign(n > 0 ? maxDepth + 2 : 1, 0);
+    for (std::size_t i = 0; i < n; ++i) {
+        ++levelStart_[depth[i] + 1];
+    }
+    for (std::size_t d = 1; d < levelStart_.size(); ++d) {
+        levelStart_[d] += levelStart_[d - 1];
+    }
+    levelOrder_.resize(n);
+    std::vector<std::size_t> cursor(levelStart_.begin(), levelStart_.end() - 1);
+    for (std::size_t i = 0; i < n; ++i) {
+        levelOrder_[cursor[depth[i]]++] = static_cast<Slot>(i);
+    }
+    levelsValid_ = true;
+}
+
+TransformTree::Slot TransformTree::append(const Eigen::Isometry3f &local, Slot parent, NodeId id) {
+    const Slot s = static_cast<Slot>(parent_.size());
+    local_.push_back(local);
+    world_.push_back(local);
+    parent_.push_back(parent);
+    node_.push_back(id);
+    dirty_.push_back(0);
+    levelsValid_ = false;
+    markDirty(s);
+    return s;
+}
+
+void TransformTree::kill(Slot s) {
+    ++version_;
+    parent_[s] = kNone;
+    node_[s] = kNone;
+    levelsValid_ = false;
+}
+
+void TransformTree::markDirty(Slot s) {
+    ++version_;
+    dirty_[s] = 1;
+    firstDirty_ = std::min(firstDirty_, static_cast<std::size_t>(s));
+}
+
+void TransformTree::moveSubtreeToEnd(Slot root) {
+    // Descendants always sit after their ancestors, so one forward scan from the root finds the whole subtree.
+    const Slot end = static_cast<Slot>(parent_.size());
+    std::vector<Slot> moved(end - root, kNone);
+    for (Slot j = root; j < end; ++j) {
+        const Slot p = parent_[j];
+        const bool inSubtree = (j == root) || (p >= root && moved[p - root] != kNone);
+        if (!inSubtree || node_[j] == kNone) continue;
+
+        const Eigen::Isometry3f local = local_[j];
+        const NodeId id = node_[j];
+        const Slot newSlot = append(local, j == root ? p : moved[p - root], id);
+        moved[j - root] = newSlot;
+        slot_[id] = newSlot;
+        kill(j);
+    }
+}
+
+void TransformTree::compact() {
+    const std::size_t n = parent_.size();
+    std::vector<Slot> remap(n, kNone);
+    Slot next = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (node_[i] != kNone) remap[i] = next++;
+    }
+
+    firstDirty_ = static_cast<std::size_t>(next);
+    for (std::size_t i = 0; i < n; ++i) {
+        const Slot s = remap[i];
+        if (s == kNone) continue;
+        local_[s] = local_[i];
+        world_[s] = world_[i];
+        parent_[s] = parent_[i] == kNone ? kNone : remap[parent_[i]];
+        node_[s] = node_[i];
+        dirty_[s] = dirty_[i];
+        slot_[node_[s]] = s;
+        if (dirty_[s]) firstDirty_ = std::min(firstDirty_, static_cast<std::size_t>(s));
+    }
+
+    local_.resize(next);
+    world_.resize(next);
+    parent_.resize(next);
+    node_.resize(next);
+    dirty_.resize(next);
+}
+
+} // namespace toph
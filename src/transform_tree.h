@@ -0,0 +1,82 @@
+#pragma once
+
+#include <Eigen/Geometry>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace toph {
+
+// Flat storage for a forest of transforms. Local and world transforms live in contiguous arrays ordered so that every
+// parent precedes its children, which turns the world update into one forward pass over the arrays. Nodes are addressed
+// by stable ids; the slot behind an id may move when the hierarchy is rearranged or compacted.
+class TransformTree {
+  public:
+    using NodeId = std::int32_t;
+    static constexpr NodeId kNone = -1;
+
+    // A node below `parent` is appended after it, so unlike a later setParent() this needs no cycle check or move.
+    NodeId create(const Eigen::Isometry3f &local = Eigen::Isometry3f::Identity(), NodeId parent = kNone);
+    // Makes room for `count` nodes in total, for callers that know the size of a hierarchy before building it.
+    void reserve(std::size_t count);
+    // Children of a destroyed node must have been detached (or destroyed) first.
+    void destroy(NodeId id);
+
+    NodeId parent(NodeId id) const;
+    void setParent(NodeId id, NodeId parent);
+    // True if `ancestor` is `id` itself or lies on its path to the root.
+    bool isAncestor(NodeId ancestor, NodeId id) const;
+
+    const Eigen::Isometry3f &local(NodeId id) const { return local_[slot_[id]]; }
+    // The reference is only valid until the next structural change (create, setParent, destroy).
+    Eigen::Isometry3f &mutableLocal(NodeId id);
+    void setLocal(NodeId id, const Eigen::Isometry3f &X);
+
+    // Updates the world transforms first if the tree is dirty, so it is a write as far as threads are concerned.
+    const Eigen::Isometry3f &world(NodeId id);
+
+    // Recomputes the world transform of every node below a changed local transform.
+    void updateWorldTransforms();
+    // Same result, but processes the hierarchy one depth level at a time and splits each level across up to
+    // threadCount threads of the shared pool (0 = all hardware threads). Pays off for wide hierarchies.
+    void updateWorldTransforms(std::size_t threadCount);
+
+    std::size_t size() const noexcept { return live_; }
+    // Bumped by every change to a local transform or to the hierarchy.
+    std::uint64_t version() const noexcept { return version_; }
+    bool dirty() const noexcept { return firstDirty_ < parent_.size(); }
+
+  private:
+    using Slot = std::int32_t;
+
+    Slot append(const Eigen::Isometry3f &local, Slot parent, NodeId id);
+    void kill(Slot s);
+    void markDirty(Slot s);
+    void moveSubtreeToEnd(Slot root);
+    void compact();
+    void rebuildLevels();
+    void updateSlot(std::size_t i);
+
+    // Per slot, in topological order. Dead slots have node_ == kNone.
+    std::vector<Eigen::Isometry3f> local_;
+    std::vector<Eigen::Isometry3f> world_;
+    std::vector<Slot> parent_;
+    std::vector<NodeId> node_;
+    std::vector<std::uint8_t> dirty_;
+
+    // Per node id.
+    std::vector<Slot> slot_;
+    std::vector<NodeId> freeIds_;
+
+    // Slots grouped by depth, rebuilt lazily after structural changes.
+    std::vector<Slot> levelOrder_;
+    std::vector<std::size_t> levelStart_;
+    bool levelsValid_ = false;
+
+    std::size_t live_ = 0;
+    std::uint64_t version_ = 0;
+    // Every slot before this one is clean, so a read below it needs no update.
+    std::size_t firstDirty_ = 0;
+};
+
+} // namespace toph
@@ -0,0 +1,455 @@
+#include "urdf.h"
+#include "mapped_file.h"
+#include "text.h"
+#include "thread_pool.h"
+
+#include "par/par_shapes.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <locale>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace toph {
+
+Frame::Ptr UrdfRobot::link(const std::string &linkName) const {
+    for (const auto &frame : links) {
+        if (frame->name() == linkName) return frame;
+    }
+    return nullptr;
+}
+
+const UrdfJoint *UrdfRobot::joint(const std::string &jointName) const {
+    for (const auto &j : joints) {
+        if (j.name == jointName) return &j;
+    }
+    return nullptr;
+}
+
+void UrdfRobot::setJointPosition(const std::string &jointName, float position) {
+    const UrdfJoint *j = joint(jointName);
+    if (!j) throw std::out_of_range("UrdfRobot::setJointPosition: no joint " + jointName);
+    switch (j->type) {
+    case UrdfJoint::Type::Revolute:
+    case UrdfJoint::Type::Continuous: j->child->setX(j->origin * Eigen::AngleAxisf(position, j->axis)); break;
+    case UrdfJoint::Type::Prismatic: j->child->setX(j->origin * Eigen::Translation3f(position * j->axis)); break;
+    default: break;
+    }
+}
+
+namespace {
+
+[[noreturn]] void fail(const std::string &path, const std::string &what) {
+    throw std::runtime_error("loadUrdf: " + path + ": " + what);
+}
+
+// --- XML ---
+
+// Just enough XML for URDF: elements and attributes. Text, comments, processing instructions, CDATA and the
+// doctype are skipped.
+struct XmlElement {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> attributes;
+    std::vector<XmlElement> children;
+
+    const std::string *attribute(const std::string &key) const {
+        for (const auto &a : attributes) {
+            if (a.first == key) return &a.second;
+        }
+        return nullptr;
+    }
+    const XmlElement *child(const std::string &childName) const {
+        for (const auto &c : children) {
+            if (c.name == childName) return &c;
+        }
+        return nullptr;
+    }
+};
+
+class XmlParser {
+  public:
+    XmlParser(const char *begin, const char *end, const std::string &path) : p_(begin), end_(end), path_(path) {}
+
+    XmlElement document() {
+        for (;;) {
+            skipSpace();
+            if (p_ == end_) fail(path_, "no root element");
+            if (!skipMarkup()) return element();
+        }
+    }
+
+  private:
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    void skipSpace() {
+        while (p_ < end_ && isSpace(*p_)) ++p_;
+    }
+
+    bool startsWith(const char *s) const {
+        const std::size_t n = std::strlen(s);
+        return static_cast<std::size_t>(end_ - p_) >= n && std::memcmp(p_, s, n) == 0;
+    }
+
+    void skipPast(const char *terminator) {
+        const std::size_t n = std::strlen(terminator);
+        while (p_ < end_ && !startsWith(terminator)) ++p_;
+        if (p_ == end_) fail(path_, std::string("missing ") + terminator);
+        p_ += n;
+    }
+
+    // Skips a comment, processing instruction, CDATA section or doctype at p_; false if there is none.
+    bool skipMarkup() {
+        if (startsWith("<!--")) skipPast("-->");
+        else if (startsWith("<![CDATA[")) skipPast("]]>");
+        else if (startsWith("<?")) skipPast("?>");
+        else if (startsWith("<!")) skipPast(">");
+        else return false;
+        return true;
+    }
+
+    std::string name() {
+        const char *start = p_;
+        while (p_ < end_ && !isSpace(*p_) && *p_ != '/' && *p_ != '>' && *p_ != '=') ++p_;
+        if (p_ == start) fail(path_, "expected a name");
+        return std::string(start, p_);
+    }
+
+    void expect(char c) {
+        skipSpace();
+        if (p_ == end_ || *p_ != c) fail(path_, std::string("expected '") + c + "'");
+        ++p_;
+    }
+
+    std::string value() {
+        skipSpace();
+        if (p_ == end_ || (*p_ != '"' && *p_ != '\'')) fail(path_, "expected a quoted attribute value");
+        const char quote = *p_++;
+        std::string out;
+        while (p_ < end_ && *p_ != quote) {
+            if (*p_ != '&') {
+                out += *p_++;
+                continue;
+            }
+            const char *semicolon = static_cast<const char *>(std::memchr(p_, ';', end_ - p_));
+            if (!semicolon) fail(path_, "unterminated entity");
+            const std::string entity(p_ + 1, semicolon);
+            p_ = semicolon + 1;
+            if (entity == "lt") out += '<';
+            else if (entity == "gt") out += '>';
+            else if (entity == "amp") out += '&';
+            else if (entity == "quot") out += '"';
+            else if (entity == "apos") out += '\'';
+            else if (entity.size() > 1 && entity[0] == '#') appendUtf8(out, codePoint(entity));
+            else fail(path_, "unknown entity &" + entity + ";");
+        }
+        if (p_ == end_) fail(path_, "unterminated attribute value");
+        ++p_;
+        return out;
+    }
+
+    static std::uint32_t codePoint(const std::string &entity) {
+        const bool hex = entity[1] == 'x' || entity[1] == 'X';
+        return static_cast<std::uint32_t>(std::strtoul(entity.c_str() + (hex ? 2 : 1), nullptr, hex ? 16 : 10));
+    }
+
+    XmlElement element() {
+        expect('<');
+        XmlElement e;
+        e.name = name();
+        for (;;) {
+            skipSpace();
+            if (startsWith("/>")) {
+                p_ += 2;
+                return e;
+            }
+            if (startsWith(">")) {
+                ++p_;
+                break;
+            }
+            std::string key = name();
+            expect('=');
+            e.attributes.emplace_back(std::move(key), value());
+        }
+        for (;;) {
+            const void *open = std::memchr(p_, '<', end_ - p_);
+            if (!open) fail(path_, "unclosed <" + e.name + ">");
+            p_ = static_cast<const char *>(open);
+            if (startsWith("</")) {
+                p_ += 2;
+                if (name() != e.name) fail(path_, "expected </" + e.name + ">");
+                expect('>');
+                return e;
+            }
+            if (!skipMarkup()) e.children.push_back(element());
+        }
+    }
+
+    const char *p_;
+    const char *end_;
+    const std::string &path_;
+};
+
+// --- URDF ---
+
+// N numbers separated by spaces, or the fallback if the attribute is missing or short.
+template <int N>
+Eigen::Matrix<float, N, 1> numbers(const std::string *text, const Eigen::Matrix<float, N, 1> &fallback) {
+    if (!text) return fallback;
+    std::istringstream in(*text);
+    in.imbue(std::locale::classic());
+    Eigen::Matrix<float, N, 1> v;
+    for (int k = 0; k < N; ++k) {
+        if (!(in >> v[k])) return fallback;
+    }
+    return v;
+}
+
+float number(const XmlElement *e, const char *key, float fallback) {
+    return e ? numbers<1>(e->attribute(key), Eigen::Matrix<float, 1, 1>(fallback))[0] : fallback;
+}
+
+// An <origin xyz rpy> with roll, pitch and yaw about fixed x, y and z axes.
+Eigen::Isometry3f origin(const XmlElement *e) {
+    Eigen::Isometry3f X = Eigen::Isometry3f::Identity();
+    if (!e) return X;
+    const Eigen::Vector3f xyz = numbers<3>(e->attribute("xyz"), Eigen::Vector3f::Zero());
+    const Eigen::Vector3f rpy = numbers<3>(e->attribute("rpy"), Eigen::Vector3f::Zero());
+    X.translation() = xyz;
+    X.linear() = (Eigen::AngleAxisf(rpy.z(), Eigen::Vector3f::UnitZ()) *
+                  Eigen::AngleAxisf(rpy.y(), Eigen::Vector3f::UnitY()) *
+                  Eigen::AngleAxisf(rpy.x(), Eigen::Vector3f::UnitX()))
+                     .toRotationMatrix();
+    return X;
+}
+
+const std::string &requiredAttribute(const XmlElement &e, const char *key, const std::string &path) {
+    const std::string *value = e.attribute(key);
+    if (!value) fail(path, "<" + e.name + "> without " + key);
+    return *value;
+}
+
+// Resolves package://, file:// and relative mesh file names.
+std::string resolve(const std::string &uri, const std::filesystem::path &urdfDirectory, const UrdfOptions &options,
+                    const std::string &path) {
+    namespace fs = std::filesystem;
+    const std::string package = "package://", file = "file://";
+    if (uri.compare(0, file.size(), file) == 0) return uri.substr(file.size());
+    if (uri.compare(0, package.size(), package) != 0) return (urdfDirectory / uri).string();
+
+    const std::string rest = uri.substr(package.size());
+    const std::size_t slash = rest.find('/');
+    const std::string name = rest.substr(0, slash);
+    const std::string relative = slash == std::string::npos ? std::string() : rest.substr(slash + 1);
+    auto listed = options.packages.find(name);
+    if (listed != options.packages.end()) return (fs::path(listed->second) / relative).string();
+    if (const char *rosPackagePath = std::getenv("ROS_PACKAGE_PATH")) {
+        std::istringstream directories(rosPackagePath);
+        for (std::string directory; std::getline(directories, directory, ':');) {
+            if (!directory.empty() && fs::exists(fs::path(directory) / name / relative)) {
+                return (fs::path(directory) / name / relative).string();
+            }
+        }
+    }
+    // Typically the URDF sits in <package>/urdf/.
+    const fs::path start = fs::absolute(urdfDirectory.empty() ? fs::path(".") : urdfDirectory);
+    for (fs::path directory = start; !directory.empty(); directory = directory.parent_path()) {
+        if (directory.filename() == name && fs::exists(directory / relative)) return (directory / relative).string();
+        if (fs::exists(directory / name / relative)) return (directory / name / relative).string();
+        if (directory == directory.parent_path()) break;
+    }
+    fail(path, "cannot find package " + name);
+}
+
+Mesh::Ptr fromParShapes(par_shapes_mesh *shape) {
+    std::vector<Eigen::Vector3f> positions(shape->npoints);
+    for (int i = 0; i < shape->npoints; ++i) {
+        positions[i] = Eigen::Vector3f(shape->points[3 * i], shape->points[3 * i + 1], shape->points[3 * i + 2]);
+    }
+    std::vector<Eigen::Vector3i> faces(shape->ntriangles);
+    for (int i = 0; i < shape->ntriangles; ++i) {
+        faces[i] = Eigen::Vector3i(shape->triangles[3 * i], shape->triangles[3 * i + 1], shape->triangles[3 * i + 2]);
+    }
+    par_shapes_free_mesh(shape);
+    return Mesh::Create(positions, faces);
+}
+
+// Centered on the origin, like URDF boxes.
+Mesh::Ptr box(const Eigen::Vector3f &size) {
+    par_shapes_mesh *shape = par_shapes_create_cube();
+    par_shapes_translate(shape, -0.5f, -0.5f, -0.5f);
+    par_shapes_scale(shape, size.x(), size.y(), size.z());
+    return fromParShapes(shape);
+}
+
+// Along z, centered on the origin, with caps.
+Mesh::Ptr cylinder(float radius, float length) {
+    const int slices = 32;
+    par_shapes_mesh *shape = par_shapes_create_cylinder(slices, 1);
+    const float top[3] = {0.0f, 0.0f, 1.0f}, bottom[3] = {0.0f, 0.0f, 0.0f};
+    const float up[3] = {0.0f, 0.0f, 1.0f}, down[3] = {0.0f, 0.0f, -1.0f};
+    par_shapes_merge_and_free(shape, par_shapes_create_disk(1.0f, slices, top, up));
+    par_shapes_merge_and_free(shape, par_shapes_create_disk(1.0f, slices, bottom, down));
+    par_shapes_translate(shape, 0.0f, 0.0f, -0.5f);
+    par_shapes_scale(shape, radius, radius, length);
+    return fromParShapes(shape);
+}
+
+Mesh::Ptr sphere(float radius) {
+    par_shapes_mesh *shape = par_shapes_create_parametric_sphere(32, 16);
+    par_shapes_scale(shape, radius, radius, radius);
+    return fromParShapes(shape);
+}
+
+// A visual whose mesh is loaded once all visuals are known.
+struct PendingVisual {
+    Frame::Ptr frame;
+    std::size_t mesh;
+};
+
+struct MeshRequest {
+    std::string path;
+    Eigen::Vector3f scale;
+    Mesh::Ptr mesh;
+};
+
+} // namespace
+
+UrdfRobot loadUrdf(const std::string &path, const UrdfOptions &options) {
+    const MappedFile file(path);
+    const XmlElement document = XmlParser(file.chars(), file.chars() + file.size(), path).document();
+    if (document.name != "robot") fail(path, "root element isn't <robot>");
+    const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+    UrdfRobot robot;
+    if (const std::string *name = document.attribute("name")) robot.name = *name;
+
+    std::unordered_map<std::string, Eigen::Vector3f> materials;
+    for (const auto &e : document.children) {
+        const XmlElement *color = e.child("color");
+        if (e.name == "material" && e.attribute("name") && color) {
+            materials[*e.attribute("name")] = numbers<4>(color->attribute("rgba"), Eigen::Vector4f::Ones()).head<3>();
+        }
+    }
+
+    std::unordered_map<std::string, Frame::Ptr> links;
+    std::vector<PendingVisual> pending;
+    std::vector<MeshRequest> requests;
+    std::unordered_map<std::string, std::size_t> requested;
+    for (const auto &e : document.children) {
+        if (e.name != "link") continue;
+        const std::string &name = requiredAttribute(e, "name", path);
+        auto link = std::make_shared<Frame>(name);
+        if (!links.emplace(name, link).second) fail(path, "duplicate link " + name);
+        robot.links.push_back(link);
+        if (!options.visuals) continue;
+
+        std::size_t index = 0;
+        for (const auto &visual : e.children) {
+            if (visual.name != "visual") continue;
+            const XmlElement *geometry = visual.child("geometry");
+            if (!geometry || geometry->children.empty()) fail(path, "visual of " + name + " without geometry");
+            const XmlElement &shape = geometry->children.front();
+            const std::string *visualName = visual.attribute("name");
+            auto frame = std::make_shared<Frame>(visualName ? *visualName : name + "/visual" + std::to_string(index++),
+                                                 origin(visual.child("origin")));
+            if (const XmlElement *material = visual.child("material")) {
+                const XmlElement *color = material->child("color");
+                const std::string *materialName = material->attribute("name");
+                if (color) frame->frameColor = numbers<4>(color->attribute("rgba"), Eigen::Vector4f::Ones()).head<3>();
+                else if (materialName && materials.count(*materialName)) frame->frameColor = materials[*materialName];
+            }
+            link->addChild(frame);
+
+            if (shape.name == "mesh") {
+                const std::string file = resolve(requiredAttribute(shape, "filename", path), directory, options, path);
+                MeshRequest request{std::filesystem::path(file).lexically_normal().string(),
+                                    numbers<3>(shape.attribute("scale"), Eigen::Vector3f::Ones()), nullptr};
+                std::ostringstream key;
+                key << request.path << '|' << request.scale.transpose();
+                auto it = requested.emplace(key.str(), requests.size()).first;
+                if (it->second == requests.size()) requests.push_back(std::move(request));
+                pending.push_back({frame, it->second});
+            } else if (shape.name == "box") {
+                frame->setMesh(box(numbers<3>(shape.attribute("size"), Eigen::Vector3f::Ones())));
+            } else if (shape.name == "cylinder") {
+                frame->setMesh(cylinder(number(&shape, "radius", 1.0f), number(&shape, "length", 1.0f)));
+            } else if (shape.name == "sphere") {
+                frame->setMesh(sphere(number(&shape, "radius", 1.0f)));
+            } else {
+                fail(path, "unknown geometry <" + shape.name + ">");
+            }
+        }
+    }
+
+    std::unordered_map<std::string, bool> hasParent;
+    for (const auto &e : document.children) {
+        if (e.name != "joint") continue;
+        UrdfJoint joint;
+        joint.name = requiredAttribute(e, "name", path);
+        const std::string &type = requiredAttribute(e, "type", path);
+        if (type == "fixed") joint.type = UrdfJoint::Type::Fixed;
+        else if (type == "revolute") joint.type = UrdfJoint::Type::Revolute;
+        else if (type == "continuous") joint.type = UrdfJoint::Type::Continuous;
+        else if (type == "prismatic") joint.type = UrdfJoint::Type::Prismatic;
+        else if (type == "floating") joint.type = UrdfJoint::Type::Floating;
+        else if (type == "planar") joint.type = UrdfJoint::Type::Planar;
+        else fail(path, "joint " + joint.name + " has unknown type " + type);
+
+        const XmlElement *parent = e.child("parent");
+        const XmlElement *child = e.child("child");
+        if (!parent || !child) fail(path, "joint " + joint.name + " without parent or child");
+        auto parentLink = links.find(requiredAttribute(*parent, "link", path));
+        auto childLink = links.find(requiredAttribute(*child, "link", path));
+        if (parentLink == links.end() || childLink == links.end()) fail(path, "joint " + joint.name + ": no such link");
+        joint.parent = parentLink->second;
+        joint.child = childLink->second;
+        if (hasParent[childLink->first]) fail(path, "link " + childLink->first + " has two parent joints");
+        hasParent[childLink->first] = true;
+
+        joint.origin = origin(e.child("origin"));
+        if (const XmlElement *axis = e.child("axis")) {
+            joint.axis = numbers<3>(axis->attribute("xyz"), Eigen::Vector3f::UnitX()).normalized();
+        }
+        if (const XmlElement *limit = e.child("limit"); limit && joint.type != UrdfJoint::Type::Continuous) {
+            joint.lower = number(limit, "lower", 0.0f);
+            joint.upper = number(limit, "upper", 0.0f);
+        }
+        try {
+            joint.parent->addChild(joint.child);
+        } catch (const std::invalid_argument &) {
+            fail(path, "joint " + joint.name + " closes a loop");
+        }
+        joint.child->setX(joint.origin);
+        robot.joints.push_back(std::move(joint));
+    }
+
+    for (const auto &link : robot.links) {
+        if (hasParent[link->name()]) continue;
+        if (robot.root) fail(path, "links " + robot.root->name() + " and " + link->name() + " both lack a parent");
+        robot.root = link;
+    }
+    if (!robot.root) fail(path, "no root link");
+
+    ThreadPool &pool = ThreadPool::shared();
+    const std::size_t threads = options.threadCount > 0 ? options.threadCount : pool.size() + 1;
+    pool.parallelFor(requests.size(), threads, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            MeshRequest &request = requests[i];
+            MeshImportOptions meshOptions = options.mesh;
+            const bool uniform = request.scale.x() == request.scale.y() && request.scale.y() == request.scale.z();
+            if (uniform) meshOptions.scale *= request.scale.x();
+            request.mesh = loadMesh(request.path, meshOptions);
+            if (!uniform) request.mesh = scaled(*request.mesh, request.scale);
+        }
+    });
+    for (const auto &visual : pending) {
+        visual.frame->setMesh(requests[visual.mesh].mesh);
+    }
+    return robot;
+}
+
+} // namespace toph
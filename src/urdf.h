@@ -0,0 +1,64 @@
+#pragma once
+
+#include "frame.h"
+#include "mesh_import.h"
+#include <Eigen/Geometry>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace toph {
+
+struct UrdfJoint {
+    enum class Type { Fixed, Revolute, Continuous, Prismatic, Floating, Planar };
+
+    std::string name;
+    Type type = Type::Fixed;
+    Frame::Ptr parent, child;
+    // The child link's pose in the parent link's frame at joint position zero.
+    Eigen::Isometry3f origin = Eigen::Isometry3f::Identity();
+    // Unit axis in the child link's frame.
+    Eigen::Vector3f axis = Eigen::Vector3f::UnitX();
+    float lower = -std::numeric_limits<float>::infinity();
+    float upper = std::numeric_limits<float>::infinity();
+};
+
+// A robot loaded from URDF. Every link is a frame named after it whose local transform is the origin of the joint
+// above it, moved by the joint position. Every visual is a child frame of its link, named after the visual or else
+// "<link>/visual<i>", posed at the visual's origin and holding its mesh; material colors become its frameColor.
+struct UrdfRobot {
+    std::string name;
+    Frame::Ptr root;
+    // In document order.
+    std::vector<Frame::Ptr> links;
+    std::vector<UrdfJoint> joints;
+
+    // nullptr if there is none by that name.
+    Frame::Ptr link(const std::string &name) const;
+    const UrdfJoint *joint(const std::string &name) const;
+
+    // Moves the child link of a revolute, continuous or prismatic joint; positions are radians or meters and aren't
+    // clamped to the limits. Throws std::out_of_range for an unknown joint; other joint types ignore this.
+    void setJointPosition(const std::string &name, float position);
+};
+
+struct UrdfOptions {
+    // Directory of each package that package:// URIs may refer to. Packages not listed are looked for in the
+    // directories of ROS_PACKAGE_PATH, then among the directories above the URDF file.
+    std::map<std::string, std::string> packages;
+    // For every mesh file; a mesh's scale in the URDF multiplies options.mesh.scale.
+    MeshImportOptions mesh;
+    // Without visuals only the link frames are built.
+    bool visuals = true;
+    // Distinct mesh files are loaded concurrently on up to this many threads of the shared pool; 0 uses all of them.
+    std::size_t threadCount = 0;
+};
+
+// Loads a URDF file. Each mesh file is loaded once no matter how many visuals refer to it, through loadMesh(), so
+// meshes still referenced by a robot loaded earlier are reused as well. Boxes, cylinders and spheres are tessellated.
+// Throws std::runtime_error for malformed URDF, links that don't form one tree, and meshes that can't be loaded.
+UrdfRobot loadUrdf(const std::string &path, const UrdfOptions &options = {});
+
+} // namespace toph
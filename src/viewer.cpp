@@ -1,314 +1,233 @@
 #include "viewer.h"
+#include "framebuffer.h"
+#include "geometry.h"
+#include "gl_ext.h"
+#include "mpsc_queue.h"
+#include "pose_buffer.h"
+#include "recorder.h"
+#include "scene.h"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
-#include <array>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 #include <utility>
 #include <vector>
 
 namespace toph {
 
-inline Eigen::Matrix4f perspective(float fovyRadians, float aspect, float zNear, float zFar) {
-    const float f = 1.0f / std::tan(fovyRadians / 2.0f);
-    Eigen::Matrix4f m = Eigen::Matrix4f::Zero();
-    m(0, 0) = f / aspect;
-    m(1, 1) = f;
-    m(2, 2) = (zFar + zNear) / (zNear - zFar);
-    m(2, 3) = (2.0f * zFar * zNear) / (zNear - zFar);
-    m(3, 2) = -1.0f;
-    return m;
-}
-
-inline Eigen::Matrix4f lookAt(const Eigen::Vector3f &eye, const Eigen::Vector3f &center, const Eigen::Vector3f &up) {
-    Eigen::Vector3f f = (center - eye).normalized();
-    Eigen::Vector3f s = f.cross(up.normalized()).normalized();
-    Eigen::Vector3f u = s.cross(f);
-
-    Eigen::Matrix4f m = Eigen::Matrix4f::Identity();
-    m.block<1, 3>(0, 0) = s.transpose();
-    m.block<1, 3>(1, 0) = u.transpose();
-    m.block<1, 3>(2, 0) = -f.transpose();
-
-    Eigen::Matrix4f trans = Eigen::Matrix4f::Identity();
-    trans.block<3, 1>(0, 3) = -eye;
-    return m * trans;
-}
-
-constexpr char VERTEX_SHADER_SRC[] = R"(
-#version 330 core
-layout(location=0) in vec3 a_position;
-layout(location=1) in vec3 a_color;
-layout(location=2) in vec3 a_normal;
-
-out vec3 v_color;
-out vec3 v_normal;
-out vec3 v_worldPos;
-
-uniform mat4 u_model;
-uniform mat4 u_view;
-uniform mat4 u_proj;
-
-void main() {
-    vec4 worldPos = u_model * vec4(a_position, 1.0);
-    v_worldPos = worldPos.xyz;
-    v_normal = mat3(transpose(inverse(u_model))) * a_normal;
-    v_color = a_color;
-    gl_Position = u_proj * u_view * worldPos;
-}
-)";
-
-constexpr char FRAGMENT_SHADER_SRC[] = R"(
-#version 330 core
-in vec3 v_color;
-in vec3 v_normal;
-in vec3 v_worldPos;
-
-out vec4 FragColor;
-
-uniform vec3 u_lightPos;
-uniform vec3 u_viewPos;
-
-void main() {
-    vec3 N = normalize(v_normal);
-    vec3 L = normalize(u_lightPos - v_worldPos);
-    vec3 V = normalize(u_viewPos - v_worldPos);
-
-    float diff = max(dot(N, L), 0.0);
-
-    vec3 ambient = 0.2 * v_color;
-    vec3 diffuse = diff * v_color;
-
-    FragColor = vec4(ambient + diffuse, 1.0);
-}
-)";
-
-struct GeometryGPU {
-    GLuint vao = 0;
-    GLuint vbo = 0;
-    GLuint ebo = 0;
-    GLsizei indexCount = 0;
-
-    GeometryGPU() = default;
-
-    ~GeometryGPU() {
-        if (vbo) glDeleteBuffers(1, &vbo);
-        if (ebo) glDeleteBuffers(1, &ebo);
-        if (vao) glDeleteVertexArrays(1, &vao);
-    }
-
-    GeometryGPU(const GeometryGPU &) = delete;
-    GeometryGPU &operator=(const GeometryGPU &) = delete;
-
-    GeometryGPU(GeometryGPU &&other) noexcept
-        : vao(other.vao), vbo(other.vbo), ebo(other.ebo), indexCount(other.indexCount) {
-        other.vao = 0;
-        other.vbo = 0;
-        other.ebo = 0;
-        other.indexCount = 0;
-    }
-
-    // Move assignment operator
-    GeometryGPU &operator=(GeometryGPU &&other) noexcept {
-        if (this != &other) {
-            this->~GeometryGPU(); // Free existing resources
-            vao = std::exchange(other.vao, 0);
-            vbo = std::exchange(other.vbo, 0);
-            ebo = std::exchange(other.ebo, 0);
-            indexCount = std::exchange(other.indexCount, 0);
-        }
-        return *this;
-    }
-
-    bool isValid() const { return vao != 0; }
-
-    void uploadMesh(const std::vector<Eigen::Vector3f> &verts, const std::vector<Eigen::Vector3i> &faces,
-                    const std::vector<Eigen::Vector3f> &colors, const Eigen::Vector3f &fallbackColor);
-
-    void draw() const;
-};
-
-void GeometryGPU::uploadMesh(const std::vector<Eigen::Vector3f> &verts, const std::vector<Eigen::Vector3i> &faces,
-                             const std::vector<Eigen::Vector3f> &colors, const Eigen::Vector3f &fallbackColor) {
-    if (verts.empty()) return;
-
-    struct Vertex {
-        Eigen::Vector3f pos;
-        Eigen::Vector3f color;
-        Eigen::Vector3f normal;
-    };
-
-    std::vector<Vertex> vertexData(verts.size());
-    for (size_t i = 0; i < verts.size(); ++i) {
-        vertexData[i].pos = verts[i];
-        vertexData[i].color = (i < colors.size()) ? colors[i] : fallbackColor;
-        vertexData[i].normal = Eigen::Vector3f::Zero();
-    }
-
-    // Compute normals (flat shading averaged per-vertex)
-    for (auto &f : faces) {
-        Eigen::Vector3f v0 = verts[f.x()];
-        Eigen::Vector3f v1 = verts[f.y()];
-        Eigen::Vector3f v2 = verts[f.z()];
-        Eigen::Vector3f n = (v1 - v0).cross(v2 - v0).normalized();
-        vertexData[f.x()].normal += n;
-        vertexData[f.y()].normal += n;
-        vertexData[f.z()].normal += n;
-    }
-    for (auto &v : vertexData) {
-        if (v.normal.norm() > 0.0f) v.normal.normalize();
-        else v.normal = Eigen::Vector3f(0, 0, 1);
-    }
-
-    std::vector<unsigned int> indexData;
-    indexData.reserve(faces.size() * 3);
-    for (const auto &face : faces) {
-        indexData.push_back(face.x());
-        indexData.push_back(face.y());
-        indexData.push_back(face.z());
-    }
-
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glBindVertexArray(vao);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(Vertex), vertexData.data(), GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, pos));
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, color));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, normal));
-    glEnableVertexAttribArray(2);
-
-    if (!indexData.empty()) {
-        glGenBuffers(1, &ebo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size() * sizeof(unsigned int), indexData.data(),
-                     GL_STATIC_DRAW);
-        indexCount = static_cast<GLsizei>(indexData.size());
-    } else {
-        indexCount = static_cast<GLsizei>(verts.size());
-    }
-}
-
-void GeometryGPU::draw() const {
-    if (!isValid()) return;
-    glBindVertexArray(vao);
-    if (ebo) {
-        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
-    } else {
-        glDrawArrays(GL_LINES, 0, indexCount); // Assuming non-indexed are lines
-    }
-}
-
 struct Viewer::Impl {
     // Window and rendering state
     int width_;
     int height_;
     GLFWwindow *window_ = nullptr;
-    GLuint shaderProgram_ = 0;
-    GeometryGPU fallbackAxes_;
-
-    // Scene data
-    std::vector<Frame::Ptr> frames_;
-    std::vector<GeometryGPU> gpuMeshes_;
-
-    // Camera state
+    std::unique_ptr<Renderer> renderer_;
+    // The same frames for ray picking while the id buffer is off.
+    Scene scene_;
+    // Copy of the renderer's stats for readers on other threads, updated after every rendered frame.
+    Viewer::Stats publishedStats_;
+    std::mutex statsMutex_;
+
+    // Camera state, and the window sizes as of the last window events. Window events are handled on the thread that
+    // created the viewer while the render thread may be drawing, so both go through inputMutex_.
+    std::mutex inputMutex_;
+    int windowWidth_ = 0;
+    int windowHeight_ = 0;
+    int framebufferWidth_ = 0;
+    int framebufferHeight_ = 0;
     Eigen::Vector3f cameraTarget_{0.0f, 0.0f, 0.0f};
     Eigen::Vector3f cameraUp_{0.0f, 0.0f, 1.0f}; // Z-up convention
     float cameraYaw_ = M_PI / 4.0f;
     float cameraPitch_ = M_PI / 4.0f;
     float cameraDistance_ = 5.0f;
 
+    // Render-on-demand state. needsRedraw_ is only used on the render thread; window events and other threads go
+    // through redrawRequested_ and wake(). The render thread started by start() waits on wakeCondition_ instead of the
+    // event queue.
+    std::atomic<bool> renderOnDemand_{false};
+    std::atomic<double> maxLatency_{0.1};
+    bool needsRedraw_ = true;
+    std::atomic<bool> redrawRequested_{false};
+    std::mutex wakeMutex_;
+    std::condition_variable wakeCondition_;
+    TreeVersions drawnTreeVersions_;
+
+    // Scene changes posted from other threads, applied at the start of each loop iteration.
+    struct SceneUpdate {
+        enum class Kind { Transform, Mesh, AddFrame, AddPoseBuffer, Record, Pick };
+        Kind kind = Kind::Transform;
+        Frame::Ptr frame;
+        Eigen::Isometry3f X = Eigen::Isometry3f::Identity();
+        Mesh::Ptr mesh;
+        PoseBuffer::Ptr poses;
+        std::shared_ptr<FrameRecorder> recorder;
+        Eigen::Vector2d cursor = Eigen::Vector2d::Zero();
+        PickCallback onPick;
+    };
+    MpscQueue<SceneUpdate> updates_;
+    // Pose snapshots applied to their frames before each frame is drawn.
+    std::vector<PoseBuffer::Ptr> poseBuffers_;
+    // Captures every rendered frame while set; replaced or reset through setRecorder() on the render thread.
+    std::shared_ptr<FrameRecorder> recorder_;
+
+    // Culling settings, which other threads may change while the render thread runs; handed to the renderer before
+    // every frame.
+    std::atomic<bool> frustumCulling_{true};
+    std::atomic<bool> gpuCulling_{false};
+    std::atomic<bool> occlusionCulling_{false};
+
+    // While the id buffer is on, frames are drawn into framebuffer_, whose frame id attachment is read for picking,
+    // and its color is copied to the window.
+    std::atomic<bool> idBuffer_{false};
+    std::unique_ptr<Framebuffer> framebuffer_;
+    // Picks wait in pickRequests_ for the next rendered frame, then for their one-pixel readback in pendingPicks_.
+    struct PickRequest {
+        Eigen::Vector2d cursor;
+        PickCallback onPick;
+    };
+    struct PendingPick {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        PickCallback onPick;
+    };
+    std::vector<PickRequest> pickRequests_;
+    std::vector<PendingPick> pendingPicks_;
+    PickCallback onClick_;
+
+    // Render thread started by Viewer::start(). The GL context is current on it while it runs, but window events stay
+    // on the thread that created the viewer, which pumps them through Viewer::pollEvents(). threaded_ is set from
+    // start() until stop() has joined the thread and taken the context back, including after the window was closed and
+    // the thread ended on its own; all that time, calls from other threads queue their updates instead of touching
+    // the scene, and stop() applies whatever the thread left in the queue.
+    std::thread renderThread_;
+    std::atomic<bool> threaded_{false};
+    std::atomic<bool> running_{false};
+    std::atomic<bool> stopRequested_{false};
+
     // Mouse interaction state
     bool isLeftMouseDown_ = false;
     bool isRightMouseDown_ = false;
     double lastMouseX_ = 0.0;
     double lastMouseY_ = 0.0;
+    Eigen::Vector2d pressedAt_ = Eigen::Vector2d::Zero();
 
     Impl(int width, int height, const char *title);
     ~Impl();
 
     void addFrame(const Frame::Ptr &f);
     void run();
+    void applyUpdates();
+    // Non-blocking; wakes a waiting render-on-demand loop at most once per drained batch.
+    void post(SceneUpdate update);
+    void requestRedraw();
+    // Wakes the render loop if it is waiting for events or, on the render thread, for a redraw request.
+    void wake();
+    // Queued like the other updates while the render thread runs.
+    void pick(const Eigen::Vector2d &cursor, PickCallback onPick);
+    // Finishes the current recording, if any, before switching to the new one.
+    void setRecorder(std::shared_ptr<FrameRecorder> recorder);
+    void requestPick(const Eigen::Vector2d &cursor, PickCallback onPick);
+
+    // Closes the window on Escape or Q. Runs where the window events are handled.
+    void handleWindowInput();
 
   private:
     void initWindow(const char *title);
     void initGraphics();
-    void initShaders();
     void initCallbacks();
-    void initFallbackGeometry();
 
-    void handleWindowInput();
+    bool sceneChanged();
+    // Waits for window events or, on the render thread, for wake(), at most `timeout` seconds.
+    void waitForRedraw(double timeout);
+
     void onCursorMove(double xpos, double ypos);
     void onMouseButton(int button, int action);
     void onScroll(double yoffset);
 
     void calculateViewProjectionMatrices(Eigen::Matrix4f &view, Eigen::Matrix4f &projection);
+    // Call with inputMutex_ held.
+    Eigen::Matrix4f cameraView() const;
+
+    // Starts the readbacks of the pick requests from the id attachment of the frame just drawn.
+    void readPicks(int framebufferWidth, int framebufferHeight);
+    // Answers the picks whose readback has completed; with wait, all of them.
+    void collectPicks(bool wait);
 };
 
 Viewer::Impl::Impl(int width, int height, const char *title) : width_(width), height_(height) {
     initWindow(title);
     initGraphics();
-    initShaders();
     initCallbacks();
-    initFallbackGeometry();
 }
 
 Viewer::Impl::~Impl() {
+    setRecorder(nullptr);
+    collectPicks(true);
+    framebuffer_.reset();
+    renderer_.reset();
     if (window_) { glfwDestroyWindow(window_); }
 }
 
 void Viewer::Impl::initWindow(const char *title) {
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    window_ = glfwCreateWindow(width_, height_, title, nullptr, nullptr);
+    // Prefer 4.3 for multi-draw indirect; everything also runs on 3.3 core.
+    for (auto [major, minor] : {std::pair{4, 3}, std::pair{3, 3}}) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        window_ = glfwCreateWindow(width_, height_, title, nullptr, nullptr);
+        if (window_) break;
+    }
     if (!window_) { throw std::runtime_error("Failed to create GLFW window"); }
+    glfwGetWindowSize(window_, &windowWidth_, &windowHeight_);
+    glfwGetFramebufferSize(window_, &framebufferWidth_, &framebufferHeight_);
     glfwMakeContextCurrent(window_);
 }
 
 void Viewer::Impl::initGraphics() {
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) { throw std::runtime_error("Failed to initialize GLAD"); }
-    glEnable(GL_DEPTH_TEST);
-    glViewport(0, 0, width_, height_);
+    glext::load((GLADloadproc)glfwGetProcAddress);
+    renderer_ = std::make_unique<Renderer>();
 }
 
-void Viewer::Impl::initShaders() {
-    auto compileShader = [](GLenum type, const char *source) -> GLuint {
-        GLuint shader = glCreateShader(type);
-        glShaderSource(shader, 1, &source, nullptr);
-        glCompileShader(shader);
-        return shader;
-    };
-
-    GLuint vs = compileShader(GL_VERTEX_SHADER, VERTEX_SHADER_SRC);
-    GLuint fs = compileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER_SRC);
+void Viewer::Impl::initCallbacks() {
+    glfwSetWindowUserPointer(window_, this);
 
-    shaderProgram_ = glCreateProgram();
-    glAttachShader(shaderProgram_, vs);
-    glAttachShader(shaderProgram_, fs);
-    glLinkProgram(shaderProgram_);
-    // Add linking error checking here
+    // The callbacks run on the thread handling window events, so they leave the GL state to the render loop.
+    glfwSetFramebufferSizeCallback(window_, [](GLFWwindow *win, int w, int h) {
+        Impl *impl = static_cast<Impl *>(glfwGetWindowUserPointer(win));
+        {
+            std::lock_guard<std::mutex> lock(impl->inputMutex_);
+            impl->framebufferWidth_ = w;
+            impl->framebufferHeight_ = h;
+        }
+        impl->requestRedraw();
+    });
 
-    glDeleteShader(vs);
-    glDeleteShader(fs);
-}
+    glfwSetWindowSizeCallback(window_, [](GLFWwindow *win, int w, int h) {
+        Impl *impl = static_cast<Impl *>(glfwGetWindowUserPointer(win));
+        std::lock_guard<std::mutex> lock(impl->inputMutex_);
+        impl->windowWidth_ = w;
+        impl->windowHeight_ = h;
+    });
 
-void Viewer::Impl::initCallbacks() {
-    glfwSetWindowUserPointer(window_, this);
+    glfwSetWindowRefreshCallback(window_, [](GLFWwindow *win) {
+        static_cast<Impl *>(glfwGetWindowUserPointer(win))->requestRedraw();
+    });
 
-    glfwSetFramebufferSizeCallback(window_, [](GLFWwindow *, int w, int h) { glViewport(0, 0, w, h); });
+    glfwSetWindowCloseCallback(window_,
+                               [](GLFWwindow *win) { static_cast<Impl *>(glfwGetWindowUserPointer(win))->wake(); });
 
     glfwSetCursorPosCallback(window_, [](GLFWwindow *win, double x, double y) {
         static_cast<Impl *>(glfwGetWindowUserPointer(win))->onCursorMove(x, y);
@@ -323,33 +242,183 @@ void Viewer::Impl::initCallbacks() {
     });
 }
 
-void Viewer::Impl::initFallbackGeometry() {
-    const std::vector<Eigen::Vector3f> verts = {
-        {0, 0, 0}, {1, 0, 0}, // X
-        {0, 0, 0}, {0, 1, 0}, // Y
-        {0, 0, 0}, {0, 0, 1}  // Z
-    };
-    const std::vector<Eigen::Vector3f> colors = {
-        {1, 0, 0}, {1, 0, 0}, // Red
-        {0, 1, 0}, {0, 1, 0}, // Green
-        {0, 0, 1}, {0, 0, 1}  // Blue
-    };
-    fallbackAxes_.uploadMesh(verts, {}, colors, {});
+void Viewer::Impl::addFrame(const Frame::Ptr &frame) {
+    needsRedraw_ = true;
+    renderer_->addFrame(frame);
+    scene_.addFrame(frame);
 }
 
-void Viewer::Impl::addFrame(const Frame::Ptr &frame) {
-    frames_.push_back(frame);
-    GeometryGPU gpuMesh;
-    gpuMesh.uploadMesh(frame->vertices, frame->faces, frame->colors, frame->frameColor);
-    gpuMeshes_.push_back(std::move(gpuMesh));
-    for (const auto &child : frame->children()) {
-        addFrame(child);
+void Viewer::Impl::post(SceneUpdate update) {
+    updates_.push(std::move(update));
+    if (!redrawRequested_.exchange(true)) wake();
+}
+
+void Viewer::Impl::requestRedraw() {
+    redrawRequested_ = true;
+    wake();
+}
+
+void Viewer::Impl::wake() {
+    if (threaded_) {
+        // Taking the mutex orders this against the waiter checking its condition, so the notification isn't lost.
+        { std::lock_guard<std::mutex> lock(wakeMutex_); }
+        wakeCondition_.notify_one();
+    } else {
+        glfwPostEmptyEvent();
+    }
+}
+
+void Viewer::Impl::waitForRedraw(double timeout) {
+    if (!threaded_) {
+        glfwWaitEventsTimeout(timeout);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(wakeMutex_);
+    wakeCondition_.wait_for(lock, std::chrono::duration<double>(timeout),
+                            [this] { return redrawRequested_ || stopRequested_ || glfwWindowShouldClose(window_); });
+}
+
+void Viewer::Impl::pick(const Eigen::Vector2d &cursor, PickCallback onPick) {
+    if (threaded_) {
+        SceneUpdate update;
+        update.kind = SceneUpdate::Kind::Pick;
+        update.cursor = cursor;
+        update.onPick = std::move(onPick);
+        post(std::move(update));
+    } else {
+        requestPick(cursor, std::move(onPick));
     }
 }
 
+void Viewer::Impl::setRecorder(std::shared_ptr<FrameRecorder> recorder) {
+    if (recorder_) {
+        try {
+            recorder_->finish();
+        } catch (const std::exception &e) {
+            std::cerr << "Viewer: recording failed: " << e.what() << std::endl;
+        }
+    }
+    recorder_ = std::move(recorder);
+}
+
+void Viewer::Impl::requestPick(const Eigen::Vector2d &cursor, PickCallback onPick) {
+    if (!idBuffer_) {
+        // Unproject the cursor onto the near and far planes and take the first triangle in between.
+        Eigen::Matrix4f view, projection;
+        calculateViewProjectionMatrices(view, projection);
+        int windowWidth, windowHeight;
+        {
+            std::lock_guard<std::mutex> lock(inputMutex_);
+            windowWidth = windowWidth_;
+            windowHeight = windowHeight_;
+        }
+        const float x = 2.0f * static_cast<float>(cursor.x()) / std::max(windowWidth, 1) - 1.0f;
+        const float y = 1.0f - 2.0f * static_cast<float>(cursor.y()) / std::max(windowHeight, 1);
+        const Eigen::Matrix4f unproject = (projection * view).inverse();
+        const Eigen::Vector3f nearPoint = (unproject * Eigen::Vector4f(x, y, -1.0f, 1.0f)).hnormalized();
+        const Eigen::Vector3f farPoint = (unproject * Eigen::Vector4f(x, y, 1.0f, 1.0f)).hnormalized();
+        const Eigen::Vector3f direction = farPoint - nearPoint;
+        onPick(scene_.raycast(nearPoint, direction, direction.norm()).frame);
+        return;
+    }
+    pickRequests_.push_back({cursor, std::move(onPick)});
+    needsRedraw_ = true;
+}
+
+void Viewer::Impl::readPicks(int framebufferWidth, int framebufferHeight) {
+    int windowWidth, windowHeight;
+    {
+        std::lock_guard<std::mutex> lock(inputMutex_);
+        windowWidth = windowWidth_;
+        windowHeight = windowHeight_;
+    }
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    for (auto &request : pickRequests_) {
+        // Cursor positions are in screen coordinates from the top left, which differ from pixels on high-DPI displays.
+        const Eigen::Vector2d scale(static_cast<double>(framebufferWidth) / std::max(windowWidth, 1),
+                                    static_cast<double>(framebufferHeight) / std::max(windowHeight, 1));
+        const int x = static_cast<int>(std::floor(request.cursor.x() * scale.x()));
+        const int y = framebufferHeight - 1 - static_cast<int>(std::floor(request.cursor.y() * scale.y()));
+        if (x < 0 || y < 0 || x >= framebufferWidth || y >= framebufferHeight) {
+            request.onPick(nullptr);
+            continue;
+        }
+        PendingPick pick;
+        pick.onPick = std::move(request.onPick);
+        glGenBuffers(1, &pick.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pick.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+        glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        pick.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        pendingPicks_.push_back(std::move(pick));
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    pickRequests_.clear();
+}
+
+void Viewer::Impl::collectPicks(bool wait) {
+    for (auto it = pendingPicks_.begin(); it != pendingPicks_.end();) {
+        const GLenum status = glClientWaitSync(it->fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                               wait ? GL_TIMEOUT_IGNORED : 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            ++it;
+            continue;
+        }
+        GLuint id = 0;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, it->buffer);
+        glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(id), &id);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glDeleteBuffers(1, &it->buffer);
+        glDeleteSync(it->fence);
+
+        // Ids are indices into the renderer's frames plus one; frames are only ever appended.
+        const auto &frames = renderer_->frames();
+        const PickCallback onPick = std::move(it->onPick);
+        it = pendingPicks_.erase(it);
+        onPick(id > 0 && id <= frames.size() ? frames[id - 1] : nullptr);
+    }
+}
+
+void Viewer::Impl::applyUpdates() {
+    SceneUpdate update;
+    while (updates_.pop(update)) {
+        switch (update.kind) {
+        case SceneUpdate::Kind::Transform:
+            update.frame->setX(update.X);
+            break;
+        case SceneUpdate::Kind::Mesh:
+            update.frame->setMesh(std::move(update.mesh));
+            break;
+        case SceneUpdate::Kind::AddFrame:
+            addFrame(update.frame);
+            break;
+        case SceneUpdate::Kind::AddPoseBuffer:
+            poseBuffers_.push_back(std::move(update.poses));
+            break;
+        case SceneUpdate::Kind::Record:
+            setRecorder(std::move(update.recorder));
+            break;
+        case SceneUpdate::Kind::Pick:
+            requestPick(update.cursor, std::move(update.onPick));
+            break;
+        }
+    }
+    for (const auto &poses : poseBuffers_) {
+        poses->apply();
+    }
+}
+
+bool Viewer::Impl::sceneChanged() {
+    // Both checks run so that the snapshot of tree versions stays current.
+    const bool transforms = renderer_->transformsChanged(drawnTreeVersions_);
+    return renderer_->meshesChanged() || transforms;
+}
+
 void Viewer::Impl::handleWindowInput() {
     if (glfwGetKey(window_, GLFW_KEY_ESCAPE) == GLFW_PRESS || glfwGetKey(window_, GLFW_KEY_Q) == GLFW_PRESS) {
         glfwSetWindowShouldClose(window_, true);
+        wake();
     }
 }
 
@@ -359,6 +428,7 @@ void Viewer::Impl::onCursorMove(double xpos, double ypos) {
     const double dx = xpos - lastMouseX_;
     const double dy = ypos - lastMouseY_;
 
+    std::unique_lock<std::mutex> lock(inputMutex_);
     if (isLeftMouseDown_) { // Orbit
         cameraYaw_ -= static_cast<float>(dx) * 0.005f;
         cameraPitch_ += static_cast<float>(dy) * 0.005f;
@@ -367,8 +437,7 @@ void Viewer::Impl::onCursorMove(double xpos, double ypos) {
 
     if (isRightMouseDown_) { // Pan
         const float panScale = cameraDistance_ * 0.001f;
-        Eigen::Matrix4f view, proj;
-        calculateViewProjectionMatrices(view, proj);
+        const Eigen::Matrix4f view = cameraView();
         Eigen::Matrix3f invView = view.topLeftCorner<3, 3>().transpose();
         Eigen::Vector3f right = invView.col(0);
         Eigen::Vector3f up = invView.col(1);
@@ -377,6 +446,9 @@ void Viewer::Impl::onCursorMove(double xpos, double ypos) {
         cameraTarget_ += up * static_cast<float>(dy) * panScale;
     }
 
+    lock.unlock();
+    requestRedraw();
+
     lastMouseX_ = xpos;
     lastMouseY_ = ypos;
 }
@@ -385,68 +457,112 @@ void Viewer::Impl::onMouseButton(int button, int action) {
     if (button == GLFW_MOUSE_BUTTON_LEFT) isLeftMouseDown_ = (action == GLFW_PRESS);
     if (button == GLFW_MOUSE_BUTTON_RIGHT) isRightMouseDown_ = (action == GLFW_PRESS);
     glfwGetCursorPos(window_, &lastMouseX_, &lastMouseY_);
+
+    // A left click that didn't orbit the camera selects.
+    const Eigen::Vector2d cursor(lastMouseX_, lastMouseY_);
+    if (button != GLFW_MOUSE_BUTTON_LEFT) return;
+    if (action == GLFW_PRESS) {
+        pressedAt_ = cursor;
+    } else if (onClick_ && (cursor - pressedAt_).squaredNorm() <= 9.0) {
+        pick(cursor, onClick_);
+    }
 }
 
 void Viewer::Impl::onScroll(double yoffset) {
-    cameraDistance_ *= (1.0f - static_cast<float>(yoffset) * 0.1f);
-    cameraDistance_ = std::max(0.1f, cameraDistance_);
+    {
+        std::lock_guard<std::mutex> lock(inputMutex_);
+        cameraDistance_ *= (1.0f - static_cast<float>(yoffset) * 0.1f);
+        cameraDistance_ = std::max(0.1f, cameraDistance_);
+    }
+    requestRedraw();
 }
 
-void Viewer::Impl::calculateViewProjectionMatrices(Eigen::Matrix4f &view, Eigen::Matrix4f &projection) {
+Eigen::Matrix4f Viewer::Impl::cameraView() const {
     Eigen::Vector3f eye;
     eye.x() = cameraTarget_.x() + cameraDistance_ * std::cos(cameraPitch_) * std::cos(cameraYaw_);
     eye.y() = cameraTarget_.y() + cameraDistance_ * std::cos(cameraPitch_) * std::sin(cameraYaw_);
     eye.z() = cameraTarget_.z() + cameraDistance_ * std::sin(cameraPitch_);
+    return lookAt(eye, cameraTarget_, cameraUp_);
+}
 
-    view = lookAt(eye, cameraTarget_, cameraUp_);
-
+void Viewer::Impl::calculateViewProjectionMatrices(Eigen::Matrix4f &view, Eigen::Matrix4f &projection) {
     int currentWidth, currentHeight;
-    glfwGetFramebufferSize(window_, &currentWidth, &currentHeight);
+    {
+        std::lock_guard<std::mutex> lock(inputMutex_);
+        view = cameraView();
+        currentWidth = framebufferWidth_;
+        currentHeight = framebufferHeight_;
+    }
     const float aspect = (currentHeight > 0) ? (float)currentWidth / currentHeight : 1.0f;
     const float fovRadians = 45.0f * M_PI / 180.0f;
     projection = perspective(fovRadians, aspect, 0.1f, 100.f);
 }
 
 void Viewer::Impl::run() {
-    GLint modelLoc = glGetUniformLocation(shaderProgram_, "u_model");
-    GLint viewLoc = glGetUniformLocation(shaderProgram_, "u_view");
-    GLint projLoc = glGetUniformLocation(shaderProgram_, "u_proj");
-    GLint lightPosLoc = glGetUniformLocation(shaderProgram_, "u_lightPos");
-    GLint viewPosLoc = glGetUniformLocation(shaderProgram_, "u_viewPos");
-
-    while (!glfwWindowShouldClose(window_)) {
-        handleWindowInput();
+    while (!glfwWindowShouldClose(window_) && !stopRequested_) {
+        applyUpdates();
+        if (!threaded_) handleWindowInput();
+
+        if (renderOnDemand_) {
+            const bool requested = redrawRequested_.exchange(false);
+            if (!sceneChanged() && !needsRedraw_ && !requested) {
+                // Woken by input, window events and requestRedraw(); the timeout bounds how late unannounced scene
+                // changes are noticed.
+                waitForRedraw(pendingPicks_.empty() ? maxLatency_.load() : 0.001);
+                collectPicks(false);
+                continue;
+            }
+            needsRedraw_ = false;
+        }
 
         Eigen::Matrix4f viewMatrix, projectionMatrix;
         calculateViewProjectionMatrices(viewMatrix, projectionMatrix);
-
-        Eigen::Vector3f eye;
-        eye.x() = cameraTarget_.x() + cameraDistance_ * std::cos(cameraPitch_) * std::cos(cameraYaw_);
-        eye.y() = cameraTarget_.y() + cameraDistance_ * std::cos(cameraPitch_) * std::sin(cameraYaw_);
-        eye.z() = cameraTarget_.z() + cameraDistance_ * std::sin(cameraPitch_);
-
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glUseProgram(shaderProgram_);
-
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, viewMatrix.data());
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, projectionMatrix.data());
-        glUniform3fv(lightPosLoc, 1, Eigen::Vector3f(5.0f, 5.0f, 5.0f).data());
-        glUniform3fv(viewPosLoc, 1, eye.data());
-
-        for (size_t i = 0; i < frames_.size(); ++i) {
-            Eigen::Matrix4f modelMatrix = frames_[i]->worldX().matrix();
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, modelMatrix.data());
-
-            if (gpuMeshes_[i].isValid()) {
-                gpuMeshes_[i].draw();
-            } else {
-                fallbackAxes_.draw();
+        renderer_->setFrustumCulling(frustumCulling_);
+        renderer_->setGpuCulling(gpuCulling_);
+        renderer_->setOcclusionCulling(occlusionCulling_);
+        int framebufferWidth, framebufferHeight;
+        {
+            std::lock_guard<std::mutex> lock(inputMutex_);
+            framebufferWidth = framebufferWidth_;
+            framebufferHeight = framebufferHeight_;
+        }
+        glViewport(0, 0, framebufferWidth, framebufferHeight);
+        const bool offscreen = idBuffer_ && framebufferWidth > 0 && framebufferHeight > 0;
+        if (offscreen) {
+            if (!framebuffer_ || framebuffer_->width() != framebufferWidth ||
+                framebuffer_->height() != framebufferHeight) {
+                framebuffer_.reset();
+                framebuffer_ = std::make_unique<Framebuffer>(framebufferWidth, framebufferHeight);
+            }
+            framebuffer_->bind();
+        }
+        renderer_->render(viewMatrix, projectionMatrix);
+        if (offscreen) {
+            readPicks(framebufferWidth, framebufferHeight);
+            framebuffer_->blitColorToWindow();
+        } else {
+            for (auto &request : pickRequests_) {
+                request.onPick(nullptr);
+            }
+            pickRequests_.clear();
+        }
+        collectPicks(false);
+        {
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            publishedStats_ = renderer_->stats();
+        }
+        if (recorder_) {
+            // Reads the back buffer, before the swap leaves its contents undefined.
+            try {
+                recorder_->capture(framebufferWidth, framebufferHeight);
+            } catch (const std::exception &e) {
+                std::cerr << "Viewer: recording stopped: " << e.what() << std::endl;
+                setRecorder(nullptr);
             }
         }
 
         glfwSwapBuffers(window_);
-        glfwPollEvents();
+        if (!threaded_) glfwPollEvents();
     }
 }
 
@@ -456,12 +572,152 @@ Viewer::Viewer(int w, int h, const char *t) {
 }
 
 Viewer::~Viewer() {
+    stop();
     pimpl_.reset();
     glfwTerminate();
 }
 
-void Viewer::addFrame(Frame::Ptr frame) { pimpl_->addFrame(std::move(frame)); }
+void Viewer::addFrame(Frame::Ptr frame) {
+    if (pimpl_->threaded_) {
+        Impl::SceneUpdate update;
+        update.kind = Impl::SceneUpdate::Kind::AddFrame;
+        update.frame = std::move(frame);
+        pimpl_->post(std::move(update));
+    } else {
+        pimpl_->addFrame(frame);
+    }
+}
+
+void Viewer::run() {
+    if (pimpl_->renderThread_.joinable()) throw std::logic_error("Viewer::run: the render thread was started");
+    pimpl_->run();
+}
+
+void Viewer::start() {
+    Impl &impl = *pimpl_;
+    if (impl.renderThread_.joinable()) return;
+    impl.stopRequested_ = false;
+    impl.running_ = true;
+    impl.threaded_ = true;
+    glfwMakeContextCurrent(nullptr);
+    impl.renderThread_ = std::thread([&impl] {
+        glfwMakeContextCurrent(impl.window_);
+        impl.run();
+        glfwMakeContextCurrent(nullptr);
+        impl.running_ = false;
+    });
+}
+
+void Viewer::stop() {
+    Impl &impl = *pimpl_;
+    if (!impl.renderThread_.joinable()) return;
+    impl.stopRequested_ = true;
+    impl.wake();
+    impl.renderThread_.join();
+    // The GL resources are released on this thread.
+    glfwMakeContextCurrent(impl.window_);
+    impl.threaded_ = false;
+    // Updates posted after the loop's last pass, e.g. once the window was closed.
+    impl.applyUpdates();
+}
+
+bool Viewer::running() const { return pimpl_->running_; }
+
+void Viewer::pollEvents(double timeout) {
+    if (timeout > 0.0) {
+        glfwWaitEventsTimeout(timeout);
+    } else {
+        glfwPollEvents();
+    }
+    pimpl_->handleWindowInput();
+}
+
+void Viewer::addPoseBuffer(PoseBuffer::Ptr poses) {
+    if (pimpl_->threaded_) {
+        Impl::SceneUpdate update;
+        update.kind = Impl::SceneUpdate::Kind::AddPoseBuffer;
+        update.poses = std::move(poses);
+        pimpl_->post(std::move(update));
+    } else {
+        pimpl_->poseBuffers_.push_back(std::move(poses));
+    }
+}
+
+void Viewer::startRecording(const std::string &pathPattern, ImageFormat format) {
+    auto recorder = std::make_shared<FrameRecorder>(pathPattern, format);
+    if (pimpl_->threaded_) {
+        Impl::SceneUpdate update;
+        update.kind = Impl::SceneUpdate::Kind::Record;
+        update.recorder = std::move(recorder);
+        pimpl_->post(std::move(update));
+    } else {
+        pimpl_->setRecorder(std::move(recorder));
+    }
+}
 
-void Viewer::run() { pimpl_->run(); }
+void Viewer::stopRecording() {
+    if (pimpl_->threaded_) {
+        Impl::SceneUpdate update;
+        update.kind = Impl::SceneUpdate::Kind::Record;
+        pimpl_->post(std::move(update));
+    } else {
+        pimpl_->setRecorder(nullptr);
+    }
+}
+
+void Viewer::setIdBuffer(bool enabled) {
+    pimpl_->idBuffer_ = enabled;
+    requestRedraw();
+}
+
+void Viewer::pick(double x, double y, PickCallback onPick) { pimpl_->pick({x, y}, std::move(onPick)); }
+
+void Viewer::setClickCallback(PickCallback onClick) { pimpl_->onClick_ = std::move(onClick); }
+
+void Viewer::postTransform(const Frame::Ptr &frame, const Eigen::Isometry3f &X) {
+    Impl::SceneUpdate update;
+    update.kind = Impl::SceneUpdate::Kind::Transform;
+    update.frame = frame;
+    update.X = X;
+    pimpl_->post(std::move(update));
+}
+
+void Viewer::postMesh(const Frame::Ptr &frame, Mesh::Ptr mesh) {
+    Impl::SceneUpdate update;
+    update.kind = Impl::SceneUpdate::Kind::Mesh;
+    update.frame = frame;
+    update.mesh = std::move(mesh);
+    pimpl_->post(std::move(update));
+}
+
+void Viewer::setFrustumCulling(bool enabled) {
+    pimpl_->frustumCulling_ = enabled;
+    requestRedraw();
+}
+
+void Viewer::setGpuCulling(bool enabled) {
+    pimpl_->gpuCulling_ = enabled;
+    requestRedraw();
+}
+
+void Viewer::setRenderOnDemand(bool enabled, double maxLatency) {
+    pimpl_->maxLatency_ = maxLatency;
+    pimpl_->renderOnDemand_ = enabled;
+    requestRedraw();
+}
+
+void Viewer::requestRedraw() { pimpl_->requestRedraw(); }
+
+void Viewer::setOcclusionCulling(bool enabled) {
+    pimpl_->occlusionCulling_ = enabled;
+    requestRedraw();
+}
+
+bool Viewer::gpuCullingSupported() const { return pimpl_->renderer_->gpuCullingSupported(); }
+
+Viewer::Stats Viewer::stats() const {
+    std::lock_guard<std::mutex> lock(pimpl_->statsMutex_);
+    return pimpl_->publishedStats_;
+}
 
 } // namespace toph
\ No newline at end of file
@@ -1,23 +1,104 @@
 #pragma once
 
 #include "frame.h"
+#include "image.h"
+#include "pose_buffer.h"
+#include "renderer.h"
+#include <cstddef>
+#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace toph {
 
 class Viewer {
   public:
+    using Stats = RenderStats;
+    // Receives the frame under the cursor, or nullptr for the background.
+    using PickCallback = std::function<void(const Frame::Ptr &)>;
+
     Viewer(int width = 800, int height = 600, const char *title = "Toph Viewer");
     ~Viewer();
 
     Viewer(const Viewer &) = delete;
     Viewer &operator=(const Viewer &) = delete;
 
+    // Adds the frame and its subtree. While the render thread runs, this is queued like the post*() calls.
     void addFrame(Frame::Ptr frame);
 
+    // Renders on the calling thread until the window is closed.
     void run();
 
+    // Renders on a thread owned by the viewer until the window is closed or stop() is called; the destructor stops it.
+    // The GL context moves to that thread meanwhile, but GLFW only handles window events on the main thread, so the
+    // thread that created the viewer must keep calling pollEvents() for the window to respond to input and closing.
+    // While it runs, change the scene only through the calls below.
+    //
+    // From start() until stop(), addFrame(), addPoseBuffer(), the recording calls and pick() are queued even once the
+    // window was closed and the thread has ended; stop() then takes the context back and applies them.
+    void start();
+    void stop();
+    // False once the render loop has ended, whether or not stop() was called yet.
+    bool running() const;
+    // Handles the pending window events, waiting up to `timeout` seconds for one if there are none, and closes the
+    // window on Escape or Q. Call it from the thread that created the viewer while the render thread runs; run() does
+    // this itself.
+    void pollEvents(double timeout = 0.0);
+
+    // Thread-safe and never block: the update goes into a lock-free queue that the render loop drains before each
+    // frame. Updates posted by one thread are applied in the order they were posted.
+    void postTransform(const Frame::Ptr &frame, const Eigen::Isometry3f &X);
+    void postMesh(const Frame::Ptr &frame, Mesh::Ptr mesh);
+
+    // The render loop applies the newest snapshot published to the buffer before every frame. Meant for a writer
+    // updating many poses at a high rate: publishing is one atomic exchange plus a copy of the poses, and never waits
+    // for the renderer. Its frames must then only be moved through the buffer. In render-on-demand mode, snapshots are
+    // picked up within the maximum latency unless requestRedraw() is called.
+    void addPoseBuffer(PoseBuffer::Ptr poses);
+
+    // Writes every rendered frame to numbered files until stopRecording(); pathPattern holds one %d conversion for the
+    // number, e.g. "frames/%06d.png", and anything else throws std::invalid_argument. Readback goes through a ring of
+    // pixel buffer objects and the files are encoded and written on a thread of the recorder's own, so recording costs
+    // the render loop little more than a copy per frame. Like the post*() calls, both are queued while the render
+    // thread runs; the last frames are written before stopRecording() takes effect.
+    void startRecording(const std::string &pathPattern, ImageFormat format = ImageFormat::Png);
+    void stopRecording();
+
+    // Off by default. When on, run() sleeps until the camera moves, a window event arrives, a frame's transform or mesh
+    // changes or requestRedraw() is called, instead of redrawing continuously. Scene changes are checked at least
+    // every maxLatency seconds; other changes, such as to frameColor, need requestRedraw().
+    // May be called from any thread.
+    void setRenderOnDemand(bool enabled, double maxLatency = 0.1);
+    // May be called from any thread.
+    void requestRedraw();
+
+    // Off by default. When on, frames are drawn into an offscreen target whose second attachment stores the id of the
+    // frame covering each pixel, written by the same draws as the color, and the color is then copied to the window.
+    // May be called from any thread.
+    void setIdBuffer(bool enabled);
+    // Looks up the frame under a cursor position (screen coordinates from the top left, as GLFW reports them) in the
+    // id buffer of the next rendered frame. The one-pixel readback is asynchronous; onPick runs on the render thread a
+    // frame or two later. Without the id buffer, a ray is cast through the cursor against the frames' triangles
+    // instead and onPick runs as soon as the render thread gets the request. Thread-safe.
+    void pick(double x, double y, PickCallback onPick);
+    // Called through pick() when the window is left-clicked without dragging. Set it before start().
+    void setClickCallback(PickCallback onClick);
+
+    // The culling settings may be changed from any thread; they take effect from the next rendered frame.
+    //
+    // On by default. Frames whose world bounds are outside the view frustum are not drawn.
+    void setFrustumCulling(bool enabled);
+    // Off by default. Culls in a compute shader that writes the indirect draws itself; ignored unless
+    // gpuCullingSupported(), which needs a GL 4.3 context. Nothing is read back, so stats() then counts every frame as
+    // visible.
+    void setGpuCulling(bool enabled);
+    // Off by default. After frustum culling, the largest visible meshes are rasterized into a small software depth
+    // buffer and frames hidden behind them are not drawn. Only applies with frustum culling on the CPU.
+    void setOcclusionCulling(bool enabled);
+    bool gpuCullingSupported() const;
+    Stats stats() const;
+
   private:
     struct Impl;
     std::unique_ptr<Impl> pimpl_;